@@ -1,5 +1,5 @@
 #include "pch.h"
-/*
+
 #define TestSuite BinaryMeshTest
 
 TEST(TestSuite, ConterShape)
@@ -13,13 +13,11 @@ TEST(TestSuite, ConterShape)
 		0, 1, 2, // triangle 1
 	};
 	const std::vector<Shape> shapes = {
-		Shape{0, 3, 0, 3, 0, 1, 2}, // shape 1
-	};
-	const std::vector<glm::vec3> instances = {
-		glm::vec3(0.0f),
+		Shape{0, 3, 0, 3, 0}, // shape 1
 	};
 
-	BinaryMesh m(Position | Texcoord0, vertices, indices, shapes, instances);
+	BinaryMesh32 m(Position | Texcoord0, vertices, indices, shapes);
+	m.generateBoundingVolumes();
 	EXPECT_NO_THROW(m.verify());
 
 	m.centerShapes();
@@ -31,6 +29,9 @@ TEST(TestSuite, ConterShape)
 	};
 	
 	EXPECT_EQ(m.getVertices(), expectedVertices);
-	auto mat = glm::vec3(0.5f, 0.5f, 0.0f);
+	ASSERT_EQ(m.getInstanceTransforms().size(), 1);
+	auto mat = glm::mat4(1.0f);
+	mat[3] = glm::vec4(0.5f, 0.5f, 0.0f, 1.0f);
 	EXPECT_EQ(m.getInstanceTransforms()[0], mat);
-}*/
\ No newline at end of file
+	EXPECT_NO_THROW(m.verify());
+}
@@ -1,4 +1,5 @@
 #include "pch.h"
+#include <functional>
 
 #define TestSuite BinaryMeshTest
 
@@ -82,6 +83,154 @@ TEST(TestSuite, RemoveDuplicates)
 	EXPECT_NO_THROW(m1.verify());
 }
 
+TEST(TestSuite, RemoveDuplicatesParallel)
+{
+	// vertices with many duplicates and permutations of the same values
+	const uint32_t stride = 3;
+	std::vector<float> vertices;
+	for (uint32_t i = 0; i < 20000; ++i)
+	{
+		const auto v = float(i * 7 % 1000);
+		const float vertex[][3] = { { v, 1.0f, 2.0f }, { 2.0f, v, 1.0f }, { 1.0f, 2.0f, v } };
+		vertices.insert(vertices.end(), vertex[i % 3], vertex[i % 3] + stride);
+	}
+	const auto numVertices = vertices.size() / stride;
+
+	std::vector<uint32_t> remap;
+	const auto numUnique = generateVertexRemap(vertices.data(), numVertices, stride, 0, stride, remap);
+	std::vector<uint32_t> parallelRemap;
+	const auto numParallelUnique = generateVertexRemap(vertices.data(), numVertices, stride, 0, stride, parallelRemap, true);
+
+	EXPECT_EQ(numUnique, 3000);
+	EXPECT_EQ(numUnique, numParallelUnique);
+	EXPECT_EQ(remap, parallelRemap);
+
+	// remapped vertices must be equal to the first occurrence
+	std::vector<size_t> firstVertex(numUnique, numVertices);
+	for (size_t i = 0; i < numVertices; ++i)
+	{
+		ASSERT_LE(remap[i], i);
+		auto& first = firstVertex[remap[i]];
+		if (first == numVertices) first = i;
+		ASSERT_EQ(memcmp(&vertices[first * stride], &vertices[i * stride], stride * sizeof(float)), 0);
+	}
+}
+
+TEST(TestSuite, WeldVertices)
+{
+	using BinaryMesh = BinaryMesh32;
+
+	const std::vector<float> vertices = {
+		0.0f, 0.0f, 0.0f, 0.0f, 0.0f, // vertex 0
+		1.0f, 0.0f, 0.0f, 1.0f, 0.0f, // vertex 1
+		0.0f, 1.0f, 0.0f, 0.0f, 1.0f, // vertex 2
+		1.00001f, 0.0f, 0.0f, 1.00001f, 0.0f, // vertex 3 (almost vertex 1)
+		0.0f, 0.99999f, 0.0f, 0.5f, 1.0f, // vertex 4 (vertex 2 with different texcoord)
+		1.0f, 1.0f, 0.0f, 1.0f, 1.0f, // vertex 5
+	};
+	const std::vector<uint32_t> indices = {
+		0, 1, 2, // triangle 1
+		3, 5, 4, // triangle 2
+	};
+	const std::vector<Shape> shapes = {
+		Shape{0, 6, 0, 6, 2}, // shape
+	};
+
+	BinaryMesh m1(Position | Texcoord0, vertices, indices, shapes);
+	m1.generateBoundingVolumes();
+	EXPECT_NO_THROW(m1.verify());
+
+	// texcoords must be bitwise equal => vertex 3 stays
+	auto exact = m1;
+	exact.weldVertices(0.001f);
+	EXPECT_EQ(exact.getNumVertices(), 6);
+
+	m1.weldVertices(0.001f, { { Texcoord0, 0.001f } });
+
+	const std::vector<float> expectedVertices = {
+		0.0f, 0.0f, 0.0f, 0.0f, 0.0f, // vertex 0
+		1.0f, 0.0f, 0.0f, 1.0f, 0.0f, // vertex 1
+		0.0f, 1.0f, 0.0f, 0.0f, 1.0f, // vertex 2
+		0.0f, 0.99999f, 0.0f, 0.5f, 1.0f, // vertex 4
+		1.0f, 1.0f, 0.0f, 1.0f, 1.0f, // vertex 5
+	};
+	const std::vector<uint32_t> expectedIndices = {
+		0, 1, 2, // triangle 1
+		1, 4, 3, // triangle 2
+	};
+
+	EXPECT_EQ(m1.getVertices(), expectedVertices);
+	EXPECT_EQ(m1.getIndices(), expectedIndices);
+	EXPECT_EQ(m1.getShapes()[0].vertexCount, 5);
+	// vertex 3 was the only vertex with x > 1
+	m1.generateBoundingVolumes();
+	EXPECT_EQ(m1.getBoundingBox().maxX, 1.0f);
+	EXPECT_NO_THROW(m1.verify());
+}
+
+TEST(TestSuite, ShadowIndices)
+{
+	using BinaryMesh = BinaryMesh16;
+
+	const std::vector<float> vertices = {
+		0.0f, 0.0f, 0.0f, 0.0f, 0.0f, // vertex 0 (shape 1)
+		1.0f, 0.0f, 0.0f, 1.0f, 0.0f, // vertex 1
+		0.0f, 1.0f, 0.0f, 0.0f, 1.0f, // vertex 2
+		1.0f, 0.0f, 0.0f, 0.5f, 0.0f, // vertex 3 (position of vertex 1)
+		0.0f, 1.0f, 0.0f, 0.5f, 1.0f, // vertex 4 (position of vertex 2)
+		1.0f, 1.0f, 0.0f, 1.0f, 1.0f, // vertex 5
+		1.0f, 0.0f, 0.0f, 0.0f, 0.0f, // vertex 0 (shape 2)
+		0.0f, 0.0f, 1.0f, 0.0f, 0.0f, // vertex 1
+		1.0f, 0.0f, 0.0f, 1.0f, 1.0f, // vertex 2 (position of vertex 0)
+	};
+	const std::vector<uint16_t> indices = {
+		0, 1, 2, // triangle 1 (shape 1)
+		3, 5, 4, // triangle 2
+		0, 1, 2, // triangle 1 (shape 2)
+	};
+	const std::vector<Shape> shapes = {
+		Shape{0, 6, 0, 6, 1}, // shape 1
+		Shape{6, 3, 6, 3, 2}, // shape 2
+	};
+
+	BinaryMesh m1(Position | Texcoord0, vertices, indices, shapes);
+	m1.generateBoundingVolumes();
+	EXPECT_TRUE(m1.getShadowIndices().empty());
+
+	m1.generateShadowIndices();
+
+	// vertices are not shared across shapes
+	EXPECT_EQ(m1.getShadowIndices(), std::vector<uint16_t>({ 0, 1, 2, 1, 5, 2, 0, 1, 0 }));
+	EXPECT_EQ(m1.getIndices(), indices);
+	EXPECT_NO_THROW(m1.verify());
+
+	// shadow indices are kept when splitting and merging
+	const auto split = m1.splitShapes();
+	EXPECT_EQ(split[1].getShadowIndices(), std::vector<uint16_t>({ 0, 1, 0 }));
+	EXPECT_EQ(BinaryMesh::mergeShapes(split).getShadowIndices(), m1.getShadowIndices());
+
+	m1.saveToFile("ShadowIndicesTest.bmf");
+	BinaryMesh m2;
+	m2.loadFromFile("ShadowIndicesTest.bmf");
+	EXPECT_EQ(m1.getShadowIndices(), m2.getShadowIndices());
+
+	// vertex operations that change nothing keep the shadow indices
+	m1.removeDuplicateVertices();
+	m1.removeUnusedVertices();
+	m1.weldVertices(0.001f);
+	EXPECT_EQ(m1.getShadowIndices(), m2.getShadowIndices());
+
+	// shadow indices are invalidated by vertex changes
+	m2 = split[0];
+	m2.weldVertices(0.001f, { { Texcoord0, 1.0f } });
+	EXPECT_EQ(m2.getNumVertices(), 4);
+	EXPECT_TRUE(m2.getShadowIndices().empty());
+
+	// shadow indices with wrong positions
+	m1.getShadowIndices()[3] = 0;
+	EXPECT_THROW(m1.verify(), std::runtime_error);
+}
+
 TEST(TestSuite, RemoveUnusedVertices)
 {
 	using BinaryMesh = BinaryMesh32;
@@ -130,6 +279,75 @@ TEST(TestSuite, RemoveUnusedVertices)
 	EXPECT_NO_THROW(m1.verify());
 }
 
+TEST(TestSuite, MultiShape)
+{
+	using BinaryMesh = BinaryMesh32;
+
+	// shapes with duplicated and unused vertices. enough vertices to process the shapes in parallel
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<Shape> shapes;
+	for (uint32_t s = 0; s < 5; ++s)
+	{
+		const auto numQuads = 4000 + s * 500;
+		const auto indexOffset = uint32_t(indices.size());
+		const auto vertexOffset = uint32_t(vertices.size() / 3);
+		for (uint32_t q = 0; q < numQuads; ++q)
+		{
+			// every quad has its own vertices and an unused vertex in between
+			const auto x = float(q % 100);
+			const auto y = float(q / 100 + s);
+			const float quad[] = { x, y, 0.0f, x + 1.0f, y, 0.0f, x + 1.0f, y + 1.0f, 0.0f, -1.0f, -1.0f, -1.0f, x, y + 1.0f, 0.0f };
+			vertices.insert(vertices.end(), quad, quad + 15);
+			const uint32_t quadIndices[] = { 0, 1, 2, 0, 2, 4 };
+			for (auto i : quadIndices)
+				indices.push_back(q * 5 + i);
+		}
+		shapes.push_back(Shape{ indexOffset, numQuads * 6, vertexOffset, numQuads * 5, s });
+	}
+
+	BinaryMesh m1(Position, vertices, indices, shapes);
+	m1.generateBoundingVolumes();
+	EXPECT_NO_THROW(m1.verify());
+
+	// processing the whole mesh must match processing each shape on its own
+	const auto expectSameAsSplit = [&m1](const std::function<void(BinaryMesh&)>& process)
+	{
+		auto splitted = m1.splitShapes();
+		for (auto& m : splitted)
+			process(m);
+		auto expected = BinaryMesh::mergeShapes(splitted);
+
+		auto res = m1;
+		process(res);
+		res.generateBoundingVolumes();
+		expected.generateBoundingVolumes();
+
+		EXPECT_EQ(res.getVertices(), expected.getVertices());
+		EXPECT_EQ(res.getIndices(), expected.getIndices());
+		EXPECT_EQ(res.getShapes().size(), expected.getShapes().size());
+		for (size_t i = 0; i < std::min(res.getShapes().size(), expected.getShapes().size()); ++i)
+		{
+			EXPECT_EQ(res.getShapes()[i].vertexOffset, expected.getShapes()[i].vertexOffset);
+			EXPECT_EQ(res.getShapes()[i].vertexCount, expected.getShapes()[i].vertexCount);
+		}
+		EXPECT_NO_THROW(res.verify());
+		return res;
+	};
+
+	auto res = expectSameAsSplit([](BinaryMesh& m) { m.removeUnusedVertices(); });
+	EXPECT_EQ(res.getNumVertices(), m1.getNumVertices() / 5 * 4);
+	res = expectSameAsSplit([](BinaryMesh& m) { m.removeDuplicateVertices(); });
+	EXPECT_LT(res.getNumVertices(), m1.getNumVertices() / 5 * 2);
+	expectSameAsSplit([](BinaryMesh& m) { m.weldVertices(0.01f); });
+	expectSameAsSplit([](BinaryMesh& m)
+	{
+		std::vector<std::unique_ptr<VertexGenerator>> generators;
+		generators.emplace_back(new NormalGenerator());
+		m.changeAttributes(Position | Normal, generators);
+	});
+}
+
 TEST(TestSuite, Force16Bit)
 {
 	using BinaryMesh = BinaryMesh32;
@@ -159,23 +377,94 @@ TEST(TestSuite, Force16Bit)
 	EXPECT_NO_THROW(m1.verify());
 	
 	auto res = m1.force16BitIndices();
-	EXPECT_EQ(res.size(), 2);
+	// only 6 vertices are used => one chunk
+	ASSERT_EQ(res.size(), 1);
+	EXPECT_NO_THROW(res[0].verify());
+	EXPECT_EQ(res[0].getShapes()[0].materialId, 2);
+
+	// vertices are numbered by their first use
+	EXPECT_EQ(res[0].getIndices(), std::vector<uint16_t>({ 0, 1, 2, 3, 0, 4, 3, 4, 5 }));
+	EXPECT_EQ(res[0].getNumVertices(), 6);
+	for (uint32_t i = 0; i < 6; ++i)
+		EXPECT_EQ(res[0].getVertices()[3 * i], float(i));
+}
+
+TEST(TestSuite, Force16BitSplit)
+{
+	using BinaryMesh = BinaryMesh32;
+
+	// 30000 triangles with separate vertices. the texcoord identifies the vertex
+	const uint32_t numVertices = 90000;
+	std::vector<float> vertices(numVertices * 5, 0.0f);
+	std::vector<uint32_t> indices(numVertices);
+	for (uint32_t i = 0; i < numVertices; ++i)
+	{
+		vertices[i * 5 + 3] = float(i);
+		indices[i] = i;
+	}
+
+	BinaryMesh m1(Position | Texcoord0, vertices, indices, { Shape{ 0, numVertices, 0, numVertices, 7 } });
+	m1.generateBoundingVolumes();
+	EXPECT_NO_THROW(m1.verify());
+
+	auto res = m1.force16BitIndices();
+	ASSERT_EQ(res.size(), 2);
+	EXPECT_TRUE(m1.getVertices().empty());
+
+	// the first chunk holds as many triangles as possible
+	const uint32_t firstTriangles = 65535 / 3;
+	EXPECT_EQ(res[0].getIndices().size(), firstTriangles * 3);
+	EXPECT_EQ(res[1].getIndices().size(), numVertices - firstTriangles * 3);
+	EXPECT_EQ(res[1].getVertices()[3], float(firstTriangles * 3));
+	EXPECT_EQ(res[1].getIndices()[0], 0);
+	EXPECT_EQ(res[1].getShapes()[0].materialId, 7);
 
 	for (auto& r : res)
 		EXPECT_NO_THROW(r.verify());
+}
+
+TEST(TestSuite, Force16BitMultiShape)
+{
+	using BinaryMesh = BinaryMesh32;
+
+	std::vector<float> vertices((4 + 70003 + 4) * 3, -1.0f);
+	// write special values to the used vertices
+	for (size_t i : { 0, 1, 2, 3, 4, 5, 7, 70004, 70005, 70006, 70007, 70008, 70009, 70010 })
+		vertices[i * 3] = float(i);
+	const std::vector<uint32_t> indices = {
+		0, 1, 2, // shape 1
+		0, 1, 3,
+		0, 1, 3, // shape 2
+		70000, 70001, 70002,
+		2, 1, 3, // shape 3
+	};
+	const std::vector<Shape> shapes = {
+		Shape{0, 6, 0, 4, 1},
+		Shape{6, 6, 4, 70003, 2},
+		Shape{12, 3, 70007, 4, 3},
+	};
+
+	BinaryMesh m1(Position, vertices, indices, shapes);
+	m1.generateBoundingVolumes();
+	EXPECT_NO_THROW(m1.verify());
 
-	// test index counts
-	EXPECT_EQ(res[0].getIndices().size(), 3);
-	EXPECT_EQ(res[1].getIndices().size(), 6);
-	// test vertices
-	EXPECT_EQ(res[0].getVertices()[0], vertices[0]);
-	EXPECT_EQ(res[0].getVertices()[3 * 1], vertices[3 * 1]);
-	EXPECT_EQ(res[0].getVertices()[3 * 2], vertices[3 * 3]);
-
-	EXPECT_EQ(res[1].getVertices()[0], vertices[0]);
-	EXPECT_EQ(res[1].getVertices()[3 * 1], vertices[3 * 70000]);
-	// test indices
-	EXPECT_EQ(res[1].getIndices()[0], 1);
+	auto res = m1.force16BitIndices();
+	ASSERT_EQ(res.size(), 2);
+
+	// small shapes stay together
+	EXPECT_EQ(res[0].getShapes().size(), 2);
+	EXPECT_EQ(res[0].getShapes()[1].materialId, 3);
+	EXPECT_EQ(res[0].getIndices(), std::vector<uint16_t>({ 0, 1, 2, 0, 1, 3, 2, 1, 3 }));
+	EXPECT_EQ(res[0].getNumVertices(), 8);
+	EXPECT_EQ(res[0].getVertices()[4 * 3], vertices[70007 * 3]);
+
+	// the big shape only uses 6 vertices
+	EXPECT_EQ(res[1].getShapes()[0].materialId, 2);
+	EXPECT_EQ(res[1].getIndices(), std::vector<uint16_t>({ 0, 1, 2, 3, 4, 5 }));
+	EXPECT_EQ(res[1].getVertices()[3 * 3], vertices[(4 + 70000) * 3]);
+
+	for (auto& r : res)
+		EXPECT_NO_THROW(r.verify());
 }
 
 TEST(TestSuite, BillboardBoundingBox)
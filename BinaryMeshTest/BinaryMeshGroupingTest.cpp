@@ -156,4 +156,163 @@ TEST(TestSuite, MergeError)
 	meshes.emplace_back(Position, std::vector<float>{}, std::vector<uint32_t>{}, std::vector<Shape>{});// , getIdentityVec(0));
 
 	EXPECT_THROW(BinaryMesh::mergeShapes(meshes), std::runtime_error);
-}
\ No newline at end of file
+}
+TEST(TestSuite, MergeByMaterial)
+{
+	using BinaryMesh = BinaryMesh32;
+
+	// one triangle per shape, vertex i is at x = i
+	std::vector<float> vertices;
+	for (uint32_t i = 0; i < 12; ++i)
+	{
+		const float v[] = { float(i), float(i % 3), 0.0f };
+		vertices.insert(vertices.end(), v, v + 3);
+	}
+	const std::vector<uint32_t> indices = {
+		0, 1, 2, // shape 1
+		2, 1, 0, // shape 2
+		0, 2, 1, // shape 3
+		1, 2, 0, // shape 4
+	};
+	const std::vector<Shape> shapes = {
+		Shape{0, 3, 0, 3, 1},
+		Shape{3, 3, 3, 3, 2},
+		Shape{6, 3, 6, 3, 1},
+		Shape{9, 3, 9, 3, 1},
+	};
+
+	BinaryMesh mesh(Position, vertices, indices, shapes);
+	mesh.generateBoundingVolumes();
+	mesh.generateShadowIndices();
+
+	// at most two triangles per merged shape
+	mesh.mergeShapesByMaterial(6);
+	EXPECT_NO_THROW(mesh.verify());
+	ASSERT_EQ(mesh.getShapes().size(), 3);
+	EXPECT_TRUE(mesh.getShadowIndices().empty());
+
+	const auto& s = mesh.getShapes();
+	EXPECT_EQ(s[0].materialId, 1);
+	EXPECT_EQ(s[0].vertexCount, 6);
+	EXPECT_EQ(s[0].indexCount, 6);
+	EXPECT_EQ(s[1].materialId, 2);
+	EXPECT_EQ(s[2].materialId, 1);
+	EXPECT_EQ(s[2].vertexOffset, 9);
+
+	// shape 3 follows shape 1 and its indices are rebased
+	EXPECT_EQ(mesh.getIndices(), std::vector<uint32_t>({ 0, 1, 2, 3, 5, 4, 2, 1, 0, 1, 2, 0 }));
+	EXPECT_EQ(mesh.getVertices()[3 * 3], 6.0f);
+	EXPECT_EQ(mesh.getVertices()[6 * 3], 3.0f);
+	EXPECT_EQ(s[0].bbox.maxX, 8.0f);
+
+	// without limit all shapes of a material are merged. the bounds of modified shapes are recalculated
+	mesh.editShapeVertices(2)[0] = 20.0f;
+	mesh.mergeShapesByMaterial();
+	EXPECT_EQ(mesh.getShapes().size(), 2);
+	EXPECT_EQ(mesh.getShapes()[0].indexCount, 9);
+	EXPECT_FALSE(mesh.hasDirtyShapes());
+	EXPECT_EQ(mesh.getBoundingBox().maxX, 20.0f);
+	EXPECT_NO_THROW(mesh.verify());
+}
+
+TEST(TestSuite, ShapeView)
+{
+	using BinaryMesh = BinaryMesh32;
+
+	const std::vector<float> vertices = {
+	0.0f, 0.0f, 0.0f, 0.0f, 0.0f, // vertex 0
+	1.0f, 0.0f, 1.0f, 0.1f, 0.2f, // vertex 1
+	2.0f, 1.0f, 0.0f, 0.5f, 0.6f, // vertex 2
+	3.0f, 0.0f, 2.0f, 0.7f, 0.9f, // vertex 3
+	4.0f, 0.0f, 2.0f, 0.7f, 0.9f, // vertex 4
+	4.0f, 8.0f, 2.0f, 0.7f, 0.9f, // vertex 5
+	9.0f, 0.0f, 2.0f, 0.7f, 0.9f, // vertex 6
+	};
+	const std::vector<uint32_t> indices = {
+		0, 1, 2, // triangle 1 shape 1
+		1, 2, 3, // triangle 2 shape 1
+		1, 0, 2, // triangle 3 shape 2
+	};
+	const std::vector<Shape> shapes = {
+		Shape{0, 6, 0, 4, 2}, // shape 1
+		Shape{6, 3, 4, 3, 7}, // shape 2
+	};
+
+	BinaryMesh mesh(Texcoord0 | Position, vertices, indices, shapes);
+	mesh.generateBoundingVolumes();
+
+	// the views match the split meshes without copying
+	const auto splitted = mesh.splitShapes();
+	for (size_t i = 0; i < shapes.size(); ++i)
+	{
+		const auto view = mesh.getShapeView(i);
+		EXPECT_NO_THROW(view.verify());
+		EXPECT_EQ(view.getIndices().data(), mesh.getIndices().data() + shapes[i].indexOffset);
+		EXPECT_EQ(std::vector<uint32_t>(view.getIndices().begin(), view.getIndices().end()), splitted[i].getIndices());
+		EXPECT_EQ(std::vector<float>(view.getVertices().begin(), view.getVertices().end()), splitted[i].getVertices());
+		EXPECT_EQ(view.getMaterialId(), shapes[i].materialId);
+		EXPECT_EQ(view.getNumVertices(), shapes[i].vertexCount);
+		EXPECT_EQ(view.calcBoundingBox(), splitted[i].getBoundingBox());
+		EXPECT_EQ(view.calcBoundingSphere(), splitted[i].getBoundingSphere());
+		EXPECT_EQ(view.getBoundingBox(), mesh.getShapes()[i].bbox);
+	}
+
+	const auto view = mesh.getShapeView(1);
+	EXPECT_EQ(view.getPosition(2), glm::vec3(9.0f, 0.0f, 2.0f));
+	EXPECT_EQ(view.getVertex(1)[getAttributeElementOffset(Texcoord0 | Position, Texcoord0)], 0.7f);
+	EXPECT_THROW(mesh.getShapeView(2), std::out_of_range);
+}
+
+TEST(TestSuite, MergeMove)
+{
+	using BinaryMesh = BinaryMesh32;
+
+	// grid of single triangle shapes
+	std::vector<BinaryMesh> meshes;
+	for (uint32_t i = 0; i < 20; ++i)
+	{
+		const float x = float(i % 5) * 3.0f;
+		const float y = float(i / 5) * 3.0f;
+		std::vector<float> vertices = { x, y, 0.0f, x + 1.0f, y, 0.0f, x, y + 1.0f, 1.0f };
+		meshes.emplace_back(Position, std::move(vertices), std::vector<uint32_t>{ 0, 1, 2 }, std::vector<Shape>{ Shape{ 0, 3, 0, 3, i } });
+		meshes.back().generateBoundingVolumes();
+		meshes.back().generateShadowIndices();
+	}
+
+	const auto copied = BinaryMesh::mergeShapes(meshes);
+	EXPECT_NO_THROW(copied.verify());
+	EXPECT_EQ(copied.getShapes().size(), 20);
+	EXPECT_EQ(copied.getShapes()[7].vertexOffset, 21);
+	EXPECT_EQ(copied.getShapes()[7].indexOffset, 21);
+	EXPECT_EQ(copied.getShadowIndices().size(), 60);
+
+	// the sphere is derived from the input spheres
+	EXPECT_EQ(copied.getBoundingBox().maxX, 13.0f);
+	EXPECT_LT(copied.getBoundingSphere().radius, 12.0f);
+
+	auto moved = BinaryMesh::mergeShapes(std::move(meshes));
+	EXPECT_NO_THROW(moved.verify());
+	EXPECT_EQ(moved.getVertices(), copied.getVertices());
+	EXPECT_EQ(moved.getIndices(), copied.getIndices());
+	EXPECT_EQ(moved.getShadowIndices(), copied.getShadowIndices());
+	EXPECT_EQ(moved.getBoundingSphere(), copied.getBoundingSphere());
+	EXPECT_EQ(moved.getShapes().back().vertexOffset, 57);
+}
+
+TEST(TestSuite, MergeBillboards)
+{
+	std::vector<BinaryMesh> meshes;
+	meshes.emplace_back(Position | Width, std::vector<float>{ 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.5f });
+	meshes.emplace_back(Position | Width, std::vector<float>{ 10.0f, 0.0f, 0.0f, 2.0f });
+	for (auto& m : meshes)
+		m.generateBoundingVolumes();
+
+	const auto copied = BinaryMesh::merge(meshes);
+	const auto moved = BinaryMesh::merge(std::move(meshes));
+	EXPECT_NO_THROW(moved.verify());
+	EXPECT_EQ(moved.getVertices(), copied.getVertices());
+	EXPECT_EQ(moved.getVertices().size(), 12);
+	EXPECT_EQ(moved.getBoundingBox().maxX, 12.0f);
+	EXPECT_EQ(moved.getBoundingBox().minX, -1.0f);
+	EXPECT_TRUE(moved.getBoundingSphere().isInside(glm::vec3(12.0f, 0.0f, 0.0f)));
+}
@@ -28,4 +28,21 @@ TEST(TestSuite, SphereUnion)
 	// point inside
 	res = s.unionWith(glm::vec3(0.5f, 0.0f, 0.0f));
 	ASSERT_EQ(s, res); // should remain unchanged
-}
\ No newline at end of file
+}
+
+TEST(TestSuite, SphereUnionSphere)
+{
+	Sphere s = Sphere{ glm::vec3(0.0f), 1.0f };
+
+	// disjoint spheres
+	auto res = s.unionWith(Sphere{ glm::vec3(4.0f, 0.0f, 0.0f), 2.0f });
+	ASSERT_NEAR(res.radius, 3.5f, 0.001f);
+	ASSERT_NEAR(res.center.x, 2.5f, 0.001f);
+	ASSERT_TRUE(res.isInside(glm::vec3(-1.0f, 0.0f, 0.0f)));
+	ASSERT_TRUE(res.isInside(glm::vec3(6.0f, 0.0f, 0.0f)));
+
+	// contained spheres
+	ASSERT_EQ(s.unionWith(Sphere{ glm::vec3(0.5f, 0.0f, 0.0f), 0.5f }), s);
+	const auto big = Sphere{ glm::vec3(1.0f, 0.0f, 0.0f), 5.0f };
+	ASSERT_EQ(s.unionWith(big), big);
+}
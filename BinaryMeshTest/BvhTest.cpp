@@ -0,0 +1,152 @@
+#include "pch.h"
+#include "TestHelpers.h"
+
+#define TestSuite BvhTest
+
+namespace
+{
+	// bumpy grid with size x size quads per shape. shape s is moved by s along x and z
+	BinaryMesh32 createBumpyGrid(uint32_t size, uint32_t numShapes)
+	{
+		return createGrid(size, numShapes, [](uint32_t s, uint32_t x, uint32_t y)
+		{
+			return glm::vec3(float(x + s), float(y), float(s) + 0.5f * std::sin(float(x * 3 + y * 7)));
+		});
+	}
+
+	glm::vec3 getTriangleVertex(const BinaryMesh32& mesh, uint32_t shape, uint32_t triangle, uint32_t corner)
+	{
+		const auto& s = mesh.getShapes()[shape];
+		const auto index = mesh.getIndices()[s.indexOffset + triangle * 3 + corner];
+		return toVec3(mesh.getVertices().data() + (s.vertexOffset + index) * 3);
+	}
+
+	// closest hit by testing all triangles
+	bool bruteForceRay(const BinaryMesh32& mesh, Ray ray, RayHit& hit)
+	{
+		bool found = false;
+		for (uint32_t shape = 0; shape < mesh.getShapes().size(); ++shape)
+		{
+			for (uint32_t t = 0; t < mesh.getShapes()[shape].indexCount / 3; ++t)
+			{
+				float dist, u, v;
+				if (!intersectRayTriangle(ray, getTriangleVertex(mesh, shape, t, 0), getTriangleVertex(mesh, shape, t, 1),
+					getTriangleVertex(mesh, shape, t, 2), dist, u, v)) continue;
+				ray.tMax = dist;
+				hit = RayHit{ shape, t, dist, u, v };
+				found = true;
+			}
+		}
+		return found;
+	}
+}
+
+TEST(TestSuite, RayQuery)
+{
+	auto mesh = createBumpyGrid(24, 3);
+	mesh.buildBvh();
+	EXPECT_NO_THROW(mesh.verify());
+	EXPECT_EQ(mesh.getBvhOffsets().size(), 4);
+	EXPECT_EQ(mesh.getBvhTriangles().size(), mesh.getIndices().size() / 3);
+	EXPECT_EQ(mesh.getTopLevelBvhShapes().size(), 3);
+
+	size_t numHits = 0;
+	for (uint32_t i = 0; i < 200; ++i)
+	{
+		const auto origin = glm::vec3(float(i % 29), float(i % 23), 10.0f);
+		const auto direction = glm::vec3(0.05f * float(i % 7) - 0.15f, 0.04f * float(i % 5) - 0.08f, -1.0f);
+		const Ray ray = { origin, direction, 0.0f, 100.0f };
+
+		RayHit expected = {};
+		RayHit hit = {};
+		const bool found = mesh.intersectRay(ray, hit);
+		ASSERT_EQ(found, bruteForceRay(mesh, ray, expected));
+		if (!found) continue;
+		++numHits;
+		EXPECT_FLOAT_EQ(hit.t, expected.t);
+		EXPECT_EQ(hit.shape, expected.shape);
+	}
+	EXPECT_GT(numHits, 100u);
+
+	// the ray interval is respected
+	RayHit hit;
+	EXPECT_FALSE(mesh.intersectRay(Ray{ glm::vec3(5.0f, 5.0f, 10.0f), glm::vec3(0.0f, 0.0f, -1.0f), 0.0f, 5.0f }, hit));
+	EXPECT_TRUE(mesh.intersectRay(Ray{ glm::vec3(5.0f, 5.0f, 10.0f), glm::vec3(0.0f, 0.0f, -1.0f), 0.0f, 15.0f }, hit));
+	EXPECT_EQ(hit.shape, 2);
+}
+
+TEST(TestSuite, BoxQuery)
+{
+	auto mesh = createBumpyGrid(16, 2);
+	mesh.buildBvh(2);
+	EXPECT_NO_THROW(mesh.verify());
+
+	const BoundingBox boxes[] = {
+		BoundingBox{ 2.5f, 3.5f, -1.0f, 6.0f, 4.0f, 0.2f },
+		BoundingBox{ 0.0f, 0.0f, 0.8f, 20.0f, 20.0f, 1.0f },
+		BoundingBox{ 30.0f, 30.0f, 30.0f, 31.0f, 31.0f, 31.0f },
+	};
+	for (const auto& box : boxes)
+	{
+		std::vector<ShapeTriangle> result;
+		mesh.queryBox(box, result);
+
+		std::vector<std::pair<uint32_t, uint32_t>> expected;
+		for (uint32_t shape = 0; shape < 2; ++shape)
+		{
+			for (uint32_t t = 0; t < mesh.getShapes()[shape].indexCount / 3; ++t)
+			{
+				if (overlapBoxTriangle(box, getTriangleVertex(mesh, shape, t, 0), getTriangleVertex(mesh, shape, t, 1),
+					getTriangleVertex(mesh, shape, t, 2)))
+					expected.emplace_back(shape, t);
+			}
+		}
+
+		std::vector<std::pair<uint32_t, uint32_t>> actual;
+		for (const auto& r : result)
+			actual.emplace_back(r.shape, r.triangle);
+		std::sort(actual.begin(), actual.end());
+		EXPECT_EQ(actual, expected);
+	}
+
+	// box and triangle touch only in the corner region of the bounding box
+	EXPECT_FALSE(overlapBoxTriangle(BoundingBox{ 0.6f, 0.6f, -1.0f, 1.0f, 1.0f, 1.0f },
+		glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+}
+
+TEST(TestSuite, BvhLoadSave)
+{
+	auto mesh = createBumpyGrid(8, 3);
+	mesh.buildBvh();
+	mesh.saveToFile("BvhTest.bmf");
+
+	BinaryMesh32 loaded;
+	loaded.loadFromFile("BvhTest.bmf");
+	EXPECT_EQ(loaded.getBvhOffsets(), mesh.getBvhOffsets());
+	EXPECT_EQ(loaded.getBvhTriangles(), mesh.getBvhTriangles());
+	EXPECT_EQ(loaded.getTopLevelBvhShapes(), mesh.getTopLevelBvhShapes());
+	ASSERT_EQ(loaded.getBvhNodes().size(), mesh.getBvhNodes().size());
+	EXPECT_EQ(memcmp(loaded.getBvhNodes().data(), mesh.getBvhNodes().data(), mesh.getBvhNodes().size() * sizeof(BvhNode)), 0);
+	EXPECT_NO_THROW(loaded.verify());
+
+	// split and merge keeps the shape bvhs
+	const auto split = mesh.splitShapes();
+	EXPECT_NO_THROW(split[1].verify());
+	const auto merged = BinaryMesh32::mergeShapes(split);
+	EXPECT_EQ(merged.getBvhOffsets(), mesh.getBvhOffsets());
+	EXPECT_EQ(merged.getBvhTriangles(), mesh.getBvhTriangles());
+	EXPECT_NO_THROW(merged.verify());
+
+	RayHit hit;
+	EXPECT_TRUE(merged.intersectRay(Ray{ glm::vec3(4.5f, 4.5f, 10.0f), glm::vec3(0.0f, 0.0f, -1.0f), 0.0f, 100.0f }, hit));
+	EXPECT_EQ(hit.shape, 2);
+
+	// modifying the index buffer discards the bvh
+	mesh.optimizeVertexCache();
+	EXPECT_TRUE(mesh.getBvhNodes().empty());
+	EXPECT_TRUE(mesh.getTopLevelBvhNodes().empty());
+	EXPECT_NO_THROW(mesh.verify());
+	EXPECT_THROW(mesh.intersectRay(Ray{ glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), 0.0f, 1.0f }, hit), std::runtime_error);
+	std::vector<ShapeTriangle> result;
+	EXPECT_THROW(mesh.queryBox(BoundingBox{ 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f }, result), std::runtime_error);
+}
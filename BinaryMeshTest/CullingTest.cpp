@@ -0,0 +1,127 @@
+#include "pch.h"
+#include "TestHelpers.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#define TestSuite CullingTest
+
+namespace
+{
+	// random boxes with their bounding spheres
+	std::vector<Shape> createShapes(size_t count, float extent)
+	{
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<float> pos(-extent, extent);
+		std::uniform_real_distribution<float> size(0.1f, 2.0f);
+		std::vector<Shape> shapes(count);
+		for (auto& s : shapes)
+		{
+			const auto center = glm::vec3(pos(rng), pos(rng), pos(rng));
+			const auto half = glm::vec3(size(rng), size(rng), size(rng));
+			s.bbox = BoundingBox{ center.x - half.x, center.y - half.y, center.z - half.z, center.x + half.x, center.y + half.y, center.z + half.z };
+			s.sphere = Sphere{ center, glm::length(half) };
+		}
+		return shapes;
+	}
+
+	// per shape loop over the interleaved shape data
+	void naiveCull(const std::vector<Shape>& shapes, const Frustum& frustum, std::vector<uint32_t>& visible)
+	{
+		for (uint32_t i = 0; i < uint32_t(shapes.size()); ++i)
+		{
+			if (frustum.isVisible(shapes[i].bbox, shapes[i].sphere))
+				visible.push_back(i);
+		}
+	}
+
+	Shape createShape(const glm::vec3& center, float halfSize)
+	{
+		Shape s = {};
+		s.bbox = BoundingBox{ center.x - halfSize, center.y - halfSize, center.z - halfSize, center.x + halfSize, center.y + halfSize, center.z + halfSize };
+		s.sphere = Sphere{ center, halfSize * 1.75f };
+		return s;
+	}
+}
+
+TEST(TestSuite, FrustumPlanes)
+{
+	const auto frustum = Frustum::fromMatrix(createViewProjection(1.0f, 100.0f));
+	const std::vector<Shape> shapes = {
+		createShape(glm::vec3(0.0f, 0.0f, 10.0f), 1.0f), // in front
+		createShape(glm::vec3(0.0f, 0.0f, -10.0f), 1.0f), // behind
+		createShape(glm::vec3(30.0f, 0.0f, 10.0f), 1.0f), // right
+		createShape(glm::vec3(0.0f, -30.0f, 10.0f), 1.0f), // below
+		createShape(glm::vec3(0.0f, 0.0f, 150.0f), 1.0f), // too far
+		createShape(glm::vec3(10.5f, 0.0f, 10.0f), 1.0f), // intersects the right plane
+		createShape(glm::vec3(0.0f, 0.0f, 0.5f), 1.0f), // intersects the near plane
+		// the sphere intersects the left plane but the box is outside
+		createShape(glm::vec3(-12.2f, 0.0f, 10.0f), 1.0f),
+	};
+
+	std::vector<uint32_t> visible;
+	naiveCull(shapes, frustum, visible);
+	EXPECT_EQ(visible, std::vector<uint32_t>({ 0, 5, 6 }));
+
+	// the result is appended
+	visible = { 42 };
+	FrustumCuller(shapes).cull(frustum, visible);
+	EXPECT_EQ(visible, std::vector<uint32_t>({ 42, 0, 5, 6 }));
+}
+
+TEST(TestSuite, MatchesNaiveCulling)
+{
+	// not a multiple of the batch size
+	const auto shapes = createShapes(1001, 50.0f);
+	const auto frustum = Frustum::fromMatrix(createViewProjection(0.5f, 40.0f));
+	FrustumCuller culler(shapes);
+	EXPECT_EQ(culler.size(), shapes.size());
+
+	std::vector<uint32_t> expected;
+	std::vector<uint32_t> visible;
+	naiveCull(shapes, frustum, expected);
+	culler.cull(frustum, visible);
+	EXPECT_EQ(visible, expected);
+	EXPECT_GT(expected.size(), 10u);
+	EXPECT_LT(expected.size(), shapes.size() / 2);
+
+	// update a single shape
+	culler.setBounds(3, BoundingBox{ -1.0f, -1.0f, 9.0f, 1.0f, 1.0f, 11.0f }, Sphere{ glm::vec3(0.0f, 0.0f, 10.0f), 1.8f });
+	visible.clear();
+	culler.cull(frustum, visible);
+	EXPECT_NE(std::find(visible.begin(), visible.end(), 3u), visible.end());
+
+	// mesh shapes
+	BinaryMesh32 mesh(Position, { 0.0f, 0.0f, 5.0f, 1.0f, 0.0f, 5.0f, 0.0f, 1.0f, 5.0f }, { 0, 1, 2 }, { Shape{ 0, 3, 0, 3, 0 } });
+	mesh.generateBoundingVolumes();
+	visible.clear();
+	FrustumCuller(mesh.getShapes()).cull(frustum, visible);
+	EXPECT_EQ(visible, std::vector<uint32_t>({ 0 }));
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST(TestSuite, DISABLED_Benchmark)
+{
+	const auto shapes = createShapes(100000, 100.0f);
+	const auto frustum = Frustum::fromMatrix(createViewProjection(0.5f, 60.0f));
+	const FrustumCuller culler(shapes);
+	const int numRuns = 100;
+
+	std::vector<uint32_t> expected;
+	std::vector<uint32_t> visible;
+	const auto measureMs = [&](const auto& func)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < numRuns; ++i) func();
+		const auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count() / numRuns;
+	};
+	const auto naiveMs = measureMs([&] { expected.clear(); naiveCull(shapes, frustum, expected); });
+	const auto batchedMs = measureMs([&] { visible.clear(); culler.cull(frustum, visible); });
+
+	std::cout << "shapes:             " << shapes.size() << " => " << expected.size() << " visible\n";
+	std::cout << "naive:              " << naiveMs << " ms\n";
+	std::cout << "FrustumCuller:      " << batchedMs << " ms\n";
+
+	EXPECT_EQ(visible, expected);
+}
@@ -1,54 +1,200 @@
 #include "pch.h"
-/*
-#define TestSuite BinaryMeshTest
 
-TEST(TestSuite, InstanceMerge)
+#define TestSuite DeinstanceTest
+
+namespace
 {
-	const std::vector<float> vertices1 = {
-		0.0f, 0.0f, 0.0f, 0.0f, 0.0f, // vertex 1
-		1.0f, 0.0f, 1.0f, 0.1f, 0.2f, // vertex 2
-		2.0f, 1.0f, 0.0f, 0.5f, 0.6f, // vertex 3
-		3.0f, 0.0f, 2.0f, 0.7f, 0.9f, // vertex 4
-	};
-	const std::vector<uint32_t> indices1 = {
-		0, 1, 2, // triangle 1
-		1, 2, 3, // triangle 2
-	};
-	const std::vector<Shape> shapes1 = {
-		Shape{0, 6, 0, 4, 0, 1, 2}, // shape 1
-	};
-	const std::vector<glm::vec3> instances1 = {
-		glm::vec3(0.0f),
+	constexpr uint32_t Attribs = Position | Normal | Texcoord0;
+
+	// tetrahedron with position, normal and texcoord
+	const std::vector<float> tetrahedron = {
+		0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+		1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.1f, 0.2f,
+		2.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.5f, 0.6f,
+		3.0f, 0.0f, 2.0f, 0.0f, 0.0f, -1.0f, 0.7f, 0.9f,
 	};
+	const std::vector<uint32_t> tetrahedronIndices = { 0, 1, 2, 1, 2, 3, 0, 3, 2 };
+
+	glm::vec3 getPosition(const std::vector<float>& vertices, size_t vertex)
+	{
+		return toVec3(vertices.data() + vertex * 8);
+	}
+
+	// applies the transform to the positions and the rotation to the normals
+	std::vector<float> transformVertices(std::vector<float> vertices, const glm::mat4& transform, const glm::mat3& rotation)
+	{
+		for (size_t i = 0; i < vertices.size(); i += 8)
+		{
+			const auto p = transform * glm::vec4(toVec3(&vertices[i]), 1.0f);
+			const auto n = rotation * toVec3(&vertices[i + 3]);
+			const float v[] = { p.x, p.y, p.z, n.x, n.y, n.z };
+			std::copy(v, v + 6, vertices.begin() + i);
+		}
+		return vertices;
+	}
 
-	std::vector<float> vertices2 = vertices1;
-	glm::vec3 transVec = glm::vec3(10.0f, -200.0f, 1.0f);
-	const auto stride = getAttributeElementStride(Position | Texcoord0);
-	for(size_t i = 0; i < vertices2.size(); i += stride)
+	BinaryMesh32 createMesh(const std::vector<std::vector<float>>& shapeVertices)
 	{
-		auto res = transVec + glm::vec3(vertices2[i], vertices2[i + 1], vertices2[i + 2]);
-		vertices2[i] = res.x;
-		vertices2[i + 1] = res.y;
-		vertices2[i + 2] = res.z;
+		std::vector<float> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<Shape> shapes;
+		for (const auto& v : shapeVertices)
+		{
+			shapes.push_back(Shape{ uint32_t(indices.size()), uint32_t(tetrahedronIndices.size()),
+				uint32_t(vertices.size() / 8), uint32_t(v.size() / 8), 0 });
+			vertices.insert(vertices.end(), v.begin(), v.end());
+			indices.insert(indices.end(), tetrahedronIndices.begin(), tetrahedronIndices.end());
+		}
+		BinaryMesh32 res(Attribs, std::move(vertices), std::move(indices), std::move(shapes));
+		res.generateBoundingVolumes();
+		return res;
 	}
 
-	std::vector<BinaryMesh> meshes;
-	meshes.emplace_back(Position | Texcoord0, vertices1, indices1, shapes1, instances1);
-	meshes.emplace_back(Position | Texcoord0, vertices2, indices1, shapes1, instances1);
-	EXPECT_NO_THROW(meshes[0].verify());
-	EXPECT_NO_THROW(meshes[1].verify());
-
-	BinaryMesh::deinstanceShapes(meshes);
-	
-	// should be succesfull deinstance
-	EXPECT_EQ(meshes.size(), 1);
-	EXPECT_EQ(meshes[0].getShapes().size(), 1);
-	EXPECT_EQ(meshes[0].getInstanceTransforms().size(), 2);
-	auto transVec2 = meshes[0].getInstanceTransforms()[1];
-	// transform matrices
-	
-	for (glm::length_t i = 0; i < 3; ++i)
-		EXPECT_LT(std::abs(transVec[i] - transVec2[i]), 0.0001f);
-
-	EXPECT_NO_THROW(meshes[0].verify());
-}*/
\ No newline at end of file
+	void expectTransformed(const std::vector<float>& src, const glm::mat4& transform, const std::vector<float>& dst)
+	{
+		for (size_t v = 0; v < src.size() / 8; ++v)
+		{
+			const auto p = glm::vec3(transform * glm::vec4(getPosition(src, v), 1.0f));
+			EXPECT_LT(glm::distance(p, getPosition(dst, v)), 0.001f);
+		}
+	}
+
+	// rotation by 90 degree around z
+	const glm::mat3 rotationZ(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
+	glm::mat4 toMat4(const glm::mat3& rotation, const glm::vec3& translation)
+	{
+		glm::mat4 res(1.0f);
+		for (int i = 0; i < 3; ++i)
+			res[i] = glm::vec4(rotation[i], 0.0f);
+		res[3] = glm::vec4(translation, 1.0f);
+		return res;
+	}
+}
+
+TEST(TestSuite, InstanceMerge)
+{
+	const auto translation = toMat4(glm::mat3(1.0f), glm::vec3(10.0f, -200.0f, 1.0f));
+	const auto rotation = toMat4(rotationZ, glm::vec3(5.0f, 2.0f, -3.0f));
+	auto otherTexcoord = tetrahedron;
+	otherTexcoord[6] = 0.5f;
+	// mirroring flips the winding
+	const auto mirror = toMat4(glm::mat3(glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)), glm::vec3(0.0f));
+
+	const std::vector<std::vector<float>> shapeVertices = {
+		tetrahedron,
+		transformVertices(tetrahedron, translation, glm::mat3(1.0f)),
+		otherTexcoord,
+		transformVertices(tetrahedron, rotation, rotationZ),
+		transformVertices(tetrahedron, mirror, glm::mat3(1.0f)),
+	};
+	auto mesh = createMesh(shapeVertices);
+
+	EXPECT_EQ(mesh.deinstanceShapes(), 2);
+	EXPECT_NO_THROW(mesh.verify());
+	ASSERT_EQ(mesh.getShapes().size(), 3);
+	EXPECT_EQ(mesh.getNumVertices(), 12);
+	EXPECT_EQ(mesh.getInstanceOffsets(), std::vector<uint32_t>({ 0, 3, 4, 5 }));
+
+	// the instances reproduce the original shapes
+	const auto& instances = mesh.getInstanceTransforms();
+	expectTransformed(tetrahedron, instances[0], shapeVertices[0]);
+	expectTransformed(tetrahedron, instances[1], shapeVertices[1]);
+	expectTransformed(tetrahedron, instances[2], shapeVertices[3]);
+
+	// nothing left to merge
+	EXPECT_EQ(mesh.deinstanceShapes(), 0);
+	EXPECT_EQ(mesh.getInstanceTransforms().size(), 5);
+}
+
+TEST(TestSuite, PlanarInstance)
+{
+	// all positions in the z = 0 plane
+	auto planar = tetrahedron;
+	for (size_t i = 0; i < planar.size(); i += 8)
+		planar[i + 2] = 0.0f;
+	const auto transform = toMat4(rotationZ * 2.0f, glm::vec3(1.0f, 2.0f, 3.0f));
+
+	auto mesh = createMesh({ planar, transformVertices(planar, transform, rotationZ) });
+	EXPECT_EQ(mesh.deinstanceShapes(), 1);
+	ASSERT_EQ(mesh.getInstanceTransforms().size(), 2);
+	expectTransformed(planar, mesh.getInstanceTransforms()[1], transformVertices(planar, transform, rotationZ));
+}
+
+TEST(TestSuite, MirroredCandidate)
+{
+	// same index pattern, but mirrored => no instance of the first shape
+	const glm::mat3 mirrorX(glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	const auto mirrored = transformVertices(tetrahedron, toMat4(mirrorX, glm::vec3(2.0f, -3.0f, 5.0f)), mirrorX);
+	const auto translation = toMat4(glm::mat3(1.0f), glm::vec3(1.0f, 2.0f, 3.0f));
+
+	auto mesh = createMesh({ tetrahedron, mirrored, transformVertices(tetrahedron, translation, glm::mat3(1.0f)) });
+	EXPECT_EQ(mesh.deinstanceShapes(), 1);
+	ASSERT_EQ(mesh.getShapes().size(), 2);
+	ASSERT_EQ(mesh.getInstanceOffsets(), std::vector<uint32_t>({ 0, 2, 3 }));
+
+	// the kept shape is not transformed by the failed match
+	EXPECT_EQ(mesh.getInstanceTransforms()[2], glm::mat4(1.0f));
+	const auto& s = mesh.getShapes()[1];
+	expectTransformed(mirrored, glm::mat4(1.0f), std::vector<float>(mesh.getVertices().begin() + s.vertexOffset * 8,
+		mesh.getVertices().begin() + (s.vertexOffset + s.vertexCount) * 8));
+	EXPECT_NO_THROW(mesh.verify());
+}
+
+TEST(TestSuite, NoInstances)
+{
+	auto mesh = createMesh({ tetrahedron });
+	EXPECT_EQ(mesh.deinstanceShapes(), 0);
+	EXPECT_TRUE(mesh.getInstanceTransforms().empty());
+	EXPECT_TRUE(mesh.getInstanceOffsets().empty());
+	EXPECT_NO_THROW(mesh.verify());
+}
+
+TEST(TestSuite, InstanceLoadSave)
+{
+	const auto translation = toMat4(glm::mat3(1.0f), glm::vec3(1.0f, 2.0f, 3.0f));
+	auto mesh = createMesh({ tetrahedron, transformVertices(tetrahedron, translation, glm::mat3(1.0f)), tetrahedron });
+	EXPECT_EQ(mesh.deinstanceShapes(), 2);
+	mesh.saveToFile("InstanceTest.bmf");
+
+	BinaryMesh32 loaded;
+	loaded.loadFromFile("InstanceTest.bmf");
+	EXPECT_EQ(loaded.getInstanceOffsets(), mesh.getInstanceOffsets());
+	ASSERT_EQ(loaded.getInstanceTransforms().size(), 3);
+	EXPECT_EQ(memcmp(loaded.getInstanceTransforms().data(), mesh.getInstanceTransforms().data(), 3 * sizeof(glm::mat4)), 0);
+	EXPECT_NO_THROW(loaded.verify());
+
+	// split and merge keeps the instances. meshes without instances get an identity instance
+	auto meshes = mesh.splitShapes();
+	meshes.push_back(createMesh({ tetrahedron }));
+	const auto merged = BinaryMesh32::mergeShapes(meshes);
+	EXPECT_EQ(merged.getInstanceOffsets(), std::vector<uint32_t>({ 0, 3, 4 }));
+	EXPECT_NO_THROW(merged.verify());
+
+	// index changes keep the instances
+	auto m16 = loaded.force16BitIndices();
+	ASSERT_EQ(m16.size(), 1);
+	EXPECT_EQ(m16[0].getInstanceOffsets(), mesh.getInstanceOffsets());
+
+	EXPECT_THROW(MixedBinaryMesh{ mesh }, std::runtime_error);
+}
+
+TEST(TestSuite, CenterShapes)
+{
+	const auto translation = toMat4(glm::mat3(1.0f), glm::vec3(10.0f, 0.0f, 0.0f));
+	const auto moved = transformVertices(tetrahedron, translation, glm::mat3(1.0f));
+	auto mesh = createMesh({ tetrahedron, moved });
+	mesh.centerShapes();
+	EXPECT_NO_THROW(mesh.verify());
+	ASSERT_EQ(mesh.getInstanceTransforms().size(), 2);
+
+	// the tetrahedron bounding box is [0, 3] x [0, 1] x [0, 2]
+	EXPECT_EQ(getPosition(mesh.getVertices(), 0), glm::vec3(-1.5f, -0.5f, -1.0f));
+	EXPECT_EQ(getPosition(mesh.getVertices(), 4), glm::vec3(-1.5f, -0.5f, -1.0f));
+	expectTransformed(std::vector<float>(mesh.getVertices().begin(), mesh.getVertices().begin() + 32), mesh.getInstanceTransforms()[0], tetrahedron);
+	expectTransformed(std::vector<float>(mesh.getVertices().begin() + 32, mesh.getVertices().end()), mesh.getInstanceTransforms()[1], moved);
+
+	// the centered shapes are instances of each other
+	EXPECT_EQ(mesh.deinstanceShapes(), 1);
+	EXPECT_EQ(mesh.getInstanceOffsets(), std::vector<uint32_t>({ 0, 2 }));
+}
@@ -0,0 +1,222 @@
+#include "pch.h"
+#include "TestHelpers.h"
+
+#define TestSuite DirtyShapesTest
+
+namespace
+{
+	// size x size quads in [0, 1]^2 per shape. shape s is moved by 2 * s along x
+	BinaryMesh32 createUnitGrid(uint32_t size, uint32_t numShapes)
+	{
+		return createGrid(size, numShapes, [size](uint32_t s, uint32_t x, uint32_t y)
+		{
+			return glm::vec3(float(x) / float(size) + 2.0f * float(s), float(y) / float(size), 0.1f * float(x % 2));
+		});
+	}
+}
+
+TEST(TestSuite, EditVertices)
+{
+	auto mesh = createUnitGrid(4, 3);
+	const auto shape0 = mesh.getShapes()[0];
+	EXPECT_FALSE(mesh.hasDirtyShapes());
+
+	// lift the second shape
+	auto vertices = mesh.editShapeVertices(1);
+	for (size_t i = 2; i < vertices.size(); i += 3)
+		vertices[i] += 5.0f;
+	EXPECT_FALSE(mesh.isShapeDirty(0));
+	EXPECT_TRUE(mesh.isShapeDirty(1));
+	EXPECT_FALSE(mesh.isShapeDirty(2));
+	EXPECT_THROW(mesh.verify(), std::runtime_error);
+	EXPECT_THROW(mesh.verify(true), std::runtime_error);
+
+	mesh.updateBoundingVolumes();
+	EXPECT_FALSE(mesh.hasDirtyShapes());
+	EXPECT_NO_THROW(mesh.verify());
+	EXPECT_NO_THROW(mesh.verify(true));
+	EXPECT_EQ(mesh.getShapes()[0].bbox, shape0.bbox);
+	EXPECT_EQ(mesh.getShapes()[0].sphere, shape0.sphere);
+	EXPECT_FLOAT_EQ(mesh.getShapes()[1].bbox.maxZ, 5.1f);
+	EXPECT_FLOAT_EQ(mesh.getBoundingBox().maxZ, 5.1f);
+
+	// the range ends in the second vertex of shape 1 and starts in the last vertex of shape 0
+	const auto numVertices = mesh.getShapes()[0].vertexCount;
+	EXPECT_EQ(mesh.editVertices(numVertices - 1, 2).size(), 6);
+	EXPECT_TRUE(mesh.isShapeDirty(0));
+	EXPECT_TRUE(mesh.isShapeDirty(1));
+	EXPECT_FALSE(mesh.isShapeDirty(2));
+	mesh.updateBoundingVolumes();
+	mesh.editVertices(numVertices * 2, 1);
+	EXPECT_FALSE(mesh.isShapeDirty(1));
+	EXPECT_TRUE(mesh.isShapeDirty(2));
+
+	EXPECT_THROW(mesh.editVertices(numVertices * 3 - 1, 2), std::runtime_error);
+	EXPECT_THROW(mesh.markShapeDirty(3), std::runtime_error);
+}
+
+TEST(TestSuite, TrustCleanShapes)
+{
+	auto mesh = createUnitGrid(4, 2);
+	// untracked modification: only the full verification notices it
+	mesh.getVertices()[0] = -1.0f;
+	EXPECT_THROW(mesh.verify(), std::runtime_error);
+	EXPECT_NO_THROW(mesh.verify(true));
+
+	mesh.markShapeDirty(0);
+	mesh.updateBoundingVolumes();
+	EXPECT_NO_THROW(mesh.verify());
+	EXPECT_FLOAT_EQ(mesh.getBoundingBox().minX, -1.0f);
+}
+
+TEST(TestSuite, DerivedVolumes)
+{
+	auto mesh = createUnitGrid(8, 3);
+	mesh.buildBvh();
+	mesh.generateOrientedBoundingBoxes();
+
+	auto vertices = mesh.editShapeVertices(2);
+	for (size_t i = 2; i < vertices.size(); i += 3)
+		vertices[i] -= 3.0f;
+	mesh.updateBoundingVolumes();
+	EXPECT_NO_THROW(mesh.verify());
+	EXPECT_NEAR(mesh.getOrientedBoundingBoxes()[2].center.z, -2.95f, 1e-4f);
+
+	// the refitted bvh finds the moved shape
+	Ray ray{ glm::vec3(4.5f, 0.5f, -10.0f), glm::vec3(0.0f, 0.0f, 1.0f), 0.0f, 100.0f };
+	RayHit hit;
+	ASSERT_TRUE(mesh.intersectRay(ray, hit));
+	EXPECT_EQ(hit.shape, 2);
+	EXPECT_NEAR(hit.t, 7.0f, 0.11f);
+	std::vector<ShapeTriangle> triangles;
+	mesh.queryBox(BoundingBox{ 4.0f, 0.0f, -3.5f, 5.0f, 1.0f, -2.5f }, triangles);
+	EXPECT_EQ(triangles.size(), mesh.getShapes()[2].indexCount / 3);
+}
+
+TEST(TestSuite, OrientedBoxRefine)
+{
+	auto mesh = createUnitGrid(8, 2);
+	mesh.generateOrientedBoundingBoxes(false);
+
+	// shear the second shape
+	auto vertices = mesh.editShapeVertices(1);
+	for (size_t i = 0; i < vertices.size(); i += 3)
+	{
+		vertices[i + 1] += 0.5f * vertices[i];
+		vertices[i + 2] += 0.3f * vertices[i + 1];
+	}
+	mesh.updateBoundingVolumes();
+
+	// the updated box is not refined either
+	const auto unrefined = computeOrientedBoundingBox(vertices.data(), vertices.size() / 3, 3, false);
+	const auto refined = computeOrientedBoundingBox(vertices.data(), vertices.size() / 3, 3, true);
+	ASSERT_NE(memcmp(&unrefined, &refined, sizeof(OrientedBoundingBox)), 0);
+	EXPECT_EQ(memcmp(&mesh.getOrientedBoundingBoxes()[1], &unrefined, sizeof(OrientedBoundingBox)), 0);
+}
+
+TEST(TestSuite, Operations)
+{
+	// welding moves vertices
+	auto mesh = createUnitGrid(4, 2);
+	auto vertices = mesh.editShapeVertices(1);
+	vertices[0] = vertices[3] - 0.01f;
+	vertices[2] = vertices[5];
+	mesh.updateBoundingVolumes();
+	mesh.weldVertices(0.05f);
+	EXPECT_FALSE(mesh.isShapeDirty(0));
+	EXPECT_TRUE(mesh.isShapeDirty(1));
+	mesh.updateBoundingVolumes();
+	EXPECT_NO_THROW(mesh.verify());
+
+	// split and merge keep the flags
+	mesh.markShapeDirty(1);
+	auto split = mesh.splitShapes();
+	EXPECT_FALSE(split[0].hasDirtyShapes());
+	EXPECT_TRUE(split[1].isShapeDirty(0));
+	const auto merged = BinaryMesh32::mergeShapes(split);
+	EXPECT_FALSE(merged.isShapeDirty(0));
+	EXPECT_TRUE(merged.isShapeDirty(1));
+	EXPECT_THROW(MixedBinaryMesh{ merged }, std::runtime_error);
+
+	mesh.generateBoundingVolumes();
+	EXPECT_FALSE(mesh.hasDirtyShapes());
+}
+
+TEST(TestSuite, GenerateBoundingVolumes)
+{
+	auto mesh = createUnitGrid(8, 3);
+	mesh.buildBvh();
+	mesh.generateOrientedBoundingBoxes();
+
+	// recalculating everything also refreshes the derived volumes of the dirty shapes
+	auto vertices = mesh.editShapeVertices(0);
+	for (size_t i = 0; i < vertices.size(); i += 3)
+		vertices[i] += 10.0f;
+	mesh.generateBoundingVolumes();
+	EXPECT_FALSE(mesh.hasDirtyShapes());
+	EXPECT_NO_THROW(mesh.verify());
+	EXPECT_NEAR(mesh.getOrientedBoundingBoxes()[0].center.x, 10.5f, 1e-4f);
+
+	Ray ray{ glm::vec3(10.5f, 0.5f, -10.0f), glm::vec3(0.0f, 0.0f, 1.0f), 0.0f, 100.0f };
+	RayHit hit;
+	ASSERT_TRUE(mesh.intersectRay(ray, hit));
+	EXPECT_EQ(hit.shape, 0);
+}
+
+TEST(TestSuite, VertexOperations)
+{
+	// simplification removes vertices
+	auto mesh = createUnitGrid(8, 2);
+	mesh.simplify(0.1f, 0.1f);
+	EXPECT_TRUE(mesh.isShapeDirty(0));
+	EXPECT_TRUE(mesh.isShapeDirty(1));
+	EXPECT_THROW(mesh.verify(true), std::runtime_error);
+	mesh.updateBoundingVolumes();
+	EXPECT_NO_THROW(mesh.verify());
+
+	// operations that change nothing keep the shapes clean
+	mesh.removeDuplicateVertices();
+	mesh.removeUnusedVertices();
+	EXPECT_FALSE(mesh.hasDirtyShapes());
+
+	// reordered vertices
+	mesh = createUnitGrid(4, 2);
+	mesh.optimizeVertexFetch();
+	mesh.updateBoundingVolumes();
+	mesh.optimizeVertexFetch();
+	EXPECT_FALSE(mesh.hasDirtyShapes());
+	auto& indices = mesh.getIndices();
+	std::reverse(indices.begin(), indices.begin() + mesh.getShapes()[0].indexCount);
+	mesh.optimizeVertexFetch();
+	EXPECT_TRUE(mesh.isShapeDirty(0));
+	EXPECT_FALSE(mesh.isShapeDirty(1));
+
+	// the flags are kept if the mesh is taken as is
+	auto meshes16 = mesh.force16BitIndices();
+	ASSERT_EQ(meshes16.size(), 1);
+	EXPECT_TRUE(meshes16[0].isShapeDirty(0));
+	EXPECT_FALSE(meshes16[0].isShapeDirty(1));
+	meshes16[0].updateBoundingVolumes();
+	EXPECT_NO_THROW(meshes16[0].verify());
+}
+
+TEST(TestSuite, ReplacedShapes)
+{
+	auto mesh = createUnitGrid(4, 2);
+	mesh.markShapeDirty(0);
+
+	// the flags of a modified shape list are outdated => all shapes are dirty
+	auto& shapes = mesh.getShapes();
+	shapes.push_back(shapes[1]);
+	EXPECT_TRUE(mesh.isShapeDirty(1));
+	EXPECT_TRUE(mesh.isShapeDirty(2));
+	EXPECT_FALSE(mesh.isShapeDirty(3));
+	mesh.markShapeDirty(2);
+	EXPECT_TRUE(mesh.isShapeDirty(1));
+
+	shapes.pop_back();
+	EXPECT_TRUE(mesh.isShapeDirty(1));
+	mesh.updateBoundingVolumes();
+	EXPECT_FALSE(mesh.hasDirtyShapes());
+	EXPECT_NO_THROW(mesh.verify());
+}
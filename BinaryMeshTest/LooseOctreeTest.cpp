@@ -0,0 +1,130 @@
+#include "pch.h"
+#include <numeric>
+#include <random>
+
+#define TestSuite LooseOctreeTest
+
+namespace
+{
+	// billboards with random positions and sizes between 0.01 and 4
+	BinaryMesh createBillboards(size_t count)
+	{
+		std::mt19937 rng(3);
+		std::uniform_real_distribution<float> pos(-50.0f, 50.0f);
+		std::uniform_real_distribution<float> size(-4.5f, 0.6f);
+		std::vector<float> vertices;
+		for (size_t i = 0; i < count; ++i)
+		{
+			const float v[] = { pos(rng), pos(rng), pos(rng), std::exp(size(rng)) * 2.0f, 0.01f };
+			vertices.insert(vertices.end(), v, v + 5);
+		}
+		BinaryMesh mesh(Position | Width | Height, std::move(vertices));
+		mesh.generateBoundingVolumes();
+		return mesh;
+	}
+
+	BoundingBox getBillboardBox(const BinaryMesh& mesh, uint32_t i)
+	{
+		const float* v = mesh.getVertices().data() + i * 5;
+		const float r = std::max(v[3], v[4]);
+		return BoundingBox{ v[0] - r, v[1] - r, v[2] - r, v[0] + r, v[1] + r, v[2] + r };
+	}
+
+	float getDistanceSq(const BoundingBox& b, const glm::vec3& p)
+	{
+		const auto d = glm::max(glm::max(glm::vec3(b.minX, b.minY, b.minZ) - p, p - glm::vec3(b.maxX, b.maxY, b.maxZ)), glm::vec3(0.0f));
+		return glm::dot(d, d);
+	}
+
+	std::vector<uint32_t> sorted(std::vector<uint32_t> v)
+	{
+		std::sort(v.begin(), v.end());
+		return v;
+	}
+}
+
+TEST(TestSuite, BillboardQueries)
+{
+	const auto mesh = createBillboards(2000);
+	const auto octree = LooseOctree::fromBillboards(mesh);
+	EXPECT_EQ(octree.size(), 2000);
+	const auto numVertices = mesh.getNumVertices();
+
+	const BoundingBox box = { -10.0f, 0.0f, -20.0f, 5.0f, 30.0f, 0.0f };
+	const Sphere sphere = { glm::vec3(10.0f, -5.0f, 3.0f), 12.0f };
+	std::vector<uint32_t> expectedBox;
+	std::vector<uint32_t> expectedSphere;
+	for (uint32_t i = 0; i < numVertices; ++i)
+	{
+		const auto b = getBillboardBox(mesh, i);
+		if (b.overlappingWith(box)) expectedBox.push_back(i);
+		if (getDistanceSq(b, sphere.center) <= sphere.radius * sphere.radius) expectedSphere.push_back(i);
+	}
+
+	std::vector<uint32_t> result;
+	octree.queryBox(box, result);
+	EXPECT_EQ(sorted(result), expectedBox);
+	EXPECT_GT(expectedBox.size(), 5u);
+
+	result.clear();
+	octree.querySphere(sphere, result);
+	EXPECT_EQ(sorted(result), expectedSphere);
+	EXPECT_GT(expectedSphere.size(), 5u);
+
+	// nearest neighbors
+	const auto point = glm::vec3(1.0f, 2.0f, 3.0f);
+	std::vector<uint32_t> expectedNearest(numVertices);
+	std::iota(expectedNearest.begin(), expectedNearest.end(), 0);
+	std::sort(expectedNearest.begin(), expectedNearest.end(), [&](uint32_t a, uint32_t b)
+	{
+		return std::make_pair(getDistanceSq(getBillboardBox(mesh, a), point), a) < std::make_pair(getDistanceSq(getBillboardBox(mesh, b), point), b);
+	});
+	expectedNearest.resize(10);
+	EXPECT_EQ(octree.queryNearest(point, 10), expectedNearest);
+	EXPECT_EQ(octree.queryNearest(point, 3000).size(), 2000);
+	EXPECT_TRUE(octree.queryNearest(point, 0).empty());
+}
+
+TEST(TestSuite, ShapeUpdates)
+{
+	BinaryMesh32 mesh(Position, {
+		0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+		10.0f, 10.0f, 10.0f, 11.0f, 10.0f, 10.0f, 10.0f, 11.0f, 10.0f,
+		-100.0f, 0.0f, 0.0f, 100.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+	}, { 0, 1, 2, 0, 1, 2, 0, 1, 2 }, {
+		Shape{ 0, 3, 0, 3, 0 },
+		Shape{ 3, 3, 3, 3, 0 },
+		Shape{ 6, 3, 6, 3, 0 },
+	});
+	mesh.generateBoundingVolumes();
+
+	auto octree = LooseOctree::fromShapes(mesh);
+	EXPECT_EQ(octree.size(), 3);
+
+	std::vector<uint32_t> result;
+	octree.queryBox(BoundingBox{ 0.5f, 0.5f, -1.0f, 2.0f, 2.0f, 1.0f }, result);
+	EXPECT_EQ(sorted(result), std::vector<uint32_t>({ 0, 2 }));
+
+	// move shape 0 outside of the root cell
+	octree.update(0, BoundingBox{ 500.0f, 500.0f, 500.0f, 501.0f, 501.0f, 501.0f });
+	EXPECT_EQ(octree.size(), 3);
+	result.clear();
+	octree.queryBox(BoundingBox{ 0.5f, 0.5f, -1.0f, 2.0f, 2.0f, 1.0f }, result);
+	EXPECT_EQ(result, std::vector<uint32_t>({ 2 }));
+	result.clear();
+	octree.querySphere(Sphere{ glm::vec3(500.0f), 1.0f }, result);
+	EXPECT_EQ(result, std::vector<uint32_t>({ 0 }));
+	EXPECT_EQ(octree.queryNearest(glm::vec3(10.5f, 10.5f, 10.0f), 2), std::vector<uint32_t>({ 1, 2 }));
+
+	octree.remove(1);
+	EXPECT_FALSE(octree.contains(1));
+	EXPECT_EQ(octree.size(), 2);
+	EXPECT_EQ(octree.queryNearest(glm::vec3(10.5f, 10.5f, 10.0f), 2), std::vector<uint32_t>({ 2, 0 }));
+
+	// new ids can be added
+	octree.update(7, BoundingBox{ 10.0f, 10.0f, 10.0f, 10.0f, 10.0f, 10.0f });
+	EXPECT_TRUE(octree.contains(7));
+	EXPECT_EQ(octree.queryNearest(glm::vec3(10.5f, 10.5f, 10.0f), 1), std::vector<uint32_t>({ 7 }));
+
+	EXPECT_THROW(LooseOctree().update(0, BoundingBox{}), std::runtime_error);
+}
@@ -0,0 +1,173 @@
+#include "pch.h"
+#include "TestHelpers.h"
+#include <random>
+
+#define TestSuite MeshOptimizerTest
+
+namespace
+{
+	// regular grid with size x size quads as two shapes. the triangles of each shape are shuffled
+	BinaryMesh32 createShuffledGrid(uint32_t size)
+	{
+		auto res = createGrid(size, 2);
+		std::mt19937 random(3);
+		auto& indices = res.getIndices();
+		for (const auto& s : res.getShapes())
+		{
+			std::vector<std::array<uint32_t, 3>> triangles(s.indexCount / 3);
+			memcpy(triangles.data(), indices.data() + s.indexOffset, s.indexCount * sizeof(uint32_t));
+			std::shuffle(triangles.begin(), triangles.end(), random);
+			memcpy(indices.data() + s.indexOffset, triangles.data(), s.indexCount * sizeof(uint32_t));
+		}
+		return res;
+	}
+
+	// triangles of the index range rotated so that the smallest index comes first (same winding) and sorted
+	std::vector<std::array<uint32_t, 3>> getSortedTriangles(const std::vector<uint32_t>& indices, size_t offset, size_t count)
+	{
+		std::vector<std::array<uint32_t, 3>> res;
+		for (size_t i = offset; i < offset + count; i += 3)
+		{
+			std::array<uint32_t, 3> t = { indices[i], indices[i + 1], indices[i + 2] };
+			std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+			res.push_back(t);
+		}
+		std::sort(res.begin(), res.end());
+		return res;
+	}
+}
+
+TEST(TestSuite, AnalyzeVertexCache)
+{
+	const std::vector<uint32_t> indices = {
+		0, 1, 2, // triangle 1
+		2, 1, 3, // triangle 2 (only vertex 3 is new)
+		4, 5, 0, // triangle 3
+	};
+
+	auto stats = analyzeVertexCache(indices.data(), indices.size(), 6);
+	EXPECT_EQ(stats.triangles, 3);
+	EXPECT_EQ(stats.usedVertices, 6);
+	EXPECT_EQ(stats.transformedVertices, 6);
+	EXPECT_FLOAT_EQ(stats.getAcmr(), 2.0f);
+	EXPECT_FLOAT_EQ(stats.getAtvr(), 1.0f);
+
+	// vertex 0 was pushed out of the cache by vertex 5
+	stats = analyzeVertexCache(indices.data(), indices.size(), 6, 5);
+	EXPECT_EQ(stats.transformedVertices, 7);
+}
+
+TEST(TestSuite, OptimizeVertexCache)
+{
+	auto mesh = createShuffledGrid(32);
+	const auto original = mesh;
+	EXPECT_NO_THROW(mesh.verify());
+
+	const auto res = mesh.optimizeVertexCache();
+	EXPECT_EQ(res.before.getAcmr(), original.analyzeVertexCache().getAcmr());
+	EXPECT_EQ(res.after.getAcmr(), mesh.analyzeVertexCache().getAcmr());
+	EXPECT_GT(res.before.getAcmr(), 2.0f);
+	// a regular grid has 0.5 vertices per triangle
+	EXPECT_LT(res.after.getAcmr(), 0.8f);
+	EXPECT_LT(res.after.getAtvr(), 1.5f);
+
+	// same triangles with the same winding in each shape
+	for (const auto& s : mesh.getShapes())
+	{
+		EXPECT_EQ(getSortedTriangles(mesh.getIndices(), s.indexOffset, s.indexCount),
+			getSortedTriangles(original.getIndices(), s.indexOffset, s.indexCount));
+	}
+	EXPECT_NO_THROW(mesh.verify());
+}
+
+TEST(TestSuite, OptimizeVertexFetch)
+{
+	auto mesh = createShuffledGrid(16);
+	mesh.optimizeVertexCache();
+	// the last vertex of the first shape is not used anymore
+	auto& indices = mesh.getIndices();
+	std::replace(indices.begin(), indices.begin() + mesh.getShapes()[0].indexCount, 16 * 17 + 16, 16 * 17 + 15);
+	const auto original = mesh;
+
+	mesh.optimizeVertexFetch();
+
+	EXPECT_EQ(mesh.getNumVertices(), original.getNumVertices() - 1);
+	EXPECT_EQ(mesh.getShapes()[0].vertexCount, original.getShapes()[0].vertexCount - 1);
+	EXPECT_EQ(mesh.getShapes()[1].vertexOffset, mesh.getShapes()[0].vertexCount);
+	for (const auto& s : mesh.getShapes())
+	{
+		const auto& o = original.getShapes()[&s - mesh.getShapes().data()];
+		uint32_t nextVertex = 0;
+		for (uint32_t i = s.indexOffset; i < s.indexOffset + s.indexCount; ++i)
+		{
+			// vertices are used in ascending order
+			const auto v = indices[i];
+			ASSERT_LE(v, nextVertex);
+			if (v == nextVertex) ++nextVertex;
+
+			// same position as before
+			const float* p = mesh.getVertices().data() + (s.vertexOffset + v) * 3;
+			const float* op = original.getVertices().data() + (o.vertexOffset + original.getIndices()[i]) * 3;
+			ASSERT_EQ(memcmp(p, op, 3 * sizeof(float)), 0);
+		}
+		EXPECT_EQ(nextVertex, s.vertexCount);
+	}
+
+	// the cache statistics did not change
+	EXPECT_EQ(mesh.analyzeVertexCache().transformedVertices, original.analyzeVertexCache().transformedVertices);
+	mesh.generateBoundingVolumes();
+	EXPECT_NO_THROW(mesh.verify());
+}
+
+TEST(TestSuite, OptimizeOverdraw)
+{
+	// two parallel grids: the inner one faces the mesh center, the outer one faces away from it
+	const uint32_t size = 8;
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices;
+	for (uint32_t g = 0; g < 2; ++g)
+	{
+		const auto base = uint32_t(vertices.size() / 3);
+		for (uint32_t y = 0; y <= size; ++y)
+		{
+			for (uint32_t x = 0; x <= size; ++x)
+			{
+				const float v[] = { float(x), float(y), g == 0 ? 1.0f : -1.0f };
+				vertices.insert(vertices.end(), v, v + 3);
+			}
+		}
+		for (uint32_t y = 0; y < size; ++y)
+		{
+			for (uint32_t x = 0; x < size; ++x)
+			{
+				// both grids face in negative z direction
+				const auto i = base + y * (size + 1) + x;
+				const uint32_t quad[] = { i, i + size + 2, i + 1, i, i + size + 1, i + size + 2 };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+	}
+	const auto numVertices = uint32_t(vertices.size() / 3);
+	const auto numIndices = uint32_t(indices.size());
+
+	BinaryMesh32 mesh(Position, vertices, indices, { Shape{ 0, numIndices, 0, numVertices, 0 } });
+	mesh.generateBoundingVolumes();
+	mesh.optimizeVertexCache();
+	const auto original = mesh;
+	// the inner grid comes first
+	EXPECT_EQ(original.getVertices()[original.getIndices()[0] * 3 + 2], 1.0f);
+
+	mesh.optimizeOverdraw(1.05f);
+
+	// triangles of the outer grid (z = -1) are drawn first
+	const auto half = numIndices / 2;
+	for (uint32_t i = 0; i < numIndices; ++i)
+	{
+		const float z = mesh.getVertices()[mesh.getIndices()[i] * 3 + 2];
+		ASSERT_EQ(z, i < half ? -1.0f : 1.0f);
+	}
+
+	EXPECT_LE(mesh.analyzeVertexCache().getAcmr(), original.analyzeVertexCache().getAcmr() * 1.05f);
+	EXPECT_EQ(getSortedTriangles(mesh.getIndices(), 0, numIndices), getSortedTriangles(original.getIndices(), 0, numIndices));
+	EXPECT_NO_THROW(mesh.verify());
+}
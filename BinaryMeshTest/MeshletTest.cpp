@@ -0,0 +1,77 @@
+#include "pch.h"
+#include "TestHelpers.h"
+
+#define TestSuite MeshletTest
+
+TEST(TestSuite, BuildMeshlets)
+{
+	auto mesh = createGrid(16, 2);
+	mesh.buildMeshlets(64, 124);
+	EXPECT_NO_THROW(mesh.verify());
+
+	const auto& meshlets = mesh.getMeshlets();
+	const auto& offsets = mesh.getMeshletOffsets();
+	ASSERT_EQ(offsets.size(), 3);
+	// 512 triangles per shape
+	EXPECT_GE(offsets[1], 5u);
+	EXPECT_EQ(offsets[2] - offsets[1], offsets[1]);
+
+	for (size_t shape = 0; shape < 2; ++shape)
+	{
+		const auto& s = mesh.getShapes()[shape];
+		// triangles are in index buffer order
+		auto curIndex = s.indexOffset;
+		for (auto i = offsets[shape]; i < offsets[shape + 1]; ++i)
+		{
+			const auto& m = meshlets[i];
+			EXPECT_LE(m.vertexCount, 64u);
+			EXPECT_LE(m.triangleCount, 124u);
+
+			for (uint32_t t = 0; t < m.triangleCount * 3; ++t)
+			{
+				const auto v = mesh.getMeshletVertices()[m.vertexOffset + mesh.getMeshletTriangles()[m.triangleOffset * 3 + t]];
+				ASSERT_EQ(v, mesh.getIndices()[curIndex++]);
+
+				const auto p = toVec3(mesh.getVertices().data() + (s.vertexOffset + v) * 3);
+				EXPECT_TRUE(m.sphere.isInside(p));
+				EXPECT_TRUE(m.bbox.minZ <= p.z && p.z <= m.bbox.maxZ);
+			}
+
+			// all triangles face +z
+			EXPECT_FLOAT_EQ(m.coneAxis.z, 1.0f);
+			EXPECT_TRUE(m.isBackfacing(glm::vec3(8.0f, 8.0f, -10.0f)));
+			EXPECT_FALSE(m.isBackfacing(glm::vec3(8.0f, 8.0f, 10.0f)));
+		}
+		EXPECT_EQ(curIndex, s.indexOffset + s.indexCount);
+	}
+
+	EXPECT_THROW(mesh.buildMeshlets(300, 124), std::runtime_error);
+}
+
+TEST(TestSuite, MeshletLoadSave)
+{
+	auto mesh = createGrid(8, 3);
+	mesh.buildMeshlets(32, 16);
+	mesh.saveToFile("MeshletTest.bmf");
+
+	BinaryMesh32 loaded;
+	loaded.loadFromFile("MeshletTest.bmf");
+	EXPECT_EQ(loaded.getMeshletOffsets(), mesh.getMeshletOffsets());
+	EXPECT_EQ(loaded.getMeshletVertices(), mesh.getMeshletVertices());
+	EXPECT_EQ(loaded.getMeshletTriangles(), mesh.getMeshletTriangles());
+	ASSERT_EQ(loaded.getMeshlets().size(), mesh.getMeshlets().size());
+	EXPECT_EQ(memcmp(loaded.getMeshlets().data(), mesh.getMeshlets().data(), mesh.getMeshlets().size() * sizeof(Meshlet)), 0);
+	EXPECT_NO_THROW(loaded.verify());
+
+	// split and merge keeps the meshlets
+	const auto merged = BinaryMesh32::mergeShapes(mesh.splitShapes());
+	EXPECT_EQ(merged.getMeshletOffsets(), mesh.getMeshletOffsets());
+	EXPECT_EQ(merged.getMeshletVertices(), mesh.getMeshletVertices());
+	EXPECT_EQ(merged.getMeshletTriangles(), mesh.getMeshletTriangles());
+	EXPECT_NO_THROW(merged.verify());
+
+	// modifying the index buffer discards the meshlets
+	mesh.optimizeVertexCache();
+	EXPECT_TRUE(mesh.getMeshlets().empty());
+	EXPECT_NO_THROW(mesh.verify());
+}
@@ -0,0 +1,94 @@
+#include "pch.h"
+
+#define TestSuite MixedBinaryMeshTest
+
+namespace
+{
+	// two small shapes around a shape with more than 65535 vertices
+	BinaryMesh32 createMesh()
+	{
+		std::vector<float> vertices((4 + 70003 + 4) * 3, -1.0f);
+		for (size_t i : { 0, 1, 2, 3, 4, 5, 7, 70004, 70005, 70006, 70007, 70008, 70009, 70010 })
+			vertices[i * 3] = float(i);
+		std::vector<uint32_t> indices = {
+			0, 1, 2, // shape 1
+			0, 1, 3,
+			0, 1, 3, // shape 2
+			70000, 70001, 70002,
+			2, 1, 3, // shape 3
+		};
+		std::vector<Shape> shapes = {
+			Shape{0, 6, 0, 4, 1},
+			Shape{6, 6, 4, 70003, 2},
+			Shape{12, 3, 70007, 4, 3},
+		};
+
+		BinaryMesh32 res(Position, std::move(vertices), std::move(indices), std::move(shapes));
+		res.generateBoundingVolumes();
+		return res;
+	}
+}
+
+TEST(TestSuite, FromShapeBinaryMesh)
+{
+	const auto original = createMesh();
+	MixedBinaryMesh mesh(original);
+	EXPECT_NO_THROW(mesh.verify());
+
+	EXPECT_EQ(mesh.getIndexSizes(), std::vector<uint8_t>({ 2, 4, 2 }));
+	// the 32 bit indices are aligned
+	EXPECT_EQ(mesh.getShapes()[1].indexOffset, 12);
+	EXPECT_EQ(mesh.getShapes()[2].indexOffset, 36);
+	EXPECT_EQ(mesh.getIndexBuffer().size(), 6 * 2 + 6 * 4 + 3 * 2);
+
+	const auto small = mesh.getShapeIndices<uint16_t>(0);
+	EXPECT_EQ(std::vector<uint16_t>(small.begin(), small.end()), std::vector<uint16_t>({ 0, 1, 2, 0, 1, 3 }));
+	const auto big = mesh.getShapeIndices<uint32_t>(1);
+	EXPECT_EQ(std::vector<uint32_t>(big.begin(), big.end()), std::vector<uint32_t>({ 0, 1, 3, 70000, 70001, 70002 }));
+	EXPECT_EQ(mesh.getIndex(2, 0), 2);
+	EXPECT_THROW(mesh.getShapeIndices<uint16_t>(1), std::runtime_error);
+
+	// writing through the span
+	mesh.getShapeIndices<uint16_t>(2)[0] = 3;
+	EXPECT_EQ(mesh.getIndex(2, 0), 3);
+}
+
+TEST(TestSuite, ToShapeBinaryMesh)
+{
+	const auto original = createMesh();
+	const MixedBinaryMesh mesh(original);
+
+	const auto m32 = mesh.toShapeBinaryMesh<uint32_t>();
+	EXPECT_EQ(m32.getIndices(), original.getIndices());
+	EXPECT_EQ(m32.getVertices(), original.getVertices());
+	EXPECT_EQ(m32.getShapes()[1].indexOffset, 6);
+	EXPECT_NO_THROW(m32.verify());
+
+	// the big shape does not fit
+	EXPECT_THROW(mesh.toShapeBinaryMesh<uint16_t>(), std::runtime_error);
+
+	// 16 bit meshes convert without loss
+	auto m16 = BinaryMesh16(Position, { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f }, { 0, 1, 2 }, { Shape{ 0, 3, 0, 3, 0 } });
+	m16.generateBoundingVolumes();
+	const auto back = MixedBinaryMesh(m16).toShapeBinaryMesh<uint16_t>();
+	EXPECT_EQ(back.getIndices(), m16.getIndices());
+	EXPECT_NO_THROW(back.verify());
+}
+
+TEST(TestSuite, LoadSave)
+{
+	const MixedBinaryMesh mesh(createMesh());
+	mesh.saveToFile("MixedTest.bmf");
+
+	MixedBinaryMesh loaded;
+	loaded.loadFromFile("MixedTest.bmf");
+	EXPECT_EQ(loaded.getIndexBuffer(), mesh.getIndexBuffer());
+	EXPECT_EQ(loaded.getIndexSizes(), mesh.getIndexSizes());
+	EXPECT_EQ(loaded.getVertices(), mesh.getVertices());
+	EXPECT_EQ(loaded.getShapes().size(), 3);
+	EXPECT_NO_THROW(loaded.verify());
+
+	// other signature
+	BinaryMesh32 m32;
+	EXPECT_THROW(m32.loadFromFile("MixedTest.bmf"), std::runtime_error);
+}
@@ -0,0 +1,88 @@
+#include "pch.h"
+
+#define TestSuite GeneratorTest
+
+TEST(TestSuite, NormalsCreaseAngle) // two triangles with a 90 degree angle between them
+{
+	using BinaryMesh = BinaryMesh32;
+
+	const std::vector<float> vertices = {
+		0.0f, 0.0f, 0.0f, // vertex 0
+		1.0f, 0.0f, 0.0f, // vertex 1
+		0.0f, 0.0f, 1.0f, // vertex 2
+		1.0f, 1.0f, 0.0f, // vertex 3
+	};
+	const std::vector<uint32_t> indices = {
+		0, 2, 1, // triangle 1 (laying on the ground with normal up)
+		3, 0, 1, // triangle 2 (standing and facing in positive z)
+	};
+	const std::vector<Shape> shapes = {
+		Shape{0, 6, 0, 4, 2}, // shape
+	};
+
+	BinaryMesh m1(Position, vertices, indices, shapes);
+	m1.generateBoundingVolumes();
+
+	// crease angle smaller than 90 degrees => split along the shared edge
+	std::vector<std::unique_ptr<VertexGenerator>> generators;
+	generators.emplace_back(new NormalGenerator(NormalGenerator::Weighting::Angle, 3.14159265f / 4.0f));
+
+	BinaryMesh res(m1);
+	res.changeAttributes(Position | Normal, generators);
+
+	EXPECT_EQ(res.getNumVertices(), 6);
+	EXPECT_EQ(res.getIndices(), std::vector<uint32_t>({ 0, 4, 2, 5, 1, 3 }));
+	EXPECT_NO_THROW(res.verify());
+
+	// crease angle bigger than 90 degrees => the shared edge stays smooth
+	generators.clear();
+	generators.emplace_back(new NormalGenerator(NormalGenerator::Weighting::Angle, 3.14159265f / 1.8f));
+
+	res = m1;
+	res.changeAttributes(Position | Normal, generators);
+
+	EXPECT_EQ(res.getNumVertices(), 4);
+	EXPECT_EQ(res.getIndices(), indices);
+	// vertex 0 has a 90 degree angle in the first and a 45 degree angle in the second triangle
+	const auto expected = glm::normalize(glm::vec3(0.0f, 2.0f, 1.0f));
+	const float* n0 = res.getVertices().data() + 3;
+	EXPECT_NEAR(n0[0], expected.x, 0.0001f);
+	EXPECT_NEAR(n0[1], expected.y, 0.0001f);
+	EXPECT_NEAR(n0[2], expected.z, 0.0001f);
+	EXPECT_NO_THROW(res.verify());
+}
+
+TEST(TestSuite, NormalsAreaWeighted)
+{
+	using BinaryMesh = BinaryMesh32;
+
+	const std::vector<float> vertices = {
+		0.0f, 0.0f, 0.0f, // vertex 0
+		1.0f, 0.0f, 0.0f, // vertex 1
+		0.0f, 0.0f, 1.0f, // vertex 2
+		0.0f, 2.0f, 0.0f, // vertex 3
+	};
+	const std::vector<uint32_t> indices = {
+		0, 2, 1, // triangle 1 (laying on the ground with normal up, area 0.5)
+		3, 0, 1, // triangle 2 (standing and facing in positive z, area 1)
+	};
+	const std::vector<Shape> shapes = {
+		Shape{0, 6, 0, 4, 2}, // shape
+	};
+
+	BinaryMesh m1(Position, vertices, indices, shapes);
+	m1.generateBoundingVolumes();
+
+	std::vector<std::unique_ptr<VertexGenerator>> generators;
+	generators.emplace_back(new NormalGenerator(NormalGenerator::Weighting::Area));
+
+	m1.changeAttributes(Position | Normal, generators);
+
+	// normal of the shared vertex is pulled towards the bigger triangle
+	const auto expected = glm::normalize(glm::vec3(0.0f, 0.5f, 1.0f));
+	const float* n0 = m1.getVertices().data() + 3;
+	EXPECT_NEAR(n0[0], expected.x, 0.0001f);
+	EXPECT_NEAR(n0[1], expected.y, 0.0001f);
+	EXPECT_NEAR(n0[2], expected.z, 0.0001f);
+	EXPECT_NO_THROW(m1.verify());
+}
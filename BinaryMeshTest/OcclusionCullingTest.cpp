@@ -0,0 +1,174 @@
+#include "pch.h"
+#include "TestHelpers.h"
+
+#define TestSuite OcclusionCullingTest
+
+namespace
+{
+	// subdivided quad [-size, size]^2 at depth z
+	void addGrid(std::vector<float>& positions, std::vector<uint32_t>& indices, float size, float z, uint32_t n)
+	{
+		const auto base = uint32_t(positions.size() / 3);
+		for (uint32_t y = 0; y <= n; ++y)
+			for (uint32_t x = 0; x <= n; ++x)
+				positions.insert(positions.end(), { -size + 2.0f * size * float(x) / float(n), -size + 2.0f * size * float(y) / float(n), z });
+		for (uint32_t y = 0; y < n; ++y)
+		{
+			for (uint32_t x = 0; x < n; ++x)
+			{
+				const uint32_t i = base + y * (n + 1) + x;
+				indices.insert(indices.end(), { i, i + 1, i + n + 1, i + 1, i + n + 2, i + n + 1 });
+			}
+		}
+	}
+
+	BoundingBox createBox(const glm::vec3& center, float halfSize)
+	{
+		return BoundingBox{ center.x - halfSize, center.y - halfSize, center.z - halfSize, center.x + halfSize, center.y + halfSize, center.z + halfSize };
+	}
+}
+
+TEST(TestSuite, QuadOccluder)
+{
+	std::vector<float> positions;
+	std::vector<uint32_t> indices;
+	addGrid(positions, indices, 5.0f, 10.0f, 1);
+
+	OcclusionCuller culler(100, 60);
+	culler.clear(createViewProjection(1.0f, 100.0f));
+	culler.rasterize(positions.data(), 3, indices.data(), indices.size());
+	culler.buildHierarchy();
+
+	// the quad covers the center of the screen
+	const auto& depth = culler.getDepthBuffer();
+	EXPECT_LT(depth[30 * 100 + 50], 1.0f);
+	EXPECT_EQ(depth[0], 1.0f);
+
+	EXPECT_TRUE(culler.isOccluded(createBox(glm::vec3(0.0f, 0.0f, 20.0f), 1.0f)));
+	EXPECT_TRUE(culler.isOccluded(createBox(glm::vec3(0.0f, 0.0f, 50.0f), 5.0f)));
+	// in front of the occluder, next to it or partially behind it
+	EXPECT_FALSE(culler.isOccluded(createBox(glm::vec3(0.0f, 0.0f, 5.0f), 1.0f)));
+	EXPECT_FALSE(culler.isOccluded(createBox(glm::vec3(15.0f, 0.0f, 20.0f), 1.0f)));
+	EXPECT_FALSE(culler.isOccluded(createBox(glm::vec3(0.0f, 0.0f, 20.0f), 15.0f)));
+	// crossing the near plane
+	EXPECT_FALSE(culler.isOccluded(createBox(glm::vec3(0.0f, 0.0f, 0.0f), 1.0f)));
+
+	std::vector<Shape> shapes(3);
+	shapes[0].bbox = createBox(glm::vec3(0.0f, 0.0f, 20.0f), 1.0f);
+	shapes[1].bbox = createBox(glm::vec3(15.0f, 0.0f, 20.0f), 1.0f);
+	shapes[2].bbox = createBox(glm::vec3(2.0f, -2.0f, 30.0f), 1.0f);
+	std::vector<uint32_t> visible = { 7 };
+	culler.cull(shapes, visible);
+	EXPECT_EQ(visible, std::vector<uint32_t>({ 7, 1 }));
+}
+
+TEST(TestSuite, ShapeOccluders)
+{
+	std::vector<float> positions;
+	std::vector<uint32_t> indices;
+	addGrid(positions, indices, 5.0f, 10.0f, 16);
+	const auto gridVertices = uint32_t(positions.size() / 3);
+	const auto gridIndices = uint32_t(indices.size());
+	// small occluder right of the grid
+	addGrid(positions, indices, 1.0f, 10.0f, 1);
+	for (size_t i = gridVertices * 3; i < positions.size(); i += 3)
+		positions[i] += 8.0f;
+	for (size_t i = gridIndices; i < indices.size(); ++i)
+		indices[i] -= gridVertices;
+
+	BinaryMesh32 mesh(Position, std::move(positions), std::move(indices), {
+		Shape{ 0, gridIndices, 0, gridVertices, 0 },
+		Shape{ gridIndices, 6, gridVertices, 4, 0 },
+	});
+	mesh.generateBoundingVolumes();
+	mesh.generateLods(1, 0.25f, 0.01f);
+	ASSERT_EQ(mesh.getNumLodLevels(), 1);
+	EXPECT_LT(mesh.getLod(1, 0).indexCount, gridIndices);
+
+	OcclusionCuller culler(64, 64);
+	const auto hidden = createBox(glm::vec3(0.0f, 0.0f, 30.0f), 2.0f);
+	const auto behindSmall = createBox(glm::vec3(24.0f, 0.0f, 30.0f), 1.0f);
+	for (uint32_t lod : { 0u, 1u })
+	{
+		culler.clear(createViewProjection(1.0f, 100.0f));
+		culler.rasterizeShapes(mesh, { 0 }, lod);
+		culler.buildHierarchy();
+		EXPECT_TRUE(culler.isOccluded(hidden));
+		EXPECT_FALSE(culler.isOccluded(behindSmall));
+
+		culler.rasterizeShapes(mesh, { 1 }, lod);
+		culler.buildHierarchy();
+		EXPECT_TRUE(culler.isOccluded(behindSmall));
+	}
+
+	EXPECT_THROW(culler.rasterizeShapes(mesh, { 2 }), std::runtime_error);
+	EXPECT_THROW(culler.rasterizeShapes(mesh, { 0 }, 2), std::runtime_error);
+}
+
+TEST(TestSuite, InstancedShapes)
+{
+	std::vector<float> positions;
+	std::vector<uint32_t> indices;
+	addGrid(positions, indices, 5.0f, 10.0f, 4);
+	const auto gridVertices = uint32_t(positions.size() / 3);
+	const auto gridIndices = uint32_t(indices.size());
+	// two copies of a small quad: behind the grid and right of the grid
+	for (float x : { 0.0f, 24.0f })
+	{
+		const auto baseVertex = uint32_t(positions.size() / 3);
+		const auto baseIndex = indices.size();
+		addGrid(positions, indices, 1.0f, 30.0f, 1);
+		for (size_t i = size_t(baseVertex) * 3; i < positions.size(); i += 3)
+			positions[i] += x;
+		for (size_t i = baseIndex; i < indices.size(); ++i)
+			indices[i] -= baseVertex;
+	}
+
+	BinaryMesh32 mesh(Position, std::move(positions), std::move(indices), {
+		Shape{ 0, gridIndices, 0, gridVertices, 0 },
+		Shape{ gridIndices, 6, gridVertices, 4, 0 },
+		Shape{ gridIndices + 6, 6, gridVertices + 4, 4, 0 },
+	});
+	mesh.generateBoundingVolumes();
+
+	OcclusionCuller culler(64, 64);
+	culler.clear(createViewProjection(1.0f, 100.0f));
+	culler.rasterizeShapes(mesh, { 0 });
+	culler.buildHierarchy();
+
+	std::vector<uint32_t> visible;
+	culler.cullShapes(mesh, visible);
+	EXPECT_EQ(visible, std::vector<uint32_t>({ 0, 2 }));
+
+	ASSERT_EQ(mesh.deinstanceShapes(), 1);
+	ASSERT_EQ(mesh.getShapes().size(), 2);
+	// the shape box is hidden but the second instance is visible
+	visible.clear();
+	culler.cullShapes(mesh, visible);
+	EXPECT_EQ(visible, std::vector<uint32_t>({ 0, 1 }));
+}
+
+TEST(TestSuite, Deterministic)
+{
+	// many overlapping triangles at different depths => parallel rasterization
+	std::vector<float> positions;
+	std::vector<uint32_t> indices;
+	for (uint32_t i = 0; i < 200; ++i)
+		addGrid(positions, indices, 1.0f + float(i % 7), 10.0f + float(i % 13), 4);
+	// same triangles in a different order
+	std::vector<uint32_t> shuffled(indices.size());
+	const auto numTriangles = indices.size() / 3;
+	for (size_t t = 0; t < numTriangles; ++t)
+	{
+		const auto src = (t * 7919) % numTriangles;
+		std::copy(indices.begin() + src * 3, indices.begin() + src * 3 + 3, shuffled.begin() + t * 3);
+	}
+
+	OcclusionCuller a(123, 77);
+	a.clear(createViewProjection(1.0f, 100.0f));
+	a.rasterize(positions.data(), 3, indices.data(), indices.size());
+	OcclusionCuller b(123, 77);
+	b.clear(createViewProjection(1.0f, 100.0f));
+	b.rasterize(positions.data(), 3, shuffled.data(), shuffled.size());
+	EXPECT_EQ(a.getDepthBuffer(), b.getDepthBuffer());
+}
@@ -0,0 +1,141 @@
+#include "pch.h"
+#include <cfloat>
+#include <random>
+
+#define TestSuite OrientedBoundingBoxTest
+
+namespace
+{
+	glm::vec3 rotateZ(const glm::vec3& v, float angle)
+	{
+		return glm::vec3(v.x * std::cos(angle) - v.y * std::sin(angle), v.x * std::sin(angle) + v.y * std::cos(angle), v.z);
+	}
+
+	glm::vec3 rotateX(const glm::vec3& v, float angle)
+	{
+		return glm::vec3(v.x, v.y * std::cos(angle) - v.z * std::sin(angle), v.y * std::sin(angle) + v.z * std::cos(angle));
+	}
+
+	// random points inside a rotated 10 x 1 x 0.5 box (long cad part) including its corners
+	std::vector<float> createRotatedBar(const glm::vec3& offset)
+	{
+		std::mt19937 rng(5);
+		std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+		const auto half = glm::vec3(5.0f, 0.5f, 0.25f);
+		std::vector<float> positions;
+		const auto add = [&](const glm::vec3& p)
+		{
+			const auto r = rotateX(rotateZ(p, 0.5f), 0.3f) + offset;
+			positions.insert(positions.end(), { r.x, r.y, r.z });
+		};
+		for (int i = 0; i < 8; ++i)
+			add(glm::vec3(i & 1 ? half.x : -half.x, i & 2 ? half.y : -half.y, i & 4 ? half.z : -half.z));
+		for (int i = 0; i < 200; ++i)
+			add(glm::vec3(dist(rng) * half.x, dist(rng) * half.y, dist(rng) * half.z));
+		return positions;
+	}
+
+	OrientedBoundingBox createBox(const glm::vec3& center, const glm::vec3& halfSize, float angleZ)
+	{
+		OrientedBoundingBox box;
+		box.center = center;
+		box.axes[0] = rotateZ(glm::vec3(1.0f, 0.0f, 0.0f), angleZ);
+		box.axes[1] = rotateZ(glm::vec3(0.0f, 1.0f, 0.0f), angleZ);
+		box.axes[2] = glm::vec3(0.0f, 0.0f, 1.0f);
+		box.halfSize = halfSize;
+		return box;
+	}
+}
+
+TEST(TestSuite, FitRotatedBar)
+{
+	const auto positions = createRotatedBar(glm::vec3(3.0f, -2.0f, 1.0f));
+	const auto count = positions.size() / 3;
+	glm::vec3 minPos(FLT_MAX);
+	glm::vec3 maxPos(-FLT_MAX);
+	for (size_t i = 0; i < count; ++i)
+	{
+		minPos = glm::min(minPos, toVec3(positions.data() + i * 3));
+		maxPos = glm::max(maxPos, toVec3(positions.data() + i * 3));
+	}
+	const auto aabbVolume = (maxPos.x - minPos.x) * (maxPos.y - minPos.y) * (maxPos.z - minPos.z);
+
+	for (bool refine : { false, true })
+	{
+		const auto box = computeOrientedBoundingBox(positions.data(), count, 3, refine);
+		for (size_t i = 0; i < count; ++i)
+			EXPECT_TRUE(box.isInside(toVec3(positions.data() + i * 3), 1e-4f));
+
+		// the optimal box has volume 5. the principal axes of the random points are slightly off
+		EXPECT_LT(box.getVolume(), refine ? 5.05f : 6.5f);
+		EXPECT_LT(box.getVolume() * 3.0f, aabbVolume);
+		EXPECT_NEAR(glm::length(box.center - glm::vec3(3.0f, -2.0f, 1.0f)), 0.0f, 1e-3f);
+		// orthonormal right handed axes
+		EXPECT_NEAR(glm::dot(glm::cross(box.axes[0], box.axes[1]), box.axes[2]), 1.0f, 1e-5f);
+	}
+
+	// flat shapes prefer the smallest area
+	const std::vector<float> square = { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.5f, 0.5f, 0.0f };
+	const auto flat = computeOrientedBoundingBox(square.data(), 5, 3);
+	EXPECT_NEAR(flat.halfSize.x * flat.halfSize.y * flat.halfSize.z, 0.0f, 1e-6f);
+	EXPECT_NEAR(flat.getBoundingBox().maxX, 1.0f, 1e-5f);
+}
+
+TEST(TestSuite, OverlapAndFrustum)
+{
+	const auto a = OrientedBoundingBox::fromBoundingBox(BoundingBox{ -1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f });
+	// the corner of the rotated box reaches x = center - sqrt(2)
+	EXPECT_TRUE(a.overlappingWith(createBox(glm::vec3(2.3f, 0.0f, 0.0f), glm::vec3(1.0f), 0.785398f)));
+	EXPECT_FALSE(a.overlappingWith(createBox(glm::vec3(2.5f, 0.0f, 0.0f), glm::vec3(1.0f), 0.785398f)));
+	EXPECT_FALSE(createBox(glm::vec3(2.5f, 0.0f, 0.0f), glm::vec3(1.0f), 0.785398f).overlappingWith(a));
+	// thin rotated bar next to the corner: the axis aligned boxes overlap
+	const auto bar = createBox(glm::vec3(2.0f, 2.0f, 0.0f), glm::vec3(2.0f, 0.1f, 1.0f), -0.785398f);
+	EXPECT_TRUE(bar.getBoundingBox().overlappingWith(BoundingBox{ -1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f }));
+	EXPECT_FALSE(a.overlappingWith(bar));
+	EXPECT_TRUE(a.overlappingWith(a));
+
+	// frustum is the box [-1, 1]^3
+	const auto frustum = Frustum::fromMatrix(glm::mat4(1.0f));
+	EXPECT_TRUE(frustum.isVisible(a));
+	EXPECT_FALSE(frustum.isVisible(createBox(glm::vec3(2.5f, 0.0f, 0.0f), glm::vec3(1.0f), 0.785398f)));
+	EXPECT_TRUE(frustum.isVisible(createBox(glm::vec3(2.3f, 0.0f, 0.0f), glm::vec3(1.0f), 0.785398f)));
+}
+
+TEST(TestSuite, ShapeBoxes)
+{
+	auto vertices = createRotatedBar(glm::vec3(0.0f));
+	const auto second = createRotatedBar(glm::vec3(20.0f, 0.0f, 0.0f));
+	vertices.insert(vertices.end(), second.begin(), second.end());
+	const auto numVertices = uint32_t(vertices.size() / 6);
+	std::vector<uint32_t> indices;
+	for (uint32_t i = 0; i + 2 < numVertices; ++i)
+		indices.insert(indices.end(), { i, i + 1, i + 2 });
+	const auto numIndices = uint32_t(indices.size());
+	indices.insert(indices.end(), indices.begin(), indices.end());
+
+	BinaryMesh32 mesh(Position, std::move(vertices), std::move(indices), {
+		Shape{ 0, numIndices, 0, numVertices, 0 },
+		Shape{ numIndices, numIndices, numVertices, numVertices, 1 },
+	});
+	mesh.generateBoundingVolumes();
+	mesh.generateOrientedBoundingBoxes();
+	ASSERT_EQ(mesh.getOrientedBoundingBoxes().size(), 2);
+	EXPECT_NEAR(mesh.getOrientedBoundingBoxes()[1].center.x, 20.0f, 1e-3f);
+	EXPECT_NO_THROW(mesh.verify());
+
+	mesh.saveToFile("ObbTest.bmf");
+	BinaryMesh32 loaded;
+	loaded.loadFromFile("ObbTest.bmf");
+	ASSERT_EQ(loaded.getOrientedBoundingBoxes().size(), 2);
+	EXPECT_EQ(memcmp(loaded.getOrientedBoundingBoxes().data(), mesh.getOrientedBoundingBoxes().data(), 2 * sizeof(OrientedBoundingBox)), 0);
+	EXPECT_NO_THROW(loaded.verify());
+
+	// split and merge keeps the boxes
+	const auto merged = BinaryMesh32::mergeShapes(mesh.splitShapes());
+	ASSERT_EQ(merged.getOrientedBoundingBoxes().size(), 2);
+	EXPECT_EQ(merged.getOrientedBoundingBoxes()[1].center, mesh.getOrientedBoundingBoxes()[1].center);
+	EXPECT_NO_THROW(merged.verify());
+
+	mesh.optimizeVertexCache();
+	EXPECT_TRUE(mesh.getOrientedBoundingBoxes().empty());
+}
@@ -0,0 +1,132 @@
+#include "pch.h"
+#include <random>
+
+#define TestSuite PointCloudHierarchyTest
+
+namespace
+{
+	BinaryMesh createPointCloud(size_t count)
+	{
+		std::mt19937 rng(11);
+		std::uniform_real_distribution<float> pos(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> size(0.0f, 0.5f);
+		std::vector<float> vertices;
+		for (size_t i = 0; i < count; ++i)
+			vertices.insert(vertices.end(), { pos(rng), pos(rng), pos(rng) * 0.1f, size(rng), size(rng) });
+		BinaryMesh mesh(Position | Width | Height, std::move(vertices));
+		mesh.generateBoundingVolumes();
+		return mesh;
+	}
+
+	std::vector<std::array<float, 5>> sortBillboards(const std::vector<float>& v)
+	{
+		std::vector<std::array<float, 5>> res(v.size() / 5);
+		memcpy(res.data(), v.data(), v.size() * sizeof(float));
+		std::sort(res.begin(), res.end());
+		return res;
+	}
+
+	bool contains(const BoundingBox& outer, const BoundingBox& inner)
+	{
+		return outer.unionWith(inner) == outer;
+	}
+}
+
+TEST(TestSuite, Hierarchy)
+{
+	const auto mesh = createPointCloud(20000);
+	writePointCloudHierarchy(mesh, "PointCloud.bmfpc", 1000, 4096);
+
+	PointCloudReader reader("PointCloud.bmfpc", size_t(-1));
+	EXPECT_EQ(reader.getAttributes(), Position | Width | Height);
+	const auto& nodes = reader.getNodes();
+	ASSERT_GT(nodes.size(), 8);
+	EXPECT_EQ(nodes[0].bbox, mesh.getBoundingBox());
+	uint32_t totalPoints = 0;
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		const auto& n = nodes[i];
+		totalPoints += n.pointCount;
+		EXPECT_LE(n.pointCount, 1000);
+		EXPECT_EQ(n.fileOffset % 4096, 0);
+		for (uint32_t c = n.firstChild; c < n.firstChild + n.childCount; ++c)
+		{
+			EXPECT_EQ(nodes[c].level, n.level + 1);
+			EXPECT_TRUE(contains(n.bbox, nodes[c].bbox));
+		}
+	}
+	EXPECT_EQ(totalPoints, 20000);
+
+	// everything fits => all billboards
+	reader.update(glm::vec3(0.0f));
+	EXPECT_EQ(reader.getSelectedNodes().size(), nodes.size());
+	EXPECT_EQ(reader.getMemoryUsage(), 20000 * 5 * sizeof(float));
+	const auto all = reader.toBinaryMesh();
+	EXPECT_EQ(sortBillboards(all.getVertices()), sortBillboards(mesh.getVertices()));
+	EXPECT_NO_THROW(all.verify());
+
+	// the root is a uniform subsample
+	const auto& root = reader.getNodeVertices(0);
+	ASSERT_EQ(root.size(), nodes[0].pointCount * 5);
+	uint32_t positiveX = 0;
+	for (size_t i = 0; i < root.size(); i += 5)
+		positiveX += root[i] > 0.0f;
+	EXPECT_NEAR(float(positiveX) / float(nodes[0].pointCount), 0.5f, 0.1f);
+}
+
+TEST(TestSuite, StreamingBudget)
+{
+	writePointCloudHierarchy(createPointCloud(20000), "PointCloudBudget.bmfpc", 1000, 4096);
+
+	// about a quarter of the billboards fit into the budget
+	const size_t budget = 5000 * 5 * sizeof(float);
+	PointCloudReader reader("PointCloudBudget.bmfpc", budget);
+	const auto& nodes = reader.getNodes();
+	const glm::vec3 camera(-150.0f, -150.0f, 0.0f);
+	reader.update(camera);
+	EXPECT_LE(reader.getMemoryUsage(), budget);
+	EXPECT_GT(reader.getMemoryUsage(), budget / 2);
+	ASSERT_FALSE(reader.getSelectedNodes().empty());
+	EXPECT_EQ(reader.getSelectedNodes().front(), 0);
+
+	// more billboards close to the camera
+	const auto near = reader.toBinaryMesh();
+	uint32_t closeCount = 0, farCount = 0;
+	for (size_t i = 0; i < near.getVertices().size(); i += 5)
+	{
+		closeCount += near.getVertices()[i] < 0.0f && near.getVertices()[i + 1] < 0.0f;
+		farCount += near.getVertices()[i] > 0.0f && near.getVertices()[i + 1] > 0.0f;
+	}
+	EXPECT_GT(closeCount, farCount * 2);
+
+	// children are only selected together with their parent
+	const auto& selected = reader.getSelectedNodes();
+	for (auto n : selected)
+	{
+		for (uint32_t c = nodes[n].firstChild; c < nodes[n].firstChild + nodes[n].childCount; ++c)
+		{
+			for (uint32_t g = nodes[c].firstChild; g < nodes[c].firstChild + nodes[c].childCount; ++g)
+			{
+				if (std::binary_search(selected.begin(), selected.end(), g))
+				{
+					EXPECT_TRUE(std::binary_search(selected.begin(), selected.end(), c));
+				}
+			}
+		}
+	}
+
+	// moving the camera unloads the nodes on the other side
+	reader.update(-camera);
+	EXPECT_LE(reader.getMemoryUsage(), budget);
+	const auto far = reader.toBinaryMesh();
+	uint32_t closeCount2 = 0;
+	for (size_t i = 0; i < far.getVertices().size(); i += 5)
+		closeCount2 += far.getVertices()[i] < 0.0f && far.getVertices()[i + 1] < 0.0f;
+	EXPECT_LT(closeCount2, closeCount);
+
+	// only the root with a high detail threshold
+	reader.update(camera, 1000.0f);
+	EXPECT_EQ(reader.getSelectedNodes(), std::vector<uint32_t>({ 0 }));
+	EXPECT_THROW(reader.getNodeVertices(1), std::runtime_error);
+	EXPECT_EQ(reader.getMemoryUsage(), nodes[0].pointCount * 5 * sizeof(float));
+}
@@ -0,0 +1,150 @@
+#include "pch.h"
+#include <chrono>
+#include <iostream>
+#include <unordered_map>
+
+#define TestSuite BenchmarkTest
+
+// run with --gtest_also_run_disabled_tests
+namespace
+{
+	// previous hash: xor of all float hashes
+	struct XorVertexHash
+	{
+		size_t operator()(const RefVertex& vertex) const noexcept
+		{
+			size_t res = 0;
+			const float* data = vertex.Vertex::data();
+			for (auto i = data, end = data + getAttributeElementStride(vertex.getAttributes()); i != end; ++i)
+				res ^= std::hash<float>()(*i);
+			return res;
+		}
+	};
+
+	// previous implementation of removeDuplicateVertices (vertex list per unique vertex and a second lookup)
+	void referenceRemoveDuplicates(uint32_t attributes, std::vector<float>& vertices, std::vector<uint32_t>& indices)
+	{
+		std::unordered_map<RefVertex, std::vector<uint32_t>, XorVertexHash> map;
+
+		const auto stride = getAttributeElementStride(attributes);
+		const auto numVertices = uint32_t(vertices.size() / stride);
+
+		for (uint32_t i = 0; i < numVertices; ++i)
+		{
+			const RefVertex v(attributes, &vertices[i * stride]);
+			auto it = map.find(v);
+			if (it != map.end())
+				it->second.push_back(i);
+			else
+				map[v] = std::vector<uint32_t>(std::initializer_list<uint32_t>{ i });
+		}
+
+		std::vector<bool> usedVertices(numVertices, false);
+		std::vector<uint32_t> newIndexLookupTable(numVertices);
+		std::vector<float> newVertices(map.size() * stride);
+		auto curVertex = newVertices.begin();
+		uint32_t curIndex = 0;
+
+		for (size_t i = 0; i < numVertices; ++i)
+		{
+			if (usedVertices[i]) continue;
+
+			curVertex = std::copy(vertices.begin() + i * stride, vertices.begin() + (i + 1) * stride, curVertex);
+
+			const RefVertex v(attributes, &vertices[i * stride]);
+			auto it = map.find(v);
+			for (auto idx : it->second)
+			{
+				usedVertices[idx] = true;
+				newIndexLookupTable[idx] = curIndex;
+			}
+			++curIndex;
+		}
+		vertices = std::move(newVertices);
+
+		for (auto& i : indices)
+			i = newIndexLookupTable[i];
+	}
+
+	// grid with position, normal and texcoord where every quad has its own 4 vertices
+	BinaryMesh32 createGrid(uint32_t size)
+	{
+		std::vector<float> vertices;
+		std::vector<uint32_t> indices;
+		vertices.reserve(size_t(size) * size * 4 * 8);
+		indices.reserve(size_t(size) * size * 6);
+		for (uint32_t y = 0; y < size; ++y)
+		{
+			for (uint32_t x = 0; x < size; ++x)
+			{
+				const auto base = uint32_t(vertices.size() / 8);
+				const float corners[][2] = { {0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f} };
+				for (const auto& c : corners)
+				{
+					const float px = float(x) + c[0];
+					const float py = float(y) + c[1];
+					const float v[] = { px, py, 0.0f, 0.0f, 0.0f, 1.0f, px / float(size), py / float(size) };
+					vertices.insert(vertices.end(), v, v + 8);
+				}
+				const uint32_t quad[] = { base, base + 1, base + 2, base, base + 2, base + 3 };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+
+		const auto numVertices = uint32_t(vertices.size() / 8);
+		const auto numIndices = uint32_t(indices.size());
+		return BinaryMesh32(Position | Normal | Texcoord0, std::move(vertices), std::move(indices),
+			{ Shape{ 0, numIndices, 0, numVertices, 0 } });
+	}
+
+	template<class Func>
+	double measureMs(Func func)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		func();
+		const auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+}
+
+TEST(TestSuite, DISABLED_RemoveDuplicates)
+{
+	const auto mesh = createGrid(1024);
+	const auto stride = getAttributeElementStride(mesh.getAttributes());
+	const auto numVertices = mesh.getNumVertices();
+
+	auto reference = mesh;
+	auto current = mesh;
+	std::vector<uint32_t> remap;
+	std::vector<uint32_t> parallelRemap;
+
+	const auto referenceMs = measureMs([&] { referenceRemoveDuplicates(reference.getAttributes(), reference.getVertices(), reference.getIndices()); });
+	const auto currentMs = measureMs([&] { current.removeDuplicateVertices(); });
+	const auto serialMs = measureMs([&] { generateVertexRemap(mesh.getVertices().data(), numVertices, stride, 0, stride, remap); });
+	const auto parallelMs = measureMs([&] { generateVertexRemap(mesh.getVertices().data(), numVertices, stride, 0, stride, parallelRemap, true); });
+
+	std::cout << "vertices:           " << numVertices << " => " << current.getNumVertices() << "\n";
+	std::cout << "reference:          " << referenceMs << " ms\n";
+	std::cout << "removeDuplicates:   " << currentMs << " ms\n";
+	std::cout << "remap (serial):     " << serialMs << " ms\n";
+	std::cout << "remap (parallel):   " << parallelMs << " ms\n";
+
+	EXPECT_EQ(reference.getVertices(), current.getVertices());
+	EXPECT_EQ(reference.getIndices(), current.getIndices());
+	EXPECT_EQ(remap, parallelRemap);
+}
+
+TEST(TestSuite, DISABLED_WeldVertices)
+{
+	auto mesh = createGrid(1024);
+	const auto numVertices = mesh.getNumVertices();
+	auto reference = mesh;
+
+	const auto weldMs = measureMs([&] { mesh.weldVertices(0.0001f, { { Texcoord0, 0.0001f } }); });
+	reference.removeDuplicateVertices();
+
+	std::cout << "vertices:           " << numVertices << " => " << mesh.getNumVertices() << "\n";
+	std::cout << "weldVertices:       " << weldMs << " ms\n";
+
+	EXPECT_EQ(reference.getNumVertices(), mesh.getNumVertices());
+}
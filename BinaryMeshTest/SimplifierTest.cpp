@@ -0,0 +1,203 @@
+#include "pch.h"
+
+#define TestSuite SimplifierTest
+
+namespace
+{
+	// flat grid with size x size quads in the xy plane. with uvIslands the left and right half have separate vertices
+	// (same positions, different texcoords) at x = size / 2
+	void createGrid(uint32_t size, bool uvIslands, std::vector<float>& vertices, std::vector<uint32_t>& indices)
+	{
+		const auto half = size / 2;
+		const auto base = uint32_t(vertices.size() / 5);
+		for (uint32_t island = 0; island < (uvIslands ? 2u : 1u); ++island)
+		{
+			const auto xStart = uvIslands ? island * half : 0;
+			const auto xEnd = uvIslands ? xStart + half : size;
+			// shape local index of the first island vertex
+			const auto islandStart = uint32_t(vertices.size() / 5) - base;
+			const auto width = xEnd - xStart + 1;
+			for (uint32_t y = 0; y <= size; ++y)
+			{
+				for (uint32_t x = xStart; x <= xEnd; ++x)
+				{
+					const float v[] = { float(x), float(y), 0.0f, float(island), 0.0f };
+					vertices.insert(vertices.end(), v, v + 5);
+				}
+			}
+			for (uint32_t y = 0; y < size; ++y)
+			{
+				for (uint32_t x = 0; x < width - 1; ++x)
+				{
+					const auto i = islandStart + y * width + x;
+					const uint32_t quad[] = { i, i + 1, i + width + 1, i, i + width + 1, i + width };
+					indices.insert(indices.end(), quad, quad + 6);
+				}
+			}
+		}
+	}
+
+	BinaryMesh32 createGridMesh(uint32_t size, bool uvIslands, uint32_t numShapes = 1)
+	{
+		std::vector<float> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<Shape> shapes;
+		for (uint32_t s = 0; s < numShapes; ++s)
+		{
+			const auto indexOffset = uint32_t(indices.size());
+			const auto vertexOffset = uint32_t(vertices.size() / 5);
+			createGrid(size, uvIslands, vertices, indices);
+			shapes.push_back(Shape{ indexOffset, uint32_t(indices.size()) - indexOffset,
+				vertexOffset, uint32_t(vertices.size() / 5) - vertexOffset, s });
+		}
+
+		BinaryMesh32 res(Position | Texcoord0, std::move(vertices), std::move(indices), std::move(shapes));
+		res.generateBoundingVolumes();
+		return res;
+	}
+
+	// signed area of the triangles in the xy plane
+	float getArea(const BinaryMesh32& mesh, const Shape& s)
+	{
+		float area = 0.0f;
+		for (uint32_t i = s.indexOffset; i < s.indexOffset + s.indexCount; i += 3)
+		{
+			glm::vec3 p[3];
+			for (uint32_t j = 0; j < 3; ++j)
+				p[j] = toVec3(mesh.getVertices().data() + (s.vertexOffset + mesh.getIndices()[i + j]) * 5);
+			const auto n = glm::cross(p[1] - p[0], p[2] - p[0]);
+			EXPECT_GT(n.z, 0.0f);
+			area += n.z * 0.5f;
+		}
+		return area;
+	}
+}
+
+TEST(TestSuite, SimplifyPlane)
+{
+	auto mesh = createGridMesh(16, false);
+	const auto numIndices = mesh.getIndices().size();
+
+	const auto error = mesh.simplify(0.1f, 0.01f);
+
+	// a plane can be simplified without error until the border stops it
+	EXPECT_LT(error, 1e-4f);
+	EXPECT_LE(mesh.getIndices().size(), numIndices / 10);
+	EXPECT_LT(mesh.getNumVertices(), 17u * 17u);
+	EXPECT_FLOAT_EQ(getArea(mesh, mesh.getShapes()[0]), 16.0f * 16.0f);
+
+	mesh.generateBoundingVolumes();
+	EXPECT_EQ(mesh.getBoundingBox(), createGridMesh(16, false).getBoundingBox());
+	EXPECT_NO_THROW(mesh.verify());
+}
+
+TEST(TestSuite, SimplifySeam)
+{
+	auto mesh = createGridMesh(16, true);
+	const auto numIndices = mesh.getIndices().size();
+	const auto& vertices = mesh.getVertices();
+
+	mesh.simplify(0.1f, 0.01f);
+	EXPECT_LE(mesh.getIndices().size(), numIndices / 4);
+	EXPECT_FLOAT_EQ(getArea(mesh, mesh.getShapes()[0]), 16.0f * 16.0f);
+
+	// triangles do not cross the seam
+	const auto& indices = mesh.getIndices();
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		const auto island = vertices[indices[i] * 5 + 3];
+		for (size_t j = 0; j < 3; ++j)
+		{
+			const auto x = vertices[indices[i + j] * 5];
+			ASSERT_EQ(vertices[indices[i + j] * 5 + 3], island);
+			ASSERT_TRUE(island == 0.0f ? x <= 8.0f : x >= 8.0f);
+		}
+	}
+
+	mesh.generateBoundingVolumes();
+	EXPECT_NO_THROW(mesh.verify());
+}
+
+TEST(TestSuite, SimplifyMaxError)
+{
+	// a bump in the center of the grid
+	auto mesh = createGridMesh(8, false);
+	mesh.getVertices()[(4 * 9 + 4) * 5 + 2] = 2.0f;
+	mesh.generateBoundingVolumes();
+
+	mesh.simplify(0.0f, 0.01f);
+	// the tip of the bump is still used
+	bool hasTip = false;
+	for (auto i : mesh.getIndices())
+		hasTip = hasTip || mesh.getVertices()[i * 5 + 2] == 2.0f;
+	EXPECT_TRUE(hasTip);
+}
+
+TEST(TestSuite, LodLoadSave)
+{
+	auto mesh = createGridMesh(16, true, 2);
+	mesh.generateLods(3, 0.5f, 0.01f);
+
+	ASSERT_EQ(mesh.getNumLodLevels(), 3);
+	ASSERT_EQ(mesh.getLods().size(), 6);
+	for (size_t s = 0; s < mesh.getShapes().size(); ++s)
+	{
+		EXPECT_LT(mesh.getLod(1, s).indexCount, mesh.getShapes()[s].indexCount);
+		EXPECT_LT(mesh.getLod(2, s).indexCount, mesh.getLod(1, s).indexCount);
+		EXPECT_LE(mesh.getLod(3, s).indexCount, mesh.getLod(2, s).indexCount);
+		EXPECT_LE(mesh.getLod(1, s).error, mesh.getLod(3, s).error);
+	}
+	EXPECT_NO_THROW(mesh.verify());
+
+	mesh.saveToFile("LodTest.bmf");
+
+	BinaryMesh32 full;
+	full.loadFromFile("LodTest.bmf");
+	EXPECT_EQ(full.getIndices(), mesh.getIndices());
+	EXPECT_EQ(full.getLodIndices(), mesh.getLodIndices());
+	EXPECT_EQ(full.getNumLodLevels(), 3);
+	EXPECT_NO_THROW(full.verify());
+
+	BinaryMesh32 lod;
+	lod.loadFromFile("LodTest.bmf", 2);
+	EXPECT_EQ(lod.getNumLodLevels(), 0);
+	EXPECT_LT(lod.getNumVertices(), mesh.getNumVertices());
+	for (size_t s = 0; s < mesh.getShapes().size(); ++s)
+	{
+		const auto& ls = lod.getShapes()[s];
+		const auto& ms = mesh.getShapes()[s];
+		const auto& l = mesh.getLod(2, s);
+		ASSERT_EQ(ls.indexCount, l.indexCount);
+
+		// same triangles
+		for (uint32_t i = 0; i < l.indexCount; ++i)
+		{
+			const float* p = lod.getVertices().data() + (ls.vertexOffset + lod.getIndices()[ls.indexOffset + i]) * 5;
+			const float* mp = mesh.getVertices().data() + (ms.vertexOffset + mesh.getLodIndices()[l.indexOffset + i]) * 5;
+			ASSERT_EQ(memcmp(p, mp, 5 * sizeof(float)), 0);
+		}
+	}
+	EXPECT_NO_THROW(lod.verify());
+
+	EXPECT_THROW(lod.loadFromFile("LodTest.bmf", 4), std::runtime_error);
+}
+
+TEST(TestSuite, LodSplitMerge)
+{
+	auto mesh = createGridMesh(8, false, 3);
+	mesh.generateLods(2, 0.5f, 0.01f);
+
+	const auto merged = BinaryMesh32::mergeShapes(mesh.splitShapes());
+	EXPECT_EQ(merged.getLodIndices(), mesh.getLodIndices());
+	ASSERT_EQ(merged.getLods().size(), mesh.getLods().size());
+	for (size_t i = 0; i < mesh.getLods().size(); ++i)
+	{
+		EXPECT_EQ(merged.getLods()[i].indexOffset, mesh.getLods()[i].indexOffset);
+		EXPECT_EQ(merged.getLods()[i].indexCount, mesh.getLods()[i].indexCount);
+	}
+	EXPECT_NO_THROW(merged.verify());
+
+	// modifying the index buffer discards the lods
+	mesh.optimizeVertexCache();
+	EXPECT_EQ(mesh.getNumLodLevels(), 0);
+}
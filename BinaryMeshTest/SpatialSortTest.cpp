@@ -0,0 +1,112 @@
+#include "pch.h"
+#include <random>
+
+#define TestSuite SpatialSortTest
+
+namespace
+{
+	// billboards with position and width in capture order (random)
+	BinaryMesh createPointCloud(size_t count)
+	{
+		std::mt19937 rng(3);
+		std::uniform_real_distribution<float> pos(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> size(0.0f, 0.5f);
+		std::vector<float> vertices;
+		for (size_t i = 0; i < count; ++i)
+			vertices.insert(vertices.end(), { pos(rng), pos(rng), pos(rng), size(rng) });
+		BinaryMesh mesh(Position | Width, std::move(vertices));
+		mesh.generateBoundingVolumes();
+		return mesh;
+	}
+
+	float getVolume(const BoundingBox& b)
+	{
+		return (b.maxX - b.minX) * (b.maxY - b.minY) * (b.maxZ - b.minZ);
+	}
+}
+
+TEST(TestSuite, RadixSort)
+{
+	// enough keys for multiple threads
+	std::mt19937 rng(7);
+	std::vector<uint32_t> keys(300000);
+	for (auto& k : keys) k = rng() % 5000;
+	keys[17] = 0xFFFFFFFFu;
+
+	std::vector<uint32_t> expected(keys.size());
+	for (size_t i = 0; i < keys.size(); ++i) expected[i] = uint32_t(i);
+	std::stable_sort(expected.begin(), expected.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+	EXPECT_EQ(radixSortIndices(keys), expected);
+
+	EXPECT_TRUE(radixSortIndices({}).empty());
+	EXPECT_EQ(radixSortIndices({ 3, 3, 1 }), std::vector<uint32_t>({ 2, 0, 1 }));
+}
+
+TEST(TestSuite, MortonCode)
+{
+	const BoundingBox bounds{ 0.0f, 0.0f, 0.0f, 1.0f, 2.0f, 4.0f };
+	EXPECT_EQ(getMortonCode(glm::vec3(0.0f), bounds), 0u);
+	EXPECT_EQ(getMortonCode(glm::vec3(1.0f, 2.0f, 4.0f), bounds), 0x3FFFFFFFu);
+	// x is the most significant axis
+	EXPECT_EQ(getMortonCode(glm::vec3(1.0f, 0.0f, 0.0f), bounds), 0x24924924u);
+	EXPECT_EQ(getMortonCode(glm::vec3(0.0f, 0.0f, 4.0f), bounds), 0x09249249u);
+	// flat bounds
+	EXPECT_EQ(getMortonCode(glm::vec3(0.5f, 0.0f, 0.0f), BoundingBox{ 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f }), 0x20000000u);
+}
+
+TEST(TestSuite, SortBillboards)
+{
+	auto mesh = createPointCloud(10000);
+	const auto bbox = mesh.getBoundingBox();
+	auto original = mesh.getVertices();
+	EXPECT_TRUE(mesh.getChunkBounds().empty());
+
+	mesh.sortSpatially(625);
+	EXPECT_EQ(mesh.getChunkSize(), 625);
+	ASSERT_EQ(mesh.getChunkBounds().size(), 16);
+	EXPECT_NO_THROW(mesh.verify());
+
+	// same billboards in a different order
+	const auto sortBillboards = [](std::vector<float> v)
+	{
+		std::vector<std::array<float, 4>> res(v.size() / 4);
+		memcpy(res.data(), v.data(), v.size() * sizeof(float));
+		std::sort(res.begin(), res.end());
+		return res;
+	};
+	EXPECT_NE(mesh.getVertices(), original);
+	EXPECT_EQ(sortBillboards(mesh.getVertices()), sortBillboards(original));
+	EXPECT_EQ(mesh.getBoundingBox(), bbox);
+
+	// the chunks are compact. each chunk of the unsorted billboards covers almost the whole box
+	auto chunkUnion = -BoundingBox::max();
+	float chunkVolume = 0.0f;
+	for (const auto& c : mesh.getChunkBounds())
+	{
+		chunkUnion = chunkUnion.unionWith(c);
+		chunkVolume += getVolume(c);
+	}
+	EXPECT_EQ(chunkUnion, bbox);
+	EXPECT_LT(chunkVolume, getVolume(bbox) * 4.0f);
+
+	mesh.saveToFile("SpatialSortTest.bmf");
+	BinaryMesh loaded;
+	loaded.loadFromFile("SpatialSortTest.bmf");
+	EXPECT_EQ(loaded.getChunkSize(), 625);
+	EXPECT_EQ(loaded.getChunkBounds(), mesh.getChunkBounds());
+	EXPECT_NO_THROW(loaded.verify());
+
+	// moved billboard
+	mesh.getVertices()[0] += 300.0f;
+	EXPECT_THROW(mesh.verify(), std::runtime_error);
+	mesh.generateBoundingVolumes();
+	EXPECT_NO_THROW(mesh.verify());
+}
+
+TEST(TestSuite, IndexedMeshes)
+{
+	BinaryMesh32 mesh(Position, { 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f }, { 0, 1, 2 }, { Shape{ 0, 3, 0, 3, 0 } });
+	EXPECT_THROW(mesh.sortSpatially(), std::runtime_error);
+	EXPECT_THROW(MixedBinaryMesh(mesh).sortSpatially(), std::runtime_error);
+	EXPECT_THROW(createPointCloud(10).sortSpatially(0), std::runtime_error);
+}
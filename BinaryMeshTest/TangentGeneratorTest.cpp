@@ -0,0 +1,127 @@
+#include "pch.h"
+
+#define TestSuite GeneratorTest
+
+TEST(TestSuite, Tangents)
+{
+	using BinaryMesh = BinaryMesh32;
+
+	const std::vector<float> vertices = {
+		0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, // vertex 0
+		1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, // vertex 1
+		1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, // vertex 2
+		0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, // vertex 3
+	};
+	const std::vector<uint32_t> indices = {
+		0, 1, 2, // triangle 1
+		0, 2, 3, // triangle 2
+	};
+	const std::vector<Shape> shapes = {
+		Shape{0, 6, 0, 4, 2}, // shape
+	};
+
+	BinaryMesh m1(Position | Normal | Texcoord0, vertices, indices, shapes);
+	m1.generateBoundingVolumes();
+
+	std::vector<std::unique_ptr<VertexGenerator>> generators;
+	generators.emplace_back(new TangentGenerator());
+
+	m1.changeAttributes(Position | Normal | Texcoord0 | Tangent | BiTangent, generators);
+
+	// texture coordinates match x and y
+	EXPECT_EQ(m1.getNumVertices(), 4);
+	EXPECT_EQ(m1.getIndices(), indices);
+	const auto stride = getAttributeElementStride(m1.getAttributes());
+	const auto tangentOffset = getAttributeElementOffset(m1.getAttributes(), Tangent);
+	const auto bitangentOffset = getAttributeElementOffset(m1.getAttributes(), BiTangent);
+	for (uint32_t v = 0; v < m1.getNumVertices(); ++v)
+	{
+		const float* t = m1.getVertices().data() + v * stride + tangentOffset;
+		const float* b = m1.getVertices().data() + v * stride + bitangentOffset;
+		EXPECT_NEAR(t[0], 1.0f, 0.0001f);
+		EXPECT_NEAR(t[1], 0.0f, 0.0001f);
+		EXPECT_NEAR(t[2], 0.0f, 0.0001f);
+		EXPECT_NEAR(b[0], 0.0f, 0.0001f);
+		EXPECT_NEAR(b[1], 1.0f, 0.0001f);
+		EXPECT_NEAR(b[2], 0.0f, 0.0001f);
+	}
+	EXPECT_NO_THROW(m1.verify());
+}
+
+TEST(TestSuite, TangentsMirrored)
+{
+	using BinaryMesh = BinaryMesh32;
+
+	const std::vector<float> vertices = {
+		0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, // vertex 0
+		1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, // vertex 1
+		1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, // vertex 2
+		0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, // vertex 3 (mirrored texture coordinate)
+	};
+	const std::vector<uint32_t> indices = {
+		0, 1, 2, // triangle 1
+		0, 2, 3, // triangle 2 (mirrored)
+	};
+	const std::vector<Shape> shapes = {
+		Shape{0, 6, 0, 4, 2}, // shape
+	};
+
+	BinaryMesh m1(Position | Normal | Texcoord0, vertices, indices, shapes);
+	m1.generateBoundingVolumes();
+
+	std::vector<std::unique_ptr<VertexGenerator>> generators;
+	generators.emplace_back(new TangentGenerator());
+
+	m1.changeAttributes(Position | Normal | Texcoord0 | Tangent | BiTangent, generators);
+
+	// vertex 0 and 2 are split because both triangles have a different orientation
+	EXPECT_EQ(m1.getNumVertices(), 6);
+	EXPECT_EQ(m1.getIndices(), std::vector<uint32_t>({ 0, 2, 3, 1, 4, 5 }));
+
+	// the mirrored vertex 0 has u along y and v along x => left handed frame
+	const auto stride = getAttributeElementStride(m1.getAttributes());
+	const float* t1 = m1.getVertices().data() + stride + getAttributeElementOffset(m1.getAttributes(), Tangent);
+	const float* b1 = m1.getVertices().data() + stride + getAttributeElementOffset(m1.getAttributes(), BiTangent);
+	EXPECT_NEAR(t1[0], 0.0f, 0.0001f);
+	EXPECT_NEAR(t1[1], 1.0f, 0.0001f);
+	EXPECT_NEAR(b1[0], 1.0f, 0.0001f);
+	EXPECT_NEAR(b1[1], 0.0f, 0.0001f);
+	EXPECT_NO_THROW(m1.verify());
+}
+
+TEST(TestSuite, TangentsDegenerateTexcoords)
+{
+	using BinaryMesh = BinaryMesh32;
+
+	const std::vector<float> vertices = {
+		0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, // vertex 0
+		1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, // vertex 1
+		1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, // vertex 2
+		0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, // vertex 3 (same texture coordinate as vertex 2)
+	};
+	const std::vector<uint32_t> indices = {
+		0, 1, 2, // triangle 1
+		0, 2, 3, // triangle 2 (zero area in texture space)
+	};
+	const std::vector<Shape> shapes = {
+		Shape{0, 6, 0, 4, 2}, // shape
+	};
+
+	BinaryMesh m1(Position | Normal | Texcoord0, vertices, indices, shapes);
+	m1.generateBoundingVolumes();
+
+	std::vector<std::unique_ptr<VertexGenerator>> generators;
+	generators.emplace_back(new TangentGenerator());
+
+	m1.changeAttributes(Position | Normal | Texcoord0 | Tangent | BiTangent, generators);
+
+	// the degenerate triangle has no orientation => no vertex is split
+	EXPECT_EQ(m1.getNumVertices(), 4);
+	EXPECT_EQ(m1.getIndices(), indices);
+	const auto stride = getAttributeElementStride(m1.getAttributes());
+	const float* b0 = m1.getVertices().data() + getAttributeElementOffset(m1.getAttributes(), BiTangent);
+	EXPECT_NEAR(b0[1], 1.0f, 0.0001f);
+	const float* b3 = m1.getVertices().data() + 3 * stride + getAttributeElementOffset(m1.getAttributes(), BiTangent);
+	EXPECT_NEAR(std::abs(b3[0]) + std::abs(b3[1]) + std::abs(b3[2]), 1.0f, 0.0001f);
+	EXPECT_NO_THROW(m1.verify());
+}
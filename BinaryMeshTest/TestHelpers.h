@@ -0,0 +1,66 @@
+//
+// TestHelpers.h
+// Fixtures that are shared by multiple tests.
+//
+
+#pragma once
+
+#include "pch.h"
+
+// left handed perspective camera at the origin looking along +z with a 90 degree field of view
+inline glm::mat4 createViewProjection(float nearPlane, float farPlane)
+{
+	glm::mat4 m(0.0f);
+	m[0][0] = 1.0f;
+	m[1][1] = 1.0f;
+	m[2][2] = (farPlane + nearPlane) / (farPlane - nearPlane);
+	m[2][3] = 1.0f;
+	m[3][2] = -2.0f * farPlane * nearPlane / (farPlane - nearPlane);
+	return m;
+}
+
+// grid with size x size quads per shape. position(shape, x, y) returns the vertex position
+template<class Func>
+BinaryMesh32 createGrid(uint32_t size, uint32_t numShapes, Func position)
+{
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<Shape> shapes;
+
+	for (uint32_t s = 0; s < numShapes; ++s)
+	{
+		const auto indexOffset = uint32_t(indices.size());
+		const auto vertexOffset = uint32_t(vertices.size() / 3);
+		for (uint32_t y = 0; y <= size; ++y)
+		{
+			for (uint32_t x = 0; x <= size; ++x)
+			{
+				const glm::vec3 v = position(s, x, y);
+				vertices.insert(vertices.end(), { v.x, v.y, v.z });
+			}
+		}
+		for (uint32_t y = 0; y < size; ++y)
+		{
+			for (uint32_t x = 0; x < size; ++x)
+			{
+				const auto i = y * (size + 1) + x;
+				const uint32_t quad[] = { i, i + 1, i + size + 2, i, i + size + 2, i + size + 1 };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+		shapes.push_back(Shape{ indexOffset, uint32_t(indices.size()) - indexOffset, vertexOffset, (size + 1) * (size + 1), s });
+	}
+
+	BinaryMesh32 res(Position, std::move(vertices), std::move(indices), std::move(shapes));
+	res.generateBoundingVolumes();
+	return res;
+}
+
+// flat grid in the xy plane (facing +z) with one unit per quad. shape s is at z = s
+inline BinaryMesh32 createGrid(uint32_t size, uint32_t numShapes)
+{
+	return createGrid(size, numShapes, [](uint32_t s, uint32_t x, uint32_t y)
+	{
+		return glm::vec3(float(x), float(y), float(s));
+	});
+}
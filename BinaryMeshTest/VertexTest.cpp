@@ -72,3 +72,15 @@ TEST(TestSuite, Set)
 	EXPECT_EQ(v.get(Texcoord0)[0], newTex[0]);
 	EXPECT_EQ(v.get(Texcoord0)[1], newTex[1]);
 }
+
+TEST(TestSuite, Hash)
+{
+	float data1[] = { 1.0f, 2.0f, 3.0f };
+	float data2[] = { 3.0f, 2.0f, 1.0f };
+	float data3[] = { 1.0f, 2.0f, 3.0f };
+
+	const std::hash<RefVertex> hash;
+	// permutations of the same values should not collide
+	EXPECT_NE(hash(RefVertex(Position, data1)), hash(RefVertex(Position, data2)));
+	EXPECT_EQ(hash(RefVertex(Position, data1)), hash(RefVertex(Position, data3)));
+}
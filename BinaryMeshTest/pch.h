@@ -11,9 +11,3 @@
 #include "../include/bmf/BinaryMesh.h"
 
 using namespace bmf;
-
-// returns vector of identity matrices
-//inline std::vector<glm::vec3> getIdentityVec(size_t numInstances)
-//{
-//	return std::vector<glm::vec3>(numInstances, glm::vec3(0.0f));
-//}
\ No newline at end of file
@@ -71,9 +71,9 @@ namespace bmf
 	/// \brief return number of floats of one vertex
 	inline uint32_t getAttributeElementStride(uint32_t attributes) noexcept
 	{
-		// this functions is used quite frequently => remember last stride
-		static uint32_t lastAttribs = 0;
-		static uint32_t lastStride = 0;
+		// this functions is used quite frequently => remember last stride (per thread)
+		thread_local uint32_t lastAttribs = 0;
+		thread_local uint32_t lastStride = 0;
 		if (attributes == lastAttribs) return lastStride;
 
 		lastAttribs = attributes;
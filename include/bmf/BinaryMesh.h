@@ -3,6 +3,7 @@
 #include <vector>
 #include <fstream>
 #include <algorithm>
+#include <limits>
 #include "Attributes.h"
 #include "VertexGenerator.h"
 #include <unordered_map>
@@ -10,20 +11,35 @@
 #include <string>
 #include "generators/glm.h"
 #include "Sphere.h"
+#include "VertexRemap.h"
+#include "MeshOptimizer.h"
+#include "Simplifier.h"
+#include "Meshlet.h"
+#include "Bvh.h"
+#include "Culling.h"
+#include "OrientedBoundingBox.h"
+#include "LooseOctree.h"
+#include "OcclusionCulling.h"
+#include "SpatialSort.h"
+#include "PointCloudHierarchy.h"
+#include "Span.h"
 
 #ifdef BMF_GENERATORS
 #include "generators/ConstantValueGenerator.h"
+#include "generators/NormalGenerator.h"
 #include "generators/FlatNormalGenerator.h"
 #include "generators/InterpolatedNormalGenerator.h"
+#include "generators/TangentGenerator.h"
 #endif
 
 namespace bmf
 {
+	template<class IndexT>
+	class ShapeView;
+
 	class BinaryMesh
 	{
 	public:
-		
-		//using InstanceData = glm::vec3;
 
 #pragma region Getter
 		/// \brief returns bitmask of all used attributes (see Attributes enum)
@@ -34,9 +50,11 @@ namespace bmf
 		const BoundingBox& getBoundingBox() const noexcept { return m_bbox; }
 		Sphere& getBoundingSphere() noexcept { return m_sphere; }
 		const Sphere& getBoundingSphere() const noexcept { return m_sphere; }
-		//std::vector<InstanceData>& getInstanceTransforms();
-		//const std::vector<InstanceData>& getInstanceTransforms() const;
 		uint32_t getNumVertices() const noexcept;
+		/// \brief billboard bounding boxes of the vertex chunks [i * chunkSize, (i + 1) * chunkSize) (see sortSpatially).
+		/// empty if the billboards were not sorted
+		const std::vector<BoundingBox>& getChunkBounds() const noexcept { return m_chunkBounds; }
+		uint32_t getChunkSize() const noexcept { return m_chunkSize; }
 		/// \brief checks if the mesh has a valid amount of indices/vertices
 		/// and no index that goes beyond the buffer.
 		/// \throw std::runtime error if something is wrong
@@ -50,7 +68,11 @@ namespace bmf
 		void saveToFile(const std::string& filename) const;
 #pragma endregion
 #pragma region Grouping
+		/// \brief concatenates the vertices of all meshes. The bounding volumes are derived from the
+		/// bounding volumes of the meshes (call generateBoundingVolumes on the meshes before)
 		static BinaryMesh merge(const std::vector<BinaryMesh>& meshes);
+		/// \brief like merge, but the vertex buffer of the first mesh is reused instead of copied
+		static BinaryMesh merge(std::vector<BinaryMesh>&& meshes);
 #pragma endregion 
 #pragma region Generating
 		void changeAttributes(uint32_t newAttributes,
@@ -59,6 +81,9 @@ namespace bmf
 		virtual void generateBoundingVolumes();
 		/// \brief adds the offset to each material id
 		virtual void offsetMaterial(uint32_t offset);
+		/// \brief reorders the billboards along a morton curve and computes the bounding box of each chunk
+		/// of chunkSize billboards (see getChunkBounds). Only supported for meshes without indices
+		virtual void sortSpatially(uint32_t chunkSize = DefaultSpatialChunkSize);
 #pragma endregion
 #pragma region Ctor
 		BinaryMesh(uint32_t attributes, std::vector<float> vertices);
@@ -74,8 +99,10 @@ namespace bmf
 		// generator helpers
 		void useVertexGenerator(const SingleVertexGenerator& svgen);
 		virtual void useMultiVertexGenerator(const MultiVertexGenerator& mvgen);
+		virtual void useIndexedVertexGenerator(const IndexedVertexGenerator& ivgen);
 
 		static BoundingBox getBillboardBoundingBox(const std::vector<float>& vertices, uint32_t attributes);
+		static BoundingBox getBillboardBoundingBox(const float* start, const float* end, uint32_t attributes);
 		static BoundingBox getBoundingBox(const float* start, const float* end, uint32_t attributes);
 		static BoundingBox getBoundingBox(const std::vector<float>& vertices, uint32_t attributes);
 		static Sphere getBillboardBoundingSphere(const std::vector<float>& vertices, uint32_t attributes);
@@ -84,6 +111,15 @@ namespace bmf
 		static bool allPointsInSphere(const std::vector<float>& vertices, uint32_t attributes, const Sphere& s);
 		static bool allPointsInSphere(const float* start, const float* end, uint32_t attributes, const Sphere& s, glm::vec3* outsidePoint = nullptr);
 		static glm::vec3 getLargestDistantPoint(const float* start, const float* end, size_t stride, glm::vec3 p);
+		// bounding sphere of merged meshes: the union of the mesh spheres or the sphere around the merged box (the smaller one)
+		template<class MeshT>
+		static Sphere getMergedBoundingSphere(const std::vector<MeshT>& meshes, const BoundingBox& bbox);
+		// the sphere or the sphere around the box (the smaller one)
+		static Sphere getSmallerBoundingSphere(const Sphere& sphere, const BoundingBox& bbox);
+#pragma endregion 
+#pragma region Grouping
+		// merge helper. the buffers of moveFirst (the first mesh) are moved instead of copied if it is not null
+		static BinaryMesh merge(const std::vector<BinaryMesh>& meshes, BinaryMesh* moveFirst);
 #pragma endregion 
 #pragma region FileIO
 		// fstream helpers
@@ -102,13 +138,22 @@ namespace bmf
 		virtual void readExtendedData(std::fstream& stream) {}
 #pragma endregion 
 		virtual void verifyBoundingVolumes() const;
+		// billboard bounds of each vertex chunk
+		void generateChunkBounds();
 
 		std::vector<float> m_vertices;
 		BoundingBox m_bbox;
 		Sphere m_sphere;
 		uint32_t m_attributes = 0;
+		std::vector<BoundingBox> m_chunkBounds;
+		uint32_t m_chunkSize = 0;
 
-		static constexpr uint32_t s_version = 8;
+		static constexpr uint32_t s_version = 15;
+		// minimum number of vertices for processing shapes (or meshes) in parallel
+		static constexpr uint32_t ShapeParallelThreshold = 100000;
+
+		// uses the bounding volume helpers
+		template<class> friend class ShapeView;
 	};
 
 	struct Shape
@@ -121,10 +166,6 @@ namespace bmf
 		uint32_t vertexOffset;
 		// number of used vertices
 		uint32_t vertexCount;
-		// offset in the instance array
-		//uint32_t instanceOffset;
-		// number of instances
-		//uint32_t instanceCount;
 		// material if for this shape
 		uint32_t materialId;
 
@@ -134,16 +175,74 @@ namespace bmf
 		Sphere sphere;
 	};
 
+	/// \brief index range of a simplified version of a shape (see ShapeBinaryMesh::generateLods)
+	struct ShapeLod
+	{
+		// offset for the first index in the lod index buffer
+		uint32_t indexOffset;
+		// number of used indices
+		uint32_t indexCount;
+		// simplification error relative to the shape extent
+		float error;
+	};
+
 	template<class IndexT>
 	class ShapeBinaryMesh final : public BinaryMesh
 	{
 	public:
+		// object to world transform of a shape instance
+		using InstanceData = glm::mat4;
 
 #pragma region GETTER
 		std::vector<IndexT>& getIndices() { return m_indices; }
 		const std::vector<IndexT>& getIndices() const { return m_indices; }
 		std::vector<Shape>& getShapes() { return m_shapes; }
 		const std::vector<Shape>& getShapes() const { return m_shapes; }
+		/// \brief position only index buffer with the same layout as the index buffer (see generateShadowIndices).
+		/// empty if no shadow indices were generated
+		std::vector<IndexT>& getShadowIndices() { return m_shadowIndices; }
+		const std::vector<IndexT>& getShadowIndices() const { return m_shadowIndices; }
+		/// \brief lod index ranges of all shapes, ordered by level and then by shape (see generateLods).
+		/// The lod indices use the vertices of the shape like the shape indices.
+		const std::vector<ShapeLod>& getLods() const { return m_lods; }
+		const std::vector<IndexT>& getLodIndices() const { return m_lodIndices; }
+		/// \brief number of lod levels without the shape indices (level 0)
+		uint32_t getNumLodLevels() const { return m_shapes.empty() ? 0 : uint32_t(m_lods.size() / m_shapes.size()); }
+		/// \param level between 1 and getNumLodLevels()
+		const ShapeLod& getLod(uint32_t level, size_t shape) const { return m_lods[(level - 1) * m_shapes.size() + shape]; }
+		/// \brief meshlets of all shapes (see buildMeshlets). empty if no meshlets were built
+		const std::vector<Meshlet>& getMeshlets() const { return m_meshlets; }
+		/// \brief the meshlets of shape i are [offsets[i], offsets[i + 1])
+		const std::vector<uint32_t>& getMeshletOffsets() const { return m_meshletOffsets; }
+		/// \brief shape local vertex indices of the meshlets
+		const std::vector<IndexT>& getMeshletVertices() const { return m_meshletVertices; }
+		/// \brief 3 meshlet local indices per triangle
+		const std::vector<uint8_t>& getMeshletTriangles() const { return m_meshletTriangles; }
+		/// \brief transforms of all shape instances (see deinstanceShapes). empty if the shapes are not instanced
+		const std::vector<InstanceData>& getInstanceTransforms() const { return m_instances; }
+		/// \brief the instances of shape i are [offsets[i], offsets[i + 1])
+		const std::vector<uint32_t>& getInstanceOffsets() const { return m_instanceOffsets; }
+		/// \brief triangle bvh nodes of all shapes (see buildBvh). empty if no bvh was built.
+		/// The nodes of shape i are [offsets[i], offsets[i + 1]) and their child indices are relative to offsets[i]
+		const std::vector<BvhNode>& getBvhNodes() const { return m_bvhNodes; }
+		const std::vector<uint32_t>& getBvhOffsets() const { return m_bvhOffsets; }
+		/// \brief shape local triangle indices in leaf order with one entry per triangle of the index buffer.
+		/// The leaf ranges of shape i are relative to shape.indexOffset / 3
+		const std::vector<uint32_t>& getBvhTriangles() const { return m_bvhTriangles; }
+		/// \brief bvh over the shape bounding boxes. the primitives are shape indices
+		const std::vector<BvhNode>& getTopLevelBvhNodes() const { return m_topLevelBvhNodes; }
+		const std::vector<uint32_t>& getTopLevelBvhShapes() const { return m_topLevelBvhShapes; }
+		/// \brief oriented bounding box of each shape in shape space (see generateOrientedBoundingBoxes). empty if not generated
+		const std::vector<OrientedBoundingBox>& getOrientedBoundingBoxes() const { return m_orientedBoxes; }
+		/// \brief closest triangle that is hit by the ray in shape space (instances are ignored). requires buildBvh
+		bool intersectRay(Ray ray, RayHit& hit) const;
+		/// \brief appends all triangles that overlap with the box (in shape space) to the result. requires buildBvh
+		void queryBox(const BoundingBox& box, std::vector<ShapeTriangle>& result) const;
+		/// \brief read only view of the shape without copying its vertices and indices (see splitShapes for copies)
+		ShapeView<IndexT> getShapeView(size_t shape) const;
+		/// \brief true if the vertices of the shape were modified after its bounding volumes were computed (see editVertices)
+		bool isShapeDirty(size_t shape) const;
+		bool hasDirtyShapes() const { return !m_dirtyShapes.empty(); }
 
 		// helper for dxr structures
 
@@ -154,31 +253,111 @@ namespace bmf
 		/// \brief returns an array with  the size of numIndices() / 3.
 		/// and holds the shape material id per triangle
 		std::vector<uint32_t> getMaterialIdPerTriangle() const;
+		/// \brief simulates a FIFO post-transform cache for the triangles of each shape
+		VertexCacheStatistics analyzeVertexCache(uint32_t cacheSize = DefaultVertexCacheSize) const;
 		virtual void verify() const override;
+		/// \brief like verify, but the bounding volumes of clean shapes and the mesh sphere are not recalculated if trustCleanShapes is set.
+		/// Only valid if all vertex modifications were done with editVertices. Dirty shapes are always an error
+		void verify(bool trustCleanShapes) const;
 #pragma endregion 
+#pragma region FileIO
+		using BinaryMesh::loadFromFile;
+		/// \brief loads only the indices of the lod level (0 = shape indices) and uses them as shape indices.
+		/// Vertices that are not used by the level are removed and the bounding volumes are recalculated.
+		void loadFromFile(const std::string& filename, uint32_t lodLevel);
+#pragma endregion
 #pragma region Grouping
 		std::vector<ShapeBinaryMesh<IndexT>> splitShapes() const;
+		/// \brief concatenates the shapes of all meshes. The mesh bounding volumes are derived from the
+		/// bounding volumes of the meshes (call generateBoundingVolumes on the meshes before)
 		static ShapeBinaryMesh<IndexT> mergeShapes(const std::vector<ShapeBinaryMesh<IndexT>>& meshes);
+		/// \brief like mergeShapes, but the vertex and index buffers of the first mesh are reused instead of copied
+		static ShapeBinaryMesh<IndexT> mergeShapes(std::vector<ShapeBinaryMesh<IndexT>>&& meshes);
+		/// \brief concatenates shapes with the same material (and the same instances) to reduce the number of draw calls.
+		/// Shapes are merged in order of appearance as long as the merged shape has at most maxVerticesPerShape vertices.
+		/// The vertex and index buffers are rebuilt in the merged shape order and the shape bounding volumes are recalculated.
+		/// \param maxVerticesPerShape vertex limit of the merged shapes (clamped to the index type)
+		void mergeShapesByMaterial(uint32_t maxVerticesPerShape = std::numeric_limits<uint32_t>::max());
+#pragma endregion
+#pragma region Mutation
+		/// \brief vertices [firstVertex, firstVertex + count) for modification. All shapes that use the vertices are
+		/// marked as dirty, call updateBoundingVolumes after the modification
+		Span<float> editVertices(uint32_t firstVertex, uint32_t count);
+		/// \brief vertices of the shape for modification (see editVertices)
+		Span<float> editShapeVertices(size_t shape);
+		/// \brief marks the bounding volumes of the shape as outdated
+		void markShapeDirty(size_t shape);
+		/// \brief recalculates the bounding box, sphere, oriented box and bvh node bounds of the dirty shapes.
+		/// The mesh bounding volumes and the top level bvh are derived from the shape bounding volumes.
+		/// Indices derived from the positions (shadow indices, lods, meshlets) are not updated
+		void updateBoundingVolumes();
 #pragma endregion
 #pragma region Generating
+		/// \brief shapes with removed vertices are marked as dirty (see updateBoundingVolumes)
 		void removeDuplicateVertices();
+		/// \brief merges vertices with a position distance <= positionEpsilon.
+		/// Other attributes may differ by the tolerance specified in attributeEpsilons (per float).
+		/// Attributes without tolerance must be bitwise equal. Merged vertices take the values of the first vertex.
+		/// Shapes with merged vertices are marked as dirty (see updateBoundingVolumes).
+		void weldVertices(float positionEpsilon, const std::unordered_map<Attributes, float>& attributeEpsilons = {});
+		/// \brief shapes with removed vertices are marked as dirty (see updateBoundingVolumes)
 		void removeUnusedVertices();
-		// tries to merge shapes with the same vertex/index information. epsilon: allowed squared vertex error
-		//static void deinstanceShapes(std::vector<BinaryMesh>& meshes, float epsilon = 0.00001f);
-		// moves all shape vertices so that they are centered around the origin
-		//void centerShapes();
-		// generates bounding boxes for all shapes
+		/// \brief generates a second index buffer for position only passes (depth prepass, shadow maps).
+		/// Each index references the first vertex of the shape with the same position.
+		/// Shadow indices are discarded by all operations that modify the vertex or index buffer.
+		void generateShadowIndices();
+		/// \brief reduces the triangles of each shape to targetRatio with quadric error edge collapses (see bmf::simplify).
+		/// Attribute seams are preserved. Unused vertices are removed and shapes with removed vertices are marked as dirty.
+		/// \param maxError maximum error relative to the extent of each shape
+		/// \return maximum error of all shapes
+		float simplify(float targetRatio, float maxError);
+		/// \brief generates numLevels simplified index ranges for each shape that use the shape vertices.
+		/// Each level has ratioPerLevel times the triangles of the previous level if maxError permits it.
+		/// Lods are discarded by all operations that modify the vertex or index buffer.
+		void generateLods(uint32_t numLevels, float ratioPerLevel, float maxError);
+		/// \brief splits each shape into meshlets with bounding volumes and normal cones (see bmf::buildMeshlets).
+		/// Meshlets are discarded by all operations that modify the vertex or index buffer.
+		void buildMeshlets(uint32_t maxVertices = DefaultMeshletMaxVertices, uint32_t maxTriangles = DefaultMeshletMaxTriangles);
+		/// \brief builds a triangle bvh for each shape (in parallel, see bmf::buildBvh) and a top level bvh over the
+		/// shape bounding boxes (call generateBoundingVolumes before). The bvh is saved with the mesh and
+		/// discarded by all operations that modify the vertex or index buffer.
+		void buildBvh(uint32_t maxLeafSize = DefaultBvhMaxLeafSize);
+		/// \brief fits an oriented bounding box to the vertices of each shape (in parallel, see bmf::computeOrientedBoundingBox).
+		/// The boxes are saved with the mesh and discarded by all operations that modify the vertex or index buffer.
+		void generateOrientedBoundingBoxes(bool refine = true);
+		/// \brief reorders the triangles within each shape for the post-transform vertex cache (Forsyth).
+		/// \return statistics of a FIFO cache with cacheSize entries before and after the optimization
+		VertexCacheOptimizationResult optimizeVertexCache(uint32_t cacheSize = DefaultVertexCacheSize);
+		/// \brief reorders the triangles within each shape to reduce overdraw. Call optimizeVertexCache() before.
+		/// \param threshold allowed ACMR degradation (1.05 => 5%)
+		void optimizeOverdraw(float threshold = 1.05f);
+		/// \brief renumbers the vertices of each shape in the order of their first use in the index buffer.
+		/// Unused vertices are removed. Call this after all triangle reordering passes. Shapes with moved vertices are marked as dirty.
+		void optimizeVertexFetch();
+		/// \brief replaces shapes that are transformed copies of another shape with instances of that shape.
+		/// Candidates need the same material, index pattern and non directional attributes. The positions must match
+		/// after a translation or an affine transform without mirroring. Normals and tangents are compared after the transform.
+		/// \param epsilon allowed squared position error
+		/// \return number of removed shapes
+		uint32_t deinstanceShapes(float epsilon = 0.00001f);
+		/// \brief moves the vertices of each shape so that its bounding box is centered around the origin.
+		/// The instance transforms compensate the movement. Bounding volumes are recalculated in shape space
+		void centerShapes();
+		// generates bounding boxes for all shapes. The oriented boxes and bvh bounds of dirty shapes are recalculated as well
 		virtual void generateBoundingVolumes() override;
 		// offsets all material indices by the specified offset
 		virtual void offsetMaterial(uint32_t offset) override;
+		// not supported, the indices depend on the vertex order
+		virtual void sortSpatially(uint32_t chunkSize = DefaultSpatialChunkSize) override;
 
-		// converts mesh to a mesh with 16 bit indices (moves all data to the other mesh)
-		// it is recommended to call removeUnusedVertices() before calling this method.
+		// converts mesh to meshes with 16 bit indices (moves all data to the other meshes).
+		// shapes with few vertices stay together in the first mesh. bigger shapes are split into chunks in
+		// index buffer order => call optimizeVertexCache() before for chunks with good locality.
 		std::vector<ShapeBinaryMesh<uint16_t>> force16BitIndices();
 #pragma endregion
 #pragma region Ctor
 		ShapeBinaryMesh(uint32_t attributes, std::vector<float> vertices, std::vector<IndexT> indices,
-			std::vector<Shape> shapes/*, std::vector<InstanceData> instances*/);
+			std::vector<Shape> shapes);
 		ShapeBinaryMesh() = default;
 		~ShapeBinaryMesh() = default;
 		ShapeBinaryMesh(const ShapeBinaryMesh&) = default;
@@ -190,6 +369,27 @@ namespace bmf
 #pragma region Generating
 		// generator helpers
 		void useMultiVertexGenerator(const MultiVertexGenerator& mvgen) override;
+		void useIndexedVertexGenerator(const IndexedVertexGenerator& ivgen) override;
+		// moves the shape vertices according to the remap table (see generateVertexRemap) and adjusts the indices.
+		// the vertex range of the shape is only shrunk, call packVertices() afterwards. false if nothing changed
+		bool applyVertexRemap(Shape& s, const std::vector<uint32_t>& remap, uint32_t numUnique);
+		// moves the vertex ranges of all shapes together after their vertex counts were reduced.
+		// The derived indices are discarded if any shape changed (one flag per shape)
+		void packVertices(const std::vector<uint8_t>& changedShapes);
+		// replaces the vertex buffer with the new vertices of each shape and adjusts the shape vertex ranges
+		void setShapeVertices(uint32_t attributes, std::vector<std::vector<float>>& shapeVertices);
+		// calls func(shapeIndex) for each shape. shapes of big meshes are processed in parallel
+		template<class Func>
+		void forEachShape(Func func);
+		// minimum number of shapes per thread in forEachShape
+		size_t getShapeGrainSize() const;
+		// true if forEachShape uses multiple threads
+		bool isShapeParallel() const;
+		// clears shadow indices, lods, meshlets, the bvh and oriented boxes after the vertex or index buffer was modified
+		// (instances stay valid)
+		void discardDerivedIndices();
+		// replaces the shape indices with the indices of each shape and adjusts the shape index ranges
+		void setShapeIndices(std::vector<std::vector<IndexT>>& shapeIndices);
 		BoundingBox calcBoundingBox(const Shape& s) const;
 		Sphere calcBoundingSphere(const Shape& s) const;
 #pragma endregion 
@@ -201,15 +401,167 @@ namespace bmf
 #pragma endregion 
 
 		virtual void verifyBoundingVolumes() const override;
+		void verifyShadowIndices() const;
+		void verifyLods() const;
+		void verifyMeshlets() const;
+		void verifyInstances() const;
+		void verifyBvh() const;
+		void verifyOrientedBoundingBoxes(bool trustCleanShapes) const;
+		// recalculates the oriented box and the bvh node bounds of the shape (if present)
+		void updateDerivedVolumes(size_t shape);
+		// recalculates the node bounds of the shape bvh without changing its structure
+		void refitBvh(size_t shape);
+		// builds the bvh over the shape bounding boxes
+		void buildTopLevelBvh();
+		void expectBvh(const std::string& operation) const;
+		// one identity instance per shape if the shapes are not instanced yet
+		void makeInstanced();
+		// transform from the shape src to the shape dst if dst is a transformed copy of src. result is unchanged otherwise
+		bool findInstanceTransform(const Shape& src, const Shape& dst, float epsilon, InstanceData& result) const;
 		void expectSingleShape(const std::string& operation) const;
+		// merge helper. the buffers of moveFirst (the first mesh) are moved instead of copied if it is not null
+		static ShapeBinaryMesh<IndexT> mergeShapes(const std::vector<ShapeBinaryMesh<IndexT>>& meshes, ShapeBinaryMesh<IndexT>* moveFirst);
 
 		std::vector<IndexT> m_indices;
 		std::vector<Shape> m_shapes;
+		std::vector<IndexT> m_shadowIndices;
+		std::vector<ShapeLod> m_lods;
+		std::vector<IndexT> m_lodIndices;
+		std::vector<Meshlet> m_meshlets;
+		std::vector<uint32_t> m_meshletOffsets;
+		std::vector<IndexT> m_meshletVertices;
+		std::vector<uint8_t> m_meshletTriangles;
+		// lod level that is read by readExtendedData
+		uint32_t m_loadLodLevel = 0;
+
+		std::vector<InstanceData> m_instances;
+		std::vector<uint32_t> m_instanceOffsets;
+
+		std::vector<BvhNode> m_bvhNodes;
+		std::vector<uint32_t> m_bvhOffsets;
+		std::vector<uint32_t> m_bvhTriangles;
+		std::vector<BvhNode> m_topLevelBvhNodes;
+		std::vector<uint32_t> m_topLevelBvhShapes;
+
+		std::vector<OrientedBoundingBox> m_orientedBoxes;
+		// refine flag of generateOrientedBoundingBoxes, reused when the boxes of modified shapes are updated
+		bool m_orientedBoxesRefined = true;
+		// empty if all shapes are clean, one flag per shape otherwise
+		std::vector<uint8_t> m_dirtyShapes;
 
-		//std::vector<InstanceData> m_instances;
+		// force16BitIndices moves the data to the other index type
+		template<class> friend class ShapeBinaryMesh;
 	};
 
 	using BinaryMesh16 = ShapeBinaryMesh<uint16_t>;
 	using BinaryMesh32 = ShapeBinaryMesh<uint32_t>;
 
+	/// \brief view of a single shape of a ShapeBinaryMesh with the queries of a single shape mesh.
+	/// The view does not own the data and is invalidated when the buffers of the mesh are modified.
+	template<class IndexT>
+	class ShapeView
+	{
+	public:
+		ShapeView(const ShapeBinaryMesh<IndexT>& mesh, size_t shape);
+		ShapeView() = default;
+
+		uint32_t getAttributes() const noexcept { return m_attributes; }
+		const Shape& getShape() const noexcept { return *m_shape; }
+		uint32_t getMaterialId() const noexcept { return m_shape->materialId; }
+		uint32_t getNumVertices() const noexcept { return m_shape->vertexCount; }
+		uint32_t getNumIndices() const noexcept { return m_shape->indexCount; }
+		/// \brief vertices of the shape. the shape local indices refer to these vertices
+		Span<const float> getVertices() const noexcept { return m_vertices; }
+		Span<const IndexT> getIndices() const noexcept { return m_indices; }
+		/// \brief first float of the vertex (see getAttributeElementOffset for the other attributes)
+		const float* getVertex(uint32_t vertex) const noexcept { return m_vertices.data() + size_t(vertex) * m_stride; }
+		glm::vec3 getPosition(uint32_t vertex) const noexcept { return toVec3(getVertex(vertex)); }
+		/// \brief bounding volumes that are stored in the shape (see generateBoundingVolumes)
+		const BoundingBox& getBoundingBox() const noexcept { return m_shape->bbox; }
+		const Sphere& getBoundingSphere() const noexcept { return m_shape->sphere; }
+		/// \brief calculates the bounding volumes from the vertex positions
+		BoundingBox calcBoundingBox() const;
+		Sphere calcBoundingSphere() const;
+		/// \brief checks if the shape indices are inside the vertex range
+		void verify() const;
+
+	private:
+		Span<const float> m_vertices;
+		Span<const IndexT> m_indices;
+		const Shape* m_shape = nullptr;
+		uint32_t m_attributes = 0;
+		uint32_t m_stride = 0;
+	};
+
+	/// \brief shape mesh where each shape uses the smallest index type for its vertex count.
+	/// The indices of all shapes are packed into one byte buffer. The indexOffset of a shape is a byte offset
+	/// (aligned to the index size) and indexCount the number of indices.
+	/// Shadow indices, lods, meshlets, instances, bvhs and oriented boxes are not supported.
+	class MixedBinaryMesh final : public BinaryMesh
+	{
+	public:
+
+#pragma region GETTER
+		std::vector<uint8_t>& getIndexBuffer() { return m_indexBuffer; }
+		const std::vector<uint8_t>& getIndexBuffer() const { return m_indexBuffer; }
+		std::vector<Shape>& getShapes() { return m_shapes; }
+		const std::vector<Shape>& getShapes() const { return m_shapes; }
+		/// \brief index size in bytes of each shape (2 or 4)
+		const std::vector<uint8_t>& getIndexSizes() const { return m_indexSizes; }
+		/// \brief indices of the shape. sizeof(IndexT) must match the index size of the shape
+		/// \throw std::runtime_error if the index size does not match
+		template<class IndexT>
+		Span<IndexT> getShapeIndices(size_t shape)
+		{
+			expectIndexSize(shape, sizeof(IndexT));
+			return Span<IndexT>(reinterpret_cast<IndexT*>(m_indexBuffer.data() + m_shapes[shape].indexOffset), m_shapes[shape].indexCount);
+		}
+		template<class IndexT>
+		Span<const IndexT> getShapeIndices(size_t shape) const
+		{
+			expectIndexSize(shape, sizeof(IndexT));
+			return Span<const IndexT>(reinterpret_cast<const IndexT*>(m_indexBuffer.data() + m_shapes[shape].indexOffset), m_shapes[shape].indexCount);
+		}
+		/// \brief index of the shape independent of the index size
+		uint32_t getIndex(size_t shape, size_t index) const;
+		virtual void verify() const override;
+#pragma endregion
+#pragma region Generating
+		// generates bounding boxes for all shapes
+		virtual void generateBoundingVolumes() override;
+		// offsets all material indices by the specified offset
+		virtual void offsetMaterial(uint32_t offset) override;
+		// not supported, the indices depend on the vertex order
+		virtual void sortSpatially(uint32_t chunkSize = DefaultSpatialChunkSize) override;
+		/// \brief converts the mesh to a mesh with one index type
+		/// \throw std::runtime_error if a shape has too many vertices for IndexT
+		template<class IndexT>
+		ShapeBinaryMesh<IndexT> toShapeBinaryMesh() const;
+#pragma endregion
+#pragma region Ctor
+		/// \brief shapes with more than 65535 vertices get 32 bit indices, all other shapes 16 bit indices
+		template<class IndexT>
+		explicit MixedBinaryMesh(const ShapeBinaryMesh<IndexT>& mesh);
+		MixedBinaryMesh() = default;
+		~MixedBinaryMesh() = default;
+		MixedBinaryMesh(const MixedBinaryMesh&) = default;
+		MixedBinaryMesh& operator=(const MixedBinaryMesh&) = default;
+		MixedBinaryMesh(MixedBinaryMesh&&) noexcept = default;
+		MixedBinaryMesh& operator=(MixedBinaryMesh&&) noexcept = default;
+#pragma endregion
+	private:
+#pragma region FileIO
+		virtual std::string getFileSignature() const override;
+		virtual void writeExtendedData(std::fstream& stream) const override;
+		virtual void readExtendedData(std::fstream& stream) override;
+#pragma endregion
+		virtual void verifyBoundingVolumes() const override;
+		void expectIndexSize(size_t shape, size_t indexSize) const;
+		const float* getShapeVertices(const Shape& s) const;
+
+		std::vector<uint8_t> m_indexBuffer;
+		std::vector<uint8_t> m_indexSizes;
+		std::vector<Shape> m_shapes;
+	};
+
 }
\ No newline at end of file
@@ -0,0 +1,160 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include "BoundingBox.h"
+#include "generators/glm.h"
+
+namespace bmf
+{
+	/// \brief default number of primitives per bvh leaf
+	constexpr uint32_t DefaultBvhMaxLeafSize = 4;
+
+	struct BvhNode
+	{
+		BoundingBox bbox;
+		// leaf: first primitive in the primitive list. inner node: index of the second child (the first child is the next node)
+		uint32_t offset;
+		// number of primitives. 0 for inner nodes
+		uint32_t count;
+
+		bool isLeaf() const { return count != 0; }
+	};
+
+	struct Ray
+	{
+		glm::vec3 origin;
+		glm::vec3 direction;
+		float tMin;
+		float tMax;
+	};
+
+	/// \brief triangle of a shape (the indices start at shape.indexOffset + triangle * 3)
+	struct ShapeTriangle
+	{
+		uint32_t shape;
+		uint32_t triangle;
+	};
+
+	struct RayHit
+	{
+		uint32_t shape;
+		uint32_t triangle;
+		// hit point is origin + t * direction
+		float t;
+		// barycentric coordinates of the second and third vertex
+		float u;
+		float v;
+	};
+
+	/// \brief builds a bvh over the boxes with a binned surface area heuristic.
+	/// The root is nodes[0] (if count > 0). The leaf primitive ranges refer to primitives.
+	/// \param nodes receives the nodes (cleared before)
+	/// \param primitives receives the box indices in leaf order (resized to count)
+	/// \param maxLeafSize leaves with more primitives are split if the boxes allow it
+	void buildBvh(std::vector<BvhNode>& nodes, std::vector<uint32_t>& primitives,
+		const BoundingBox* boxes, size_t count, uint32_t maxLeafSize = DefaultBvhMaxLeafSize);
+
+	/// \brief builds a bvh over the triangles of the index buffer (see buildBvh). The primitives are triangle indices
+	/// \param positions first position, the position of vertex i is at positions[i * stride]
+	template<class IndexT>
+	void buildTriangleBvh(std::vector<BvhNode>& nodes, std::vector<uint32_t>& triangles,
+		const IndexT* indices, size_t numIndices, const float* positions, size_t stride,
+		uint32_t maxLeafSize = DefaultBvhMaxLeafSize);
+
+	/// \brief throws a std::runtime_error if the nodes are not a valid bvh (see buildBvh) over numPrimitives primitives
+	void verifyBvhNodes(const BvhNode* nodes, size_t numNodes, const uint32_t* primitives, size_t numPrimitives);
+
+	/// \brief Moeller-Trumbore intersection. t must be inside [ray.tMin, ray.tMax].
+	/// Both triangle sides are hit
+	bool intersectRayTriangle(const Ray& ray, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2,
+		float& t, float& u, float& v);
+
+	/// \brief separating axis test between the box and the triangle
+	bool overlapBoxTriangle(const BoundingBox& box, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2);
+
+	/// \brief slab test. invDirection is 1 / ray.direction
+	inline bool intersectRayBox(const Ray& ray, const glm::vec3& invDirection, const BoundingBox& box)
+	{
+		float tMin = ray.tMin;
+		float tMax = ray.tMax;
+		const float mins[] = { box.minX, box.minY, box.minZ };
+		const float maxs[] = { box.maxX, box.maxY, box.maxZ };
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float t0 = (mins[axis] - ray.origin[axis]) * invDirection[axis];
+			float t1 = (maxs[axis] - ray.origin[axis]) * invDirection[axis];
+			if (t0 > t1) std::swap(t0, t1);
+			// NaN (origin on the slab plane with a zero direction) keeps the interval
+			tMin = t0 > tMin ? t0 : tMin;
+			tMax = t1 < tMax ? t1 : tMax;
+			if (tMin > tMax) return false;
+		}
+		return true;
+	}
+
+	// the traversal stack has 64 entries => the builder limits the tree depth
+	constexpr uint32_t BvhMaxDepth = 62;
+
+	/// \brief calls func(primitive) for all primitives in the leaves that overlap with the box
+	template<class Func>
+	void queryBvh(const BvhNode* nodes, const uint32_t* primitives, const BoundingBox& box, Func func)
+	{
+		uint32_t stack[64];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize)
+		{
+			const auto& node = nodes[stack[--stackSize]];
+			if (!node.bbox.overlappingWith(box)) continue;
+
+			if (node.isLeaf())
+			{
+				for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+					func(primitives[i]);
+			}
+			else
+			{
+				stack[stackSize++] = node.offset;
+				stack[stackSize++] = uint32_t(&node - nodes) + 1;
+			}
+		}
+	}
+
+	/// \brief calls func(primitive, ray) for the primitives in the leaves that are hit by the ray.
+	/// func may shorten ray.tMax to skip nodes that are farther away. The nearer child is visited first
+	template<class Func>
+	void traverseBvh(const BvhNode* nodes, const uint32_t* primitives, Ray& ray, Func func)
+	{
+		const auto invDirection = glm::vec3(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+		uint32_t stack[64];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize)
+		{
+			const auto& node = nodes[stack[--stackSize]];
+			if (!intersectRayBox(ray, invDirection, node.bbox)) continue;
+
+			if (node.isLeaf())
+			{
+				for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+					func(primitives[i], ray);
+			}
+			else
+			{
+				auto first = uint32_t(&node - nodes) + 1;
+				auto second = node.offset;
+				// the child that is closer along the ray is processed first (pushed last)
+				const auto& a = nodes[first].bbox;
+				const auto& b = nodes[second].bbox;
+				const auto centerA = glm::vec3(a.minX + a.maxX, a.minY + a.maxY, a.minZ + a.maxZ);
+				const auto centerB = glm::vec3(b.minX + b.maxX, b.minY + b.maxY, b.minZ + b.maxZ);
+				if (glm::dot(centerA - centerB, ray.direction) < 0.0f) std::swap(first, second);
+				stack[stackSize++] = first;
+				stack[stackSize++] = second;
+			}
+		}
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "BoundingBox.h"
+#include "Sphere.h"
+#include "OrientedBoundingBox.h"
+#include "generators/glm.h"
+
+namespace bmf
+{
+	/// \brief points with dot(normal, p) + distance >= 0 are inside
+	struct Plane
+	{
+		glm::vec3 normal;
+		float distance;
+
+		float getSignedDistance(const glm::vec3& p) const
+		{
+			return glm::dot(normal, p) + distance;
+		}
+	};
+
+	struct Frustum
+	{
+		// left, right, bottom, top, near, far
+		Plane planes[6];
+
+		/// \brief extracts the normalized planes from a view projection matrix (glm clip space with depth in [-1, 1])
+		static Frustum fromMatrix(const glm::mat4& viewProjection);
+
+		/// \brief conservative test: the sphere and the box are not completely outside of a plane
+		bool isVisible(const BoundingBox& box, const Sphere& sphere) const
+		{
+			for (const auto& p : planes)
+			{
+				if (p.getSignedDistance(sphere.center) < -sphere.radius) return false;
+				// box corner that is farthest along the plane normal
+				const auto corner = glm::vec3(
+					p.normal.x >= 0.0f ? box.maxX : box.minX,
+					p.normal.y >= 0.0f ? box.maxY : box.minY,
+					p.normal.z >= 0.0f ? box.maxZ : box.minZ);
+				if (p.getSignedDistance(corner) < 0.0f) return false;
+			}
+			return true;
+		}
+
+		/// \brief conservative test: the box is not completely outside of a plane
+		bool isVisible(const OrientedBoundingBox& box) const
+		{
+			for (const auto& p : planes)
+			{
+				if (p.getSignedDistance(box.center) < -box.getProjectedRadius(p.normal)) return false;
+			}
+			return true;
+		}
+	};
+
+	/// \brief frustum culling of many bounding volumes (e.g. shapes) at once.
+	/// The bounds are stored as structure of arrays and tested in batches without branches between the lanes
+	class FrustumCuller
+	{
+	public:
+		// number of bounds that are tested together
+		static constexpr uint32_t BatchSize = 8;
+
+		FrustumCuller() = default;
+		/// \brief copies the bounding box and sphere of each element (e.g. ShapeBinaryMesh::getShapes())
+		template<class T>
+		explicit FrustumCuller(const std::vector<T>& elements)
+		{
+			resize(elements.size());
+			for (size_t i = 0; i < elements.size(); ++i)
+				setBounds(i, elements[i].bbox, elements[i].sphere);
+		}
+
+		void resize(size_t count);
+		size_t size() const { return m_count; }
+		void setBounds(size_t i, const BoundingBox& box, const Sphere& sphere);
+
+		/// \brief appends the indices of all elements that pass Frustum::isVisible in ascending order
+		void cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+	private:
+		size_t m_count = 0;
+		// padded to a multiple of BatchSize
+		std::vector<float> m_centerX, m_centerY, m_centerZ, m_radius;
+		std::vector<float> m_minX, m_minY, m_minZ, m_maxX, m_maxY, m_maxZ;
+	};
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+namespace bmf
+{
+	/// \brief 64 bit hash of the raw bytes of count floats (MurmurHash3 based).
+	/// The hash depends on the position of each value, i.e. permutations of the same values produce different hashes
+	inline uint64_t hashFloats(const float* data, size_t count) noexcept
+	{
+		constexpr uint64_t c1 = 0x87c37b91114253d5ull;
+		constexpr uint64_t c2 = 0x4cf5ad432745937full;
+		const auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+
+		uint64_t h = 0x9e3779b97f4a7c15ull ^ (uint64_t(count) * c2);
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2)
+		{
+			// combine two floats to one 64 bit block
+			uint64_t k;
+			memcpy(&k, data + i, sizeof(k));
+
+			k *= c1;
+			k = rotl(k, 31);
+			k *= c2;
+			h ^= k;
+			h = rotl(h, 27) * 5 + 0x52dce729;
+		}
+		if (i < count)
+		{
+			uint32_t tail;
+			memcpy(&tail, data + i, sizeof(tail));
+			uint64_t k = tail;
+			k *= c1;
+			k = rotl(k, 31);
+			k *= c2;
+			h ^= k;
+		}
+
+		// finalization mix
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ull;
+		h ^= h >> 33;
+		return h;
+	}
+}
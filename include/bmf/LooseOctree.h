@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "BoundingBox.h"
+#include "Sphere.h"
+#include "generators/glm.h"
+
+namespace bmf
+{
+	class BinaryMesh;
+	template<class IndexT> class ShapeBinaryMesh;
+
+	/// \brief default number of subdivisions below the root node
+	constexpr uint32_t DefaultOctreeMaxDepth = 8;
+
+	/// \brief spatial index over bounding boxes that are identified by dense ids (shape or billboard indices).
+	/// Each element is stored in the deepest node whose cell contains the box center and whose cell size is at least
+	/// the box size. The node bounds are loosened by the cell size (twice the cell extent) => elements are never split.
+	/// Elements that are outside of the root cell are kept in the root node.
+	class LooseOctree
+	{
+	public:
+		LooseOctree() = default;
+		/// \brief empty octree with a root cell that is a cube around the bounds
+		explicit LooseOctree(const BoundingBox& bounds, uint32_t maxDepth = DefaultOctreeMaxDepth);
+
+		/// \brief octree over the shape bounding boxes (call generateBoundingVolumes before). ids are shape indices
+		template<class IndexT>
+		static LooseOctree fromShapes(const ShapeBinaryMesh<IndexT>& mesh, uint32_t maxDepth = DefaultOctreeMaxDepth);
+		/// \brief octree over the billboards. ids are vertex indices and the box extent is the maximum of width, height and depth
+		/// (like BinaryMesh::getBillboardBoundingBox)
+		static LooseOctree fromBillboards(const BinaryMesh& mesh, uint32_t maxDepth = DefaultOctreeMaxDepth);
+
+		/// \brief inserts or moves the element
+		void update(uint32_t id, const BoundingBox& box);
+		void remove(uint32_t id);
+		bool contains(uint32_t id) const { return id < m_elements.size() && m_elements[id].node != InvalidNode; }
+		size_t size() const { return m_size; }
+		const BoundingBox& getBoundingBox(uint32_t id) const { return m_elements[id].bbox; }
+
+		/// \brief appends the ids of all elements whose box overlaps with the box
+		void queryBox(const BoundingBox& box, std::vector<uint32_t>& result) const;
+		/// \brief appends the ids of all elements whose box overlaps with the sphere
+		void querySphere(const Sphere& sphere, std::vector<uint32_t>& result) const;
+		/// \brief the k elements that are closest to the point (distance to the box), sorted by distance and id
+		std::vector<uint32_t> queryNearest(const glm::vec3& point, uint32_t k) const;
+
+	private:
+		static constexpr uint32_t InvalidNode = uint32_t(-1);
+
+		struct Node
+		{
+			glm::vec3 center;
+			// half size of the cell. the loose bounds are center +- 2 * halfSize
+			float halfSize;
+			// 0 => no child (the root is never a child)
+			uint32_t children[8];
+			std::vector<uint32_t> elements;
+		};
+
+		struct Element
+		{
+			BoundingBox bbox;
+			uint32_t node = InvalidNode;
+			// position in the element list of the node
+			uint32_t slot = 0;
+		};
+
+		// loose bounds of the node. the root is unbounded because of the elements outside of the root cell
+		BoundingBox getLooseBounds(uint32_t node) const;
+		// calls func(node) for all nodes where visit(loose bounds) is true. the root is always visited
+		template<class Visit, class Func>
+		void traverse(Visit visit, Func func) const;
+
+		std::vector<Node> m_nodes;
+		std::vector<Element> m_elements;
+		uint32_t m_maxDepth = 0;
+		size_t m_size = 0;
+	};
+}
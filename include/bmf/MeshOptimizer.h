@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace bmf
+{
+	/// \brief number of entries of the simulated FIFO post-transform cache
+	constexpr uint32_t DefaultVertexCacheSize = 16;
+
+	struct VertexCacheStatistics
+	{
+		// number of vertex shader invocations (cache misses)
+		size_t transformedVertices = 0;
+		// number of distinct vertices referenced by the triangles
+		size_t usedVertices = 0;
+		size_t triangles = 0;
+
+		/// \brief average cache miss ratio: transformed vertices per triangle (between 0.5 and 3, lower is better)
+		float getAcmr() const noexcept { return triangles ? float(transformedVertices) / float(triangles) : 0.0f; }
+		/// \brief average transformed vertex ratio: transformed vertices per used vertex (1 is optimal)
+		float getAtvr() const noexcept { return usedVertices ? float(transformedVertices) / float(usedVertices) : 0.0f; }
+
+		VertexCacheStatistics& operator+=(const VertexCacheStatistics& o) noexcept
+		{
+			transformedVertices += o.transformedVertices;
+			usedVertices += o.usedVertices;
+			triangles += o.triangles;
+			return *this;
+		}
+	};
+
+	struct VertexCacheOptimizationResult
+	{
+		VertexCacheStatistics before;
+		VertexCacheStatistics after;
+	};
+
+	/// \brief simulates a FIFO post-transform cache for the triangle list
+	/// \param numVertices all indices must be smaller than numVertices
+	template<class IndexT>
+	VertexCacheStatistics analyzeVertexCache(
+		const IndexT* indices,
+		size_t numIndices,
+		size_t numVertices,
+		uint32_t cacheSize = DefaultVertexCacheSize);
+
+	/// \brief reorders the triangles of the triangle list for the post-transform cache (Forsyth, linear time).
+	/// The vertex order within a triangle is preserved.
+	/// \param numVertices all indices must be smaller than numVertices
+	template<class IndexT>
+	void optimizeVertexCache(
+		IndexT* indices,
+		size_t numIndices,
+		size_t numVertices);
+
+	/// \brief numbers the vertices in the order of their first use in the triangle list
+	/// \param remap will be resized to numVertices. remap[i] = j means: vertex i is now at position j.
+	/// Unused vertices get the value ~0.
+	/// \return number of used vertices
+	template<class IndexT>
+	uint32_t generateVertexFetchRemap(
+		const IndexT* indices,
+		size_t numIndices,
+		size_t numVertices,
+		std::vector<uint32_t>& remap);
+
+	/// \brief reorders the triangles to reduce overdraw (Sander et al. "Fast Triangle Reordering for Vertex Locality
+	/// and Reduced Overdraw"). The triangle list is split into clusters that are sorted by their occlusion potential
+	/// (clusters that face away from the mesh center first). The input should be optimized with optimizeVertexCache.
+	/// \param positions first position, the position of vertex i is at positions[i * stride]
+	/// \param threshold allowed ACMR degradation (1.05 allows the ACMR of each cluster to get 5% worse)
+	template<class IndexT>
+	void optimizeOverdraw(
+		IndexT* indices,
+		size_t numIndices,
+		const float* positions,
+		size_t numVertices,
+		size_t stride,
+		float threshold,
+		uint32_t cacheSize = DefaultVertexCacheSize);
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include "Sphere.h"
+#include "BoundingBox.h"
+
+namespace bmf
+{
+	/// \brief default limits for meshlets (common mesh shader output limits)
+	constexpr uint32_t DefaultMeshletMaxVertices = 64;
+	constexpr uint32_t DefaultMeshletMaxTriangles = 124;
+
+	struct Meshlet
+	{
+		// offset for the first vertex in the meshlet vertex buffer
+		uint32_t vertexOffset;
+		// number of vertices. the meshlet vertex buffer contains indices of the original vertices
+		uint32_t vertexCount;
+		// offset for the first triangle in the meshlet triangle buffer (3 meshlet local 8 bit indices per triangle)
+		uint32_t triangleOffset;
+		// number of triangles
+		uint32_t triangleCount;
+
+		BoundingBox bbox;
+		Sphere sphere;
+		// normal cone. coneCutoff is 1 if the triangle normals diverge too much for backface culling
+		glm::vec3 coneApex;
+		glm::vec3 coneAxis;
+		float coneCutoff;
+
+		/// \brief all triangles of the meshlet are backfacing for the camera position
+		bool isBackfacing(const glm::vec3& cameraPosition) const
+		{
+			const auto toApex = coneApex - cameraPosition;
+			return coneCutoff < 1.0f && glm::dot(toApex, coneAxis) >= coneCutoff * glm::length(toApex);
+		}
+	};
+
+	/// \brief splits the triangle list into meshlets and appends them to the meshlet buffers.
+	/// Triangles are added in index buffer order => optimize the vertex cache before for better meshlets.
+	/// \param meshletVertices receives the indices of the meshlet vertices (meshlet local index -> vertex index)
+	/// \param meshletTriangles receives 3 meshlet local indices per triangle
+	/// \param positions first position, the position of vertex i is at positions[i * stride]
+	/// \param maxVertices maximum vertices per meshlet (at most 255)
+	/// \param maxTriangles maximum triangles per meshlet
+	template<class IndexT>
+	void buildMeshlets(
+		std::vector<Meshlet>& meshlets,
+		std::vector<IndexT>& meshletVertices,
+		std::vector<uint8_t>& meshletTriangles,
+		const IndexT* indices,
+		size_t numIndices,
+		const float* positions,
+		size_t numVertices,
+		size_t stride,
+		uint32_t maxVertices = DefaultMeshletMaxVertices,
+		uint32_t maxTriangles = DefaultMeshletMaxTriangles);
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "BoundingBox.h"
+#include "generators/glm.h"
+
+namespace bmf
+{
+	template<class IndexT> class ShapeBinaryMesh;
+
+	/// \brief software occlusion culling: occluder triangles are rasterized into a depth buffer and
+	/// bounding boxes are tested against a hierarchical max depth buffer (see buildHierarchy).
+	/// Rows of tiles are rasterized in parallel. Each pixel keeps the minimum depth => the result does not
+	/// depend on the number of threads or the triangle order
+	class OcclusionCuller
+	{
+	public:
+		// the depth buffer is processed in rows of TileSize x TileSize tiles
+		static constexpr uint32_t TileSize = 8;
+
+		OcclusionCuller() = default;
+		OcclusionCuller(uint32_t width, uint32_t height);
+
+		uint32_t getWidth() const { return m_width; }
+		uint32_t getHeight() const { return m_height; }
+		/// \brief depth in [0, 1] (glm clip space depth [-1, 1] mapped to [0, 1]). 1 is the far plane
+		const std::vector<float>& getDepthBuffer() const { return m_levels.front(); }
+
+		/// \brief clears the depth buffer to the far plane. the view projection is used for all following operations
+		void clear(const glm::mat4& viewProjection);
+
+		/// \brief rasterizes the triangles (both sides). triangles that cross the near plane are skipped (conservative)
+		/// \param positions first position, the position of vertex i is at positions[i * stride]
+		/// \param transform object to world transformation
+		template<class IndexT>
+		void rasterize(const float* positions, size_t stride, const IndexT* indices, size_t numIndices,
+			const glm::mat4& transform = glm::mat4(1.0f));
+
+		/// \brief rasterizes the occluder shapes of the mesh with all instances of the shapes.
+		/// \param lodLevel 0 for the shape indices or a lod level (see ShapeBinaryMesh::generateLods) for simplified occluders
+		template<class IndexT>
+		void rasterizeShapes(const ShapeBinaryMesh<IndexT>& mesh, const std::vector<uint32_t>& occluders, uint32_t lodLevel = 0);
+
+		/// \brief computes the max depth mip levels of the depth buffer. required after rasterization and before the tests
+		void buildHierarchy();
+
+		/// \brief true if the box (in world space) is completely behind the occluders
+		bool isOccluded(const BoundingBox& box) const;
+
+		/// \brief appends the indices of all elements (with a bbox member) that are not occluded in ascending order.
+		/// The boxes must be in world space => use cullShapes for instanced shapes
+		template<class T>
+		void cull(const std::vector<T>& elements, std::vector<uint32_t>& visible) const
+		{
+			std::vector<BoundingBox> boxes(elements.size());
+			for (size_t i = 0; i < elements.size(); ++i)
+				boxes[i] = elements[i].bbox;
+			cull(boxes, visible);
+		}
+		void cull(const std::vector<BoundingBox>& boxes, std::vector<uint32_t>& visible) const;
+
+		/// \brief appends the indices of all shapes of the mesh that are not occluded in ascending order.
+		/// The shape boxes are tested with all instance transforms, a shape is visible if any instance is visible
+		template<class IndexT>
+		void cullShapes(const ShapeBinaryMesh<IndexT>& mesh, std::vector<uint32_t>& visible) const;
+
+	private:
+		// true if the box transformed by clipTransform (object to clip space) is completely behind the occluders
+		bool isOccluded(const BoundingBox& box, const glm::mat4& clipTransform) const;
+
+		struct ScreenVertex
+		{
+			float x;
+			float y;
+			float depth;
+		};
+
+		// appends 3 screen vertices for each triangle in front of the near plane
+		template<class IndexT>
+		void transformTriangles(const float* positions, size_t stride, const IndexT* indices, size_t numIndices,
+			const glm::mat4& transform, std::vector<ScreenVertex>& result) const;
+		void rasterizeTriangles(const std::vector<ScreenVertex>& vertices);
+		void rasterizeTriangle(const ScreenVertex* v, uint32_t minY, uint32_t maxY);
+
+		uint32_t m_width = 0;
+		uint32_t m_height = 0;
+		glm::mat4 m_viewProjection = glm::mat4(1.0f);
+		// level 0 is the depth buffer, level i has the max depth of 2^i x 2^i pixels
+		std::vector<std::vector<float>> m_levels = { {} };
+	};
+}
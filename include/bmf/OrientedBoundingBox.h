@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include "BoundingBox.h"
+#include "generators/glm.h"
+
+namespace bmf
+{
+	struct OrientedBoundingBox
+	{
+		glm::vec3 center;
+		// orthonormal right handed axes
+		glm::vec3 axes[3];
+		// half extent along each axis
+		glm::vec3 halfSize;
+
+		/// \brief point is inside the box enlarged by epsilon
+		bool isInside(const glm::vec3& point, float epsilon = 0.0f) const
+		{
+			const auto d = point - center;
+			for (int i = 0; i < 3; ++i)
+			{
+				if (std::abs(glm::dot(d, axes[i])) > halfSize[i] + epsilon) return false;
+			}
+			return true;
+		}
+
+		/// \brief half length of the projection onto the direction (distance from the center to the farthest corner)
+		float getProjectedRadius(const glm::vec3& direction) const
+		{
+			return std::abs(glm::dot(direction, axes[0])) * halfSize.x +
+				std::abs(glm::dot(direction, axes[1])) * halfSize.y +
+				std::abs(glm::dot(direction, axes[2])) * halfSize.z;
+		}
+
+		float getVolume() const
+		{
+			return 8.0f * halfSize.x * halfSize.y * halfSize.z;
+		}
+
+		/// \brief separating axis test with the 15 candidate axes
+		bool overlappingWith(const OrientedBoundingBox& o) const;
+
+		/// \brief axis aligned box that contains this box
+		BoundingBox getBoundingBox() const;
+
+		static OrientedBoundingBox fromBoundingBox(const BoundingBox& box);
+	};
+
+	/// \brief fits an oriented box to the points along their principal components.
+	/// The refinement additionally rotates the box around its axes and keeps the rotation with the smallest volume
+	/// \param positions first position, the position of point i is at positions[i * stride]
+	OrientedBoundingBox computeOrientedBoundingBox(const float* positions, size_t count, size_t stride, bool refine = true);
+}
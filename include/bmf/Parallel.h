@@ -0,0 +1,43 @@
+#pragma once
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+namespace bmf
+{
+	/// \brief returns the number of worker threads that should be used for count work items
+	/// \param grainSize minimum number of work items per thread
+	inline size_t getNumThreads(size_t count, size_t grainSize)
+	{
+		const size_t hardwareThreads = std::max(size_t(std::thread::hardware_concurrency()), size_t(1));
+		return std::max(std::min(hardwareThreads, count / std::max(grainSize, size_t(1))), size_t(1));
+	}
+
+	/// \brief splits [0, count) into contiguous ranges and calls func(begin, end, threadIndex) for each range.
+	/// The ranges only depend on count and the number of threads. The calling thread processes the first range.
+	/// \param grainSize minimum number of work items per thread
+	template<class Func>
+	void parallelFor(size_t count, size_t grainSize, Func func)
+	{
+		const auto numThreads = getNumThreads(count, grainSize);
+		if (numThreads == 1)
+		{
+			func(size_t(0), count, size_t(0));
+			return;
+		}
+
+		const auto chunkSize = (count + numThreads - 1) / numThreads;
+		std::vector<std::thread> threads;
+		threads.reserve(numThreads - 1);
+		for (size_t t = 1; t < numThreads; ++t)
+		{
+			const auto begin = std::min(t * chunkSize, count);
+			const auto end = std::min(begin + chunkSize, count);
+			threads.emplace_back(func, begin, end, t);
+		}
+		func(size_t(0), std::min(chunkSize, count), size_t(0));
+
+		for (auto& t : threads)
+			t.join();
+	}
+}
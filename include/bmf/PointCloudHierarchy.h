@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <fstream>
+#include "BoundingBox.h"
+#include "generators/glm.h"
+
+namespace bmf
+{
+	class BinaryMesh;
+
+	/// \brief default maximum number of billboards per hierarchy node
+	constexpr uint32_t DefaultPointCloudNodeSize = 16384;
+	/// \brief default alignment of the node data in the file
+	constexpr uint32_t DefaultPointCloudPageSize = 4096;
+
+	struct PointCloudNode
+	{
+		// billboard bounds of the node and all descendants
+		BoundingBox bbox;
+		// the children are [firstChild, firstChild + childCount)
+		uint32_t firstChild;
+		uint32_t childCount;
+		// 0 for the root
+		uint32_t level;
+		// number of billboards stored in this node
+		uint32_t pointCount;
+		// byte offset of the node vertices in the file (multiple of the page size)
+		uint64_t fileOffset;
+	};
+
+	/// \brief writes the billboards of the mesh into an octree where each node stores a subsample of the billboards
+	/// of its octant that were not stored by its ancestors. The union of a node and its ancestors is a lod of the node region.
+	/// The nodes are in breadth first order and the vertices of each node start at a new page.
+	/// \param maxNodePoints maximum number of billboards per node (except for nodes at the deepest level)
+	void writePointCloudHierarchy(const BinaryMesh& mesh, const std::string& filename,
+		uint32_t maxNodePoints = DefaultPointCloudNodeSize, uint32_t pageSize = DefaultPointCloudPageSize);
+
+	/// \brief streams nodes of a point cloud hierarchy (see writePointCloudHierarchy).
+	/// Only the node table is kept in memory, the vertices of a node are loaded when the node is selected
+	class PointCloudReader
+	{
+	public:
+		/// \param memoryBudget maximum size of all loaded vertices in bytes
+		PointCloudReader(const std::string& filename, size_t memoryBudget);
+
+		uint32_t getAttributes() const { return m_attributes; }
+		const std::vector<PointCloudNode>& getNodes() const { return m_nodes; }
+		size_t getMemoryBudget() const { return m_memoryBudget; }
+		void setMemoryBudget(size_t memoryBudget) { m_memoryBudget = memoryBudget; }
+		/// \brief size of the loaded vertices in bytes
+		size_t getMemoryUsage() const { return m_memoryUsage; }
+
+		/// \brief selects the nodes with the highest size to view distance ratio that fit into the memory budget,
+		/// loads them and unloads all other nodes. Children are only selected together with their parent.
+		/// \param minDetail nodes with a smaller size to view distance ratio are not selected (except for the root)
+		void update(const glm::vec3& viewPosition, float minDetail = 0.0f);
+		/// \brief selected nodes in ascending order
+		const std::vector<uint32_t>& getSelectedNodes() const { return m_selected; }
+		/// \throw std::runtime_error if the node is not loaded
+		const std::vector<float>& getNodeVertices(uint32_t node) const;
+		/// \brief billboards of all selected nodes
+		BinaryMesh toBinaryMesh() const;
+
+	private:
+		std::ifstream m_file;
+		uint32_t m_attributes = 0;
+		std::vector<PointCloudNode> m_nodes;
+		std::vector<std::vector<float>> m_nodeVertices;
+		std::vector<uint8_t> m_loaded;
+		std::vector<uint32_t> m_selected;
+		size_t m_memoryBudget = 0;
+		size_t m_memoryUsage = 0;
+	};
+}
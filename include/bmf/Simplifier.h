@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace bmf
+{
+	/// \brief reduces the number of triangles with edge collapses that are ranked by quadric error metrics.
+	/// Vertices are only moved onto other existing vertices => the result references a subset of the input vertices.
+	/// Vertices on borders can only move along the border. Vertices on attribute seams (vertices with identical
+	/// positions) move together along the seam, other vertices with multiple wedges are locked.
+	/// \param destination indices of the simplified triangle list (resized to the result)
+	/// \param positions first position, the position of vertex i is at positions[i * stride]
+	/// \param targetIndexCount simplification stops if the triangle list has at most this many indices
+	/// \param maxError maximum allowed distance of the simplified surface relative to the extent of the mesh
+	/// \return error of the simplified triangle list relative to the extent of the mesh
+	template<class IndexT>
+	float simplify(
+		std::vector<IndexT>& destination,
+		const IndexT* indices,
+		size_t numIndices,
+		const float* positions,
+		size_t numVertices,
+		size_t stride,
+		size_t targetIndexCount,
+		float maxError);
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+
+namespace bmf
+{
+	/// \brief non owning view of contiguous elements
+	template<class T>
+	class Span
+	{
+	public:
+		Span() = default;
+		Span(T* data, size_t size) : m_data(data), m_size(size) {}
+
+		T* data() const noexcept { return m_data; }
+		size_t size() const noexcept { return m_size; }
+		bool empty() const noexcept { return m_size == 0; }
+		T* begin() const noexcept { return m_data; }
+		T* end() const noexcept { return m_data + m_size; }
+		T& operator[](size_t i) const noexcept { return m_data[i]; }
+
+	private:
+		T* m_data = nullptr;
+		size_t m_size = 0;
+	};
+}
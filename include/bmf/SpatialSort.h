@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "BoundingBox.h"
+#include "generators/glm.h"
+
+namespace bmf
+{
+	/// \brief default number of billboards per chunk (see BinaryMesh::sortSpatially)
+	constexpr uint32_t DefaultSpatialChunkSize = 4096;
+
+	/// \brief 30 bit morton code of the point quantized to a 1024^3 grid over the bounds
+	uint32_t getMortonCode(const glm::vec3& point, const BoundingBox& bounds);
+
+	/// \brief morton codes of all points (see getMortonCode)
+	/// \param positions first position, the position of point i is at positions[i * stride]
+	std::vector<uint32_t> computeMortonCodes(const float* positions, size_t count, size_t stride, const BoundingBox& bounds);
+
+	/// \brief stable parallel least significant digit radix sort.
+	/// \return permutation where keys[result[i]] is the i-th smallest key
+	std::vector<uint32_t> radixSortIndices(const std::vector<uint32_t>& keys);
+}
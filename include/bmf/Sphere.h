@@ -32,6 +32,20 @@ namespace bmf
 			};
 		}
 
+		Sphere unionWith(const Sphere& o) const
+		{
+			const float dist = distance(center, o.center);
+			if (dist + o.radius <= radius) return *this; // o is inside
+			if (dist + radius <= o.radius) return o;
+
+			// the new center is on the line between both centers
+			const float newRadius = (dist + radius + o.radius) * 0.5f;
+			return Sphere{
+				center + (o.center - center) * ((newRadius - radius) / dist),
+				newRadius * 1.00001f
+			};
+		}
+
 		bool overlappingWith(const Sphere& o) const
 		{
 			float distSq = glm::dot(center - o.center, center - o.center);
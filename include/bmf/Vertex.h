@@ -3,6 +3,7 @@
 #include "Attributes.h"
 #include <cassert>
 #include "VertexCache.h"
+#include "Hash.h"
 
 namespace bmf
 {
@@ -168,25 +169,9 @@ namespace std
 	{
 		size_t operator()(const bmf::RefVertex& vertex) const noexcept
 		{
-			if(m_cachedAttribute != vertex.getAttributes())
-			{
-				m_cachedAttribute = vertex.getAttributes();
-				m_cachedCount = bmf::getAttributeElementStride(vertex.getAttributes());
-			}
-
-			size_t res = 0;
-			const float* data = vertex.Vertex::data();
-			// hash all members
-			for (auto i = data, end = data + m_cachedCount; i != end; ++i)
-				res ^= fhash(*i);
-
-			return res;
+			// hash the raw bytes of all members
+			return size_t(bmf::hashFloats(vertex.Vertex::data(), bmf::getAttributeElementStride(vertex.getAttributes())));
 		}
-
-	private:
-		mutable uint32_t m_cachedAttribute = 0;
-		mutable uint32_t m_cachedCount = 0;
-		const std::hash<float> fhash;
 	};
 
 	template<>
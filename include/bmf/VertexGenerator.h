@@ -38,4 +38,44 @@ namespace bmf
 			std::vector<ValueVertex>& outVertices, 
 			std::vector<uint32_t>& outIndices) const = 0;
 	};
+
+	class IndexedVertexGenerator : public VertexGenerator
+	{
+	public:
+
+		/// \brief will be called once for the whole vertex and index buffer
+		/// \param attributes attributes of the input vertices
+		/// \param vertices the input vertices
+		/// \param indices triangle list that references the input vertices.
+		/// The indices must be rewritten to reference outVertices.
+		/// \param outVertices the converted vertices with getOutputAttribute(attributes).
+		/// The vector is empty. Vertices that are not referenced by any triangle may be discarded.
+		virtual void generate(
+			uint32_t attributes,
+			const std::vector<float>& vertices,
+			std::vector<uint32_t>& indices,
+			std::vector<float>& outVertices) const = 0;
+
+	protected:
+		/// \brief creates a vertex => triangle corner lookup (counting sort over the index buffer).
+		/// The corners of vertex v are corners[cornerStart[v]] ... corners[cornerStart[v + 1] - 1]
+		/// in ascending order. A corner c belongs to the triangle c / 3.
+		static void getVertexCorners(
+			size_t numVertices,
+			const std::vector<uint32_t>& indices,
+			std::vector<uint32_t>& cornerStart,
+			std::vector<uint32_t>& corners)
+		{
+			cornerStart.assign(numVertices + 1, 0);
+			for (auto i : indices)
+				++cornerStart[i + 1];
+			for (size_t v = 0; v < numVertices; ++v)
+				cornerStart[v + 1] += cornerStart[v];
+
+			corners.resize(indices.size());
+			auto curCorner = cornerStart;
+			for (size_t c = 0; c < indices.size(); ++c)
+				corners[curCorner[indices[c]]++] = uint32_t(c);
+		}
+	};
 }
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace bmf
+{
+	/// \brief vertex count above which generateVertexRemap should use the parallel mode
+	constexpr size_t VertexRemapParallelThreshold = 10000000;
+
+	/// \brief finds vertices with bitwise identical keys using an open addressing hash table.
+	/// The key of vertex i are the floats [i * stride + keyOffset, i * stride + keyOffset + keyCount).
+	/// \param remap will be resized to numVertices. remap[i] = j means: vertex i is the unique vertex j.
+	/// Unique vertices are numbered in the order of their first occurrence => remap[i] <= i.
+	/// \param parallel partitions the vertices by their hash and processes the partitions in parallel.
+	/// The result is identical to the single threaded version.
+	/// \return number of unique vertices
+	uint32_t generateVertexRemap(
+		const float* vertices,
+		size_t numVertices,
+		size_t stride,
+		size_t keyOffset,
+		size_t keyCount,
+		std::vector<uint32_t>& remap,
+		bool parallel = false);
+
+	/// \brief finds vertices that are equal within a tolerance using a uniform hash grid over the position.
+	/// Two vertices match if their positions (first three floats of each vertex) have a distance <= positionEpsilon
+	/// and all other floats e differ by at most elementEpsilons[e]. A negative epsilon requires bitwise equality.
+	/// Each vertex is merged into the first matching vertex that was not merged itself.
+	/// \param elementEpsilons tolerance for each float of a vertex (stride values, position values are ignored)
+	/// \param remap see generateVertexRemap
+	/// \return number of unique vertices
+	uint32_t generateWeldRemap(
+		const float* vertices,
+		size_t numVertices,
+		size_t stride,
+		float positionEpsilon,
+		const float* elementEpsilons,
+		std::vector<uint32_t>& remap);
+}
@@ -1,17 +1,14 @@
 #pragma once
-#include "../VertexGenerator.h"
+#include "NormalGenerator.h"
 
 namespace bmf
 {
-	class InterpolatedNormalGenerator : public MultiVertexGenerator
+	/// \brief generates the average of all adjacent face normals for each vertex
+	class InterpolatedNormalGenerator : public NormalGenerator
 	{
 	public:
-		uint32_t getRequiredAttributes() const override;
-		uint32_t getOutputAttribute(uint32_t inAttr) const override;
-		void generate(
-			const std::vector<Triangle>& triangles, 
-			std::vector<ValueVertex>& outVertices,
-			std::vector<uint32_t>& outIndices) const override;
+		InterpolatedNormalGenerator();
+
 		static void getInterpolatedNormal(const std::vector<Triangle>& triangles, float* dstNormal);
 	};
 }
@@ -0,0 +1,54 @@
+#pragma once
+#include "../VertexGenerator.h"
+
+namespace bmf
+{
+	/// \brief generates normals for the whole mesh at once.
+	/// All face normals are computed once, accumulated into the vertices and
+	/// vertices are split along edges where the face normals differ by more than the crease angle
+	class NormalGenerator : public IndexedVertexGenerator
+	{
+	public:
+		enum class Weighting
+		{
+			Uniform, // each face contributes equally
+			Area,    // faces are weighted by their area
+			Angle    // faces are weighted by the angle of the corner that touches the vertex
+		};
+
+		/// \brief face normals in structure of arrays layout (one entry per triangle)
+		struct FaceNormals
+		{
+			std::vector<float> x;
+			std::vector<float> y;
+			std::vector<float> z;
+			// triangle area (0 for degenerated triangles)
+			std::vector<float> area;
+		};
+
+		/// \param weighting weighting of the face normals when accumulating them into a vertex
+		/// \param creaseAngle maximum angle (radians) between two face normals that share one vertex
+		explicit NormalGenerator(Weighting weighting = Weighting::Angle, float creaseAngle = 3.14159265f);
+
+		uint32_t getRequiredAttributes() const override;
+		uint32_t getOutputAttribute(uint32_t inAttr) const override;
+		void generate(
+			uint32_t attributes,
+			const std::vector<float>& vertices,
+			std::vector<uint32_t>& indices,
+			std::vector<float>& outVertices) const override;
+
+		/// \brief computes the normalized face normal and the area of each triangle.
+		/// degenerated triangles get a zero normal
+		static FaceNormals getFaceNormals(
+			uint32_t attributes,
+			const std::vector<float>& vertices,
+			const std::vector<uint32_t>& indices);
+	private:
+		// allowed numerical error for the crease angle test
+		static constexpr float CreaseEpsilon = 0.000001f;
+
+		Weighting m_weighting;
+		float m_minCosAngle;
+	};
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "../VertexGenerator.h"
+
+namespace bmf
+{
+	/// \brief generates tangent frames compatible with MikkTSpace.
+	/// Face tangents are derived from the Texcoord0 mapping, projected into the tangent plane
+	/// of the vertex normal and accumulated with the corner angle as weight.
+	/// Vertices that are shared by triangles with a mirrored texture mapping are split.
+	/// The bitangent is sign * cross(normal, tangent).
+	class TangentGenerator final : public IndexedVertexGenerator
+	{
+		// minimum number of triangles/vertices per thread
+		static constexpr size_t GrainSize = 4096;
+	public:
+		uint32_t getRequiredAttributes() const override;
+		uint32_t getOutputAttribute(uint32_t inAttr) const override;
+		void generate(
+			uint32_t attributes,
+			const std::vector<float>& vertices,
+			std::vector<uint32_t>& indices,
+			std::vector<float>& outVertices) const override;
+	};
+}
@@ -1,20 +1,12 @@
 #include "../include/bmf/BinaryMesh.h"
-//#include "../dependencies/eigen/Eigen/Dense"
+#include "../include/bmf/Parallel.h"
+#include <exception>
+#include "../dependencies/eigen/Eigen/Dense"
 
 namespace bmf
 {
 #pragma region Getter
 
-	/*std::vector<BinaryMesh::InstanceData>& BinaryMesh::getInstanceTransforms()
-	{
-		return m_instances;
-	}
-
-	const std::vector<BinaryMesh::InstanceData>& BinaryMesh::getInstanceTransforms() const
-	{
-		return m_instances;
-	}*/
-
 	template <class IndexT>
 	std::vector<uint32_t> ShapeBinaryMesh<IndexT>::getSummedIndices() const
 	{
@@ -50,8 +42,25 @@ namespace bmf
 		return res;
 	}
 
+	template <class IndexT>
+	VertexCacheStatistics ShapeBinaryMesh<IndexT>::analyzeVertexCache(uint32_t cacheSize) const
+	{
+		VertexCacheStatistics res;
+		for (const auto& s : m_shapes)
+		{
+			res += bmf::analyzeVertexCache(m_indices.data() + s.indexOffset, s.indexCount, s.vertexCount, cacheSize);
+		}
+		return res;
+	}
+
 	template <class IndexT>
 	void ShapeBinaryMesh<IndexT>::verify() const
+	{
+		verify(false);
+	}
+
+	template <class IndexT>
+	void ShapeBinaryMesh<IndexT>::verify(bool trustCleanShapes) const
 	{
 		BinaryMesh::verify();
 		if (m_indices.size() % 3 != 0)
@@ -62,7 +71,6 @@ namespace bmf
 		const auto numIndices = m_indices.size();
 		const auto numVertices = m_vertices.size() / stride;
 		size_t curVertexOffset = 0;
-		size_t curInstanceOffset = 0;
 		size_t curShape = 0;
 		BoundingBox globalBbox = -BoundingBox::max();
 		try
@@ -71,8 +79,6 @@ namespace bmf
 			{
 				if (s.vertexOffset != curVertexOffset)
 					throw std::runtime_error("shape vertex offset is not tightly packed");
-				//if (s.instanceOffset != curInstanceOffset)
-				//	throw std::runtime_error("shape instance offset is not tightly packed");
 				if (s.indexOffset % 3 != 0)
 					throw std::runtime_error("shape index offset is not a multiple of 3");
 				if (s.indexOffset >= numIndices)
@@ -83,8 +89,6 @@ namespace bmf
 					throw std::runtime_error("shape index count out of range");
 				if (s.indexCount == 0)
 					throw std::runtime_error("shape zero index count");
-				//if (s.instanceCount == 0)
-				//	throw std::runtime_error("shape zero instances count");
 				if (s.vertexCount == 0)
 					throw std::runtime_error("shape zero vertex count");
 				if (s.vertexCount > std::numeric_limits<IndexT>::max())
@@ -106,18 +110,15 @@ namespace bmf
 				// check bounding boxes
 				if (m_attributes & Position)
 				{
-					if (s.bbox != calcBoundingBox(s))
+					if (isShapeDirty(curShape))
+						throw std::runtime_error("shape bounding volumes are outdated (see updateBoundingVolumes)");
+					if (!trustCleanShapes && s.bbox != calcBoundingBox(s))
 						throw std::runtime_error("shape bounding box not correct");
 					globalBbox = globalBbox.unionWith(s.bbox);
-					if (s.sphere != calcBoundingSphere(s))
+					if (!trustCleanShapes && s.sphere != calcBoundingSphere(s))
 						throw std::runtime_error("shape bounding sphere not correct");
 				}
 
-				// check instances for this shape
-				//curInstanceOffset += s.instanceCount;
-				//if (curInstanceOffset > m_instances.size())
-				//	throw std::runtime_error("shape instance count out of range");
-
 				++curShape;
 			}
 		}
@@ -139,12 +140,185 @@ namespace bmf
 			if (m_bbox != globalBbox)
 				throw std::runtime_error("global bounding box not correct");
 			
-			if (m_sphere != getBoundingSphere(m_vertices, m_attributes))
+			// merged meshes derive the sphere from the merged spheres => it only has to contain all vertices
+			if (!trustCleanShapes && !allPointsInSphere(m_vertices, m_attributes, m_sphere))
 				throw std::runtime_error("global bounding sphere not correct");
 		}
+
+		verifyShadowIndices();
+		verifyLods();
+		verifyMeshlets();
+		verifyInstances();
+		verifyBvh();
+		verifyOrientedBoundingBoxes(trustCleanShapes);
+	}
+
+	template <class IndexT>
+	void ShapeBinaryMesh<IndexT>::verifyShadowIndices() const
+	{
+		if (m_shadowIndices.empty()) return;
+
+		if (m_shadowIndices.size() != m_indices.size())
+			throw std::runtime_error("shadow index count does not match index count");
+
+		if (!(m_attributes & Position)) return;
+		const auto stride = getAttributeElementStride(m_attributes);
+		const auto positionOffset = getAttributeElementOffset(m_attributes, Position);
+		for (const auto& s : m_shapes)
+		{
+			const float* vertices = m_vertices.data() + size_t(s.vertexOffset) * stride + positionOffset;
+			for (size_t i = s.indexOffset, end = s.indexOffset + s.indexCount; i != end; ++i)
+			{
+				if (m_shadowIndices[i] >= s.vertexCount)
+					throw std::runtime_error("shadow index out of range");
+				if (!std::equal(vertices + m_shadowIndices[i] * stride, vertices + m_shadowIndices[i] * stride + 3,
+					vertices + m_indices[i] * stride))
+					throw std::runtime_error("shadow index position does not match index position");
+			}
+		}
+	}
+
+	template <class IndexT>
+	void ShapeBinaryMesh<IndexT>::verifyLods() const
+	{
+		if (m_lods.empty()) return;
+
+		if (m_lods.size() % m_shapes.size() != 0)
+			throw std::runtime_error("lod count is not a multiple of the shape count");
+
+		for (size_t i = 0; i < m_lods.size(); ++i)
+		{
+			const auto& lod = m_lods[i];
+			const auto& s = m_shapes[i % m_shapes.size()];
+			if (lod.indexOffset % 3 != 0 || lod.indexCount % 3 != 0)
+				throw std::runtime_error("lod index range is not a multiple of 3");
+			if (lod.indexCount == 0)
+				throw std::runtime_error("lod zero index count");
+			if (size_t(lod.indexOffset) + lod.indexCount > m_lodIndices.size())
+				throw std::runtime_error("lod index range out of range");
+
+			for (size_t j = lod.indexOffset, end = lod.indexOffset + lod.indexCount; j != end; ++j)
+			{
+				if (m_lodIndices[j] >= s.vertexCount)
+					throw std::runtime_error("lod index out of range for lod " + std::to_string(i));
+			}
+		}
+	}
+
+	template <class IndexT>
+	void ShapeBinaryMesh<IndexT>::verifyMeshlets() const
+	{
+		if (m_meshlets.empty() && m_meshletOffsets.empty()) return;
+
+		if (m_meshletOffsets.size() != m_shapes.size() + 1 || m_meshletOffsets.back() != m_meshlets.size())
+			throw std::runtime_error("meshlet offsets do not match shapes");
+
+		for (size_t shape = 0; shape < m_shapes.size(); ++shape)
+		{
+			const auto& s = m_shapes[shape];
+			if (m_meshletOffsets[shape] > m_meshletOffsets[shape + 1])
+				throw std::runtime_error("meshlet offsets are not ascending for shape " + std::to_string(shape));
+
+			size_t numTriangles = 0;
+			for (auto i = m_meshletOffsets[shape]; i != m_meshletOffsets[shape + 1]; ++i)
+			{
+				const auto& m = m_meshlets[i];
+				if (m.vertexCount == 0 || m.triangleCount == 0)
+					throw std::runtime_error("empty meshlet " + std::to_string(i));
+				if (size_t(m.vertexOffset) + m.vertexCount > m_meshletVertices.size())
+					throw std::runtime_error("meshlet vertex range out of range for meshlet " + std::to_string(i));
+				if ((size_t(m.triangleOffset) + m.triangleCount) * 3 > m_meshletTriangles.size())
+					throw std::runtime_error("meshlet triangle range out of range for meshlet " + std::to_string(i));
+
+				for (auto v = m.vertexOffset; v != m.vertexOffset + m.vertexCount; ++v)
+				{
+					if (m_meshletVertices[v] >= s.vertexCount)
+						throw std::runtime_error("meshlet vertex out of range for meshlet " + std::to_string(i));
+				}
+				for (auto t = size_t(m.triangleOffset) * 3, end = size_t(m.triangleOffset + m.triangleCount) * 3; t != end; ++t)
+				{
+					if (m_meshletTriangles[t] >= m.vertexCount)
+						throw std::runtime_error("meshlet triangle index out of range for meshlet " + std::to_string(i));
+				}
+				numTriangles += m.triangleCount;
+			}
+
+			if (numTriangles * 3 != s.indexCount)
+				throw std::runtime_error("meshlet triangle count does not match for shape " + std::to_string(shape));
+		}
+	}
+
+	template <class IndexT>
+	void ShapeBinaryMesh<IndexT>::verifyInstances() const
+	{
+		if (m_instances.empty() && m_instanceOffsets.empty()) return;
+
+		if (m_instanceOffsets.size() != m_shapes.size() + 1 || m_instanceOffsets.front() != 0 ||
+			m_instanceOffsets.back() != m_instances.size())
+			throw std::runtime_error("instance offsets do not match shapes");
+
+		for (size_t shape = 0; shape < m_shapes.size(); ++shape)
+		{
+			if (m_instanceOffsets[shape] >= m_instanceOffsets[shape + 1])
+				throw std::runtime_error("shape zero instances count for shape " + std::to_string(shape));
+		}
 	}
 
-	
+	template <class IndexT>
+	void ShapeBinaryMesh<IndexT>::verifyBvh() const
+	{
+		if (m_bvhOffsets.empty() && m_bvhNodes.empty() && m_bvhTriangles.empty() &&
+			m_topLevelBvhNodes.empty() && m_topLevelBvhShapes.empty()) return;
+
+		if (m_bvhOffsets.size() != m_shapes.size() + 1 || m_bvhOffsets.front() != 0 ||
+			m_bvhOffsets.back() != m_bvhNodes.size())
+			throw std::runtime_error("bvh offsets do not match shapes");
+		if (m_bvhTriangles.size() != m_indices.size() / 3)
+			throw std::runtime_error("bvh triangle count does not match index count");
+
+		for (size_t shape = 0; shape < m_shapes.size(); ++shape)
+		{
+			const auto& s = m_shapes[shape];
+			if (m_bvhOffsets[shape] > m_bvhOffsets[shape + 1])
+				throw std::runtime_error("bvh offsets are not ascending for shape " + std::to_string(shape));
+			if (s.indexOffset % 3 != 0)
+				throw std::runtime_error("bvh shape index offset is not a multiple of 3 for shape " + std::to_string(shape));
+			verifyBvhNodes(m_bvhNodes.data() + m_bvhOffsets[shape], m_bvhOffsets[shape + 1] - m_bvhOffsets[shape],
+				m_bvhTriangles.data() + s.indexOffset / 3, s.indexCount / 3);
+		}
+
+		if (m_topLevelBvhNodes.empty())
+			throw std::runtime_error("top level bvh is missing");
+		if (m_topLevelBvhShapes.size() != m_shapes.size())
+			throw std::runtime_error("top level bvh shape count does not match");
+		verifyBvhNodes(m_topLevelBvhNodes.data(), m_topLevelBvhNodes.size(), m_topLevelBvhShapes.data(), m_shapes.size());
+	}
+
+	template <class IndexT>
+	void ShapeBinaryMesh<IndexT>::verifyOrientedBoundingBoxes(bool trustCleanShapes) const
+	{
+		if (m_orientedBoxes.empty()) return;
+
+		if (m_orientedBoxes.size() != m_shapes.size())
+			throw std::runtime_error("oriented bounding box count does not match shape count");
+		if (!(m_attributes & Position) || trustCleanShapes) return;
+
+		const auto stride = getAttributeElementStride(m_attributes);
+		const auto positionOffset = getAttributeElementOffset(m_attributes, Position);
+		for (size_t shape = 0; shape < m_shapes.size(); ++shape)
+		{
+			const auto& s = m_shapes[shape];
+			const auto& box = m_orientedBoxes[shape];
+			// tolerance for the rounding of the projections
+			const float epsilon = 1e-5f * std::max(1.0f, glm::length(box.center) + box.halfSize.x + box.halfSize.y + box.halfSize.z);
+			const float* vertices = m_vertices.data() + size_t(s.vertexOffset) * stride + positionOffset;
+			for (uint32_t v = 0; v < s.vertexCount; ++v)
+			{
+				if (!box.isInside(toVec3(vertices + size_t(v) * stride), epsilon))
+					throw std::runtime_error("oriented bounding box does not contain all vertices of shape " + std::to_string(shape));
+			}
+		}
+	}
 
 	template <class IndexT>
 	void ShapeBinaryMesh<IndexT>::verifyBoundingVolumes() const
@@ -202,8 +376,37 @@ namespace bmf
 
 		if (m_bbox != getBillboardBoundingBox(m_vertices, m_attributes))
 			throw std::runtime_error("bbox does not match computed billboard bounding box");
-		if (m_sphere != getBillboardBoundingSphere(m_vertices, m_attributes))
-			throw std::runtime_error("bounding sphere does not match computed bounding sphere");
+
+		// merged meshes derive the sphere from the merged spheres => it only has to contain all billboards
+		const auto stride = getAttributeElementStride(m_attributes);
+		const auto extentOffsets = {
+			(m_attributes & Width) ? int(getAttributeElementOffset(m_attributes, Width)) : -1,
+			(m_attributes & Height) ? int(getAttributeElementOffset(m_attributes, Height)) : -1,
+			(m_attributes & Depth) ? int(getAttributeElementOffset(m_attributes, Depth)) : -1,
+		};
+		for (auto i = m_vertices.data(), end = m_vertices.data() + m_vertices.size(); i != end; i += stride)
+		{
+			float extent = 0.0f;
+			for (auto offset : extentOffsets)
+			{
+				if (offset >= 0) extent = std::max(extent, i[offset]);
+			}
+			const auto radius = m_sphere.radius - extent;
+			if (radius < 0.0f || !Sphere{ m_sphere.center, radius }.isInside(toVec3(i)))
+				throw std::runtime_error("bounding sphere does not contain all billboards");
+		}
+
+		if (m_chunkBounds.empty()) return;
+		const size_t numVertices = m_vertices.size() / stride;
+		if (m_chunkSize == 0 || m_chunkBounds.size() != (numVertices + m_chunkSize - 1) / m_chunkSize)
+			throw std::runtime_error("number of chunk bounds does not match the number of vertices");
+		for (size_t c = 0; c < m_chunkBounds.size(); ++c)
+		{
+			const auto start = m_vertices.data() + c * m_chunkSize * stride;
+			const auto end = m_vertices.data() + std::min((c + 1) * m_chunkSize, numVertices) * stride;
+			if (m_chunkBounds[c] != getBillboardBoundingBox(start, end, m_attributes))
+				throw std::runtime_error("chunk bounds " + std::to_string(c) + " do not match computed billboard bounding box");
+		}
 	}
 #pragma endregion
 #pragma region FileIO
@@ -235,6 +438,11 @@ namespace bmf
 		// read vertex data
 		m_vertices = read<float>(f, ui32);
 
+		// read chunk bounds
+		m_chunkSize = read<uint32_t>(f);
+		ui32 = read<uint32_t>(f); // num chunks
+		m_chunkBounds = read<BoundingBox>(f, ui32);
+
 		readExtendedData(f);
 
 		// check file end signature
@@ -265,6 +473,11 @@ namespace bmf
 		write(f, uint32_t(m_vertices.size()));
 		write(f, m_vertices);
 
+		// write chunk bounds
+		write(f, m_chunkSize);
+		write(f, uint32_t(m_chunkBounds.size()));
+		write(f, m_chunkBounds);
+
 		writeExtendedData(f);
 
 		// write end of file signature
@@ -273,36 +486,67 @@ namespace bmf
 		f.close();
 	}
 
+	template<class MeshT>
+	Sphere BinaryMesh::getMergedBoundingSphere(const std::vector<MeshT>& meshes, const BoundingBox& bbox)
+	{
+		auto s = meshes.front().m_sphere;
+		for (auto i = meshes.begin() + 1; i != meshes.end(); ++i)
+			s = s.unionWith(i->m_sphere);
+
+		return getSmallerBoundingSphere(s, bbox);
+	}
+
+	Sphere BinaryMesh::getSmallerBoundingSphere(const Sphere& sphere, const BoundingBox& bbox)
+	{
+		const auto minPos = glm::vec3(bbox.minX, bbox.minY, bbox.minZ);
+		const auto maxPos = glm::vec3(bbox.maxX, bbox.maxY, bbox.maxZ);
+		const auto boxSphere = Sphere{ (minPos + maxPos) * 0.5f, glm::distance(minPos, maxPos) * 0.50001f };
+		return boxSphere.radius < sphere.radius ? boxSphere : sphere;
+	}
+
 	BinaryMesh BinaryMesh::merge(const std::vector<BinaryMesh>& meshes)
+	{
+		return merge(meshes, nullptr);
+	}
+
+	BinaryMesh BinaryMesh::merge(std::vector<BinaryMesh>&& meshes)
+	{
+		return merge(meshes, meshes.empty() ? nullptr : &meshes.front());
+	}
+
+	BinaryMesh BinaryMesh::merge(const std::vector<BinaryMesh>& meshes, BinaryMesh* moveFirst)
 	{
 		if (meshes.empty()) return BinaryMesh();
 
 		BinaryMesh m;
 		m.m_attributes = meshes.front().m_attributes;
 		m.m_bbox = -BoundingBox::max();
-		size_t m_totalVertices = 0;
 
-		// acquire total vertex count
-		for (const auto& src : meshes)
+		// acquire vertex offsets
+		std::vector<size_t> vertexOffsets(meshes.size() + 1, 0);
+		for (size_t i = 0; i < meshes.size(); ++i)
 		{
+			const auto& src = meshes[i];
 			if (src.m_attributes != m.m_attributes)
 				throw std::runtime_error("BinaryMesh::merge attributes of all meshes must be the same");
 
-			m_totalVertices += src.m_vertices.size();
+			vertexOffsets[i + 1] = vertexOffsets[i] + src.m_vertices.size();
+			m.m_bbox = m.m_bbox.unionWith(src.m_bbox);
 		}
+		m.m_sphere = getMergedBoundingSphere(meshes, m.m_bbox);
 
 		// resize buffers
-		m.m_vertices.resize(m_totalVertices);
-
-		auto curVertex = m.m_vertices.begin();
+		if (moveFirst) m.m_vertices = std::move(moveFirst->m_vertices);
+		m.m_vertices.resize(vertexOffsets.back());
 
 		// copy data
-		for (const auto& src : meshes)
+		const auto stride = std::max(getAttributeElementStride(m.m_attributes), uint32_t(1));
+		const auto grainSize = vertexOffsets.back() / stride >= ShapeParallelThreshold ? size_t(1) : meshes.size();
+		parallelFor(meshes.size(), grainSize, [&](size_t begin, size_t end, size_t)
 		{
-			curVertex = std::copy(src.m_vertices.begin(), src.m_vertices.end(), curVertex);
-			m.m_bbox = m.m_bbox.unionWith(src.m_bbox);
-		}
-		m.m_sphere = getBoundingSphere(m.m_vertices, m.m_attributes);
+			for (size_t i = std::max(begin, size_t(moveFirst ? 1 : 0)); i < end; ++i)
+				std::copy(meshes[i].m_vertices.begin(), meshes[i].m_vertices.end(), m.m_vertices.begin() + vertexOffsets[i]);
+		});
 
 		return m;
 	}
@@ -365,29 +609,164 @@ namespace bmf
 		write(f, uint32_t(m_shapes.size()));
 		write(f, m_shapes);
 
-		//write(f, uint32_t(m_instances.size()));
-		//write(f, m_instances);
+		// write shadow indices (optional)
+		write(f, uint32_t(m_shadowIndices.size()));
+		write(f, m_shadowIndices);
+
+		// write lods (optional)
+		write(f, uint32_t(m_lods.size()));
+		write(f, m_lods);
+		write(f, uint32_t(m_lodIndices.size()));
+		write(f, m_lodIndices);
+
+		// write meshlets (optional)
+		write(f, uint32_t(m_meshlets.size()));
+		write(f, m_meshlets);
+		write(f, uint32_t(m_meshletOffsets.size()));
+		write(f, m_meshletOffsets);
+		write(f, uint32_t(m_meshletVertices.size()));
+		write(f, m_meshletVertices);
+		write(f, uint32_t(m_meshletTriangles.size()));
+		write(f, m_meshletTriangles);
+
+		// write instances (optional)
+		write(f, uint32_t(m_instanceOffsets.size()));
+		write(f, m_instanceOffsets);
+		write(f, uint32_t(m_instances.size()));
+		write(f, m_instances);
+
+		// write bvh (optional)
+		write(f, uint32_t(m_bvhOffsets.size()));
+		write(f, m_bvhOffsets);
+		write(f, uint32_t(m_bvhNodes.size()));
+		write(f, m_bvhNodes);
+		write(f, uint32_t(m_bvhTriangles.size()));
+		write(f, m_bvhTriangles);
+		write(f, uint32_t(m_topLevelBvhNodes.size()));
+		write(f, m_topLevelBvhNodes);
+		write(f, uint32_t(m_topLevelBvhShapes.size()));
+		write(f, m_topLevelBvhShapes);
+
+		// write oriented bounding boxes (optional)
+		write(f, uint32_t(m_orientedBoxes.size()));
+		write(f, m_orientedBoxes);
 	}
 
 	template <class IndexT>
 	void ShapeBinaryMesh<IndexT>::readExtendedData(std::fstream& f)
 	{
+		m_dirtyShapes.clear();
+
 		// read indices
 		if (read<uint8_t>(f) != sizeof(IndexT))
 			throw std::runtime_error("index size mismatch. expected " + std::to_string(sizeof(IndexT)));
 
 		uint32_t ui32 = read<uint32_t>(f); // num indices
-		// read index data
-		m_indices = read<IndexT>(f, ui32);
+		// read index data (not required for other lod levels)
+		if (m_loadLodLevel == 0) m_indices = read<IndexT>(f, ui32);
+		else f.seekg(size_t(ui32) * sizeof(IndexT), std::ios::cur);
 
 		// read shapes
 		ui32 = read<uint32_t>(f); // num shapes
 		// read shape data
 		m_shapes = read<Shape>(f, ui32);
 
+		// read shadow indices (only valid for lod level 0)
+		ui32 = read<uint32_t>(f); // num shadow indices
+		if (m_loadLodLevel == 0)
+		{
+			m_shadowIndices = read<IndexT>(f, ui32);
+		}
+		else
+		{
+			m_shadowIndices.clear();
+			f.seekg(size_t(ui32) * sizeof(IndexT), std::ios::cur);
+		}
+
+		// read lods
+		ui32 = read<uint32_t>(f); // num lods
+		m_lods = read<ShapeLod>(f, ui32);
+		ui32 = read<uint32_t>(f); // num lod indices
+		if (m_loadLodLevel == 0)
+		{
+			m_lodIndices = read<IndexT>(f, ui32);
+		}
+		else
+		{
+			if (m_loadLodLevel > getNumLodLevels())
+				throw std::runtime_error("lod level " + std::to_string(m_loadLodLevel) + " not available");
+
+			// the indices of one level are stored consecutively
+			const auto levelLods = m_lods.begin() + (m_loadLodLevel - 1) * m_shapes.size();
+			const auto levelEnd = std::prev(levelLods + m_shapes.size());
+			const auto levelOffset = levelLods->indexOffset;
+			const auto levelCount = levelEnd->indexOffset + levelEnd->indexCount - levelOffset;
+			const auto lodIndicesStart = f.tellg();
+
+			f.seekg(size_t(levelOffset) * sizeof(IndexT), std::ios::cur);
+			m_indices = read<IndexT>(f, levelCount);
+			f.seekg(lodIndicesStart + std::streamoff(size_t(ui32) * sizeof(IndexT)));
+
+			for (size_t i = 0; i < m_shapes.size(); ++i)
+			{
+				m_shapes[i].indexOffset = levelLods[i].indexOffset - levelOffset;
+				m_shapes[i].indexCount = levelLods[i].indexCount;
+			}
+			m_lods.clear();
+			m_lodIndices.clear();
+		}
+
+		// read meshlets (they are discarded for other lod levels)
+		ui32 = read<uint32_t>(f); // num meshlets
+		m_meshlets = read<Meshlet>(f, ui32);
+		ui32 = read<uint32_t>(f); // num meshlet offsets
+		m_meshletOffsets = read<uint32_t>(f, ui32);
+		ui32 = read<uint32_t>(f); // num meshlet vertices
+		m_meshletVertices = read<IndexT>(f, ui32);
+		ui32 = read<uint32_t>(f); // num meshlet triangle indices
+		m_meshletTriangles = read<uint8_t>(f, ui32);
+
 		// read instances
-		//ui32 = read<uint32_t>(f);
-		//m.m_instances = read<InstanceData>(f, ui32);
+		ui32 = read<uint32_t>(f); // num instance offsets
+		m_instanceOffsets = read<uint32_t>(f, ui32);
+		ui32 = read<uint32_t>(f); // num instances
+		m_instances = read<InstanceData>(f, ui32);
+
+		// read bvh (discarded for other lod levels)
+		ui32 = read<uint32_t>(f); // num bvh offsets
+		m_bvhOffsets = read<uint32_t>(f, ui32);
+		ui32 = read<uint32_t>(f); // num bvh nodes
+		m_bvhNodes = read<BvhNode>(f, ui32);
+		ui32 = read<uint32_t>(f); // num bvh triangles
+		m_bvhTriangles = read<uint32_t>(f, ui32);
+		ui32 = read<uint32_t>(f); // num top level bvh nodes
+		m_topLevelBvhNodes = read<BvhNode>(f, ui32);
+		ui32 = read<uint32_t>(f); // num top level bvh shapes
+		m_topLevelBvhShapes = read<uint32_t>(f, ui32);
+
+		// read oriented bounding boxes (discarded for other lod levels)
+		ui32 = read<uint32_t>(f); // num oriented boxes
+		m_orientedBoxes = read<OrientedBoundingBox>(f, ui32);
+	}
+
+	template <class IndexT>
+	void ShapeBinaryMesh<IndexT>::loadFromFile(const std::string& filename, uint32_t lodLevel)
+	{
+		m_loadLodLevel = lodLevel;
+		try
+		{
+			BinaryMesh::loadFromFile(filename);
+		}
+		catch (...)
+		{
+			m_loadLodLevel = 0;
+			throw;
+		}
+		m_loadLodLevel = 0;
+		if (lodLevel == 0) return;
+
+		removeUnusedVertices();
+		generateBoundingVolumes();
 	}
 #pragma endregion
 #pragma region Grouping
@@ -411,7 +790,6 @@ namespace bmf
 			dst.m_shapes[0].vertexOffset = 0;
 			dst.m_bbox = src.bbox;
 			dst.m_sphere = src.sphere;
-			//dst.m_shapes[0].instanceOffset = 0;
 
 			// copy indices and determine number of vertices to copy
 			dst.m_indices.resize(src.indexCount);
@@ -421,6 +799,40 @@ namespace bmf
 				dst.m_indices.begin()
 			);
 
+			// copy shadow indices
+			if (!m_shadowIndices.empty())
+				dst.m_shadowIndices.assign(
+					m_shadowIndices.begin() + src.indexOffset,
+					m_shadowIndices.begin() + src.indexOffset + src.indexCount
+				);
+
+			// copy lods of all levels
+			for (uint32_t level = 1; level <= getNumLodLevels(); ++level)
+			{
+				auto lod = getLod(level, i);
+				const auto lodIndices = m_lodIndices.begin() + lod.indexOffset;
+				lod.indexOffset = uint32_t(dst.m_lodIndices.size());
+				dst.m_lodIndices.insert(dst.m_lodIndices.end(), lodIndices, lodIndices + lod.indexCount);
+				dst.m_lods.push_back(lod);
+			}
+
+			// copy meshlets
+			if (!m_meshletOffsets.empty())
+			{
+				for (auto j = m_meshletOffsets[i]; j != m_meshletOffsets[i + 1]; ++j)
+				{
+					auto m = m_meshlets[j];
+					const auto vertices = m_meshletVertices.begin() + m.vertexOffset;
+					const auto triangles = m_meshletTriangles.begin() + size_t(m.triangleOffset) * 3;
+					m.vertexOffset = uint32_t(dst.m_meshletVertices.size());
+					m.triangleOffset = uint32_t(dst.m_meshletTriangles.size() / 3);
+					dst.m_meshletVertices.insert(dst.m_meshletVertices.end(), vertices, vertices + m.vertexCount);
+					dst.m_meshletTriangles.insert(dst.m_meshletTriangles.end(), triangles, triangles + size_t(m.triangleCount) * 3);
+					dst.m_meshlets.push_back(m);
+				}
+				dst.m_meshletOffsets = { 0, uint32_t(dst.m_meshlets.size()) };
+			}
+
 			// copy vertices
 			dst.m_vertices.resize(src.vertexCount * attributeCount);
 			std::copy(
@@ -429,12 +841,39 @@ namespace bmf
 				dst.m_vertices.begin());
 
 			// copy instances
-			/*dst.m_instances.resize(src.instanceCount);
-			std::copy(
-				m_instances.begin() + src.instanceOffset,
-				m_instances.begin() + src.instanceOffset + src.instanceCount,
-				dst.m_instances.begin()
-			);*/
+			if (!m_instanceOffsets.empty())
+			{
+				dst.m_instances.assign(
+					m_instances.begin() + m_instanceOffsets[i],
+					m_instances.begin() + m_instanceOffsets[i + 1]
+				);
+				dst.m_instanceOffsets = { 0, uint32_t(dst.m_instances.size()) };
+			}
+
+			// copy bvh (the triangles are shape local)
+			if (!m_bvhOffsets.empty())
+			{
+				dst.m_bvhNodes.assign(
+					m_bvhNodes.begin() + m_bvhOffsets[i],
+					m_bvhNodes.begin() + m_bvhOffsets[i + 1]
+				);
+				dst.m_bvhOffsets = { 0, uint32_t(dst.m_bvhNodes.size()) };
+				dst.m_bvhTriangles.assign(
+					m_bvhTriangles.begin() + src.indexOffset / 3,
+					m_bvhTriangles.begin() + (src.indexOffset + src.indexCount) / 3
+				);
+				dst.buildTopLevelBvh();
+			}
+
+			// copy oriented bounding box
+			if (!m_orientedBoxes.empty())
+			{
+				dst.m_orientedBoxes.push_back(m_orientedBoxes[i]);
+				dst.m_orientedBoxesRefined = m_orientedBoxesRefined;
+			}
+
+			if (isShapeDirty(i))
+				dst.m_dirtyShapes = { 1 };
 		}
 
 		return meshes;
@@ -442,6 +881,19 @@ namespace bmf
 
 	template<class IndexT>
 	ShapeBinaryMesh<IndexT> ShapeBinaryMesh<IndexT>::mergeShapes(const std::vector<ShapeBinaryMesh<IndexT>>& meshes)
+	{
+		return mergeShapes(meshes, nullptr);
+	}
+
+	template<class IndexT>
+	ShapeBinaryMesh<IndexT> ShapeBinaryMesh<IndexT>::mergeShapes(std::vector<ShapeBinaryMesh<IndexT>>&& meshes)
+	{
+		return mergeShapes(meshes, meshes.empty() ? nullptr : &meshes.front());
+	}
+
+	template<class IndexT>
+	ShapeBinaryMesh<IndexT> ShapeBinaryMesh<IndexT>::mergeShapes(const std::vector<ShapeBinaryMesh<IndexT>>& meshes,
+		ShapeBinaryMesh<IndexT>* moveFirst)
 	{
 		if (meshes.empty()) return ShapeBinaryMesh<IndexT>();
 
@@ -449,129 +901,518 @@ namespace bmf
 		m.m_attributes = meshes.front().m_attributes;
 		m.m_bbox = -BoundingBox::max();
 		const auto attributeCount = getAttributeElementStride(meshes.front().m_attributes);
-		size_t m_totalVertices = 0;
-		size_t m_totalIndices = 0;
-		size_t m_totalShapes = 0;
-		size_t m_totalInstances = 0;
-
-		// acquire total vertex/index count
-		for (const auto& src : meshes)
+		// shadow indices, lods, meshlets, bvhs and oriented boxes are only kept if all meshes have them
+		bool hasShadowIndices = true;
+		const auto numLodLevels = meshes.front().getNumLodLevels();
+		bool hasLods = numLodLevels > 0;
+		bool hasMeshlets = true;
+		bool hasBvh = true;
+		bool hasOrientedBoxes = true;
+		// instances are kept if any mesh has them
+		bool hasInstances = false;
+
+		// acquire vertex/index/shape offsets of each mesh
+		std::vector<size_t> vertexOffsets(meshes.size() + 1, 0);
+		std::vector<size_t> indexOffsets(meshes.size() + 1, 0);
+		std::vector<size_t> shapeOffsets(meshes.size() + 1, 0);
+		for (size_t i = 0; i < meshes.size(); ++i)
 		{
+			const auto& src = meshes[i];
 			if (src.m_attributes != m.m_attributes)
 				throw std::runtime_error("BinaryMesh::mergeShapes attributes of all meshes must be the same");
 
-			m_totalVertices += src.m_vertices.size();
-			m_totalIndices += src.m_indices.size();
-			m_totalShapes += src.m_shapes.size();
-			//m_totalInstances += src.m_instances.size();
+			hasShadowIndices = hasShadowIndices && !src.m_shadowIndices.empty();
+			hasLods = hasLods && src.getNumLodLevels() == numLodLevels;
+			hasMeshlets = hasMeshlets && !src.m_meshletOffsets.empty();
+			hasBvh = hasBvh && !src.m_bvhOffsets.empty();
+			hasOrientedBoxes = hasOrientedBoxes && !src.m_orientedBoxes.empty();
+			hasInstances = hasInstances || !src.m_instanceOffsets.empty();
+
+			vertexOffsets[i + 1] = vertexOffsets[i] + src.m_vertices.size();
+			indexOffsets[i + 1] = indexOffsets[i] + src.m_indices.size();
+			shapeOffsets[i + 1] = shapeOffsets[i] + src.m_shapes.size();
+			for (const auto& s : src.m_shapes)
+				m.m_bbox = m.m_bbox.unionWith(s.bbox);
 		}
+		m.m_sphere = getMergedBoundingSphere(meshes, m.m_bbox);
 
-		// resize buffers
-		m.m_shapes.resize(m_totalShapes);
-		m.m_indices.resize(m_totalIndices);
-		m.m_vertices.resize(m_totalVertices);
-		//m.m_instances.resize(m_totalInstances);
+		// resize buffers. the buffers of the first mesh are reused if possible
+		if (moveFirst)
+		{
+			m.m_vertices = std::move(moveFirst->m_vertices);
+			m.m_indices = std::move(moveFirst->m_indices);
+			if (hasShadowIndices)
+				m.m_shadowIndices = std::move(moveFirst->m_shadowIndices);
+		}
+		m.m_shapes.resize(shapeOffsets.back());
+		m.m_indices.resize(indexOffsets.back());
+		m.m_vertices.resize(vertexOffsets.back());
+		if (hasShadowIndices)
+			m.m_shadowIndices.resize(indexOffsets.back());
+
+		// copy data at the precomputed offsets
+		const auto grainSize = vertexOffsets.back() / std::max(attributeCount, uint32_t(1)) >= ShapeParallelThreshold ? size_t(1) : meshes.size();
+		parallelFor(meshes.size(), grainSize, [&](size_t begin, size_t end, size_t)
+		{
+			for (size_t i = begin; i != end; ++i)
+			{
+				const auto& src = meshes[i];
+				// start index of the new vertices
+				const auto vertexOffset = uint32_t(vertexOffsets[i] / attributeCount);
+				// additional index offset for shapes
+				const auto indexOffset = uint32_t(indexOffsets[i]);
+
+				// the buffers of the first mesh were moved
+				if (i != 0 || !moveFirst)
+				{
+					std::copy(src.m_vertices.begin(), src.m_vertices.end(), m.m_vertices.begin() + vertexOffsets[i]);
+					std::copy(src.m_indices.begin(), src.m_indices.end(), m.m_indices.begin() + indexOffsets[i]);
+					if (hasShadowIndices)
+						std::copy(src.m_shadowIndices.begin(), src.m_shadowIndices.end(), m.m_shadowIndices.begin() + indexOffsets[i]);
+				}
 
-		auto curShape = m.m_shapes.begin();
-		auto curIndex = m.m_indices.begin();
-		auto curVertex = m.m_vertices.begin();
-		//auto curInstance = m.m_instances.begin();
+				std::transform(src.m_shapes.begin(), src.m_shapes.end(), m.m_shapes.begin() + shapeOffsets[i],
+					[&](Shape s)
+				{
+					s.indexOffset += indexOffset;
+					s.vertexOffset += vertexOffset;
+					return s;
+				});
+			}
+		});
 
-		// copy data
-		for (const auto& src : meshes)
+		// lods are ordered by level => the levels of all meshes are concatenated
+		if (hasLods)
 		{
-			// start index of the new vertices
-			auto vertexOffset = uint32_t((curVertex - m.m_vertices.begin()) / attributeCount);
-			// additional index offset for shapes
-			auto indexOffset = uint32_t(curIndex - m.m_indices.begin());
-			//auto instanceOffset = uint32_t(curInstance - m.m_instances.begin());
-
-			curVertex = std::copy(src.m_vertices.begin(), src.m_vertices.end(), curVertex);
-			curIndex = std::copy(src.m_indices.begin(), src.m_indices.end(), curIndex);
-			//curInstance = std::copy(src.m_instances.begin(), src.m_instances.end(), curInstance);
-			
-			curShape = std::transform(src.m_shapes.begin(), src.m_shapes.end(), curShape,
-				[&](Shape s)
+			for (uint32_t level = 1; level <= numLodLevels; ++level)
 			{
-				s.indexOffset += indexOffset;
-				s.vertexOffset += vertexOffset;
-				m.m_bbox = m.m_bbox.unionWith(s.bbox);
-				//s.instanceOffset += instanceOffset;
-				return s;
-			});
+				for (const auto& src : meshes)
+				{
+					for (size_t i = 0; i < src.m_shapes.size(); ++i)
+					{
+						auto lod = src.getLod(level, i);
+						const auto lodIndices = src.m_lodIndices.begin() + lod.indexOffset;
+						lod.indexOffset = uint32_t(m.m_lodIndices.size());
+						m.m_lodIndices.insert(m.m_lodIndices.end(), lodIndices, lodIndices + lod.indexCount);
+						m.m_lods.push_back(lod);
+					}
+				}
+			}
 		}
-		m.m_sphere = getBoundingSphere(m.m_vertices, m.m_attributes);
 
-		return m;
-	}
-#pragma endregion
-#pragma region Generation
-	void BinaryMesh::changeAttributes(uint32_t newAttributes,
-		const std::vector<std::unique_ptr<VertexGenerator>>& generators)
-	{
-		while (newAttributes != m_attributes)
+		// shapes without instances get an identity instance
+		if (hasInstances)
 		{
-			// everything generated?
-			if ((newAttributes & m_attributes) == newAttributes)
+			m.m_instanceOffsets.push_back(0);
+			for (const auto& src : meshes)
 			{
-				// remove unnecessary attributes
-				const auto oldVertexStride = getAttributeElementStride(m_attributes);
-				const auto vertexCount = m_vertices.size() / oldVertexStride;
-				const auto newVertexStride = getAttributeElementStride(newAttributes);
-				std::vector<float> newVertices(newVertexStride * vertexCount);
-
-				for (size_t i = 0; i < vertexCount; ++i)
+				for (size_t i = 0; i < src.m_shapes.size(); ++i)
 				{
-					const RefVertex src(m_attributes, const_cast<float*>(&m_vertices[i * oldVertexStride]));
-					RefVertex dst(newAttributes, &newVertices[i * newVertexStride]);
-					// change attributes to match destination
-					src.copyAttributesTo(dst);
+					if (src.m_instanceOffsets.empty())
+						m.m_instances.push_back(InstanceData(1.0f));
+					else
+						m.m_instances.insert(m.m_instances.end(),
+							src.m_instances.begin() + src.m_instanceOffsets[i],
+							src.m_instances.begin() + src.m_instanceOffsets[i + 1]);
+					m.m_instanceOffsets.push_back(uint32_t(m.m_instances.size()));
 				}
-
-				m_attributes = newAttributes;
-				m_vertices = std::move(newVertices);
-				// indices and shapes remain
-				continue;
 			}
+		}
 
-			// find first promising generator
-			auto gen = generators.begin();
-			for (const auto end = generators.end(); gen != end; ++gen)
+		if (hasMeshlets)
+		{
+			m.m_meshletOffsets.push_back(0);
+			for (const auto& src : meshes)
 			{
-				// can this generator be used?
-				if (((*gen)->getRequiredAttributes() & m_attributes) != (*gen)->getRequiredAttributes())
-					continue;
-
-				// will this generator produce something useful?
-				auto outAttribs = (*gen)->getOutputAttribute(m_attributes);
-				if ((newAttributes & outAttribs) > (newAttributes & m_attributes))
-					break;
+				const auto vertexOffset = uint32_t(m.m_meshletVertices.size());
+				const auto triangleOffset = uint32_t(m.m_meshletTriangles.size() / 3);
+				const auto meshletOffset = uint32_t(m.m_meshlets.size());
+				m.m_meshletVertices.insert(m.m_meshletVertices.end(), src.m_meshletVertices.begin(), src.m_meshletVertices.end());
+				m.m_meshletTriangles.insert(m.m_meshletTriangles.end(), src.m_meshletTriangles.begin(), src.m_meshletTriangles.end());
+				for (auto ml : src.m_meshlets)
+				{
+					ml.vertexOffset += vertexOffset;
+					ml.triangleOffset += triangleOffset;
+					m.m_meshlets.push_back(ml);
+				}
+				for (auto o = src.m_meshletOffsets.begin() + 1; o != src.m_meshletOffsets.end(); ++o)
+					m.m_meshletOffsets.push_back(*o + meshletOffset);
 			}
+		}
 
-			if (gen == generators.end())
-				throw std::runtime_error("BinaryMesh::changeAttributes no matching generator found to convert to new attributes");
-
-			// use the generator to generate a new mesh
-			BinaryMesh res;
-			const auto svgen = dynamic_cast<SingleVertexGenerator*>((*gen).get());
-			if (svgen != nullptr)
+		// the shape bvhs are shape local => only the top level bvh is rebuilt
+		if (hasBvh)
+		{
+			m.m_bvhOffsets.push_back(0);
+			for (const auto& src : meshes)
 			{
-				useVertexGenerator(*svgen);
-				continue;
+				const auto nodeOffset = uint32_t(m.m_bvhNodes.size());
+				m.m_bvhNodes.insert(m.m_bvhNodes.end(), src.m_bvhNodes.begin(), src.m_bvhNodes.end());
+				m.m_bvhTriangles.insert(m.m_bvhTriangles.end(), src.m_bvhTriangles.begin(), src.m_bvhTriangles.end());
+				for (auto o = src.m_bvhOffsets.begin() + 1; o != src.m_bvhOffsets.end(); ++o)
+					m.m_bvhOffsets.push_back(*o + nodeOffset);
 			}
+			m.buildTopLevelBvh();
+		}
 
-			const auto mvgen = dynamic_cast<MultiVertexGenerator*>((*gen).get());
-			if (mvgen != nullptr)
+		if (hasOrientedBoxes)
+		{
+			for (const auto& src : meshes)
 			{
-				useMultiVertexGenerator(*mvgen);
-				continue;
+				m.m_orientedBoxes.insert(m.m_orientedBoxes.end(), src.m_orientedBoxes.begin(), src.m_orientedBoxes.end());
+				m.m_orientedBoxesRefined = m.m_orientedBoxesRefined && src.m_orientedBoxesRefined;
 			}
+		}
 
-			throw std::runtime_error("BinaryMesh::changeAttributes incompatible vertex generator type");
+		for (size_t i = 0; i < meshes.size(); ++i)
+		{
+			for (size_t shape = 0; shape < meshes[i].m_shapes.size(); ++shape)
+			{
+				if (meshes[i].isShapeDirty(shape))
+					m.markShapeDirty(shapeOffsets[i] + shape);
+			}
 		}
+
+		return m;
 	}
 
-	void BinaryMesh::useVertexGenerator(const SingleVertexGenerator& svgen)
+	template <class IndexT>
+	void ShapeBinaryMesh<IndexT>::mergeShapesByMaterial(uint32_t maxVerticesPerShape)
+	{
+		maxVerticesPerShape = std::min(maxVerticesPerShape, uint32_t(std::numeric_limits<IndexT>::max()));
+		const auto stride = getAttributeElementStride(m_attributes);
+		const bool instanced = !m_instanceOffsets.empty();
+
+		const auto hasSameInstances = [&](uint32_t a, uint32_t b)
+		{
+			if (!instanced) return true;
+			return m_instanceOffsets[a + 1] - m_instanceOffsets[a] == m_instanceOffsets[b + 1] - m_instanceOffsets[b] &&
+				std::equal(m_instances.begin() + m_instanceOffsets[a], m_instances.begin() + m_instanceOffsets[a + 1],
+					m_instances.begin() + m_instanceOffsets[b]);
+		};
+
+		// source shapes of each merged shape
+		struct Group
+		{
+			std::vector<uint32_t> shapes;
+			uint32_t vertexCount;
+		};
+		std::vector<Group> groups;
+		// material => groups with that material
+		std::unordered_map<uint32_t, std::vector<size_t>> materialGroups;
+		for (uint32_t i = 0; i < uint32_t(m_shapes.size()); ++i)
+		{
+			const auto& s = m_shapes[i];
+			auto& candidates = materialGroups[s.materialId];
+			const auto g = std::find_if(candidates.begin(), candidates.end(), [&](size_t g)
+			{
+				return uint64_t(groups[g].vertexCount) + s.vertexCount <= maxVerticesPerShape && hasSameInstances(groups[g].shapes[0], i);
+			});
+			if (g == candidates.end())
+			{
+				candidates.push_back(groups.size());
+				groups.push_back(Group{ { i }, s.vertexCount });
+			}
+			else
+			{
+				groups[*g].shapes.push_back(i);
+				groups[*g].vertexCount += s.vertexCount;
+			}
+		}
+		if (groups.size() == m_shapes.size()) return;
+
+		// vertex ranges are reordered so that each merged shape is contiguous
+		std::vector<float> vertices;
+		vertices.reserve(m_vertices.size());
+		std::vector<IndexT> indices;
+		indices.reserve(m_indices.size());
+		std::vector<Shape> shapes;
+		shapes.reserve(groups.size());
+		std::vector<InstanceData> instances;
+		std::vector<uint32_t> instanceOffsets;
+		if (instanced) instanceOffsets.push_back(0);
+
+		for (const auto& g : groups)
+		{
+			Shape dst = m_shapes[g.shapes[0]];
+			dst.indexOffset = uint32_t(indices.size());
+			dst.indexCount = 0;
+			dst.vertexOffset = uint32_t(vertices.size() / stride);
+			dst.vertexCount = 0;
+
+			for (auto i : g.shapes)
+			{
+				const auto& src = m_shapes[i];
+				const auto srcVertices = m_vertices.begin() + size_t(src.vertexOffset) * stride;
+				vertices.insert(vertices.end(), srcVertices, srcVertices + size_t(src.vertexCount) * stride);
+
+				// rebase the shape local indices
+				const auto srcIndices = m_indices.begin() + src.indexOffset;
+				const auto base = IndexT(dst.vertexCount);
+				std::transform(srcIndices, srcIndices + src.indexCount, std::back_inserter(indices),
+					[base](IndexT idx) { return IndexT(idx + base); });
+
+				dst.indexCount += src.indexCount;
+				dst.vertexCount += src.vertexCount;
+			}
+			shapes.push_back(dst);
+
+			if (instanced)
+			{
+				const auto first = g.shapes[0];
+				instances.insert(instances.end(), m_instances.begin() + m_instanceOffsets[first],
+					m_instances.begin() + m_instanceOffsets[first + 1]);
+				instanceOffsets.push_back(uint32_t(instances.size()));
+			}
+		}
+
+		m_vertices = std::move(vertices);
+		m_indices = std::move(indices);
+		m_shapes = std::move(shapes);
+		m_instances = std::move(instances);
+		m_instanceOffsets = std::move(instanceOffsets);
+		discardDerivedIndices();
+
+		// the bounding sphere depends on the vertex order. all shape volumes are recalculated => no dirty shapes
+		m_dirtyShapes.clear();
+		if (m_attributes & Position)
+		{
+			m_sphere = getBoundingSphere(m_vertices, m_attributes);
+			forEachShape([&](size_t shapeIndex)
+			{
+				auto& s = m_shapes[shapeIndex];
+				s.bbox = calcBoundingBox(s);
+				s.sphere = calcBoundingSphere(s);
+			});
+			m_bbox = -BoundingBox::max();
+			for (const auto& s : m_shapes)
+				m_bbox = m_bbox.unionWith(s.bbox);
+		}
+	}
+#pragma endregion
+#pragma region Mutation
+	template<class IndexT>
+	Span<float> ShapeBinaryMesh<IndexT>::editVertices(uint32_t firstVertex, uint32_t count)
+	{
+		const auto stride = getAttributeElementStride(m_attributes);
+		if (size_t(firstVertex) + count > m_vertices.size() / stride)
+			throw std::runtime_error("BinaryMesh::editVertices vertex range out of range");
+
+		// the shapes are tightly packed in vertex offset order
+		auto shape = std::upper_bound(m_shapes.begin(), m_shapes.end(), firstVertex, [](uint32_t v, const Shape& s)
+		{
+			return v < s.vertexOffset;
+		});
+		if (shape != m_shapes.begin()) --shape;
+		for (; shape != m_shapes.end() && shape->vertexOffset < firstVertex + count; ++shape)
+		{
+			if (shape->vertexOffset + shape->vertexCount > firstVertex)
+				markShapeDirty(size_t(shape - m_shapes.begin()));
+		}
+
+		return Span<float>(m_vertices.data() + size_t(firstVertex) * stride, size_t(count) * stride);
+	}
+
+	template<class IndexT>
+	Span<float> ShapeBinaryMesh<IndexT>::editShapeVertices(size_t shape)
+	{
+		markShapeDirty(shape);
+		const auto stride = getAttributeElementStride(m_attributes);
+		const auto& s = m_shapes[shape];
+		return Span<float>(m_vertices.data() + size_t(s.vertexOffset) * stride, size_t(s.vertexCount) * stride);
+	}
+
+	template<class IndexT>
+	void ShapeBinaryMesh<IndexT>::markShapeDirty(size_t shape)
+	{
+		if (shape >= m_shapes.size())
+			throw std::runtime_error("BinaryMesh::markShapeDirty shape " + std::to_string(shape) + " out of range");
+		// flags of a replaced shape list are outdated => all shapes are dirty
+		if (m_dirtyShapes.size() != m_shapes.size())
+			m_dirtyShapes.assign(m_shapes.size(), m_dirtyShapes.empty() ? 0 : 1);
+		m_dirtyShapes[shape] = 1;
+	}
+
+	template<class IndexT>
+	bool ShapeBinaryMesh<IndexT>::isShapeDirty(size_t shape) const
+	{
+		if (m_dirtyShapes.empty() || shape >= m_shapes.size()) return false;
+		// flags of a replaced shape list are outdated => all shapes are dirty
+		return m_dirtyShapes.size() != m_shapes.size() || m_dirtyShapes[shape];
+	}
+
+	template<class IndexT>
+	void ShapeBinaryMesh<IndexT>::updateBoundingVolumes()
+	{
+		if (m_dirtyShapes.empty()) return;
+		if (!(m_attributes & Position))
+		{
+			m_dirtyShapes.clear();
+			return;
+		}
+
+		std::vector<uint32_t> dirty;
+		size_t numDirtyVertices = 0;
+		for (size_t i = 0; i < m_shapes.size(); ++i)
+		{
+			if (!isShapeDirty(i)) continue;
+			dirty.push_back(uint32_t(i));
+			numDirtyVertices += m_shapes[i].vertexCount;
+		}
+
+		const auto grainSize = numDirtyVertices >= ShapeParallelThreshold ? size_t(1) : dirty.size();
+		parallelFor(dirty.size(), grainSize, [&](size_t begin, size_t end, size_t)
+		{
+			for (size_t i = begin; i != end; ++i)
+			{
+				auto& s = m_shapes[dirty[i]];
+				s.bbox = calcBoundingBox(s);
+				s.sphere = calcBoundingSphere(s);
+				updateDerivedVolumes(dirty[i]);
+			}
+		});
+		m_dirtyShapes.clear();
+
+		// the mesh volumes are derived from the shape volumes (see getMergedBoundingSphere)
+		m_bbox = -BoundingBox::max();
+		for (const auto& s : m_shapes)
+			m_bbox = m_bbox.unionWith(s.bbox);
+		auto sphere = m_shapes.front().sphere;
+		for (auto s = m_shapes.begin() + 1; s != m_shapes.end(); ++s)
+			sphere = sphere.unionWith(s->sphere);
+		m_sphere = getSmallerBoundingSphere(sphere, m_bbox);
+
+		if (!m_bvhOffsets.empty()) buildTopLevelBvh();
+	}
+
+	template<class IndexT>
+	void ShapeBinaryMesh<IndexT>::updateDerivedVolumes(size_t shape)
+	{
+		const auto& s = m_shapes[shape];
+		if (shape < m_orientedBoxes.size())
+		{
+			const auto stride = getAttributeElementStride(m_attributes);
+			m_orientedBoxes[shape] = computeOrientedBoundingBox(
+				m_vertices.data() + size_t(s.vertexOffset) * stride + getAttributeElementOffset(m_attributes, Position), s.vertexCount, stride,
+				m_orientedBoxesRefined);
+		}
+		if (shape + 1 < m_bvhOffsets.size())
+			refitBvh(shape);
+	}
+
+	template<class IndexT>
+	void ShapeBinaryMesh<IndexT>::refitBvh(size_t shape)
+	{
+		const auto& s = m_shapes[shape];
+		const auto stride = getAttributeElementStride(m_attributes);
+		const float* positions = m_vertices.data() + size_t(s.vertexOffset) * stride + getAttributeElementOffset(m_attributes, Position);
+		const IndexT* indices = m_indices.data() + s.indexOffset;
+		const uint32_t* triangles = m_bvhTriangles.data() + s.indexOffset / 3;
+		BvhNode* nodes = m_bvhNodes.data() + m_bvhOffsets[shape];
+
+		// children have higher indices than their parent
+		for (size_t n = m_bvhOffsets[shape + 1] - m_bvhOffsets[shape]; n-- > 0;)
+		{
+			auto& node = nodes[n];
+			if (!node.isLeaf())
+			{
+				node.bbox = nodes[n + 1].bbox.unionWith(nodes[node.offset].bbox);
+				continue;
+			}
+
+			node.bbox = -BoundingBox::max();
+			for (uint32_t i = node.offset; i != node.offset + node.count; ++i)
+			{
+				for (uint32_t j = 0; j < 3; ++j)
+				{
+					const auto p = toVec3(positions + size_t(indices[triangles[i] * 3 + j]) * stride);
+					node.bbox = node.bbox.unionWith(BoundingBox{ p.x, p.y, p.z, p.x, p.y, p.z });
+				}
+			}
+		}
+	}
+#pragma endregion
+#pragma region Generation
+	void BinaryMesh::changeAttributes(uint32_t newAttributes,
+		const std::vector<std::unique_ptr<VertexGenerator>>& generators)
+	{
+		while (newAttributes != m_attributes)
+		{
+			// everything generated?
+			if ((newAttributes & m_attributes) == newAttributes)
+			{
+				// remove unnecessary attributes
+				const auto oldVertexStride = getAttributeElementStride(m_attributes);
+				const auto vertexCount = m_vertices.size() / oldVertexStride;
+				const auto newVertexStride = getAttributeElementStride(newAttributes);
+				std::vector<float> newVertices(newVertexStride * vertexCount);
+
+				for (size_t i = 0; i < vertexCount; ++i)
+				{
+					const RefVertex src(m_attributes, const_cast<float*>(&m_vertices[i * oldVertexStride]));
+					RefVertex dst(newAttributes, &newVertices[i * newVertexStride]);
+					// change attributes to match destination
+					src.copyAttributesTo(dst);
+				}
+
+				m_attributes = newAttributes;
+				m_vertices = std::move(newVertices);
+				// indices and shapes remain
+				continue;
+			}
+
+			// find first promising generator
+			auto gen = generators.begin();
+			for (const auto end = generators.end(); gen != end; ++gen)
+			{
+				// can this generator be used?
+				if (((*gen)->getRequiredAttributes() & m_attributes) != (*gen)->getRequiredAttributes())
+					continue;
+
+				// will this generator produce something useful?
+				auto outAttribs = (*gen)->getOutputAttribute(m_attributes);
+				if ((newAttributes & outAttribs) > (newAttributes & m_attributes))
+					break;
+			}
+
+			if (gen == generators.end())
+				throw std::runtime_error("BinaryMesh::changeAttributes no matching generator found to convert to new attributes");
+
+			// use the generator to generate a new mesh
+			BinaryMesh res;
+			const auto svgen = dynamic_cast<SingleVertexGenerator*>((*gen).get());
+			if (svgen != nullptr)
+			{
+				useVertexGenerator(*svgen);
+				continue;
+			}
+
+			const auto mvgen = dynamic_cast<MultiVertexGenerator*>((*gen).get());
+			if (mvgen != nullptr)
+			{
+				useMultiVertexGenerator(*mvgen);
+				continue;
+			}
+
+			const auto ivgen = dynamic_cast<IndexedVertexGenerator*>((*gen).get());
+			if (ivgen != nullptr)
+			{
+				useIndexedVertexGenerator(*ivgen);
+				continue;
+			}
+
+			throw std::runtime_error("BinaryMesh::changeAttributes incompatible vertex generator type");
+		}
+
+		// the billboard extents might have changed
+		if (!m_chunkBounds.empty())
+		{
+			if (m_attributes & Position) generateChunkBounds();
+			else m_chunkBounds.clear();
+		}
+	}
+
+	void BinaryMesh::useVertexGenerator(const SingleVertexGenerator& svgen)
 	{
 		const auto newAttributes = svgen.getOutputAttribute(m_attributes);
 		const auto oldVertexStride = getAttributeElementStride(m_attributes);
@@ -600,6 +1441,11 @@ namespace bmf
 		throw std::runtime_error("BinaryMesh::changeAttributes MultiVertexGenerator can only be used with ShapedMesh meshes");
 	}
 
+	void BinaryMesh::useIndexedVertexGenerator(const IndexedVertexGenerator& ivgen)
+	{
+		throw std::runtime_error("BinaryMesh::changeAttributes IndexedVertexGenerator can only be used with ShapedMesh meshes");
+	}
+
 	void BinaryMesh::offsetMaterial(uint32_t offset)
 	{
 		if (!(m_attributes & Material) || m_vertices.empty()) return; // nothing to do
@@ -626,13 +1472,17 @@ namespace bmf
 	}
 
 	BoundingBox BinaryMesh::getBillboardBoundingBox(const std::vector<float>& vertices, uint32_t attributes)
+	{
+		return getBillboardBoundingBox(vertices.data(), vertices.data() + vertices.size(), attributes);
+	}
+
+	BoundingBox BinaryMesh::getBillboardBoundingBox(const float* start, const float* end, uint32_t attributes)
 	{
 		if (!(attributes & Position))
 			throw std::runtime_error("positions are required to calculate bounding box");
 
 		// convert all vertices
 		const auto stride = getAttributeElementStride(attributes);
-		const auto vertexCount = vertices.size() / stride;
 
 		const bool hasWidth = attributes & Width;
 		const size_t widthOffset = getAttributeElementOffset(attributes, Width);
@@ -642,10 +1492,8 @@ namespace bmf
 		const size_t depthOffset = getAttributeElementOffset(attributes, Depth);
 
 		auto bbox = -BoundingBox::max();
-		for (size_t i = 0; i < vertexCount; ++i)
+		for (const float* pos = start; pos != end; pos += stride)
 		{
-			const float* pos = &vertices[i * stride];
-
 			// add radius for billboards
 			float radius = 0.0f;
 			if (hasWidth)
@@ -670,119 +1518,203 @@ namespace bmf
 	{
 		m_bbox = getBillboardBoundingBox(m_vertices, m_attributes);
 		m_sphere = getBillboardBoundingSphere(m_vertices, m_attributes);
+		if (!m_chunkBounds.empty()) generateChunkBounds();
+	}
+
+	void BinaryMesh::sortSpatially(uint32_t chunkSize)
+	{
+		if (!(m_attributes & Position))
+			throw std::runtime_error("BinaryMesh::sortSpatially positions are required");
+		if (chunkSize == 0)
+			throw std::runtime_error("BinaryMesh::sortSpatially chunk size must not be 0");
+
+		const auto stride = getAttributeElementStride(m_attributes);
+		const auto numVertices = m_vertices.size() / stride;
+		const auto codes = computeMortonCodes(m_vertices.data(), numVertices, stride,
+			getBoundingBox(m_vertices, m_attributes));
+		const auto order = radixSortIndices(codes);
+
+		std::vector<float> vertices(m_vertices.size());
+		parallelFor(numVertices, ShapeParallelThreshold, [&](size_t begin, size_t end, size_t)
+		{
+			for (size_t i = begin; i != end; ++i)
+			{
+				const auto src = m_vertices.begin() + size_t(order[i]) * stride;
+				std::copy(src, src + stride, vertices.begin() + i * stride);
+			}
+		});
+		m_vertices = std::move(vertices);
+
+		m_chunkSize = chunkSize;
+		generateChunkBounds();
+	}
+
+	void BinaryMesh::generateChunkBounds()
+	{
+		const auto stride = getAttributeElementStride(m_attributes);
+		const size_t numVertices = m_vertices.size() / stride;
+		m_chunkBounds.resize((numVertices + m_chunkSize - 1) / m_chunkSize);
+		parallelFor(m_chunkBounds.size(), std::max(size_t(ShapeParallelThreshold / m_chunkSize), size_t(1)), [&](size_t begin, size_t end, size_t)
+		{
+			for (size_t c = begin; c != end; ++c)
+			{
+				const auto start = m_vertices.data() + c * m_chunkSize * stride;
+				const auto last = m_vertices.data() + std::min((c + 1) * m_chunkSize, numVertices) * stride;
+				m_chunkBounds[c] = getBillboardBoundingBox(start, last, m_attributes);
+			}
+		});
 	}
 
 	template<class IndexT>
-	void ShapeBinaryMesh<IndexT>::useMultiVertexGenerator(const MultiVertexGenerator& mvgen)
+	void ShapeBinaryMesh<IndexT>::sortSpatially(uint32_t /*chunkSize*/)
 	{
-		expectSingleShape("BinaryMesh::useVertexGenerator");
+		throw std::runtime_error("BinaryMesh::sortSpatially is not supported for meshes with indices");
+	}
 
+	template<class IndexT>
+	void ShapeBinaryMesh<IndexT>::useMultiVertexGenerator(const MultiVertexGenerator& mvgen)
+	{
 		const auto newAttributes = mvgen.getOutputAttribute(m_attributes);
 		const auto oldVertexStride = getAttributeElementStride(m_attributes);
-		const auto vertexCount = m_vertices.size() / oldVertexStride;
 		const auto newVertexStride = getAttributeElementStride(newAttributes);
 
-		std::vector<float> newVertices;
-		newVertices.reserve(newVertexStride * vertexCount);
-		std::vector<IndexT> newIndices(m_indices);
-
-		std::vector<std::array<IndexT*, 3>> triangleIndices;
-		std::vector<Triangle> triangles;
-		std::vector<ValueVertex> valueVertices;
-		std::vector<uint32_t>  outIndices;
-		valueVertices.reserve(16);
-		triangleIndices.reserve(16);
-		triangles.reserve(16);
-		outIndices.reserve(16);
-
-		for (size_t vertIdx = 0; vertIdx < vertexCount; ++vertIdx)
+		std::vector<std::vector<float>> shapeVertices(m_shapes.size());
+		forEachShape([&](size_t shapeIndex)
 		{
-			triangleIndices.resize(0);
-			triangles.resize(0);
-			valueVertices.resize(0);
-			outIndices.resize(0);
-
-			// find all triangles that reference this vertex
-			for (size_t idxIdx = 0, idxSize = m_indices.size(); idxIdx < idxSize; idxIdx += 3)
+			const auto& s = m_shapes[shapeIndex];
+			const auto vertexCount = s.vertexCount;
+			const auto vertices = m_vertices.data() + size_t(s.vertexOffset) * oldVertexStride;
+			const auto indices = m_indices.data() + s.indexOffset;
+
+			auto& newVertices = shapeVertices[shapeIndex];
+			newVertices.reserve(newVertexStride * vertexCount);
+			std::vector<IndexT> newIndices(indices, indices + s.indexCount);
+
+			std::vector<std::array<IndexT*, 3>> triangleIndices;
+			std::vector<Triangle> triangles;
+			std::vector<ValueVertex> valueVertices;
+			std::vector<uint32_t>  outIndices;
+			valueVertices.reserve(16);
+			triangleIndices.reserve(16);
+			triangles.reserve(16);
+			outIndices.reserve(16);
+
+			for (size_t vertIdx = 0; vertIdx < vertexCount; ++vertIdx)
 			{
-				if (m_indices[idxIdx] != vertIdx && m_indices[idxIdx + 1] != vertIdx && m_indices[idxIdx + 2] != vertIdx)
-					continue;
+				triangleIndices.resize(0);
+				triangles.resize(0);
+				valueVertices.resize(0);
+				outIndices.resize(0);
 
-				// this triangle matches
-				triangleIndices.emplace_back();
-
-				// get rotatation amount (vertex index must be first index)
-				size_t rot = 0;
-				if (m_indices[idxIdx + 1] == vertIdx) rot = 1;
-				if (m_indices[idxIdx + 2] == vertIdx) rot = 2;
-
-				// get offsets from rotation
-				size_t off0 = rot;
-				size_t off1 = (rot + 1) % 3;
-				size_t off2 = (rot + 2) % 3;
-
-				auto& itri = triangleIndices.back();
-				itri[0] = &newIndices[idxIdx + off0];
-				itri[1] = &newIndices[idxIdx + off1];
-				itri[2] = &newIndices[idxIdx + off2];
-
-				// add triangle representation
-				triangles.emplace_back();
-				auto& tri = triangles.back();
-				tri.vertex[0] = RefVertex(m_attributes, const_cast<float*>(&m_vertices[m_indices[idxIdx + off0] * oldVertexStride]));
-				tri.vertex[1] = RefVertex(m_attributes, const_cast<float*>(&m_vertices[m_indices[idxIdx + off1] * oldVertexStride]));
-				tri.vertex[2] = RefVertex(m_attributes, const_cast<float*>(&m_vertices[m_indices[idxIdx + off2] * oldVertexStride]));
-			}
+				// find all triangles that reference this vertex
+				for (size_t idxIdx = 0, idxSize = s.indexCount; idxIdx < idxSize; idxIdx += 3)
+				{
+					if (indices[idxIdx] != vertIdx && indices[idxIdx + 1] != vertIdx && indices[idxIdx + 2] != vertIdx)
+						continue;
+
+					// this triangle matches
+					triangleIndices.emplace_back();
+
+					// get rotatation amount (vertex index must be first index)
+					size_t rot = 0;
+					if (indices[idxIdx + 1] == vertIdx) rot = 1;
+					if (indices[idxIdx + 2] == vertIdx) rot = 2;
+
+					// get offsets from rotation
+					size_t off0 = rot;
+					size_t off1 = (rot + 1) % 3;
+					size_t off2 = (rot + 2) % 3;
+
+					auto& itri = triangleIndices.back();
+					itri[0] = &newIndices[idxIdx + off0];
+					itri[1] = &newIndices[idxIdx + off1];
+					itri[2] = &newIndices[idxIdx + off2];
+
+					// add triangle representation
+					triangles.emplace_back();
+					auto& tri = triangles.back();
+					tri.vertex[0] = RefVertex(m_attributes, const_cast<float*>(&vertices[indices[idxIdx + off0] * oldVertexStride]));
+					tri.vertex[1] = RefVertex(m_attributes, const_cast<float*>(&vertices[indices[idxIdx + off1] * oldVertexStride]));
+					tri.vertex[2] = RefVertex(m_attributes, const_cast<float*>(&vertices[indices[idxIdx + off2] * oldVertexStride]));
+				}
 
-			if (triangles.empty()) continue; // this vertex is not used in any triangle => discard
+				if (triangles.empty()) continue; // this vertex is not used in any triangle => discard
 
-			// use generator to generate new vertices
-			outIndices.reserve(triangles.size());
-			mvgen.generate(triangles, valueVertices, outIndices);
+				// use generator to generate new vertices
+				outIndices.reserve(triangles.size());
+				mvgen.generate(triangles, valueVertices, outIndices);
 
-			assert(valueVertices.size());
+				assert(valueVertices.size());
 
-			// add vertices
-			const auto startIdx = uint32_t(newVertices.size());
-			const auto startElementIdx = uint32_t(startIdx / newVertexStride);
+				// add vertices
+				const auto startIdx = uint32_t(newVertices.size());
+				const auto startElementIdx = uint32_t(startIdx / newVertexStride);
 
-			newVertices.resize(newVertices.size() + valueVertices.size() * newVertexStride);
-			// copy vertices
-			for (size_t i = 0; i < valueVertices.size(); ++i)
-			{
-				std::copy(
-					valueVertices[i].data(),
-					valueVertices[i].data() + newVertexStride,
-					newVertices.data() + startIdx + i * newVertexStride);
-			}
+				newVertices.resize(newVertices.size() + valueVertices.size() * newVertexStride);
+				// copy vertices
+				for (size_t i = 0; i < valueVertices.size(); ++i)
+				{
+					std::copy(
+						valueVertices[i].data(),
+						valueVertices[i].data() + newVertexStride,
+						newVertices.data() + startIdx + i * newVertexStride);
+				}
 
-			// adjust indices
-			if (valueVertices.size() == 1)
-			{
-				// all indices must be the same (there is only one vertex)
-				for (size_t i = 0; i < triangleIndices.size(); ++i)
+				// adjust indices
+				if (valueVertices.size() == 1)
 				{
-					*triangleIndices[i][0] = IndexT(startElementIdx);
+					// all indices must be the same (there is only one vertex)
+					for (size_t i = 0; i < triangleIndices.size(); ++i)
+					{
+						*triangleIndices[i][0] = IndexT(startElementIdx);
+					}
 				}
-			}
-			else
-			{
-				// multiple vertices => different output indices
-				assert(outIndices.size() == triangles.size());
-				assert(triangles.size() == triangleIndices.size());
-				for (size_t i = 0; i < triangleIndices.size(); ++i)
+				else
 				{
-					*triangleIndices[i][0] = IndexT(startElementIdx + outIndices[i]);
+					// multiple vertices => different output indices
+					assert(outIndices.size() == triangles.size());
+					assert(triangles.size() == triangleIndices.size());
+					for (size_t i = 0; i < triangleIndices.size(); ++i)
+					{
+						*triangleIndices[i][0] = IndexT(startElementIdx + outIndices[i]);
+					}
 				}
 			}
-		}
 
-		m_attributes = newAttributes;
-		m_vertices = std::move(newVertices);
-		m_indices = std::move(newIndices);
+			// index ranges of the shapes do not overlap => write back in place
+			std::copy(newIndices.begin(), newIndices.end(), m_indices.begin() + s.indexOffset);
+		});
+
+		// shape indices: index offsets and count have not changed. only the values of the indices changed
+		setShapeVertices(newAttributes, shapeVertices);
+	}
+
+	template<class IndexT>
+	void ShapeBinaryMesh<IndexT>::useIndexedVertexGenerator(const IndexedVertexGenerator& ivgen)
+	{
+		const auto newAttributes = ivgen.getOutputAttribute(m_attributes);
+		const auto stride = getAttributeElementStride(m_attributes);
+
+		std::vector<std::vector<float>> shapeVertices(m_shapes.size());
+		forEachShape([&](size_t shapeIndex)
+		{
+			const auto& s = m_shapes[shapeIndex];
+
+			// the generator works on the whole index buffer of the shape at once
+			const std::vector<float> vertices(
+				m_vertices.begin() + size_t(s.vertexOffset) * stride,
+				m_vertices.begin() + size_t(s.vertexOffset + s.vertexCount) * stride);
+			std::vector<uint32_t> indices(m_indices.begin() + s.indexOffset, m_indices.begin() + s.indexOffset + s.indexCount);
+			ivgen.generate(m_attributes, vertices, indices, shapeVertices[shapeIndex]);
+
+			std::transform(indices.begin(), indices.end(), m_indices.begin() + s.indexOffset, [](uint32_t i)
+			{
+				return IndexT(i);
+			});
+		});
 
 		// shape indices: index offsets and count have not changed. only the values of the indices changed
-		m_shapes[0].vertexCount = uint32_t(m_vertices.size() / newVertexStride);
+		setShapeVertices(newAttributes, shapeVertices);
 	}
 
 	template<class IndexT>
@@ -810,316 +1742,950 @@ namespace bmf
 	template<class IndexT>
 	void ShapeBinaryMesh<IndexT>::removeDuplicateVertices()
 	{
-		expectSingleShape("BinaryMesh::removeDuplicateVertices");
+		const auto stride = getAttributeElementStride(m_attributes);
+		// only one level of threads
+		const bool parallelRemap = !isShapeParallel();
+
+		std::vector<uint8_t> changed(m_shapes.size(), 0);
+		forEachShape([&](size_t shapeIndex)
+		{
+			auto& s = m_shapes[shapeIndex];
+
+			// remap[a] = b indicates that the vertex that was on (index) position a is now on (index) position b
+			std::vector<uint32_t> remap;
+			const auto numUnique = generateVertexRemap(m_vertices.data() + size_t(s.vertexOffset) * stride, s.vertexCount,
+				stride, 0, stride, remap, parallelRemap && s.vertexCount > VertexRemapParallelThreshold);
+
+			changed[shapeIndex] = applyVertexRemap(s, remap, numUnique);
+		});
+
+		packVertices(changed);
+	}
+
+	template<class IndexT>
+	void ShapeBinaryMesh<IndexT>::weldVertices(float positionEpsilon,
+		const std::unordered_map<Attributes, float>& attributeEpsilons)
+	{
+		if (!(m_attributes & Position))
+			throw std::runtime_error("BinaryMesh::weldVertices positions are required");
+
+		const auto stride = getAttributeElementStride(m_attributes);
+
+		// tolerance for each vertex element (-1 => bitwise equal)
+		std::vector<float> elementEpsilons(stride, -1.0f);
+		for (const auto& e : attributeEpsilons)
+		{
+			if (!(m_attributes & e.first) || e.first == Material) continue;
+			const auto offset = getAttributeElementOffset(m_attributes, e.first);
+			std::fill_n(elementEpsilons.begin() + offset, getAttributeElementCount(e.first), e.second);
+		}
 
-		std::unordered_map<RefVertex, std::vector<uint32_t>> map;
+		std::vector<uint8_t> changed(m_shapes.size(), 0);
+		forEachShape([&](size_t shapeIndex)
+		{
+			auto& s = m_shapes[shapeIndex];
+
+			std::vector<uint32_t> remap;
+			const auto numUnique = generateWeldRemap(m_vertices.data() + size_t(s.vertexOffset) * stride, s.vertexCount,
+				stride, positionEpsilon, elementEpsilons.data(), remap);
+
+			changed[shapeIndex] = applyVertexRemap(s, remap, numUnique);
+		});
+
+		packVertices(changed);
+	}
 
+	template<class IndexT>
+	bool ShapeBinaryMesh<IndexT>::applyVertexRemap(Shape& s, const std::vector<uint32_t>& remap, uint32_t numUnique)
+	{
 		const auto stride = getAttributeElementStride(m_attributes);
-		const auto numVertices = uint32_t(m_vertices.size() / stride);
-		assert(numVertices == m_shapes[0].vertexCount);
+		const auto numVertices = uint32_t(remap.size());
+		if (numUnique == numVertices) return false; // no duplicates
 
+		// unique vertices are numbered by their first occurrence => remap[i] <= i and vertices can be moved in place
+		const auto vertices = m_vertices.begin() + size_t(s.vertexOffset) * stride;
+		uint32_t curIndex = 0;
 		for (uint32_t i = 0; i < numVertices; ++i)
 		{
-			const RefVertex v(m_attributes, &m_vertices[i * stride]);
-			auto it = map.find(v);
-			if (it != map.end())
+			if (remap[i] != curIndex) continue; // duplicate of a previous vertex (or unused)
+
+			if (curIndex != i)
+				std::copy(
+					vertices + size_t(i) * stride,
+					vertices + size_t(i + 1) * stride,
+					vertices + size_t(curIndex) * stride);
+			++curIndex;
+		}
+
+		// fix indices
+		for (auto i = m_indices.begin() + s.indexOffset, end = i + s.indexCount; i != end; ++i)
+		{
+			*i = IndexT(remap[*i]);
+		}
+
+		// only vertex count changed (the vertex ranges are packed afterwards)
+		s.vertexCount = numUnique;
+		return true;
+	}
+
+	template<class IndexT>
+	void ShapeBinaryMesh<IndexT>::packVertices(const std::vector<uint8_t>& changedShapes)
+	{
+		// the derived indices are still valid if no vertex was moved
+		if (std::none_of(changedShapes.begin(), changedShapes.end(), [](uint8_t c) { return c != 0; })) return;
+
+		const auto stride = getAttributeElementStride(m_attributes);
+
+		// shapes are ordered by their vertex offset and only got smaller => vertices can be moved to the front
+		uint32_t curOffset = 0;
+		for (auto& s : m_shapes)
+		{
+			if (s.vertexOffset != curOffset)
+				std::copy(
+					m_vertices.begin() + size_t(s.vertexOffset) * stride,
+					m_vertices.begin() + size_t(s.vertexOffset + s.vertexCount) * stride,
+					m_vertices.begin() + size_t(curOffset) * stride);
+			s.vertexOffset = curOffset;
+			curOffset += s.vertexCount;
+		}
+		m_vertices.resize(size_t(curOffset) * stride);
+		discardDerivedIndices();
+
+		// the bounding sphere depends on the vertex order
+		for (size_t i = 0; i < changedShapes.size(); ++i)
+		{
+			if (changedShapes[i]) markShapeDirty(i);
+		}
+	}
+
+	template<class IndexT>
+	void ShapeBinaryMesh<IndexT>::setShapeVertices(uint32_t attributes, std::vector<std::vector<float>>& shapeVertices)
+	{
+		const auto stride = getAttributeElementStride(attributes);
+
+		// vertex ranges start directly after each other
+		size_t totalVertices = 0;
+		for (size_t i = 0; i < m_shapes.size(); ++i)
+		{
+			m_shapes[i].vertexOffset = uint32_t(totalVertices / stride);
+			m_shapes[i].vertexCount = uint32_t(shapeVertices[i].size() / stride);
+			totalVertices += shapeVertices[i].size();
+		}
+
+		if (m_shapes.size() == 1)
+		{
+			m_vertices = std::move(shapeVertices[0]);
+		}
+		else
+		{
+			m_vertices.resize(totalVertices);
+			forEachShape([&](size_t shapeIndex)
 			{
-				// add this vertex index
-				it->second.push_back(i);
+				auto& src = shapeVertices[shapeIndex];
+				std::copy(src.begin(), src.end(), m_vertices.begin() + size_t(m_shapes[shapeIndex].vertexOffset) * stride);
+				std::vector<float>().swap(src);
+			});
+		}
+
+		m_attributes = attributes;
+		discardDerivedIndices();
+	}
+
+	template<class IndexT>
+	void ShapeBinaryMesh<IndexT>::setShapeIndices(std::vector<std::vector<IndexT>>& shapeIndices)
+	{
+		uint32_t totalIndices = 0;
+		for (size_t i = 0; i < m_shapes.size(); ++i)
+		{
+			m_shapes[i].indexOffset = totalIndices;
+			m_shapes[i].indexCount = uint32_t(shapeIndices[i].size());
+			totalIndices += m_shapes[i].indexCount;
+		}
+
+		m_indices.resize(totalIndices);
+		for (size_t i = 0; i < m_shapes.size(); ++i)
+		{
+			std::copy(shapeIndices[i].begin(), shapeIndices[i].end(), m_indices.begin() + m_shapes[i].indexOffset);
+			std::vector<IndexT>().swap(shapeIndices[i]);
+		}
+		discardDerivedIndices();
+	}
+
+	template<class IndexT>
+	void ShapeBinaryMesh<IndexT>::discardDerivedIndices()
+	{
+		m_shadowIndices.clear();
+		m_lods.clear();
+		m_lodIndices.clear();
+		m_meshlets.clear();
+		m_meshletOffsets.clear();
+		m_meshletVertices.clear();
+		m_meshletTriangles.clear();
+		m_bvhNodes.clear();
+		m_bvhOffsets.clear();
+		m_bvhTriangles.clear();
+		m_topLevelBvhNodes.clear();
+		m_topLevelBvhShapes.clear();
+		m_orientedBoxes.clear();
+	}
+
+	template<class IndexT>
+	size_t ShapeBinaryMesh<IndexT>::getShapeGrainSize() const
+	{
+		// small meshes are not worth the thread overhead
+		return getNumVertices() >= ShapeParallelThreshold ? size_t(1) : m_shapes.size();
+	}
+
+	template<class IndexT>
+	bool ShapeBinaryMesh<IndexT>::isShapeParallel() const
+	{
+		return getNumThreads(m_shapes.size(), getShapeGrainSize()) > 1;
+	}
+
+	template<class IndexT>
+	template<class Func>
+	void ShapeBinaryMesh<IndexT>::forEachShape(Func func)
+	{
+		const auto grainSize = getShapeGrainSize();
+
+		// exceptions must not leave the worker threads => rethrow the first one on the calling thread
+		std::vector<std::exception_ptr> errors(getNumThreads(m_shapes.size(), grainSize));
+		parallelFor(m_shapes.size(), grainSize, [&](size_t begin, size_t end, size_t threadIndex)
+		{
+			try
+			{
+				for (size_t i = begin; i != end; ++i)
+					func(i);
 			}
-			else
+			catch (...)
 			{
-				map[v] = std::vector<uint32_t>(std::initializer_list<uint32_t>{ i });
+				errors[threadIndex] = std::current_exception();
 			}
+		});
+
+		for (const auto& e : errors)
+		{
+			if (e) std::rethrow_exception(e);
 		}
+	}
+
+	template<class IndexT>
+	void ShapeBinaryMesh<IndexT>::removeUnusedVertices()
+	{
+		std::vector<uint8_t> changed(m_shapes.size(), 0);
+		forEachShape([&](size_t shapeIndex)
+		{
+			auto& s = m_shapes[shapeIndex];
+			const auto indices = m_indices.begin() + s.indexOffset;
 
-		if (map.size() == numVertices) return; // no duplicates
+			std::vector<bool> used(s.vertexCount, false);
+			for (auto i = indices, end = indices + s.indexCount; i != end; ++i)
+				used[*i] = true;
 
-		// remove duplicates
-		std::vector<bool> usedVertices;
-		// boolmap that indicates which vertices were already used
-		usedVertices.assign(numVertices, false);
+			// remap[a] = b means: the vertex that was on index a is now on index b (unused vertices are not referenced)
+			std::vector<uint32_t> remap(s.vertexCount, std::numeric_limits<uint32_t>::max());
+			uint32_t curIndex = 0;
+			for (uint32_t i = 0; i < s.vertexCount; ++i)
+			{
+				if (used[i]) remap[i] = curIndex++;
+			}
 
-		// newIndexLookupTable[a] = b indicates that the vertex that was on (index) position a is now on (index) position b
-		std::vector<uint32_t> newIndexLookupTable;
-		newIndexLookupTable.resize(numVertices);
+			changed[shapeIndex] = applyVertexRemap(s, remap, curIndex);
+		});
 
-		std::vector<float> newVertices;
-		newVertices.resize(map.size() * stride);
-		auto curVertex = newVertices.begin();
-		uint32_t curIndex = 0;
+		packVertices(changed);
+	}
 
-		// fill newVertices and create index lookup table
-		for (size_t i = 0; i < numVertices; ++i)
+	template<class IndexT>
+	void ShapeBinaryMesh<IndexT>::generateShadowIndices()
+	{
+		if (!(m_attributes & Position))
+			throw std::runtime_error("BinaryMesh::generateShadowIndices positions are required");
+
+		const auto stride = getAttributeElementStride(m_attributes);
+		const auto positionOffset = getAttributeElementOffset(m_attributes, Position);
+		m_shadowIndices.resize(m_indices.size());
+		// only one level of threads
+		const bool parallelRemap = !isShapeParallel();
+
+		forEachShape([&](size_t shapeIndex)
 		{
-			// already inserted into new vertices?
-			if (usedVertices[i]) continue;
+			const auto& s = m_shapes[shapeIndex];
 
-			// insert into new vertices
-			curVertex = std::copy(
-				m_vertices.begin() + i * stride,
-				m_vertices.begin() + (i + 1) * stride,
-				curVertex);
+			// deduplicate only the position of the vertices of this shape
+			std::vector<uint32_t> remap;
+			const auto numUnique = generateVertexRemap(m_vertices.data() + size_t(s.vertexOffset) * stride, s.vertexCount,
+				stride, positionOffset, 3, remap, parallelRemap && s.vertexCount > VertexRemapParallelThreshold);
 
-			const RefVertex v(m_attributes, &m_vertices[i * stride]);
-			auto it = map.find(v);
-			// set bitflags and index lookup
-			for (auto idx : it->second)
+			// unique vertices are numbered by their first occurrence
+			std::vector<uint32_t> firstVertex(numUnique);
+			uint32_t curUnique = 0;
+			for (uint32_t i = 0; i < s.vertexCount; ++i)
 			{
-				usedVertices[idx] = true;
-				newIndexLookupTable[idx] = curIndex;
+				if (remap[i] == curUnique) firstVertex[curUnique++] = i;
 			}
 
-			++curIndex;
+			for (size_t i = s.indexOffset, end = s.indexOffset + s.indexCount; i != end; ++i)
+			{
+				m_shadowIndices[i] = IndexT(firstVertex[remap[m_indices[i]]]);
+			}
+		});
+	}
+
+	template<class IndexT>
+	float ShapeBinaryMesh<IndexT>::simplify(float targetRatio, float maxError)
+	{
+		if (!(m_attributes & Position))
+			throw std::runtime_error("BinaryMesh::simplify positions are required");
+
+		const auto stride = getAttributeElementStride(m_attributes);
+		const auto positionOffset = getAttributeElementOffset(m_attributes, Position);
+		std::vector<std::vector<IndexT>> shapeIndices(m_shapes.size());
+		std::vector<float> shapeErrors(m_shapes.size(), 0.0f);
+
+		forEachShape([&](size_t shapeIndex)
+		{
+			const auto& s = m_shapes[shapeIndex];
+			const auto indices = m_indices.data() + s.indexOffset;
+			const auto targetCount = size_t(float(s.indexCount / 3) * targetRatio) * 3;
+
+			auto& dst = shapeIndices[shapeIndex];
+			shapeErrors[shapeIndex] = bmf::simplify(dst, indices, s.indexCount,
+				m_vertices.data() + size_t(s.vertexOffset) * stride + positionOffset, s.vertexCount, stride,
+				std::max(targetCount, size_t(3)), maxError);
+
+			// shapes must not be empty
+			if (dst.empty())
+			{
+				dst.assign(indices, indices + s.indexCount);
+				shapeErrors[shapeIndex] = 0.0f;
+			}
+		});
+
+		setShapeIndices(shapeIndices);
+		// marks the shapes with removed vertices as dirty
+		removeUnusedVertices();
+
+		return *std::max_element(shapeErrors.begin(), shapeErrors.end());
+	}
+
+	template<class IndexT>
+	void ShapeBinaryMesh<IndexT>::generateLods(uint32_t numLevels, float ratioPerLevel, float maxError)
+	{
+		if (!(m_attributes & Position))
+			throw std::runtime_error("BinaryMesh::generateLods positions are required");
+
+		const auto stride = getAttributeElementStride(m_attributes);
+		const auto positionOffset = getAttributeElementOffset(m_attributes, Position);
+		// shapeLods[shape][level - 1]
+		std::vector<std::vector<std::vector<IndexT>>> shapeLods(m_shapes.size());
+		std::vector<std::vector<float>> shapeErrors(m_shapes.size());
+
+		forEachShape([&](size_t shapeIndex)
+		{
+			const auto& s = m_shapes[shapeIndex];
+			const float* positions = m_vertices.data() + size_t(s.vertexOffset) * stride + positionOffset;
+			auto& lods = shapeLods[shapeIndex];
+			auto& errors = shapeErrors[shapeIndex];
+			lods.resize(numLevels);
+			errors.resize(numLevels);
+
+			// each level is simplified from the previous level. the errors of the levels are accumulated
+			std::vector<IndexT> prev(m_indices.begin() + s.indexOffset, m_indices.begin() + s.indexOffset + s.indexCount);
+			float prevError = 0.0f;
+			for (uint32_t level = 0; level < numLevels; ++level)
+			{
+				const auto targetCount = size_t(float(prev.size() / 3) * ratioPerLevel) * 3;
+				auto& dst = lods[level];
+				const auto error = bmf::simplify(dst, prev.data(), prev.size(), positions, s.vertexCount, stride,
+					std::max(targetCount, size_t(3)), std::max(maxError - prevError, 0.0f));
+
+				// the level repeats the previous level if nothing could be simplified
+				if (dst.empty() || dst.size() == prev.size())
+				{
+					dst = prev;
+					errors[level] = prevError;
+					continue;
+				}
+
+				prevError += error;
+				errors[level] = prevError;
+				prev = dst;
+			}
+		});
+
+		// level major order => the indices of one level can be loaded at once
+		m_lods.clear();
+		m_lodIndices.clear();
+		for (uint32_t level = 0; level < numLevels; ++level)
+		{
+			for (size_t i = 0; i < m_shapes.size(); ++i)
+			{
+				const auto& indices = shapeLods[i][level];
+				m_lods.push_back(ShapeLod{ uint32_t(m_lodIndices.size()), uint32_t(indices.size()), shapeErrors[i][level] });
+				m_lodIndices.insert(m_lodIndices.end(), indices.begin(), indices.end());
+			}
 		}
-		m_vertices = std::move(newVertices);
+	}
 
-		// fix indices
-		for (auto& i : m_indices)
+	template<class IndexT>
+	void ShapeBinaryMesh<IndexT>::buildMeshlets(uint32_t maxVertices, uint32_t maxTriangles)
+	{
+		if (!(m_attributes & Position))
+			throw std::runtime_error("BinaryMesh::buildMeshlets positions are required");
+
+		const auto stride = getAttributeElementStride(m_attributes);
+		const auto positionOffset = getAttributeElementOffset(m_attributes, Position);
+		std::vector<std::vector<Meshlet>> shapeMeshlets(m_shapes.size());
+		std::vector<std::vector<IndexT>> shapeVertices(m_shapes.size());
+		std::vector<std::vector<uint8_t>> shapeTriangles(m_shapes.size());
+
+		forEachShape([&](size_t shapeIndex)
+		{
+			const auto& s = m_shapes[shapeIndex];
+			bmf::buildMeshlets(shapeMeshlets[shapeIndex], shapeVertices[shapeIndex], shapeTriangles[shapeIndex],
+				m_indices.data() + s.indexOffset, s.indexCount,
+				m_vertices.data() + size_t(s.vertexOffset) * stride + positionOffset, s.vertexCount, stride,
+				maxVertices, maxTriangles);
+		});
+
+		// meshlet ranges of the shapes are consecutive
+		m_meshlets.clear();
+		m_meshletVertices.clear();
+		m_meshletTriangles.clear();
+		m_meshletOffsets.assign(1, 0);
+		for (size_t i = 0; i < m_shapes.size(); ++i)
 		{
-			i = newIndexLookupTable[i];
+			const auto vertexOffset = uint32_t(m_meshletVertices.size());
+			const auto triangleOffset = uint32_t(m_meshletTriangles.size() / 3);
+			for (auto m : shapeMeshlets[i])
+			{
+				m.vertexOffset += vertexOffset;
+				m.triangleOffset += triangleOffset;
+				m_meshlets.push_back(m);
+			}
+			m_meshletVertices.insert(m_meshletVertices.end(), shapeVertices[i].begin(), shapeVertices[i].end());
+			m_meshletTriangles.insert(m_meshletTriangles.end(), shapeTriangles[i].begin(), shapeTriangles[i].end());
+			m_meshletOffsets.push_back(uint32_t(m_meshlets.size()));
 		}
+	}
 
-		// only vertex count changed (offset is 0 anyways)
-		m_shapes[0].vertexCount = uint32_t(m_vertices.size() / stride);
+	template <class IndexT>
+	void ShapeBinaryMesh<IndexT>::buildBvh(uint32_t maxLeafSize)
+	{
+		if (!(m_attributes & Position))
+			throw std::runtime_error("BinaryMesh::buildBvh positions are required");
+		for (const auto& s : m_shapes)
+		{
+			if (s.indexOffset % 3 != 0 || s.indexCount % 3 != 0)
+				throw std::runtime_error("BinaryMesh::buildBvh shape index ranges must be a multiple of 3");
+		}
+
+		const auto stride = getAttributeElementStride(m_attributes);
+		const auto positionOffset = getAttributeElementOffset(m_attributes, Position);
+		std::vector<std::vector<BvhNode>> shapeNodes(m_shapes.size());
+		m_bvhTriangles.resize(m_indices.size() / 3);
+
+		forEachShape([&](size_t shapeIndex)
+		{
+			const auto& s = m_shapes[shapeIndex];
+			std::vector<uint32_t> triangles;
+			buildTriangleBvh(shapeNodes[shapeIndex], triangles, m_indices.data() + s.indexOffset, s.indexCount,
+				m_vertices.data() + size_t(s.vertexOffset) * stride + positionOffset, stride, maxLeafSize);
+			std::copy(triangles.begin(), triangles.end(), m_bvhTriangles.begin() + s.indexOffset / 3);
+		});
+
+		// node ranges of the shapes are consecutive
+		m_bvhNodes.clear();
+		m_bvhOffsets.assign(1, 0);
+		for (const auto& nodes : shapeNodes)
+		{
+			m_bvhNodes.insert(m_bvhNodes.end(), nodes.begin(), nodes.end());
+			m_bvhOffsets.push_back(uint32_t(m_bvhNodes.size()));
+		}
+
+		buildTopLevelBvh();
+	}
+
+	template <class IndexT>
+	void ShapeBinaryMesh<IndexT>::generateOrientedBoundingBoxes(bool refine)
+	{
+		if (!(m_attributes & Position))
+			throw std::runtime_error("BinaryMesh::generateOrientedBoundingBoxes positions are required");
+
+		const auto stride = getAttributeElementStride(m_attributes);
+		const auto positionOffset = getAttributeElementOffset(m_attributes, Position);
+		m_orientedBoxes.resize(m_shapes.size());
+		m_orientedBoxesRefined = refine;
+		forEachShape([&](size_t shapeIndex)
+		{
+			const auto& s = m_shapes[shapeIndex];
+			m_orientedBoxes[shapeIndex] = computeOrientedBoundingBox(
+				m_vertices.data() + size_t(s.vertexOffset) * stride + positionOffset, s.vertexCount, stride, refine);
+		});
+	}
+
+	template <class IndexT>
+	void ShapeBinaryMesh<IndexT>::buildTopLevelBvh()
+	{
+		std::vector<BoundingBox> boxes;
+		boxes.reserve(m_shapes.size());
+		for (const auto& s : m_shapes)
+			boxes.push_back(s.bbox);
+
+		bmf::buildBvh(m_topLevelBvhNodes, m_topLevelBvhShapes, boxes.data(), boxes.size());
+	}
+
+	template <class IndexT>
+	bool ShapeBinaryMesh<IndexT>::intersectRay(Ray ray, RayHit& hit) const
+	{
+		expectBvh("BinaryMesh::intersectRay");
+		if (m_topLevelBvhNodes.empty()) return false;
+
+		const auto stride = getAttributeElementStride(m_attributes);
+		const auto positionOffset = getAttributeElementOffset(m_attributes, Position);
+		bool found = false;
+		traverseBvh(m_topLevelBvhNodes.data(), m_topLevelBvhShapes.data(), ray, [&](uint32_t shapeIndex, Ray& topRay)
+		{
+			const auto& s = m_shapes[shapeIndex];
+			// empty shapes have no nodes
+			if (m_bvhOffsets[shapeIndex] == m_bvhOffsets[shapeIndex + 1]) return;
+
+			const float* positions = m_vertices.data() + size_t(s.vertexOffset) * stride + positionOffset;
+			const IndexT* indices = m_indices.data() + s.indexOffset;
+			traverseBvh(m_bvhNodes.data() + m_bvhOffsets[shapeIndex], m_bvhTriangles.data() + s.indexOffset / 3, topRay,
+				[&](uint32_t triangle, Ray& shapeRay)
+			{
+				float t, u, v;
+				if (!intersectRayTriangle(shapeRay,
+					toVec3(positions + size_t(indices[triangle * 3]) * stride),
+					toVec3(positions + size_t(indices[triangle * 3 + 1]) * stride),
+					toVec3(positions + size_t(indices[triangle * 3 + 2]) * stride), t, u, v)) return;
+
+				// only closer hits are accepted from now on
+				shapeRay.tMax = t;
+				hit = RayHit{ shapeIndex, triangle, t, u, v };
+				found = true;
+			});
+		});
+		return found;
+	}
+
+	template <class IndexT>
+	void ShapeBinaryMesh<IndexT>::queryBox(const BoundingBox& box, std::vector<ShapeTriangle>& result) const
+	{
+		expectBvh("BinaryMesh::queryBox");
+		if (m_topLevelBvhNodes.empty()) return;
+
+		const auto stride = getAttributeElementStride(m_attributes);
+		const auto positionOffset = getAttributeElementOffset(m_attributes, Position);
+		queryBvh(m_topLevelBvhNodes.data(), m_topLevelBvhShapes.data(), box, [&](uint32_t shapeIndex)
+		{
+			const auto& s = m_shapes[shapeIndex];
+			if (m_bvhOffsets[shapeIndex] == m_bvhOffsets[shapeIndex + 1]) return;
+
+			const float* positions = m_vertices.data() + size_t(s.vertexOffset) * stride + positionOffset;
+			const IndexT* indices = m_indices.data() + s.indexOffset;
+			queryBvh(m_bvhNodes.data() + m_bvhOffsets[shapeIndex], m_bvhTriangles.data() + s.indexOffset / 3, box,
+				[&](uint32_t triangle)
+			{
+				if (overlapBoxTriangle(box,
+					toVec3(positions + size_t(indices[triangle * 3]) * stride),
+					toVec3(positions + size_t(indices[triangle * 3 + 1]) * stride),
+					toVec3(positions + size_t(indices[triangle * 3 + 2]) * stride)))
+					result.push_back(ShapeTriangle{ shapeIndex, triangle });
+			});
+		});
 	}
 
 	template<class IndexT>
-	void ShapeBinaryMesh<IndexT>::removeUnusedVertices()
+	VertexCacheOptimizationResult ShapeBinaryMesh<IndexT>::optimizeVertexCache(uint32_t cacheSize)
+	{
+		VertexCacheOptimizationResult res;
+		res.before = analyzeVertexCache(cacheSize);
+
+		forEachShape([this](size_t shapeIndex)
+		{
+			const auto& s = m_shapes[shapeIndex];
+			bmf::optimizeVertexCache(m_indices.data() + s.indexOffset, s.indexCount, s.vertexCount);
+		});
+		discardDerivedIndices();
+
+		res.after = analyzeVertexCache(cacheSize);
+		return res;
+	}
+
+	template<class IndexT>
+	void ShapeBinaryMesh<IndexT>::optimizeOverdraw(float threshold)
 	{
-		expectSingleShape("BinaryMesh::removeUnusedVertices");
+		if (!(m_attributes & Position))
+			throw std::runtime_error("BinaryMesh::optimizeOverdraw positions are required");
 
 		const auto stride = getAttributeElementStride(m_attributes);
-		const auto numVertices = uint32_t(m_vertices.size() / stride);
-		assert(numVertices == m_shapes[0].vertexCount);
-		std::vector<bool> used(numVertices, false);
+		const auto positionOffset = getAttributeElementOffset(m_attributes, Position);
 
-		for (auto i : m_indices)
-			used[i] = true;
+		forEachShape([&](size_t shapeIndex)
+		{
+			const auto& s = m_shapes[shapeIndex];
+			bmf::optimizeOverdraw(m_indices.data() + s.indexOffset, s.indexCount,
+				m_vertices.data() + size_t(s.vertexOffset) * stride + positionOffset, s.vertexCount, stride, threshold);
+		});
+		discardDerivedIndices();
+	}
+
+	template<class IndexT>
+	void ShapeBinaryMesh<IndexT>::optimizeVertexFetch()
+	{
+		const auto stride = getAttributeElementStride(m_attributes);
+
+		std::vector<uint8_t> changed(m_shapes.size(), 0);
+		forEachShape([&](size_t shapeIndex)
+		{
+			auto& s = m_shapes[shapeIndex];
+			const auto indices = m_indices.begin() + s.indexOffset;
+
+			std::vector<uint32_t> remap;
+			const auto numUsed = generateVertexFetchRemap(m_indices.data() + s.indexOffset, s.indexCount, s.vertexCount, remap);
+
+			// vertices are already in fetch order
+			uint32_t identity = 0;
+			while (identity < s.vertexCount && remap[identity] == identity) ++identity;
+			if (identity == s.vertexCount) return;
+			changed[shapeIndex] = 1;
+
+			// vertices are permuted => gather them in a temporary buffer
+			const auto vertices = m_vertices.begin() + size_t(s.vertexOffset) * stride;
+			std::vector<float> newVertices(size_t(numUsed) * stride);
+			for (uint32_t i = 0; i < s.vertexCount; ++i)
+			{
+				if (remap[i] == ~uint32_t(0)) continue;
+				std::copy(vertices + size_t(i) * stride, vertices + size_t(i + 1) * stride,
+					newVertices.begin() + size_t(remap[i]) * stride);
+			}
+			std::copy(newVertices.begin(), newVertices.end(), vertices);
+
+			for (auto i = indices, end = indices + s.indexCount; i != end; ++i)
+			{
+				*i = IndexT(remap[*i]);
+			}
+			s.vertexCount = numUsed;
+		});
+
+		packVertices(changed);
+	}
+
+	template<class IndexT>
+	void ShapeBinaryMesh<IndexT>::makeInstanced()
+	{
+		if (!m_instanceOffsets.empty()) return;
 
-		// create offset map
-		// find the first unused one
-		auto firstUnused = uint32_t(0);
-		while (firstUnused < numVertices && used[firstUnused])
-			++firstUnused;
+		m_instances.assign(m_shapes.size(), InstanceData(1.0f));
+		m_instanceOffsets.resize(m_shapes.size() + 1);
+		for (size_t i = 0; i < m_instanceOffsets.size(); ++i)
+			m_instanceOffsets[i] = uint32_t(i);
+	}
 
-		if (firstUnused == numVertices) return; // all vertices were used
+	template<class IndexT>
+	bool ShapeBinaryMesh<IndexT>::findInstanceTransform(const Shape& src, const Shape& dst, float epsilon,
+		InstanceData& result) const
+	{
+		if (src.materialId != dst.materialId || src.vertexCount != dst.vertexCount || src.indexCount != dst.indexCount)
+			return false;
+		if (!std::equal(m_indices.begin() + src.indexOffset, m_indices.begin() + src.indexOffset + src.indexCount,
+			m_indices.begin() + dst.indexOffset))
+			return false;
+
+		const auto stride = getAttributeElementStride(m_attributes);
+		const float* srcVertices = m_vertices.data() + size_t(src.vertexOffset) * stride;
+		const float* dstVertices = m_vertices.data() + size_t(dst.vertexOffset) * stride;
+
+		// attributes that are not affected by the transform must be equal
+		for (uint32_t a = 1; a < Attributes::SIZE; a <<= 1)
+		{
+			if (!(m_attributes & a) || a == Position || a == Normal || a == Tangent || a == BiTangent) continue;
+			const auto offset = getAttributeElementOffset(m_attributes, Attributes(a));
+			const auto count = getAttributeElementCount(Attributes(a));
+			for (uint32_t v = 0; v < src.vertexCount; ++v)
+			{
+				if (memcmp(srcVertices + size_t(v) * stride + offset, dstVertices + size_t(v) * stride + offset, count * sizeof(float)))
+					return false;
+			}
+		}
 
-		// create offset map
-		// table[a - firstUnused] = b means: the vertex that was on index a is now on index b
-		std::vector<uint32_t> newVertexIndexTable(numVertices - firstUnused);
+		const auto getSrc = [&](uint32_t v) { return toVec3(srcVertices + size_t(v) * stride); };
+		const auto getDst = [&](uint32_t v) { return toVec3(dstVertices + size_t(v) * stride); };
 
-		auto curIndex = firstUnused;
-		for (auto i = firstUnused; i < numVertices; ++i)
+		// translation: the vertex differences lie in a small box
+		glm::vec3 minDiff(std::numeric_limits<float>::max());
+		glm::vec3 maxDiff(-std::numeric_limits<float>::max());
+		for (uint32_t v = 0; v < src.vertexCount; ++v)
+		{
+			minDiff = glm::min(minDiff, getDst(v) - getSrc(v));
+			maxDiff = glm::max(maxDiff, getDst(v) - getSrc(v));
+		}
+		// the result is only written if the shapes match
+		InstanceData transform(1.0f);
+		const auto spread = maxDiff - minDiff;
+		if (glm::dot(spread, spread) <= epsilon)
 		{
-			newVertexIndexTable[i - firstUnused] = curIndex;
-			if (used[i]) ++curIndex;
+			transform[3] = glm::vec4((minDiff + maxDiff) * 0.5f, 1.0f);
+		}
+		else
+		{
+			// affine transform from 4 well spread points
+			const auto farthest = [&](auto distance)
+			{
+				uint32_t res = 0;
+				float maxDist = 0.0f;
+				for (uint32_t v = 0; v < src.vertexCount; ++v)
+				{
+					const auto d = distance(getSrc(v));
+					if (d > maxDist)
+					{
+						maxDist = d;
+						res = v;
+					}
+				}
+				return std::make_pair(res, maxDist);
+			};
+
+			const auto a = getSrc(0);
+			const auto bIndex = farthest([&](glm::vec3 p) { return glm::distance(p, a); }).first;
+			const auto b = getSrc(bIndex);
+			const auto cIndex = farthest([&](glm::vec3 p) { return glm::length(glm::cross(p - a, b - a)); }).first;
+			const auto abc = glm::cross(b - a, getSrc(cIndex) - a);
+			// collinear vertices do not define the rotation around the line
+			if (glm::length(abc) == 0.0f) return false;
+			const auto abcNormal = glm::normalize(abc);
+			const auto dIndex = farthest([&](glm::vec3 p) { return std::abs(glm::dot(p - a, abcNormal)); });
+
+			glm::vec3 srcPoints[] = { a, b, getSrc(cIndex), glm::vec3(0.0f) };
+			glm::vec3 dstPoints[] = { getDst(0), getDst(bIndex), getDst(cIndex), glm::vec3(0.0f) };
+			if (dIndex.second * dIndex.second > epsilon)
+			{
+				srcPoints[3] = getSrc(dIndex.first);
+				dstPoints[3] = getDst(dIndex.first);
+			}
+			else
+			{
+				// planar shape: a virtual point above the plane. the scale is derived from the triangle areas
+				const auto dstAbc = glm::cross(dstPoints[1] - dstPoints[0], dstPoints[2] - dstPoints[0]);
+				if (glm::length(dstAbc) == 0.0f) return false;
+				srcPoints[3] = a + abcNormal * std::sqrt(glm::length(abc));
+				dstPoints[3] = dstPoints[0] + glm::normalize(dstAbc) * std::sqrt(glm::length(dstAbc));
+			}
+
+			// solve transform * [src, 1] = dst for each row of the transform
+			Eigen::Matrix4d m;
+			for (int i = 0; i < 4; ++i)
+				m.row(i) << srcPoints[i].x, srcPoints[i].y, srcPoints[i].z, 1.0;
+			const Eigen::ColPivHouseholderQR<Eigen::Matrix4d> qr(m);
+			if (!qr.isInvertible()) return false;
+			for (int row = 0; row < 3; ++row)
+			{
+				Eigen::Vector4d rhs;
+				for (int i = 0; i < 4; ++i) rhs[i] = dstPoints[i][row];
+				const Eigen::Vector4d x = qr.solve(rhs);
+				for (int col = 0; col < 4; ++col)
+					transform[col][row] = float(x[col]);
+			}
 		}
 
-		// move vertices
-		for (size_t i = firstUnused; i < numVertices; ++i)
+		// linear part of the transform. mirrored instances would flip the triangle winding
+		Eigen::Matrix3f linear;
+		for (int row = 0; row < 3; ++row)
+			for (int col = 0; col < 3; ++col)
+				linear(row, col) = transform[col][row];
+		if (linear.determinant() <= 0.0f) return false;
+
+		for (uint32_t v = 0; v < src.vertexCount; ++v)
 		{
-			if (used[i])
-				std::copy(
-					m_vertices.begin() + i * stride,
-					m_vertices.begin() + (i + 1) * stride,
-					m_vertices.begin() + newVertexIndexTable[i - firstUnused] * stride);
+			const auto p = glm::vec3(transform * glm::vec4(getSrc(v), 1.0f));
+			const auto d = p - getDst(v);
+			if (glm::dot(d, d) > epsilon) return false;
 		}
-		m_vertices.resize(curIndex * stride);
 
-		// adjust indices
-		for (auto& i : m_indices)
+		// directions keep their length
+		const auto matchDirections = [&](Attributes attribute, const Eigen::Matrix3f& matrix)
 		{
-			if (i >= firstUnused)
+			if (!(m_attributes & attribute)) return true;
+			const auto offset = getAttributeElementOffset(m_attributes, attribute);
+			for (uint32_t v = 0; v < src.vertexCount; ++v)
 			{
-				i = newVertexIndexTable[i - firstUnused];
+				const Eigen::Vector3f srcDir = Eigen::Map<const Eigen::Vector3f>(srcVertices + size_t(v) * stride + offset);
+				const Eigen::Vector3f dstDir = Eigen::Map<const Eigen::Vector3f>(dstVertices + size_t(v) * stride + offset);
+				Eigen::Vector3f dir = matrix * srcDir;
+				if (dir.norm() != 0.0f) dir *= srcDir.norm() / dir.norm();
+				if ((dir - dstDir).squaredNorm() > epsilon) return false;
 			}
-		}
+			return true;
+		};
 
-		// only vertex count changed
-		m_shapes[0].vertexCount = uint32_t(m_vertices.size() / stride);
+		if (!matchDirections(Normal, linear.inverse().transpose()) ||
+			!matchDirections(Tangent, linear) || !matchDirections(BiTangent, linear))
+			return false;
+
+		result = transform;
+		return true;
 	}
 
 	template<class IndexT>
-	void ShapeBinaryMesh<IndexT>::generateBoundingVolumes()
+	uint32_t ShapeBinaryMesh<IndexT>::deinstanceShapes(float epsilon)
 	{
-		m_bbox = -BoundingBox::max();
-		m_sphere = getBoundingSphere(m_vertices, m_attributes);
-		for(auto& s : m_shapes)
+		if (!(m_attributes & Position))
+			throw std::runtime_error("positions are required for deinstancing");
+		updateBoundingVolumes();
+
+		const bool wasInstanced = !m_instanceOffsets.empty();
+		makeInstanced();
+
+		// candidates must have the same material and index pattern
+		std::unordered_map<size_t, std::vector<uint32_t>> groupMap;
+		for (uint32_t i = 0; i < uint32_t(m_shapes.size()); ++i)
 		{
-			s.sphere = calcBoundingSphere(s);
-			s.bbox = calcBoundingBox(s);
-			m_bbox = m_bbox.unionWith(s.bbox);
+			const auto& s = m_shapes[i];
+			size_t hash = 14695981039346656037ull;
+			const auto combine = [&hash](size_t value) { hash = (hash ^ value) * 1099511628211ull; };
+			combine(s.materialId);
+			combine(s.vertexCount);
+			combine(s.indexCount);
+			for (auto idx = m_indices.begin() + s.indexOffset, end = idx + s.indexCount; idx != end; ++idx)
+				combine(*idx);
+			groupMap[hash].push_back(i);
+		}
+		std::vector<const std::vector<uint32_t>*> groups;
+		for (const auto& g : groupMap)
+		{
+			if (g.second.size() > 1) groups.push_back(&g.second);
 		}
-	
-	}
 
-	/*void BinaryMesh::deinstanceShapes(std::vector<BinaryMesh>& meshes, float epsilon)
-	{
-		for(const auto& m : meshes)
-			m.expectSingleShape("BinaryMesh::deinstanceShapes");
+		// each shape is either kept (instanceOf[i] == i) or a transformed copy of a kept shape
+		std::vector<uint32_t> instanceOf(m_shapes.size());
+		for (uint32_t i = 0; i < uint32_t(m_shapes.size()); ++i)
+			instanceOf[i] = i;
+		std::vector<InstanceData> toShape(m_shapes.size(), InstanceData(1.0f));
 
-		auto end = meshes.end();
-		for(auto cur = meshes.begin(); cur != end; ++cur)
+		// small meshes are not worth the thread overhead
+		const auto grainSize = getNumVertices() >= ShapeParallelThreshold ? size_t(1) : groups.size();
+		parallelFor(groups.size(), grainSize, [&](size_t begin, size_t end, size_t)
 		{
-			end = std::remove_if(cur + 1, end, [&left = *cur, epsilon](const BinaryMesh& right)
+			std::vector<uint32_t> representatives;
+			for (size_t g = begin; g != end; ++g)
 			{
-				// matching attributes?
-				if (left.getAttributes() != right.getAttributes()) return false;
-				if (left.m_shapes[0].materialId != right.m_shapes[0].materialId) return false;
-				// test for same vertex/index sizes
-				if (left.m_indices.size() != right.m_indices.size()) return false;
-				if (left.m_vertices.size() != right.m_vertices.size()) return false;
-
-				// is the index pattern the same?
-				if (!std::equal(left.m_indices.begin(), left.m_indices.end(), right.m_indices.begin())) return false;
-
-				// one final check: at least four different vertices are required
-				if (left.getNumVertices() < 4) return false;
-
-				// looks good. try to recreate the transformation matrix
-				// extract points from left
-				const auto stride = getAttributeElementStride(left.getAttributes());
-				// take vertices that are not very close to each other to improve precision
-				
-				// left + translation = right
-				const float* l0 = left.m_vertices.data();
-				const float* r0 = right.m_vertices.data();
-				// determine lower and upper bound for translation for each vertex
-				glm::vec3 transMin;
-				glm::vec3 transMax;
-				transMax.x = transMin.x = r0[0] - l0[0];
-				transMax.y = transMin.y = r0[1] - l0[1];
-				transMax.z = transMin.z = r0[2] - l0[2];
-
-				// go through all vertices
-				for(const float* curLeft = left.m_vertices.data(), *curRight = right.m_vertices.data(), 
-					*end = left.m_vertices.data() + left.m_vertices.size();
-						curLeft < end; curLeft += stride, curRight += stride)
-				{
-					transMin[0] = std::min(transMin[0], curRight[0] - curLeft[0]);
-					transMin[1] = std::min(transMin[1], curRight[1] - curLeft[1]);
-					transMin[2] = std::min(transMin[2], curRight[2] - curLeft[2]);
-					transMax[0] = std::max(transMax[0], curRight[0] - curLeft[0]);
-					transMax[1] = std::max(transMax[1], curRight[1] - curLeft[1]);
-					transMax[2] = std::max(transMax[2], curRight[2] - curLeft[2]);
-				}
-
-				// if the difference between min an max is not high the translation should work
-				auto diff = transMax - transMin;
-				auto error = glm::dot(diff, diff);
-				// error too high?
-				if (error > epsilon) return false;
-
-				// this is an instance => transport instance information to left
-				left.m_shapes[0].instanceCount += right.m_shapes[0].instanceCount;
-				std::transform(right.m_instances.begin(), right.m_instances.end(), std::back_inserter(left.m_instances),
-					[trans = (transMin + transMax) / 2.0f](const glm::vec3& rightTrans)
-				{
-					return rightTrans + trans;
-				});
-				return true;
-
-				// more complex algorithm for 4x4 transforms:
-				/*const auto step = left.m_vertices.size() / stride / 4;
-
-				const float* l0 = left.m_vertices.data();
-				const float* l1 = left.m_vertices.data() + stride * step;
-				const float* l2 = left.m_vertices.data() + 2 * stride * step;
-				const float* l3 = left.m_vertices.data() + 3 * stride * step;
-				const float* r0 = right.m_vertices.data();
-				const float* r1 = right.m_vertices.data() + stride * step;
-				const float* r2 = right.m_vertices.data() + 2 * stride * step;
-				const float* r3 = right.m_vertices.data() + 3 * stride * step;
-
-				glm::mat4 transformMatrix;
-				// column major matrix
-				transformMatrix[0][3] = 0.0f;
-				transformMatrix[1][3] = 0.0f;
-				transformMatrix[2][3] = 0.0f;
-				transformMatrix[3][3] = 1.0f;
-
-				Eigen::Matrix4f mat;
-				mat <<
-					l0[0], l0[1], l0[2], 1,
-					l1[0], l1[1], l1[2], 1,
-					l2[0], l2[1], l2[2], 1,
-					l3[0], l3[1], l3[2], 1;
-				
-				// create qr decomposition
-				const Eigen::ColPivHouseholderQR<Eigen::Matrix4f> decomp(mat);
-
-				// solve linear equation to determine the transformation matrix
-				for(size_t row = 0; row < 3; ++row)
+				representatives.clear();
+				for (auto shape : *groups[g])
 				{
-					Eigen::Vector4f vec{ r0[row], r1[row], r2[row], r3[row] };
-
-					auto res = decomp.solve(vec);
-					transformMatrix[0][glm::length_t(row)] = res[0];
-					transformMatrix[1][glm::length_t(row)] = res[1];
-					transformMatrix[2][glm::length_t(row)] = res[2];
-					transformMatrix[3][glm::length_t(row)] = res[3];
+					for (auto rep : representatives)
+					{
+						if (findInstanceTransform(m_shapes[rep], m_shapes[shape], epsilon, toShape[shape]))
+						{
+							instanceOf[shape] = rep;
+							break;
+						}
+					}
+					if (instanceOf[shape] == shape) representatives.push_back(shape);
 				}
-				
-				// test if this is really the transformation matrix
-				for(size_t i = 0; i < left.m_vertices.size(); i += stride)
-				{
-					auto lpoint = toVec3(left.m_vertices.data() + i);
-					auto rpoint = toVec3(right.m_vertices.data() + i);
+			}
+		});
 
-					// transform
-					auto tpoint = transformMatrix * glm::vec4(lpoint, 1.0f);
+		// collect the instances of the kept shapes
+		std::vector<std::vector<InstanceData>> shapeInstances(m_shapes.size());
+		for (size_t i = 0; i < m_shapes.size(); ++i)
+		{
+			for (auto inst = m_instanceOffsets[i]; inst != m_instanceOffsets[i + 1]; ++inst)
+				shapeInstances[instanceOf[i]].push_back(m_instances[inst] * toShape[i]);
+		}
 
-					auto errVec = tpoint - glm::vec4(rpoint, 1.0f);
-					auto error = glm::dot(errVec, errVec); // squard error
+		// compact the buffers
+		const auto stride = getAttributeElementStride(m_attributes);
+		std::vector<float> vertices;
+		std::vector<IndexT> indices;
+		std::vector<Shape> shapes;
+		m_instances.clear();
+		m_instanceOffsets.assign(1, 0);
+		m_bbox = -BoundingBox::max();
+		for (size_t i = 0; i < m_shapes.size(); ++i)
+		{
+			if (instanceOf[i] != i) continue;
+			auto s = m_shapes[i];
+			const auto srcVertices = m_vertices.begin() + size_t(s.vertexOffset) * stride;
+			const auto srcIndices = m_indices.begin() + s.indexOffset;
+			s.vertexOffset = uint32_t(vertices.size() / stride);
+			s.indexOffset = uint32_t(indices.size());
+			vertices.insert(vertices.end(), srcVertices, srcVertices + size_t(s.vertexCount) * stride);
+			indices.insert(indices.end(), srcIndices, srcIndices + s.indexCount);
+			m_bbox = m_bbox.unionWith(s.bbox);
+			shapes.push_back(s);
 
-					// test if error is small enough
-					if (error > epsilon) return false;
-				}
+			m_instances.insert(m_instances.end(), shapeInstances[i].begin(), shapeInstances[i].end());
+			m_instanceOffsets.push_back(uint32_t(m_instances.size()));
+		}
 
-				// this is an instance => transport instance information to left
-				left.m_shapes[0].instanceCount += right.m_shapes[0].instanceCount;
-				std::transform(right.m_instances.begin(), right.m_instances.end(), std::back_inserter(left.m_instances), 
-					[&transformMatrix](const glm::mat4& mat)
-				{
-					return mat * transformMatrix;
-				});
+		const auto numRemoved = uint32_t(m_shapes.size() - shapes.size());
+		m_vertices = std::move(vertices);
+		m_indices = std::move(indices);
+		m_shapes = std::move(shapes);
+		m_sphere = getBoundingSphere(m_vertices, m_attributes);
+		discardDerivedIndices();
 
-				return true;*//*
-			});
+		if (!numRemoved && !wasInstanced)
+		{
+			m_instances.clear();
+			m_instanceOffsets.clear();
 		}
-
-		// resize meshes
-		if (end == meshes.end()) return;
-		// erase meshes that became instances of another
-		meshes.erase(end, meshes.end());
+		return numRemoved;
 	}
 
-	void BinaryMesh::centerShapes()
+	template<class IndexT>
+	void ShapeBinaryMesh<IndexT>::centerShapes()
 	{
-		expectSingleShape("BinaryMesh::centerShapes");
-
-		auto bbox = getBoundingBox(m_vertices, m_attributes);
-		
-		glm::vec3 center = { bbox.maxX + bbox.minX, bbox.maxY + bbox.minY, bbox.maxZ + bbox.minZ };
-		center /= 2.0f;
-
-		// move every vertex
+		makeInstanced();
 		const auto stride = getAttributeElementStride(m_attributes);
-		for(float* start = m_vertices.data(), *end = m_vertices.data() + m_vertices.size(); start < end; start += stride)
+
+		forEachShape([&](size_t shapeIndex)
 		{
-			start[0] -= center.x;
-			start[1] -= center.y;
-			start[2] -= center.z;
-		}
+			const auto& s = m_shapes[shapeIndex];
+			const auto bbox = calcBoundingBox(s);
+			const auto center = glm::vec3(bbox.minX + bbox.maxX, bbox.minY + bbox.maxY, bbox.minZ + bbox.maxZ) * 0.5f;
+
+			auto v = m_vertices.begin() + size_t(s.vertexOffset) * stride;
+			for (uint32_t i = 0; i < s.vertexCount; ++i, v += stride)
+			{
+				v[0] -= center.x;
+				v[1] -= center.y;
+				v[2] -= center.z;
+			}
+
+			// the instances move the shape back
+			InstanceData translation(1.0f);
+			translation[3] = glm::vec4(center, 1.0f);
+			for (auto inst = m_instanceOffsets[shapeIndex]; inst != m_instanceOffsets[shapeIndex + 1]; ++inst)
+				m_instances[inst] = m_instances[inst] * translation;
+		});
+
+		discardDerivedIndices();
+		generateBoundingVolumes();
+	}
 
-		// move instances
-		for(auto& i : m_instances)
+	template<class IndexT>
+	void ShapeBinaryMesh<IndexT>::generateBoundingVolumes()
+	{
+		m_bbox = -BoundingBox::max();
+		m_sphere = getBoundingSphere(m_vertices, m_attributes);
+		for(size_t i = 0; i < m_shapes.size(); ++i)
 		{
-			i += center;
+			auto& s = m_shapes[i];
+			s.sphere = calcBoundingSphere(s);
+			s.bbox = calcBoundingBox(s);
+			m_bbox = m_bbox.unionWith(s.bbox);
+			// the oriented box and bvh bounds are only outdated for modified shapes
+			if (isShapeDirty(i)) updateDerivedVolumes(i);
 		}
-	}*/
+		m_dirtyShapes.clear();
 
+		// the top level bvh depends on the shape bounding boxes
+		if (!m_bvhOffsets.empty()) buildTopLevelBvh();
+	}
 	BoundingBox BinaryMesh::getBoundingBox(const float* start, const float* end,
 		uint32_t attributes)
 	{
@@ -1191,7 +2757,8 @@ namespace bmf
 
 		const auto stride = getAttributeElementStride(attributes);
 
-		if (start == end || start + stride == end) return Sphere::min();
+		if (start == end) return Sphere::min();
+		if (start + stride == end) return Sphere{ toVec3(start), 0.0f };
 		// Ritter's bounding sphere algorithm
 		// 1. Pick a point x, search a point y which has the largest distance from x
 		// 2. Search a point z which has the largest distance from y. Set up an initial ball B, with its centre as the midpoint of y and z, the radius as half of the distance between y and z;
@@ -1258,74 +2825,141 @@ namespace bmf
 	template <class IndexT>
 	std::vector<ShapeBinaryMesh<uint16_t>> ShapeBinaryMesh<IndexT>::force16BitIndices()
 	{
-		expectSingleShape("BinaryMesh::force16BitIndices");
-
 		std::vector<BinaryMesh16> res;
-		res.reserve(8);
-
+		discardDerivedIndices();
 
 		const auto stride = getAttributeElementStride(m_attributes);
-		using Triangle = std::array<IndexT, 3>;
-		auto maxIndex = IndexT(std::numeric_limits<uint16_t>::max());
+		const auto maxVertices = uint32_t(std::numeric_limits<uint16_t>::max());
+
+		// indices are shape local => the mesh can be taken as is if all shapes have few vertices
+		const bool allSmall = std::all_of(m_shapes.begin(), m_shapes.end(), [maxVertices](const Shape& s)
+		{
+			return s.vertexCount <= maxVertices;
+		});
+		if (allSmall)
+		{
+			res.emplace_back(m_attributes, std::move(m_vertices),
+				std::vector<uint16_t>(m_indices.begin(), m_indices.end()), std::move(m_shapes));
+			res.back().getBoundingBox() = m_bbox;
+			res.back().getBoundingSphere() = m_sphere;
+			res.back().m_instances = std::move(m_instances);
+			res.back().m_instanceOffsets = std::move(m_instanceOffsets);
+			res.back().m_dirtyShapes = std::move(m_dirtyShapes);
+			m_indices.clear();
+			m_dirtyShapes.clear();
+			return res;
+		}
+
+		// all shapes with few vertices stay in one mesh
+		std::vector<float> smallVertices;
+		std::vector<uint16_t> smallIndices;
+		std::vector<Shape> smallShapes;
+		std::vector<uint32_t> smallShapeIndices;
+		// bigger shapes are split into chunks
+		std::vector<BinaryMesh16> chunks;
+
+		// local index of the vertices in the current chunk
+		std::vector<uint32_t> localIndex;
+		std::vector<uint32_t> chunkVertices;
+		std::vector<uint16_t> chunkIndices;
+
+		// copies the instances of the source shapes (if present)
+		const auto copyInstances = [this](BinaryMesh16& dst, const std::vector<uint32_t>& srcShapes)
+		{
+			if (m_instanceOffsets.empty()) return;
+			dst.m_instanceOffsets.assign(1, 0);
+			for (auto shape : srcShapes)
+			{
+				dst.m_instances.insert(dst.m_instances.end(), m_instances.begin() + m_instanceOffsets[shape],
+					m_instances.begin() + m_instanceOffsets[shape + 1]);
+				dst.m_instanceOffsets.push_back(uint32_t(dst.m_instances.size()));
+			}
+		};
 
-		do
+		for (uint32_t shapeIndex = 0; shapeIndex < uint32_t(m_shapes.size()); ++shapeIndex)
 		{
-			// if the number of vertices is small enough we can take the mesh as is
-			if (m_vertices.size() <= std::numeric_limits<uint16_t>::max())
+			const auto& s = m_shapes[shapeIndex];
+			const auto srcVertices = m_vertices.begin() + size_t(s.vertexOffset) * stride;
+			const auto srcIndices = m_indices.begin() + s.indexOffset;
+			if (s.vertexCount <= maxVertices)
 			{
-				res.emplace_back(m_attributes, std::move(m_vertices),
-					std::vector<uint16_t>(m_indices.begin(), m_indices.end()), std::move(m_shapes));
-				
-				if (res.size() > 1) // if this wasn't the only shape, the bounding box was invalidated
-					res.back().generateBoundingVolumes();
-				break;
+				smallShapeIndices.push_back(shapeIndex);
+				Shape dst = s;
+				dst.indexOffset = uint32_t(smallIndices.size());
+				dst.vertexOffset = uint32_t(smallVertices.size() / stride);
+				smallShapes.push_back(dst);
+				smallIndices.insert(smallIndices.end(), srcIndices, srcIndices + s.indexCount);
+				smallVertices.insert(smallVertices.end(), srcVertices, srcVertices + size_t(s.vertexCount) * stride);
+				continue;
 			}
 
-			const auto start = reinterpret_cast<Triangle*>(m_indices.data());
-			assert(m_indices.size() % 3 == 0);
-			const auto end = start + m_indices.size() / 3;
-			IndexT maxVertex = 0;
+			// triangles are added in index buffer order until the chunk has no free 16 bit index left.
+			// this keeps the locality of the index buffer (e.g. after optimizeVertexCache)
+			localIndex.assign(s.vertexCount, std::numeric_limits<uint32_t>::max());
+			const auto emitChunk = [&]()
+			{
+				std::vector<float> vertices(chunkVertices.size() * stride);
+				for (size_t i = 0; i < chunkVertices.size(); ++i)
+				{
+					std::copy(srcVertices + size_t(chunkVertices[i]) * stride, srcVertices + size_t(chunkVertices[i] + 1) * stride,
+						vertices.begin() + i * stride);
+					localIndex[chunkVertices[i]] = std::numeric_limits<uint32_t>::max();
+				}
+
+				const auto numIndices = uint32_t(chunkIndices.size());
+				const auto numVertices = uint32_t(chunkVertices.size());
+				chunks.emplace_back(m_attributes, std::move(vertices), std::move(chunkIndices),
+					std::vector<Shape>{ Shape{ 0, numIndices, 0, numVertices, s.materialId } });
+				chunks.back().generateBoundingVolumes();
+				copyInstances(chunks.back(), { shapeIndex });
+
+				chunkIndices.clear();
+				chunkVertices.clear();
+			};
 
-			// partition
-			// only use triangles with a lower index than max index
-			const auto split = std::partition(start, end, [maxIndex, &maxVertex](const Triangle& tri)
+			for (auto tri = srcIndices, end = srcIndices + s.indexCount; tri != end; tri += 3)
 			{
-				auto max = std::max({tri[0], tri[1], tri[2]});
-				if (max >= maxIndex)
-					return false;
-				
-				maxVertex = std::max(maxVertex, max);
-				return true;
-			});
-			// data for new partition
-			const auto numTriangles = split - start;
-			const auto numIndices = numTriangles * 3;
-
-			// those remain unchanged 
-			std::vector<uint16_t> newIndices;
-			newIndices.assign(m_indices.begin(), m_indices.begin() + numIndices);
-			std::vector<float> newVertices;
-			newVertices.assign(m_vertices.begin(), m_vertices.begin() + size_t(maxVertex + 1) * stride);
-
-			// add shape with only 16 bit indices
-			res.emplace_back(m_attributes, std::move(newVertices), std::move(newIndices), 
-			                 std::vector<Shape>{ Shape{
-				                 0, uint32_t(newIndices.size()), 
-				                 0, uint32_t(maxVertex + 1),
-				                 m_shapes[0].materialId, -BoundingBox::max()
-			                 }});
-			// unused vertices could be created by splitting
-			res.back().removeUnusedVertices();
-			res.back().generateBoundingVolumes();
+				uint32_t newVertices = 0;
+				for (uint32_t j = 0; j < 3; ++j)
+				{
+					// degenerate triangles may contain the same new vertex twice
+					if (localIndex[tri[j]] == std::numeric_limits<uint32_t>::max() &&
+						std::find(tri, tri + j, tri[j]) == tri + j)
+						++newVertices;
+				}
 
-			// adjust this shape so it contains only the new vertices
-			m_indices.erase(m_indices.begin(), m_indices.begin() + numIndices);
-			m_shapes[0].indexCount = uint32_t(m_indices.size());
+				if (chunkVertices.size() + newVertices > maxVertices)
+					emitChunk();
 
-			// remove all vertices that are no longer references
-			removeUnusedVertices();
-		} while (!m_vertices.empty());
+				for (uint32_t j = 0; j < 3; ++j)
+				{
+					auto& local = localIndex[tri[j]];
+					if (local == std::numeric_limits<uint32_t>::max())
+					{
+						local = uint32_t(chunkVertices.size());
+						chunkVertices.push_back(uint32_t(tri[j]));
+					}
+					chunkIndices.push_back(uint16_t(local));
+				}
+			}
+			emitChunk();
+		}
 
+		if (!smallShapes.empty())
+		{
+			res.emplace_back(m_attributes, std::move(smallVertices), std::move(smallIndices), std::move(smallShapes));
+			res.back().generateBoundingVolumes();
+			copyInstances(res.back(), smallShapeIndices);
+		}
+		std::move(chunks.begin(), chunks.end(), std::back_inserter(res));
+
+		// all data was moved to the other meshes
+		m_vertices.clear();
+		m_indices.clear();
+		m_shapes.clear();
+		m_instances.clear();
+		m_instanceOffsets.clear();
+		m_dirtyShapes.clear();
 		return res;
 	}
 #pragma endregion
@@ -1354,6 +2988,283 @@ namespace bmf
 			throw std::runtime_error(operation + " only works if a single shape is present in the mesh");
 	}
 
+	template <class IndexT>
+	void ShapeBinaryMesh<IndexT>::expectBvh(const std::string& operation) const
+	{
+		if (m_bvhOffsets.empty())
+			throw std::runtime_error(operation + " requires a bvh (see buildBvh)");
+	}
+
+#pragma region ShapeView
+	template<class IndexT>
+	ShapeView<IndexT> ShapeBinaryMesh<IndexT>::getShapeView(size_t shape) const
+	{
+		return ShapeView<IndexT>(*this, shape);
+	}
+
+	template<class IndexT>
+	ShapeView<IndexT>::ShapeView(const ShapeBinaryMesh<IndexT>& mesh, size_t shape)
+		:
+	m_shape(&mesh.getShapes().at(shape)),
+	m_attributes(mesh.getAttributes()),
+	m_stride(getAttributeElementStride(mesh.getAttributes()))
+	{
+		m_vertices = Span<const float>(mesh.getVertices().data() + size_t(m_shape->vertexOffset) * m_stride,
+			size_t(m_shape->vertexCount) * m_stride);
+		m_indices = Span<const IndexT>(mesh.getIndices().data() + m_shape->indexOffset, m_shape->indexCount);
+	}
+
+	template<class IndexT>
+	BoundingBox ShapeView<IndexT>::calcBoundingBox() const
+	{
+		return BinaryMesh::getBoundingBox(m_vertices.begin(), m_vertices.end(), m_attributes);
+	}
+
+	template<class IndexT>
+	Sphere ShapeView<IndexT>::calcBoundingSphere() const
+	{
+		return BinaryMesh::getBoundingSphere(m_vertices.begin(), m_vertices.end(), m_attributes);
+	}
+
+	template<class IndexT>
+	void ShapeView<IndexT>::verify() const
+	{
+		if (m_indices.size() % 3 != 0)
+			throw std::runtime_error("indices are not a multiple of 3");
+		for (auto i : m_indices)
+		{
+			if (i >= m_shape->vertexCount)
+				throw std::runtime_error("shape index out of range");
+		}
+	}
+
+	template class ShapeView<uint16_t>;
+	template class ShapeView<uint32_t>;
+#pragma endregion
+
 	template class ShapeBinaryMesh<uint16_t>;
 	template class ShapeBinaryMesh<uint32_t>;
+
+#pragma region MixedBinaryMesh
+	template <class IndexT>
+	MixedBinaryMesh::MixedBinaryMesh(const ShapeBinaryMesh<IndexT>& mesh)
+		:
+	BinaryMesh(mesh.getAttributes(), mesh.getVertices()),
+	m_shapes(mesh.getShapes())
+	{
+		if (!mesh.getInstanceOffsets().empty())
+			throw std::runtime_error("MixedBinaryMesh does not support instanced shapes");
+		if (mesh.hasDirtyShapes())
+			throw std::runtime_error("MixedBinaryMesh shape bounding volumes are outdated (see updateBoundingVolumes)");
+
+		m_bbox = mesh.getBoundingBox();
+		m_sphere = mesh.getBoundingSphere();
+		m_indexSizes.resize(m_shapes.size());
+
+		for (size_t i = 0; i < m_shapes.size(); ++i)
+		{
+			auto& s = m_shapes[i];
+			const auto src = mesh.getIndices().begin() + s.indexOffset;
+			const auto indexSize = s.vertexCount <= std::numeric_limits<uint16_t>::max() ? sizeof(uint16_t) : sizeof(uint32_t);
+
+			// align the shape indices to their size
+			const auto offset = (m_indexBuffer.size() + indexSize - 1) / indexSize * indexSize;
+			m_indexBuffer.resize(offset + s.indexCount * indexSize);
+			m_indexSizes[i] = uint8_t(indexSize);
+			s.indexOffset = uint32_t(offset);
+
+			if (indexSize == sizeof(uint16_t))
+				std::transform(src, src + s.indexCount, reinterpret_cast<uint16_t*>(m_indexBuffer.data() + offset),
+					[](IndexT i) { return uint16_t(i); });
+			else
+				std::copy(src, src + s.indexCount, reinterpret_cast<uint32_t*>(m_indexBuffer.data() + offset));
+		}
+	}
+
+	template <class IndexT>
+	ShapeBinaryMesh<IndexT> MixedBinaryMesh::toShapeBinaryMesh() const
+	{
+		std::vector<IndexT> indices;
+		std::vector<Shape> shapes = m_shapes;
+		for (size_t i = 0; i < shapes.size(); ++i)
+		{
+			if (shapes[i].vertexCount > std::numeric_limits<IndexT>::max())
+				throw std::runtime_error("MixedBinaryMesh::toShapeBinaryMesh shape " + std::to_string(i) +
+					" has too many vertices for the index type. use force16BitIndices() on a 32 bit mesh");
+
+			shapes[i].indexOffset = uint32_t(indices.size());
+			for (uint32_t j = 0; j < shapes[i].indexCount; ++j)
+				indices.push_back(IndexT(getIndex(i, j)));
+		}
+
+		ShapeBinaryMesh<IndexT> res(m_attributes, m_vertices, std::move(indices), std::move(shapes));
+		res.getBoundingBox() = m_bbox;
+		res.getBoundingSphere() = m_sphere;
+		return res;
+	}
+
+	uint32_t MixedBinaryMesh::getIndex(size_t shape, size_t index) const
+	{
+		const auto src = m_indexBuffer.data() + m_shapes[shape].indexOffset;
+		if (m_indexSizes[shape] == sizeof(uint16_t))
+			return reinterpret_cast<const uint16_t*>(src)[index];
+		return reinterpret_cast<const uint32_t*>(src)[index];
+	}
+
+	void MixedBinaryMesh::verify() const
+	{
+		BinaryMesh::verify();
+
+		const auto stride = getAttributeElementStride(m_attributes);
+		const auto numVertices = m_vertices.size() / stride;
+		if (m_indexSizes.size() != m_shapes.size())
+			throw std::runtime_error("index size count does not match shape count");
+
+		size_t curVertexOffset = 0;
+		size_t curShape = 0;
+		BoundingBox globalBbox = -BoundingBox::max();
+		try
+		{
+			for (const auto& s : m_shapes)
+			{
+				const auto indexSize = m_indexSizes[curShape];
+				if (indexSize != sizeof(uint16_t) && indexSize != sizeof(uint32_t))
+					throw std::runtime_error("invalid index size");
+				if (s.vertexOffset != curVertexOffset)
+					throw std::runtime_error("shape vertex offset is not tightly packed");
+				if (s.indexOffset % indexSize != 0)
+					throw std::runtime_error("shape index offset is not aligned to the index size");
+				if (s.indexCount % 3 != 0)
+					throw std::runtime_error("shape index count is not a multiple of 3");
+				if (s.indexCount == 0)
+					throw std::runtime_error("shape zero index count");
+				if (size_t(s.indexOffset) + size_t(s.indexCount) * indexSize > m_indexBuffer.size())
+					throw std::runtime_error("shape index count out of range");
+				if (s.vertexCount == 0)
+					throw std::runtime_error("shape zero vertex count");
+				if (indexSize == sizeof(uint16_t) && s.vertexCount > std::numeric_limits<uint16_t>::max())
+					throw std::runtime_error("shape vertex count bigger than index range");
+
+				uint32_t maxVertexIndex = 0;
+				for (uint32_t i = 0; i < s.indexCount; ++i)
+					maxVertexIndex = std::max(maxVertexIndex, getIndex(curShape, i));
+				if (s.vertexCount != maxVertexIndex + 1)
+					throw std::runtime_error("shape invalid vertex count");
+
+				curVertexOffset += s.vertexCount;
+				if (curVertexOffset > numVertices)
+					throw std::runtime_error("shape index out of range");
+
+				if (m_attributes & Position)
+				{
+					const auto vertices = getShapeVertices(s);
+					if (s.bbox != getBoundingBox(vertices, vertices + size_t(s.vertexCount) * stride, m_attributes))
+						throw std::runtime_error("shape bounding box not correct");
+					globalBbox = globalBbox.unionWith(s.bbox);
+					if (s.sphere != getBoundingSphere(vertices, vertices + size_t(s.vertexCount) * stride, m_attributes))
+						throw std::runtime_error("shape bounding sphere not correct");
+				}
+
+				++curShape;
+			}
+		}
+		catch (const std::runtime_error& e)
+		{
+			throw std::runtime_error(e.what() + std::string(" for shape ") + std::to_string(curShape));
+		}
+
+		if (m_shapes.empty())
+			throw std::runtime_error("no shapes");
+
+		if (m_attributes & Position)
+		{
+			if (m_bbox != globalBbox)
+				throw std::runtime_error("global bounding box not correct");
+
+			// merged meshes derive the sphere from the merged spheres => it only has to contain all vertices
+			if (!allPointsInSphere(m_vertices, m_attributes, m_sphere))
+				throw std::runtime_error("global bounding sphere not correct");
+		}
+	}
+
+	void MixedBinaryMesh::verifyBoundingVolumes() const
+	{
+		// empty => bounding box check is in overloaded verify function
+	}
+
+	void MixedBinaryMesh::generateBoundingVolumes()
+	{
+		const auto stride = getAttributeElementStride(m_attributes);
+		m_bbox = -BoundingBox::max();
+		m_sphere = getBoundingSphere(m_vertices, m_attributes);
+		for (auto& s : m_shapes)
+		{
+			const auto vertices = getShapeVertices(s);
+			s.bbox = getBoundingBox(vertices, vertices + size_t(s.vertexCount) * stride, m_attributes);
+			s.sphere = getBoundingSphere(vertices, vertices + size_t(s.vertexCount) * stride, m_attributes);
+			m_bbox = m_bbox.unionWith(s.bbox);
+		}
+	}
+
+	void MixedBinaryMesh::offsetMaterial(uint32_t offset)
+	{
+		BinaryMesh::offsetMaterial(offset);
+
+		for (auto& s : m_shapes)
+		{
+			s.materialId += offset;
+		}
+	}
+
+	void MixedBinaryMesh::sortSpatially(uint32_t /*chunkSize*/)
+	{
+		throw std::runtime_error("BinaryMesh::sortSpatially is not supported for meshes with indices");
+	}
+
+	std::string MixedBinaryMesh::getFileSignature() const
+	{
+		return "BMFMX";
+	}
+
+	void MixedBinaryMesh::writeExtendedData(std::fstream& f) const
+	{
+		// write index buffer
+		write(f, uint32_t(m_indexBuffer.size()));
+		write(f, m_indexBuffer);
+
+		// write shapes with their index sizes
+		write(f, uint32_t(m_shapes.size()));
+		write(f, m_shapes);
+		write(f, m_indexSizes);
+	}
+
+	void MixedBinaryMesh::readExtendedData(std::fstream& f)
+	{
+		// read index buffer
+		uint32_t ui32 = read<uint32_t>(f); // num index bytes
+		m_indexBuffer = read<uint8_t>(f, ui32);
+
+		// read shapes
+		ui32 = read<uint32_t>(f); // num shapes
+		m_shapes = read<Shape>(f, ui32);
+		m_indexSizes = read<uint8_t>(f, ui32);
+	}
+
+	void MixedBinaryMesh::expectIndexSize(size_t shape, size_t indexSize) const
+	{
+		if (m_indexSizes[shape] != indexSize)
+			throw std::runtime_error("MixedBinaryMesh shape " + std::to_string(shape) + " has an index size of " +
+				std::to_string(m_indexSizes[shape]) + " bytes, not " + std::to_string(indexSize));
+	}
+
+	const float* MixedBinaryMesh::getShapeVertices(const Shape& s) const
+	{
+		return m_vertices.data() + size_t(s.vertexOffset) * getAttributeElementStride(m_attributes);
+	}
+
+	template MixedBinaryMesh::MixedBinaryMesh(const ShapeBinaryMesh<uint16_t>&);
+	template MixedBinaryMesh::MixedBinaryMesh(const ShapeBinaryMesh<uint32_t>&);
+	template ShapeBinaryMesh<uint16_t> MixedBinaryMesh::toShapeBinaryMesh<uint16_t>() const;
+	template ShapeBinaryMesh<uint32_t> MixedBinaryMesh::toShapeBinaryMesh<uint32_t>() const;
+#pragma endregion
 }
\ No newline at end of file
@@ -0,0 +1,306 @@
+#include "../include/bmf/Bvh.h"
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace bmf
+{
+	namespace
+	{
+		constexpr uint32_t NumBins = 16;
+		// deeper nodes are split at the median => the depth stays below BvhMaxDepth for 2^32 primitives
+		constexpr uint32_t MaxSahDepth = BvhMaxDepth - 32;
+
+		BoundingBox emptyBox()
+		{
+			return -BoundingBox::max();
+		}
+
+		float getArea(const BoundingBox& b)
+		{
+			const float dx = b.maxX - b.minX;
+			const float dy = b.maxY - b.minY;
+			const float dz = b.maxZ - b.minZ;
+			return 2.0f * (dx * dy + dy * dz + dz * dx);
+		}
+
+		glm::vec3 getCenter(const BoundingBox& b)
+		{
+			return glm::vec3(b.minX + b.maxX, b.minY + b.maxY, b.minZ + b.maxZ) * 0.5f;
+		}
+
+		class BvhBuilder
+		{
+		public:
+			BvhBuilder(std::vector<BvhNode>& nodes, std::vector<uint32_t>& primitives,
+				const BoundingBox* boxes, size_t count, uint32_t maxLeafSize)
+				:
+			m_nodes(nodes),
+			m_primitives(primitives),
+			m_boxes(boxes),
+			m_maxLeafSize(std::max(maxLeafSize, uint32_t(1)))
+			{
+				m_centers.resize(count);
+				for (size_t i = 0; i < count; ++i)
+					m_centers[i] = getCenter(boxes[i]);
+			}
+
+			void build(uint32_t nodeIndex, uint32_t begin, uint32_t end, uint32_t depth)
+			{
+				auto bbox = emptyBox();
+				auto centerBox = emptyBox();
+				for (uint32_t i = begin; i < end; ++i)
+				{
+					bbox = bbox.unionWith(m_boxes[m_primitives[i]]);
+					const auto& c = m_centers[m_primitives[i]];
+					centerBox = centerBox.unionWith(BoundingBox{ c.x, c.y, c.z, c.x, c.y, c.z });
+				}
+				m_nodes[nodeIndex].bbox = bbox;
+
+				const auto count = end - begin;
+				if (count <= m_maxLeafSize || depth >= BvhMaxDepth)
+				{
+					m_nodes[nodeIndex].offset = begin;
+					m_nodes[nodeIndex].count = count;
+					return;
+				}
+
+				// split along the largest extent of the primitive centers
+				const float extent[] = { centerBox.maxX - centerBox.minX, centerBox.maxY - centerBox.minY, centerBox.maxZ - centerBox.minZ };
+				const int axis = int(std::max_element(extent, extent + 3) - extent);
+				const float axisMin = (&centerBox.minX)[axis];
+
+				uint32_t mid = begin;
+				if (depth < MaxSahDepth && extent[axis] > 0.0f)
+					mid = splitSah(begin, end, axis, axisMin, extent[axis]);
+
+				// median split if the sah did not separate the primitives
+				if (mid == begin || mid == end)
+				{
+					mid = begin + count / 2;
+					std::nth_element(m_primitives.begin() + begin, m_primitives.begin() + mid, m_primitives.begin() + end,
+						[&](uint32_t a, uint32_t b) { return m_centers[a][axis] < m_centers[b][axis]; });
+				}
+
+				// depth first order => the first child follows the parent
+				const auto first = uint32_t(m_nodes.size());
+				m_nodes.emplace_back();
+				build(first, begin, mid, depth + 1);
+				const auto second = uint32_t(m_nodes.size());
+				m_nodes.emplace_back();
+				build(second, mid, end, depth + 1);
+
+				m_nodes[nodeIndex].offset = second;
+				m_nodes[nodeIndex].count = 0;
+			}
+
+		private:
+			// partitions the primitives at the bin boundary with the lowest surface area cost. returns the partition point
+			uint32_t splitSah(uint32_t begin, uint32_t end, int axis, float axisMin, float axisExtent)
+			{
+				const float scale = float(NumBins) / axisExtent;
+				const auto getBin = [&](uint32_t primitive)
+				{
+					const auto bin = uint32_t((m_centers[primitive][axis] - axisMin) * scale);
+					return std::min(bin, NumBins - 1);
+				};
+
+				BoundingBox binBoxes[NumBins];
+				uint32_t binCounts[NumBins] = {};
+				std::fill(binBoxes, binBoxes + NumBins, emptyBox());
+				for (uint32_t i = begin; i < end; ++i)
+				{
+					const auto bin = getBin(m_primitives[i]);
+					binBoxes[bin] = binBoxes[bin].unionWith(m_boxes[m_primitives[i]]);
+					++binCounts[bin];
+				}
+
+				// cost of the right side for a split after bin i
+				float rightCost[NumBins] = {};
+				auto box = emptyBox();
+				uint32_t count = 0;
+				for (uint32_t i = NumBins - 1; i > 0; --i)
+				{
+					box = box.unionWith(binBoxes[i]);
+					count += binCounts[i];
+					rightCost[i - 1] = count ? getArea(box) * float(count) : 0.0f;
+				}
+
+				float bestCost = std::numeric_limits<float>::max();
+				uint32_t bestSplit = 0;
+				box = emptyBox();
+				count = 0;
+				for (uint32_t i = 0; i + 1 < NumBins; ++i)
+				{
+					box = box.unionWith(binBoxes[i]);
+					count += binCounts[i];
+					const float cost = (count ? getArea(box) * float(count) : 0.0f) + rightCost[i];
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						bestSplit = i;
+					}
+				}
+
+				const auto mid = std::partition(m_primitives.begin() + begin, m_primitives.begin() + end,
+					[&](uint32_t p) { return getBin(p) <= bestSplit; });
+				return uint32_t(mid - m_primitives.begin());
+			}
+
+			std::vector<BvhNode>& m_nodes;
+			std::vector<uint32_t>& m_primitives;
+			const BoundingBox* m_boxes;
+			std::vector<glm::vec3> m_centers;
+			uint32_t m_maxLeafSize;
+		};
+	}
+
+	void buildBvh(std::vector<BvhNode>& nodes, std::vector<uint32_t>& primitives,
+		const BoundingBox* boxes, size_t count, uint32_t maxLeafSize)
+	{
+		nodes.clear();
+		primitives.resize(count);
+		std::iota(primitives.begin(), primitives.end(), uint32_t(0));
+		if (count == 0) return;
+
+		// a binary tree has less than 2 * count nodes
+		nodes.reserve(2 * count);
+		nodes.emplace_back();
+		BvhBuilder(nodes, primitives, boxes, count, maxLeafSize).build(0, 0, uint32_t(count), 0);
+	}
+
+	template<class IndexT>
+	void buildTriangleBvh(std::vector<BvhNode>& nodes, std::vector<uint32_t>& triangles,
+		const IndexT* indices, size_t numIndices, const float* positions, size_t stride, uint32_t maxLeafSize)
+	{
+		std::vector<BoundingBox> boxes(numIndices / 3);
+		for (size_t t = 0; t < boxes.size(); ++t)
+		{
+			auto& b = boxes[t];
+			b = emptyBox();
+			for (size_t i = t * 3; i < t * 3 + 3; ++i)
+			{
+				const auto p = toVec3(positions + size_t(indices[i]) * stride);
+				b = b.unionWith(BoundingBox{ p.x, p.y, p.z, p.x, p.y, p.z });
+			}
+		}
+
+		buildBvh(nodes, triangles, boxes.data(), boxes.size(), maxLeafSize);
+	}
+
+	void verifyBvhNodes(const BvhNode* nodes, size_t numNodes, const uint32_t* primitives, size_t numPrimitives)
+	{
+		if (numNodes == 0)
+		{
+			if (numPrimitives != 0) throw std::runtime_error("bvh has primitives but no nodes");
+			return;
+		}
+
+		// every node and primitive must be reached exactly once from the root
+		std::vector<bool> primitiveSeen(numPrimitives, false);
+		size_t numVisited = 0;
+		std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0, 0 } }; // node, depth
+		while (!stack.empty())
+		{
+			const auto nodeIndex = stack.back().first;
+			const auto depth = stack.back().second;
+			stack.pop_back();
+			if (++numVisited > numNodes)
+				throw std::runtime_error("bvh contains shared nodes");
+			if (depth > BvhMaxDepth)
+				throw std::runtime_error("bvh is deeper than " + std::to_string(BvhMaxDepth));
+
+			const auto& node = nodes[nodeIndex];
+			if (node.isLeaf())
+			{
+				if (size_t(node.offset) + node.count > numPrimitives)
+					throw std::runtime_error("bvh leaf range out of range for node " + std::to_string(nodeIndex));
+				for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+				{
+					if (primitives[i] >= numPrimitives || primitiveSeen[primitives[i]])
+						throw std::runtime_error("bvh primitive out of range or referenced twice in node " + std::to_string(nodeIndex));
+					primitiveSeen[primitives[i]] = true;
+				}
+			}
+			else
+			{
+				// children come after the parent => no cycles
+				if (nodeIndex + 1 >= numNodes || node.offset <= nodeIndex + 1 || node.offset >= numNodes)
+					throw std::runtime_error("bvh child out of range for node " + std::to_string(nodeIndex));
+				stack.emplace_back(nodeIndex + 1, depth + 1);
+				stack.emplace_back(node.offset, depth + 1);
+			}
+		}
+
+		if (numVisited != numNodes)
+			throw std::runtime_error("bvh contains unreachable nodes");
+		if (std::find(primitiveSeen.begin(), primitiveSeen.end(), false) != primitiveSeen.end())
+			throw std::runtime_error("bvh does not reference all primitives");
+	}
+
+	bool intersectRayTriangle(const Ray& ray, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2,
+		float& t, float& u, float& v)
+	{
+		const auto e1 = v1 - v0;
+		const auto e2 = v2 - v0;
+		const auto p = glm::cross(ray.direction, e2);
+		const float det = glm::dot(e1, p);
+		// ray is parallel to the triangle plane
+		if (det == 0.0f) return false;
+		const float invDet = 1.0f / det;
+
+		const auto s = ray.origin - v0;
+		u = glm::dot(s, p) * invDet;
+		if (u < 0.0f || u > 1.0f) return false;
+
+		const auto q = glm::cross(s, e1);
+		v = glm::dot(ray.direction, q) * invDet;
+		if (v < 0.0f || u + v > 1.0f) return false;
+
+		t = glm::dot(e2, q) * invDet;
+		return t >= ray.tMin && t <= ray.tMax;
+	}
+
+	bool overlapBoxTriangle(const BoundingBox& box, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2)
+	{
+		// triangle relative to the box center
+		const auto center = getCenter(box);
+		const auto halfSize = glm::vec3(box.maxX - box.minX, box.maxY - box.minY, box.maxZ - box.minZ) * 0.5f;
+		const glm::vec3 v[] = { v0 - center, v1 - center, v2 - center };
+
+		const auto separated = [&](const glm::vec3& axis)
+		{
+			const float p0 = glm::dot(v[0], axis);
+			const float p1 = glm::dot(v[1], axis);
+			const float p2 = glm::dot(v[2], axis);
+			const float r = glm::dot(halfSize, glm::abs(axis));
+			return std::min({ p0, p1, p2 }) > r || std::max({ p0, p1, p2 }) < -r;
+		};
+
+		// box axes
+		const glm::vec3 boxAxes[] = { glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f) };
+		for (const auto& a : boxAxes)
+			if (separated(a)) return false;
+
+		// triangle normal
+		const glm::vec3 edges[] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+		if (separated(glm::cross(edges[0], edges[1]))) return false;
+
+		// edge cross products
+		for (const auto& e : edges)
+		{
+			for (const auto& a : boxAxes)
+			{
+				if (separated(glm::cross(a, e))) return false;
+			}
+		}
+		return true;
+	}
+
+	template void buildTriangleBvh<uint16_t>(std::vector<BvhNode>&, std::vector<uint32_t>&,
+		const uint16_t*, size_t, const float*, size_t, uint32_t);
+	template void buildTriangleBvh<uint32_t>(std::vector<BvhNode>&, std::vector<uint32_t>&,
+		const uint32_t*, size_t, const float*, size_t, uint32_t);
+}
@@ -0,0 +1,106 @@
+#include "../include/bmf/Culling.h"
+#include <cmath>
+
+namespace bmf
+{
+	Frustum Frustum::fromMatrix(const glm::mat4& viewProjection)
+	{
+		const auto& m = viewProjection;
+		const auto getRow = [&](int row)
+		{
+			return glm::vec4(m[0][row], m[1][row], m[2][row], m[3][row]);
+		};
+		const auto r0 = getRow(0);
+		const auto r1 = getRow(1);
+		const auto r2 = getRow(2);
+		const auto r3 = getRow(3);
+		const glm::vec4 planes[] = { r3 + r0, r3 - r0, r3 + r1, r3 - r1, r3 + r2, r3 - r2 };
+
+		Frustum f;
+		for (int i = 0; i < 6; ++i)
+		{
+			const auto normal = glm::vec3(planes[i].x, planes[i].y, planes[i].z);
+			const float length = glm::length(normal);
+			f.planes[i] = Plane{ normal / length, planes[i].w / length };
+		}
+		return f;
+	}
+
+	void FrustumCuller::resize(size_t count)
+	{
+		m_count = count;
+		const auto padded = (count + BatchSize - 1) / BatchSize * BatchSize;
+		for (auto v : { &m_centerX, &m_centerY, &m_centerZ, &m_radius, &m_minX, &m_minY, &m_minZ, &m_maxX, &m_maxY, &m_maxZ })
+			v->resize(padded, 0.0f);
+	}
+
+	void FrustumCuller::setBounds(size_t i, const BoundingBox& box, const Sphere& sphere)
+	{
+		m_centerX[i] = sphere.center.x;
+		m_centerY[i] = sphere.center.y;
+		m_centerZ[i] = sphere.center.z;
+		m_radius[i] = sphere.radius;
+		m_minX[i] = box.minX;
+		m_minY[i] = box.minY;
+		m_minZ[i] = box.minZ;
+		m_maxX[i] = box.maxX;
+		m_maxY[i] = box.maxY;
+		m_maxZ[i] = box.maxZ;
+	}
+
+	void FrustumCuller::cull(const Frustum& frustum, std::vector<uint32_t>& visible) const
+	{
+		// the result is compacted in place => reserve the worst case
+		const auto resultOffset = visible.size();
+		visible.resize(resultOffset + m_centerX.size());
+		uint32_t* out = visible.data() + resultOffset;
+
+		// the loops over the lanes have a fixed length and no branches => the compiler uses vector instructions
+		for (size_t batch = 0; batch < m_count; batch += BatchSize)
+		{
+			uint32_t inside[BatchSize];
+			for (uint32_t lane = 0; lane < BatchSize; ++lane)
+				inside[lane] = batch + lane < m_count;
+
+			// spheres first: cheaper and rejects most invisible elements
+			const float* cx = m_centerX.data() + batch;
+			const float* cy = m_centerY.data() + batch;
+			const float* cz = m_centerZ.data() + batch;
+			const float* r = m_radius.data() + batch;
+			for (const auto& p : frustum.planes)
+			{
+				for (uint32_t lane = 0; lane < BatchSize; ++lane)
+				{
+					const float dist = p.normal.x * cx[lane] + p.normal.y * cy[lane] + p.normal.z * cz[lane] + p.distance;
+					inside[lane] &= uint32_t(dist >= -r[lane]);
+				}
+			}
+
+			uint32_t any = 0;
+			for (uint32_t lane = 0; lane < BatchSize; ++lane)
+				any |= inside[lane];
+			if (!any) continue;
+
+			// the box corner along the plane normal is the same for all lanes => select the arrays once per plane
+			for (const auto& p : frustum.planes)
+			{
+				const float* px = (p.normal.x >= 0.0f ? m_maxX : m_minX).data() + batch;
+				const float* py = (p.normal.y >= 0.0f ? m_maxY : m_minY).data() + batch;
+				const float* pz = (p.normal.z >= 0.0f ? m_maxZ : m_minZ).data() + batch;
+				for (uint32_t lane = 0; lane < BatchSize; ++lane)
+				{
+					const float dist = p.normal.x * px[lane] + p.normal.y * py[lane] + p.normal.z * pz[lane] + p.distance;
+					inside[lane] &= uint32_t(dist >= 0.0f);
+				}
+			}
+
+			for (uint32_t lane = 0; lane < BatchSize; ++lane)
+			{
+				*out = uint32_t(batch + lane);
+				out += inside[lane];
+			}
+		}
+
+		visible.resize(out - visible.data());
+	}
+}
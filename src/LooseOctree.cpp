@@ -0,0 +1,241 @@
+#include "../include/bmf/LooseOctree.h"
+#include "../include/bmf/BinaryMesh.h"
+#include <queue>
+#include <utility>
+
+namespace bmf
+{
+	namespace
+	{
+		float getDistanceSq(const BoundingBox& box, const glm::vec3& p)
+		{
+			const float dx = std::max({ box.minX - p.x, 0.0f, p.x - box.maxX });
+			const float dy = std::max({ box.minY - p.y, 0.0f, p.y - box.maxY });
+			const float dz = std::max({ box.minZ - p.z, 0.0f, p.z - box.maxZ });
+			return dx * dx + dy * dy + dz * dz;
+		}
+
+		bool overlapsSphere(const BoundingBox& box, const Sphere& s)
+		{
+			return getDistanceSq(box, s.center) <= s.radius * s.radius;
+		}
+	}
+
+	LooseOctree::LooseOctree(const BoundingBox& bounds, uint32_t maxDepth)
+		:
+	m_maxDepth(maxDepth)
+	{
+		Node root = {};
+		root.center = glm::vec3(bounds.minX + bounds.maxX, bounds.minY + bounds.maxY, bounds.minZ + bounds.maxZ) * 0.5f;
+		root.halfSize = std::max({ bounds.maxX - bounds.minX, bounds.maxY - bounds.minY, bounds.maxZ - bounds.minZ }) * 0.5f;
+		// a single point would result in empty cells
+		if (!(root.halfSize > 0.0f)) root.halfSize = 1.0f;
+		m_nodes.push_back(root);
+	}
+
+	template<class IndexT>
+	LooseOctree LooseOctree::fromShapes(const ShapeBinaryMesh<IndexT>& mesh, uint32_t maxDepth)
+	{
+		const auto& shapes = mesh.getShapes();
+		auto bounds = -BoundingBox::max();
+		for (const auto& s : shapes)
+			bounds = bounds.unionWith(s.bbox);
+
+		LooseOctree res(shapes.empty() ? BoundingBox{} : bounds, maxDepth);
+		for (size_t i = 0; i < shapes.size(); ++i)
+			res.update(uint32_t(i), shapes[i].bbox);
+		return res;
+	}
+
+	LooseOctree LooseOctree::fromBillboards(const BinaryMesh& mesh, uint32_t maxDepth)
+	{
+		const auto attributes = mesh.getAttributes();
+		if (!(attributes & Position))
+			throw std::runtime_error("LooseOctree::fromBillboards positions are required");
+
+		const auto stride = getAttributeElementStride(attributes);
+		const int extentOffsets[] = {
+			(attributes & Width) ? int(getAttributeElementOffset(attributes, Width)) : -1,
+			(attributes & Height) ? int(getAttributeElementOffset(attributes, Height)) : -1,
+			(attributes & Depth) ? int(getAttributeElementOffset(attributes, Depth)) : -1,
+		};
+
+		const auto& vertices = mesh.getVertices();
+		const auto numVertices = vertices.size() / stride;
+		std::vector<BoundingBox> boxes(numVertices);
+		auto bounds = -BoundingBox::max();
+		for (size_t i = 0; i < numVertices; ++i)
+		{
+			const float* v = vertices.data() + i * stride;
+			float extent = 0.0f;
+			for (auto offset : extentOffsets)
+			{
+				if (offset >= 0) extent = std::max(extent, v[offset]);
+			}
+			boxes[i] = BoundingBox{ v[0] - extent, v[1] - extent, v[2] - extent, v[0] + extent, v[1] + extent, v[2] + extent };
+			bounds = bounds.unionWith(boxes[i]);
+		}
+
+		LooseOctree res(boxes.empty() ? BoundingBox{} : bounds, maxDepth);
+		for (size_t i = 0; i < boxes.size(); ++i)
+			res.update(uint32_t(i), boxes[i]);
+		return res;
+	}
+
+	void LooseOctree::update(uint32_t id, const BoundingBox& box)
+	{
+		if (m_nodes.empty())
+			throw std::runtime_error("LooseOctree::update octree was not initialized with bounds");
+
+		// find the deepest cell that contains the center and is at least as big as the box
+		const auto center = glm::vec3(box.minX + box.maxX, box.minY + box.maxY, box.minZ + box.maxZ) * 0.5f;
+		const float extent = std::max({ box.maxX - box.minX, box.maxY - box.minY, box.maxZ - box.minZ }) * 0.5f;
+		uint32_t node = 0;
+		const auto& root = m_nodes[0];
+		const auto rootOffset = glm::abs(center - root.center);
+		const bool insideRoot = std::max({ rootOffset.x, rootOffset.y, rootOffset.z }) <= root.halfSize;
+		for (uint32_t depth = 0; insideRoot && depth < m_maxDepth; ++depth)
+		{
+			const float childHalfSize = m_nodes[node].halfSize * 0.5f;
+			if (extent > childHalfSize) break;
+
+			const auto& n = m_nodes[node];
+			const uint32_t octant = (center.x >= n.center.x ? 1 : 0) | (center.y >= n.center.y ? 2 : 0) | (center.z >= n.center.z ? 4 : 0);
+			if (n.children[octant] == 0)
+			{
+				Node child = {};
+				child.halfSize = childHalfSize;
+				child.center = n.center + glm::vec3(
+					octant & 1 ? childHalfSize : -childHalfSize,
+					octant & 2 ? childHalfSize : -childHalfSize,
+					octant & 4 ? childHalfSize : -childHalfSize);
+				m_nodes[node].children[octant] = uint32_t(m_nodes.size());
+				// invalidates n
+				m_nodes.push_back(child);
+			}
+			node = m_nodes[node].children[octant];
+		}
+
+		if (id >= m_elements.size()) m_elements.resize(size_t(id) + 1);
+		auto& e = m_elements[id];
+		e.bbox = box;
+		if (e.node == node) return;
+
+		if (e.node != InvalidNode) remove(id);
+		e.node = node;
+		e.slot = uint32_t(m_nodes[node].elements.size());
+		m_nodes[node].elements.push_back(id);
+		++m_size;
+	}
+
+	void LooseOctree::remove(uint32_t id)
+	{
+		if (!contains(id)) return;
+
+		// empty nodes are kept for later insertions
+		auto& e = m_elements[id];
+		auto& list = m_nodes[e.node].elements;
+		const auto last = list.back();
+		list[e.slot] = last;
+		m_elements[last].slot = e.slot;
+		list.pop_back();
+		e.node = InvalidNode;
+		--m_size;
+	}
+
+	BoundingBox LooseOctree::getLooseBounds(uint32_t node) const
+	{
+		if (node == 0) return BoundingBox::max();
+
+		const auto& n = m_nodes[node];
+		const float s = n.halfSize * 2.0f;
+		return BoundingBox{ n.center.x - s, n.center.y - s, n.center.z - s, n.center.x + s, n.center.y + s, n.center.z + s };
+	}
+
+	template<class Visit, class Func>
+	void LooseOctree::traverse(Visit visit, Func func) const
+	{
+		if (m_nodes.empty()) return;
+
+		std::vector<uint32_t> stack = { 0 };
+		while (!stack.empty())
+		{
+			const auto node = stack.back();
+			stack.pop_back();
+			func(m_nodes[node]);
+			for (auto child : m_nodes[node].children)
+			{
+				if (child && visit(getLooseBounds(child)))
+					stack.push_back(child);
+			}
+		}
+	}
+
+	void LooseOctree::queryBox(const BoundingBox& box, std::vector<uint32_t>& result) const
+	{
+		traverse([&](const BoundingBox& bounds) { return bounds.overlappingWith(box); }, [&](const Node& node)
+		{
+			for (auto id : node.elements)
+			{
+				if (m_elements[id].bbox.overlappingWith(box))
+					result.push_back(id);
+			}
+		});
+	}
+
+	void LooseOctree::querySphere(const Sphere& sphere, std::vector<uint32_t>& result) const
+	{
+		traverse([&](const BoundingBox& bounds) { return overlapsSphere(bounds, sphere); }, [&](const Node& node)
+		{
+			for (auto id : node.elements)
+			{
+				if (overlapsSphere(m_elements[id].bbox, sphere))
+					result.push_back(id);
+			}
+		});
+	}
+
+	std::vector<uint32_t> LooseOctree::queryNearest(const glm::vec3& point, uint32_t k) const
+	{
+		using Entry = std::pair<float, uint32_t>; // squared distance, node or element id
+		// best first search: nodes ordered by the distance to their loose bounds
+		std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> nodes;
+		// the k best elements with the farthest on top
+		std::priority_queue<Entry> best;
+
+		if (!m_nodes.empty() && k > 0) nodes.emplace(0.0f, 0);
+		while (!nodes.empty())
+		{
+			const auto cur = nodes.top();
+			nodes.pop();
+			if (best.size() == k && cur.first > best.top().first) break;
+
+			const auto& node = m_nodes[cur.second];
+			for (auto id : node.elements)
+			{
+				const Entry e(getDistanceSq(m_elements[id].bbox, point), id);
+				if (best.size() < k) best.push(e);
+				else if (e < best.top())
+				{
+					best.pop();
+					best.push(e);
+				}
+			}
+			for (auto child : node.children)
+			{
+				if (child) nodes.emplace(getDistanceSq(getLooseBounds(child), point), child);
+			}
+		}
+
+		std::vector<uint32_t> res(best.size());
+		for (auto i = res.rbegin(); i != res.rend(); ++i)
+		{
+			*i = best.top().second;
+			best.pop();
+		}
+		return res;
+	}
+
+	template LooseOctree LooseOctree::fromShapes<uint16_t>(const ShapeBinaryMesh<uint16_t>&, uint32_t);
+	template LooseOctree LooseOctree::fromShapes<uint32_t>(const ShapeBinaryMesh<uint32_t>&, uint32_t);
+}
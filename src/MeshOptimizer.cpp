@@ -0,0 +1,362 @@
+#include "../include/bmf/MeshOptimizer.h"
+#include "../include/bmf/generators/glm.h"
+#include <algorithm>
+#include <cmath>
+
+namespace bmf
+{
+	namespace
+	{
+		// size of the simulated LRU cache used for scoring
+		constexpr uint32_t ForsythCacheSize = 32;
+		// triangles with more references are scored like triangles with this number of references
+		constexpr uint32_t ForsythMaxValence = 32;
+		constexpr uint32_t InvalidTriangle = ~uint32_t(0);
+
+		/// \brief scores of "Linear-Speed Vertex Cache Optimisation" (Tom Forsyth)
+		class ForsythScore
+		{
+		public:
+			ForsythScore()
+			{
+				const float CacheDecayPower = 1.5f;
+				const float LastTriangleScore = 0.75f;
+				const float ValenceBoostScale = 2.0f;
+				const float ValenceBoostPower = 0.5f;
+
+				// vertices of the last triangle get a fixed score => no preference for the order of the last triangle
+				for (uint32_t i = 0; i < ForsythCacheSize; ++i)
+					m_cache[i] = i < 3 ? LastTriangleScore
+					: std::pow(1.0f - float(i - 3) / float(ForsythCacheSize - 3), CacheDecayPower);
+
+				// vertices with few remaining triangles are preferred to avoid lonely triangles
+				m_valence[0] = 0.0f;
+				for (uint32_t i = 1; i <= ForsythMaxValence; ++i)
+					m_valence[i] = ValenceBoostScale * std::pow(float(i), -ValenceBoostPower);
+			}
+
+			/// \param cachePosition position in the LRU cache or -1 if not in the cache
+			float get(int32_t cachePosition, uint32_t remainingTriangles) const
+			{
+				if (remainingTriangles == 0) return -1.0f;
+				const float cacheScore = cachePosition >= 0 ? m_cache[cachePosition] : 0.0f;
+				return cacheScore + m_valence[std::min(remainingTriangles, ForsythMaxValence)];
+			}
+		private:
+			float m_cache[ForsythCacheSize];
+			float m_valence[ForsythMaxValence + 1];
+		};
+
+		/// \brief simulated FIFO post-transform cache
+		class FifoCache
+		{
+		public:
+			FifoCache(size_t numVertices, uint32_t cacheSize)
+				:
+			m_insertTime(numVertices, 0),
+			m_cacheSize(cacheSize),
+			m_time(cacheSize + 1)
+			{}
+
+			/// \brief returns true if the vertex was not in the cache (and inserts it)
+			bool access(uint32_t vertex)
+			{
+				// a vertex is in the cache if less than cacheSize misses happened since it was inserted
+				if (m_time - m_insertTime[vertex] <= m_cacheSize) return false;
+				m_insertTime[vertex] = m_time++;
+				return true;
+			}
+
+			/// \brief returns the number of cache misses for the triangle
+			uint32_t access(const uint32_t* triangle)
+			{
+				return uint32_t(access(triangle[0])) + uint32_t(access(triangle[1])) + uint32_t(access(triangle[2]));
+			}
+
+			/// \brief removes all vertices from the cache
+			void flush()
+			{
+				m_time += m_cacheSize + 1;
+			}
+		private:
+			std::vector<size_t> m_insertTime;
+			size_t m_cacheSize;
+			size_t m_time;
+		};
+	}
+
+	template<class IndexT>
+	VertexCacheStatistics analyzeVertexCache(const IndexT* indices, size_t numIndices, size_t numVertices,
+		uint32_t cacheSize)
+	{
+		VertexCacheStatistics res;
+		res.triangles = numIndices / 3;
+
+		FifoCache cache(numVertices, cacheSize);
+		std::vector<bool> used(numVertices, false);
+		for (size_t i = 0; i < numIndices; ++i)
+		{
+			const auto v = indices[i];
+			if (cache.access(v))
+				++res.transformedVertices;
+			if (!used[v])
+			{
+				used[v] = true;
+				++res.usedVertices;
+			}
+		}
+
+		return res;
+	}
+
+	template<class IndexT>
+	void optimizeVertexCache(IndexT* indices, size_t numIndices, size_t numVertices)
+	{
+		const auto numTriangles = uint32_t(numIndices / 3);
+		if (numTriangles == 0) return;
+		const std::vector<IndexT> src(indices, indices + numTriangles * 3);
+
+		static const ForsythScore scores;
+
+		// vertex => triangle adjacency. the first remaining[v] triangles of each vertex are not emitted yet
+		std::vector<uint32_t> remaining(numVertices, 0);
+		for (auto i : src)
+			++remaining[i];
+
+		std::vector<uint32_t> adjacencyStart(numVertices + 1, 0);
+		for (size_t v = 0; v < numVertices; ++v)
+			adjacencyStart[v + 1] = adjacencyStart[v] + remaining[v];
+
+		std::vector<uint32_t> adjacency(src.size());
+		{
+			std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+			for (uint32_t c = 0; c < uint32_t(src.size()); ++c)
+				adjacency[fill[src[c]]++] = c / 3;
+		}
+
+		// initial scores
+		std::vector<int32_t> cachePosition(numVertices, -1);
+		std::vector<float> vertexScore(numVertices);
+		for (size_t v = 0; v < numVertices; ++v)
+			vertexScore[v] = scores.get(-1, remaining[v]);
+
+		std::vector<float> triangleScore(numTriangles);
+		for (uint32_t t = 0; t < numTriangles; ++t)
+			triangleScore[t] = vertexScore[src[t * 3]] + vertexScore[src[t * 3 + 1]] + vertexScore[src[t * 3 + 2]];
+
+		std::vector<bool> emitted(numTriangles, false);
+
+		// LRU cache (3 additional entries for the vertices that are pushed out by the current triangle)
+		uint32_t cache[ForsythCacheSize + 3];
+		uint32_t newCache[ForsythCacheSize + 3];
+		uint32_t cacheCount = 0;
+
+		uint32_t bestTriangle = uint32_t(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+		// triangles in front of the cursor were emitted (fallback if no triangle in the cache is left)
+		uint32_t inputCursor = 0;
+
+		for (uint32_t outTriangle = 0; outTriangle < numTriangles; ++outTriangle)
+		{
+			if (bestTriangle == InvalidTriangle)
+			{
+				while (emitted[inputCursor]) ++inputCursor;
+				bestTriangle = inputCursor;
+			}
+
+			const auto tri = &src[bestTriangle * 3];
+			std::copy(tri, tri + 3, indices + outTriangle * 3);
+			emitted[bestTriangle] = true;
+
+			// remove the triangle from the remaining triangles of its vertices
+			for (uint32_t i = 0; i < 3; ++i)
+			{
+				const auto v = tri[i];
+				const auto begin = adjacency.begin() + adjacencyStart[v];
+				const auto end = begin + remaining[v];
+				std::iter_swap(std::find(begin, end, bestTriangle), end - 1);
+				--remaining[v];
+			}
+
+			// move the triangle vertices to the front of the cache
+			uint32_t newCount = 0;
+			for (uint32_t i = 0; i < 3; ++i)
+			{
+				if (std::find(newCache, newCache + newCount, uint32_t(tri[i])) == newCache + newCount)
+					newCache[newCount++] = tri[i];
+			}
+			for (uint32_t i = 0; i < cacheCount; ++i)
+			{
+				if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2])
+					newCache[newCount++] = cache[i];
+			}
+
+			// update scores of all vertices that were touched
+			for (uint32_t i = 0; i < newCount; ++i)
+			{
+				const auto v = newCache[i];
+				cachePosition[v] = i < ForsythCacheSize ? int32_t(i) : -1;
+				const auto score = scores.get(cachePosition[v], remaining[v]);
+				const auto delta = score - vertexScore[v];
+				vertexScore[v] = score;
+
+				for (auto a = adjacencyStart[v], end = adjacencyStart[v] + remaining[v]; a != end; ++a)
+					triangleScore[adjacency[a]] += delta;
+			}
+
+			// find the best triangle in the cache
+			cacheCount = std::min(newCount, ForsythCacheSize);
+			bestTriangle = InvalidTriangle;
+			float bestScore = -1.0f;
+			for (uint32_t i = 0; i < cacheCount; ++i)
+			{
+				const auto v = newCache[i];
+				for (auto a = adjacencyStart[v], end = adjacencyStart[v] + remaining[v]; a != end; ++a)
+				{
+					const auto t = adjacency[a];
+					if (triangleScore[t] > bestScore)
+					{
+						bestScore = triangleScore[t];
+						bestTriangle = t;
+					}
+				}
+			}
+
+			std::copy(newCache, newCache + cacheCount, cache);
+		}
+	}
+
+	template<class IndexT>
+	uint32_t generateVertexFetchRemap(const IndexT* indices, size_t numIndices, size_t numVertices,
+		std::vector<uint32_t>& remap)
+	{
+		remap.assign(numVertices, ~uint32_t(0));
+
+		uint32_t curVertex = 0;
+		for (size_t i = 0; i < numIndices; ++i)
+		{
+			auto& r = remap[indices[i]];
+			if (r == ~uint32_t(0)) r = curVertex++;
+		}
+
+		return curVertex;
+	}
+
+	template<class IndexT>
+	void optimizeOverdraw(IndexT* indices, size_t numIndices, const float* positions, size_t numVertices, size_t stride,
+		float threshold, uint32_t cacheSize)
+	{
+		const auto numTriangles = numIndices / 3;
+		if (numTriangles == 0) return;
+		const std::vector<uint32_t> src(indices, indices + numTriangles * 3);
+		FifoCache cache(numVertices, cacheSize);
+
+		// hard boundaries: all vertices of the triangle miss the cache => usually a new patch of the mesh
+		std::vector<size_t> hardClusters;
+		for (size_t t = 0; t < numTriangles; ++t)
+		{
+			if (cache.access(&src[t * 3]) == 3 || t == 0)
+				hardClusters.push_back(t);
+		}
+		hardClusters.push_back(numTriangles);
+
+		// soft boundaries: split the hard clusters as soon as the ACMR of the part (with an empty cache)
+		// is within the threshold of the ACMR of the whole cluster
+		std::vector<size_t> clusters;
+		for (size_t c = 0; c + 1 < hardClusters.size(); ++c)
+		{
+			const auto start = hardClusters[c];
+			const auto end = hardClusters[c + 1];
+
+			cache.flush();
+			uint32_t clusterMisses = 0;
+			for (auto t = start; t < end; ++t)
+				clusterMisses += cache.access(&src[t * 3]);
+			const float clusterThreshold = threshold * float(clusterMisses) / float(end - start);
+
+			clusters.push_back(start);
+			cache.flush();
+			uint32_t misses = 0;
+			uint32_t triangles = 0;
+			for (auto t = start; t < end; ++t)
+			{
+				misses += cache.access(&src[t * 3]);
+				++triangles;
+				if (float(misses) <= clusterThreshold * float(triangles))
+				{
+					clusters.push_back(t + 1);
+					cache.flush();
+					misses = 0;
+					triangles = 0;
+				}
+			}
+
+			// the last part would be inefficient (the cache was flushed) => merge it with the previous part
+			if (clusters.back() != start) clusters.pop_back();
+		}
+		clusters.push_back(numTriangles);
+		const auto numClusters = clusters.size() - 1;
+
+		const auto getPosition = [positions, stride](uint32_t v)
+		{
+			const float* p = positions + size_t(v) * stride;
+			return glm::vec3(p[0], p[1], p[2]);
+		};
+
+		glm::vec3 meshCentroid(0.0f);
+		for (auto i : src)
+			meshCentroid += getPosition(i);
+		meshCentroid /= float(src.size());
+
+		// occlusion potential: clusters that point away from the mesh center are likely to occlude other clusters
+		std::vector<float> sortKey(numClusters);
+		for (size_t c = 0; c < numClusters; ++c)
+		{
+			glm::vec3 centroid(0.0f);
+			glm::vec3 normal(0.0f);
+			float area = 0.0f;
+			for (auto t = clusters[c]; t < clusters[c + 1]; ++t)
+			{
+				const auto p0 = getPosition(src[t * 3]);
+				const auto p1 = getPosition(src[t * 3 + 1]);
+				const auto p2 = getPosition(src[t * 3 + 2]);
+				const auto n = glm::cross(p1 - p0, p2 - p0);
+				const auto triangleArea = glm::length(n);
+
+				centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+				normal += n;
+				area += triangleArea;
+			}
+			centroid *= area > 0.0f ? 1.0f / area : 0.0f;
+			const auto normalLength = glm::length(normal);
+			normal *= normalLength > 0.0f ? 1.0f / normalLength : 0.0f;
+
+			sortKey[c] = glm::dot(centroid - meshCentroid, normal);
+		}
+
+		std::vector<uint32_t> order(numClusters);
+		for (uint32_t c = 0; c < uint32_t(numClusters); ++c)
+			order[c] = c;
+		std::stable_sort(order.begin(), order.end(), [&sortKey](uint32_t a, uint32_t b)
+		{
+			return sortKey[a] > sortKey[b];
+		});
+
+		auto dst = indices;
+		for (auto c : order)
+		{
+			dst = std::transform(src.begin() + clusters[c] * 3, src.begin() + clusters[c + 1] * 3, dst, [](uint32_t i)
+			{
+				return IndexT(i);
+			});
+		}
+	}
+
+	template VertexCacheStatistics analyzeVertexCache<uint16_t>(const uint16_t*, size_t, size_t, uint32_t);
+	template VertexCacheStatistics analyzeVertexCache<uint32_t>(const uint32_t*, size_t, size_t, uint32_t);
+	template void optimizeVertexCache<uint16_t>(uint16_t*, size_t, size_t);
+	template void optimizeVertexCache<uint32_t>(uint32_t*, size_t, size_t);
+	template uint32_t generateVertexFetchRemap<uint16_t>(const uint16_t*, size_t, size_t, std::vector<uint32_t>&);
+	template uint32_t generateVertexFetchRemap<uint32_t>(const uint32_t*, size_t, size_t, std::vector<uint32_t>&);
+	template void optimizeOverdraw<uint16_t>(uint16_t*, size_t, const float*, size_t, size_t, float, uint32_t);
+	template void optimizeOverdraw<uint32_t>(uint32_t*, size_t, const float*, size_t, size_t, float, uint32_t);
+}
@@ -0,0 +1,158 @@
+#include "../include/bmf/Meshlet.h"
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace bmf
+{
+	namespace
+	{
+		constexpr uint8_t NoLocalIndex = 0xff;
+
+		// triangle normals that diverge more than this (cosine to the average) disable the normal cone
+		constexpr float MinConeDot = 0.1f;
+
+		template<class IndexT>
+		void computeMeshletBounds(Meshlet& m, const IndexT* vertices, const uint8_t* triangles,
+			const float* positions, size_t stride)
+		{
+			const auto getPosition = [&](uint32_t localIndex)
+			{
+				return toVec3(positions + size_t(vertices[localIndex]) * stride);
+			};
+
+			// bounding box and a sphere around its center
+			glm::vec3 minPos(FLT_MAX);
+			glm::vec3 maxPos(-FLT_MAX);
+			for (uint32_t i = 0; i < m.vertexCount; ++i)
+			{
+				minPos = glm::min(minPos, getPosition(i));
+				maxPos = glm::max(maxPos, getPosition(i));
+			}
+			m.bbox = BoundingBox{ minPos.x, minPos.y, minPos.z, maxPos.x, maxPos.y, maxPos.z };
+
+			m.sphere.center = (minPos + maxPos) * 0.5f;
+			float maxDistSq = 0.0f;
+			for (uint32_t i = 0; i < m.vertexCount; ++i)
+			{
+				const auto d = getPosition(i) - m.sphere.center;
+				maxDistSq = std::max(maxDistSq, glm::dot(d, d));
+			}
+			// rounded up => Sphere::isInside holds for all vertices
+			m.sphere.radius = std::nextafter(std::sqrt(maxDistSq), FLT_MAX);
+
+			// normal cone axis is the average triangle normal
+			std::vector<glm::vec3> normals(m.triangleCount, glm::vec3(0.0f));
+			glm::vec3 axis(0.0f);
+			for (uint32_t t = 0; t < m.triangleCount; ++t)
+			{
+				const auto p0 = getPosition(triangles[t * 3]);
+				const auto n = glm::cross(getPosition(triangles[t * 3 + 1]) - p0, getPosition(triangles[t * 3 + 2]) - p0);
+				const auto area = glm::length(n);
+				// degenerate triangles are never visible
+				if (area == 0.0f) continue;
+				normals[t] = n / area;
+				axis += normals[t];
+			}
+
+			m.coneApex = glm::vec3(0.0f);
+			m.coneAxis = glm::vec3(0.0f);
+			m.coneCutoff = 1.0f;
+
+			const auto axisLength = glm::length(axis);
+			if (axisLength == 0.0f) return;
+			axis /= axisLength;
+
+			float minDot = 1.0f;
+			for (const auto& n : normals)
+			{
+				if (n != glm::vec3(0.0f)) minDot = std::min(minDot, glm::dot(n, axis));
+			}
+			if (minDot <= MinConeDot) return;
+
+			// the apex is moved back along the axis until it is behind all triangle planes
+			float maxT = 0.0f;
+			for (uint32_t t = 0; t < m.triangleCount; ++t)
+			{
+				if (normals[t] == glm::vec3(0.0f)) continue;
+				const auto p0 = getPosition(triangles[t * 3]);
+				const auto dc = glm::dot(m.sphere.center - p0, normals[t]);
+				const auto dn = glm::dot(axis, normals[t]);
+				maxT = std::max(maxT, dc / dn);
+			}
+
+			m.coneApex = m.sphere.center - axis * maxT;
+			m.coneAxis = axis;
+			// sine of the cone angle: the camera must be inside the negative cone with the complementary angle
+			m.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+		}
+	}
+
+	template<class IndexT>
+	void buildMeshlets(std::vector<Meshlet>& meshlets, std::vector<IndexT>& meshletVertices,
+		std::vector<uint8_t>& meshletTriangles, const IndexT* indices, size_t numIndices,
+		const float* positions, size_t numVertices, size_t stride, uint32_t maxVertices, uint32_t maxTriangles)
+	{
+		// the local index 255 marks vertices that are not in the current meshlet
+		if (maxVertices < 3 || maxVertices > NoLocalIndex)
+			throw std::runtime_error("buildMeshlets max vertices must be between 3 and 255 but is " + std::to_string(maxVertices));
+		if (maxTriangles == 0)
+			throw std::runtime_error("buildMeshlets max triangles must not be 0");
+
+		// meshlet local index of each vertex of the current meshlet
+		std::vector<uint8_t> localIndex(numVertices, NoLocalIndex);
+
+		Meshlet cur = {};
+		cur.vertexOffset = uint32_t(meshletVertices.size());
+		cur.triangleOffset = uint32_t(meshletTriangles.size() / 3);
+
+		const auto finishMeshlet = [&]()
+		{
+			computeMeshletBounds(cur, meshletVertices.data() + cur.vertexOffset,
+				meshletTriangles.data() + size_t(cur.triangleOffset) * 3, positions, stride);
+			meshlets.push_back(cur);
+
+			for (uint32_t i = 0; i < cur.vertexCount; ++i)
+				localIndex[meshletVertices[cur.vertexOffset + i]] = NoLocalIndex;
+
+			cur = {};
+			cur.vertexOffset = uint32_t(meshletVertices.size());
+			cur.triangleOffset = uint32_t(meshletTriangles.size() / 3);
+		};
+
+		for (size_t i = 0; i + 2 < numIndices; i += 3)
+		{
+			const IndexT tri[] = { indices[i], indices[i + 1], indices[i + 2] };
+
+			uint32_t newVertices = 0;
+			for (uint32_t j = 0; j < 3; ++j)
+			{
+				// the same vertex may appear twice in degenerate triangles
+				if (localIndex[tri[j]] == NoLocalIndex && (j == 0 || tri[j] != tri[0]) && (j < 2 || tri[j] != tri[1]))
+					++newVertices;
+			}
+
+			if (cur.vertexCount + newVertices > maxVertices || cur.triangleCount == maxTriangles)
+				finishMeshlet();
+
+			for (auto v : tri)
+			{
+				if (localIndex[v] == NoLocalIndex)
+				{
+					localIndex[v] = uint8_t(cur.vertexCount++);
+					meshletVertices.push_back(v);
+				}
+				meshletTriangles.push_back(localIndex[v]);
+			}
+			++cur.triangleCount;
+		}
+
+		if (cur.triangleCount) finishMeshlet();
+	}
+
+	template void buildMeshlets<uint16_t>(std::vector<Meshlet>&, std::vector<uint16_t>&, std::vector<uint8_t>&,
+		const uint16_t*, size_t, const float*, size_t, size_t, uint32_t, uint32_t);
+	template void buildMeshlets<uint32_t>(std::vector<Meshlet>&, std::vector<uint32_t>&, std::vector<uint8_t>&,
+		const uint32_t*, size_t, const float*, size_t, size_t, uint32_t, uint32_t);
+}
@@ -0,0 +1,171 @@
+#include "../include/bmf/generators/NormalGenerator.h"
+#include "../include/bmf/generators/glm.h"
+#include <cmath>
+
+bmf::NormalGenerator::NormalGenerator(Weighting weighting, float creaseAngle)
+	:
+m_weighting(weighting),
+m_minCosAngle(std::cos(creaseAngle) - CreaseEpsilon)
+{}
+
+uint32_t bmf::NormalGenerator::getRequiredAttributes() const
+{
+	return Position;
+}
+
+uint32_t bmf::NormalGenerator::getOutputAttribute(uint32_t inAttr) const
+{
+	return inAttr | Normal;
+}
+
+void bmf::NormalGenerator::generate(uint32_t attributes, const std::vector<float>& vertices,
+	std::vector<uint32_t>& indices, std::vector<float>& outVertices) const
+{
+	const auto outAttributes = getOutputAttribute(attributes);
+	const auto stride = getAttributeElementStride(attributes);
+	const auto outStride = getAttributeElementStride(outAttributes);
+	const auto normalOffset = getAttributeElementOffset(outAttributes, Normal);
+	const auto numVertices = uint32_t(vertices.size() / stride);
+	const auto numIndices = indices.size();
+
+	const auto faces = getFaceNormals(attributes, vertices, indices);
+
+	// weight of each triangle corner
+	std::vector<float> weights(numIndices, 1.0f);
+	if (m_weighting == Weighting::Area)
+	{
+		for (size_t c = 0; c < numIndices; ++c)
+			weights[c] = faces.area[c / 3];
+	}
+	else if (m_weighting == Weighting::Angle)
+	{
+		for (size_t t = 0; t < numIndices; t += 3)
+		{
+			const glm::vec3 p[] = {
+				toVec3(&vertices[indices[t] * stride]),
+				toVec3(&vertices[indices[t + 1] * stride]),
+				toVec3(&vertices[indices[t + 2] * stride])
+			};
+			for (size_t i = 0; i < 3; ++i)
+			{
+				const auto e1 = p[(i + 1) % 3] - p[i];
+				const auto e2 = p[(i + 2) % 3] - p[i];
+				const auto lenSq = glm::dot(e1, e1) * glm::dot(e2, e2);
+				weights[t + i] = lenSq > 0.0f
+					? std::acos(std::max(-1.0f, std::min(1.0f, glm::dot(e1, e2) / std::sqrt(lenSq))))
+					: 0.0f;
+			}
+		}
+	}
+
+	// vertex => corner adjacency (corners of each vertex stay in triangle order)
+	std::vector<uint32_t> cornerStart;
+	std::vector<uint32_t> corners;
+	getVertexCorners(numVertices, indices, cornerStart, corners);
+
+	struct Group
+	{
+		// face normal that started this group (used for the crease angle test)
+		glm::vec3 reference;
+		// weighted sum of all face normals
+		glm::vec3 sum;
+		uint32_t outIndex;
+	};
+	std::vector<Group> groups;
+	groups.reserve(16);
+	outVertices.reserve(size_t(numVertices) * outStride);
+
+	for (uint32_t v = 0; v < numVertices; ++v)
+	{
+		groups.resize(0);
+
+		for (auto k = cornerStart[v], end = cornerStart[v + 1]; k != end; ++k)
+		{
+			const auto c = corners[k];
+			const auto t = c / 3;
+			const glm::vec3 n(faces.x[t], faces.y[t], faces.z[t]);
+			const bool degenerated = faces.area[t] == 0.0f;
+
+			// find a group with a similar normal
+			auto g = groups.begin();
+			for (; g != groups.end(); ++g)
+			{
+				// degenerated triangles have no normal => they fit everywhere
+				if (degenerated) break;
+				if (g->reference == glm::vec3(0.0f))
+				{
+					g->reference = n;
+					break;
+				}
+				if (glm::dot(g->reference, n) >= m_minCosAngle) break;
+			}
+
+			if (g == groups.end())
+			{
+				// start a new vertex for this group
+				const auto outIndex = uint32_t(outVertices.size() / outStride);
+				outVertices.resize(outVertices.size() + outStride);
+				const RefVertex src(attributes, const_cast<float*>(&vertices[size_t(v) * stride]));
+				RefVertex dst(outAttributes, &outVertices[size_t(outIndex) * outStride]);
+				src.copyAttributesTo(dst);
+
+				groups.push_back(Group{ n, glm::vec3(0.0f), outIndex });
+				g = groups.end() - 1;
+			}
+
+			g->sum += n * weights[c];
+			indices[c] = g->outIndex;
+		}
+
+		// write accumulated normals
+		for (const auto& g : groups)
+		{
+			const auto len = glm::length(g.sum);
+			const auto n = len > 0.0f ? g.sum / len : g.reference;
+			toFloat3(n, &outVertices[size_t(g.outIndex) * outStride + normalOffset]);
+		}
+	}
+}
+
+bmf::NormalGenerator::FaceNormals bmf::NormalGenerator::getFaceNormals(uint32_t attributes,
+	const std::vector<float>& vertices, const std::vector<uint32_t>& indices)
+{
+	const auto stride = getAttributeElementStride(attributes);
+	const auto numTriangles = indices.size() / 3;
+
+	FaceNormals res;
+	res.x.resize(numTriangles);
+	res.y.resize(numTriangles);
+	res.z.resize(numTriangles);
+	res.area.resize(numTriangles);
+
+	// gather unnormalized cross products
+	for (size_t t = 0; t < numTriangles; ++t)
+	{
+		const auto p0 = toVec3(&vertices[indices[t * 3] * stride]);
+		const auto p1 = toVec3(&vertices[indices[t * 3 + 1] * stride]);
+		const auto p2 = toVec3(&vertices[indices[t * 3 + 2] * stride]);
+
+		const auto n = glm::cross(p1 - p0, p2 - p0);
+		res.x[t] = n.x;
+		res.y[t] = n.y;
+		res.z[t] = n.z;
+	}
+
+	// normalize (branch free over contiguous arrays => can be vectorized by the compiler)
+	float* x = res.x.data();
+	float* y = res.y.data();
+	float* z = res.z.data();
+	float* area = res.area.data();
+	for (size_t t = 0; t < numTriangles; ++t)
+	{
+		const float len = std::sqrt(x[t] * x[t] + y[t] * y[t] + z[t] * z[t]);
+		const float invLen = len > 0.0f ? 1.0f / len : 0.0f;
+		x[t] *= invLen;
+		y[t] *= invLen;
+		z[t] *= invLen;
+		area[t] = 0.5f * len;
+	}
+
+	return res;
+}
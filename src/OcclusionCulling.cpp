@@ -0,0 +1,311 @@
+#include "../include/bmf/OcclusionCulling.h"
+#include "../include/bmf/BinaryMesh.h"
+#include "../include/bmf/Parallel.h"
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <string>
+
+namespace bmf
+{
+	namespace
+	{
+		// minimum number of triangles for rasterizing the tile rows in parallel
+		constexpr size_t ParallelTriangleThreshold = 1024;
+		// minimum number of boxes per thread for the visibility tests
+		constexpr size_t CullGrainSize = 1024;
+		// the box footprint covers at most MaxFootprint x MaxFootprint texels of the chosen hierarchy level
+		constexpr uint32_t MaxFootprint = 4;
+
+		// edge function: positive if p is left of the edge a -> b
+		float getEdge(float ax, float ay, float bx, float by, float px, float py)
+		{
+			return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+		}
+	}
+
+	OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height)
+		:
+	m_width(width),
+	m_height(height)
+	{
+		if (width == 0 || height == 0)
+			throw std::runtime_error("OcclusionCuller depth buffer size must not be 0");
+		m_levels.front().assign(size_t(width) * height, 1.0f);
+	}
+
+	void OcclusionCuller::clear(const glm::mat4& viewProjection)
+	{
+		m_viewProjection = viewProjection;
+		m_levels.resize(1);
+		m_levels.front().assign(size_t(m_width) * m_height, 1.0f);
+	}
+
+	template<class IndexT>
+	void OcclusionCuller::transformTriangles(const float* positions, size_t stride, const IndexT* indices, size_t numIndices,
+		const glm::mat4& transform, std::vector<ScreenVertex>& result) const
+	{
+		const auto matrix = m_viewProjection * transform;
+		for (size_t i = 0; i + 2 < numIndices; i += 3)
+		{
+			ScreenVertex tri[3];
+			bool inFront = true;
+			for (size_t j = 0; j < 3; ++j)
+			{
+				const auto p = toVec3(positions + size_t(indices[i + j]) * stride);
+				const auto clip = matrix * glm::vec4(p, 1.0f);
+				// clipping against the near plane is not required for a conservative depth buffer
+				inFront = inFront && clip.w > 0.0f && clip.z >= -clip.w;
+				if (!inFront) break;
+				tri[j].x = (clip.x / clip.w * 0.5f + 0.5f) * float(m_width);
+				tri[j].y = (clip.y / clip.w * 0.5f + 0.5f) * float(m_height);
+				tri[j].depth = clip.z / clip.w * 0.5f + 0.5f;
+			}
+			if (inFront) result.insert(result.end(), tri, tri + 3);
+		}
+	}
+
+	template<class IndexT>
+	void OcclusionCuller::rasterize(const float* positions, size_t stride, const IndexT* indices, size_t numIndices,
+		const glm::mat4& transform)
+	{
+		std::vector<ScreenVertex> vertices;
+		transformTriangles(positions, stride, indices, numIndices, transform, vertices);
+		rasterizeTriangles(vertices);
+	}
+
+	template<class IndexT>
+	void OcclusionCuller::rasterizeShapes(const ShapeBinaryMesh<IndexT>& mesh, const std::vector<uint32_t>& occluders, uint32_t lodLevel)
+	{
+		const auto attributes = mesh.getAttributes();
+		if (!(attributes & Position))
+			throw std::runtime_error("OcclusionCuller::rasterizeShapes positions are required");
+		if (lodLevel > mesh.getNumLodLevels())
+			throw std::runtime_error("OcclusionCuller::rasterizeShapes lod level " + std::to_string(lodLevel) + " not available");
+
+		const auto stride = getAttributeElementStride(attributes);
+		const auto positionOffset = getAttributeElementOffset(attributes, Position);
+		const auto& instanceOffsets = mesh.getInstanceOffsets();
+		std::vector<ScreenVertex> vertices;
+		for (auto shape : occluders)
+		{
+			if (shape >= mesh.getShapes().size())
+				throw std::runtime_error("OcclusionCuller::rasterizeShapes shape " + std::to_string(shape) + " out of range");
+
+			const auto& s = mesh.getShapes()[shape];
+			const float* positions = mesh.getVertices().data() + size_t(s.vertexOffset) * stride + positionOffset;
+			const IndexT* indices = mesh.getIndices().data() + s.indexOffset;
+			size_t numIndices = s.indexCount;
+			if (lodLevel)
+			{
+				const auto& lod = mesh.getLod(lodLevel, shape);
+				indices = mesh.getLodIndices().data() + lod.indexOffset;
+				numIndices = lod.indexCount;
+			}
+
+			if (instanceOffsets.empty())
+			{
+				transformTriangles(positions, stride, indices, numIndices, glm::mat4(1.0f), vertices);
+				continue;
+			}
+			for (auto i = instanceOffsets[shape]; i != instanceOffsets[shape + 1]; ++i)
+				transformTriangles(positions, stride, indices, numIndices, mesh.getInstanceTransforms()[i], vertices);
+		}
+		rasterizeTriangles(vertices);
+	}
+
+	void OcclusionCuller::rasterizeTriangles(const std::vector<ScreenVertex>& vertices)
+	{
+		// the tile rows are disjoint => no synchronization
+		const size_t numTriangles = vertices.size() / 3;
+		const size_t numRows = (m_height + TileSize - 1) / TileSize;
+		parallelFor(numRows, numTriangles >= ParallelTriangleThreshold ? size_t(1) : numRows, [&](size_t begin, size_t end, size_t)
+		{
+			const auto minY = uint32_t(begin * TileSize);
+			const auto maxY = uint32_t(std::min(end * TileSize, size_t(m_height)));
+			for (size_t t = 0; t < numTriangles; ++t)
+				rasterizeTriangle(vertices.data() + t * 3, minY, maxY);
+		});
+	}
+
+	void OcclusionCuller::rasterizeTriangle(const ScreenVertex* v, uint32_t minY, uint32_t maxY)
+	{
+		// counter clockwise on the screen => the edge functions are positive inside
+		float area = getEdge(v[0].x, v[0].y, v[1].x, v[1].y, v[2].x, v[2].y);
+		if (!(area != 0.0f)) return;
+		const ScreenVertex* a = &v[0];
+		const ScreenVertex* b = area > 0.0f ? &v[1] : &v[2];
+		const ScreenVertex* c = area > 0.0f ? &v[2] : &v[1];
+		area = std::abs(area);
+
+		// pixels with their center inside the triangle bounds
+		const auto clampRange = [](float lo, float hi, uint32_t rangeBegin, uint32_t rangeEnd, uint32_t& first, uint32_t& last)
+		{
+			const float f = std::max(std::ceil(lo - 0.5f), float(rangeBegin));
+			const float l = std::min(std::floor(hi - 0.5f), float(rangeEnd) - 1.0f);
+			if (!(f <= l)) return false;
+			first = uint32_t(f);
+			last = uint32_t(l);
+			return true;
+		};
+		uint32_t x0, x1, y0, y1;
+		if (!clampRange(std::min({ a->x, b->x, c->x }), std::max({ a->x, b->x, c->x }), 0, m_width, x0, x1)) return;
+		if (!clampRange(std::min({ a->y, b->y, c->y }), std::max({ a->y, b->y, c->y }), minY, maxY, y0, y1)) return;
+
+		auto& depth = m_levels.front();
+		const float invArea = 1.0f / area;
+		for (uint32_t y = y0; y <= y1; ++y)
+		{
+			const float py = float(y) + 0.5f;
+			float* row = depth.data() + size_t(y) * m_width;
+			// fixed length chunks without branches => vector instructions
+			for (uint32_t x = x0; x <= x1; x += TileSize)
+			{
+				const uint32_t count = std::min(TileSize, x1 + 1 - x);
+				for (uint32_t lane = 0; lane < count; ++lane)
+				{
+					const float px = float(x + lane) + 0.5f;
+					const float wa = getEdge(b->x, b->y, c->x, c->y, px, py);
+					const float wb = getEdge(c->x, c->y, a->x, a->y, px, py);
+					const float wc = getEdge(a->x, a->y, b->x, b->y, px, py);
+					const float d = (wa * a->depth + wb * b->depth + wc * c->depth) * invArea;
+					const bool inside = wa >= 0.0f && wb >= 0.0f && wc >= 0.0f;
+					row[x + lane] = inside && d < row[x + lane] ? d : row[x + lane];
+				}
+			}
+		}
+	}
+
+	void OcclusionCuller::buildHierarchy()
+	{
+		m_levels.resize(1);
+		uint32_t width = m_width;
+		uint32_t height = m_height;
+		while (width > 1 || height > 1)
+		{
+			const uint32_t nextWidth = (width + 1) / 2;
+			const uint32_t nextHeight = (height + 1) / 2;
+			const auto& src = m_levels.back();
+			std::vector<float> dst(size_t(nextWidth) * nextHeight);
+			for (uint32_t y = 0; y < nextHeight; ++y)
+			{
+				const uint32_t y1 = std::min(y * 2 + 1, height - 1);
+				for (uint32_t x = 0; x < nextWidth; ++x)
+				{
+					const uint32_t x1 = std::min(x * 2 + 1, width - 1);
+					dst[size_t(y) * nextWidth + x] = std::max({
+						src[size_t(y * 2) * width + x * 2], src[size_t(y * 2) * width + x1],
+						src[size_t(y1) * width + x * 2], src[size_t(y1) * width + x1] });
+				}
+			}
+			m_levels.push_back(std::move(dst));
+			width = nextWidth;
+			height = nextHeight;
+		}
+	}
+
+	bool OcclusionCuller::isOccluded(const BoundingBox& box) const
+	{
+		return isOccluded(box, m_viewProjection);
+	}
+
+	bool OcclusionCuller::isOccluded(const BoundingBox& box, const glm::mat4& clipTransform) const
+	{
+		if (m_width == 0) return false;
+
+		float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+		float minDepth = FLT_MAX;
+		for (int i = 0; i < 8; ++i)
+		{
+			const auto corner = glm::vec3(i & 1 ? box.maxX : box.minX, i & 2 ? box.maxY : box.minY, i & 4 ? box.maxZ : box.minZ);
+			const auto clip = clipTransform * glm::vec4(corner, 1.0f);
+			// boxes that reach the near plane are never occluded
+			if (!(clip.w > 0.0f && clip.z >= -clip.w)) return false;
+			const float x = (clip.x / clip.w * 0.5f + 0.5f) * float(m_width);
+			const float y = (clip.y / clip.w * 0.5f + 0.5f) * float(m_height);
+			minX = std::min(minX, x);
+			maxX = std::max(maxX, x);
+			minY = std::min(minY, y);
+			maxY = std::max(maxY, y);
+			minDepth = std::min(minDepth, clip.z / clip.w * 0.5f + 0.5f);
+		}
+
+		// outside of the screen (frustum culling is not done here)
+		if (maxX < 0.0f || maxY < 0.0f || minX >= float(m_width) || minY >= float(m_height)) return false;
+
+		// all pixels that overlap with the screen rectangle of the box
+		uint32_t x0 = uint32_t(std::max(minX, 0.0f));
+		uint32_t y0 = uint32_t(std::max(minY, 0.0f));
+		uint32_t x1 = uint32_t(std::min(maxX, float(m_width - 1)));
+		uint32_t y1 = uint32_t(std::min(maxY, float(m_height - 1)));
+
+		// coarsest level where the footprint is small
+		size_t level = 0;
+		uint32_t width = m_width;
+		while (level + 1 < m_levels.size() && std::max(x1 - x0, y1 - y0) >= MaxFootprint)
+		{
+			++level;
+			width = (width + 1) / 2;
+			x0 /= 2; y0 /= 2; x1 /= 2; y1 /= 2;
+		}
+
+		const auto& depth = m_levels[level];
+		for (uint32_t y = y0; y <= y1; ++y)
+		{
+			for (uint32_t x = x0; x <= x1; ++x)
+			{
+				if (depth[size_t(y) * width + x] >= minDepth) return false;
+			}
+		}
+		return true;
+	}
+
+	void OcclusionCuller::cull(const std::vector<BoundingBox>& boxes, std::vector<uint32_t>& visible) const
+	{
+		std::vector<uint8_t> isVisible(boxes.size());
+		parallelFor(boxes.size(), CullGrainSize, [&](size_t begin, size_t end, size_t)
+		{
+			for (size_t i = begin; i != end; ++i)
+				isVisible[i] = !isOccluded(boxes[i]);
+		});
+
+		for (size_t i = 0; i < boxes.size(); ++i)
+		{
+			if (isVisible[i]) visible.push_back(uint32_t(i));
+		}
+	}
+
+	template<class IndexT>
+	void OcclusionCuller::cullShapes(const ShapeBinaryMesh<IndexT>& mesh, std::vector<uint32_t>& visible) const
+	{
+		const auto& shapes = mesh.getShapes();
+		const auto& instanceOffsets = mesh.getInstanceOffsets();
+		const auto& instances = mesh.getInstanceTransforms();
+		std::vector<uint8_t> isVisible(shapes.size());
+		parallelFor(shapes.size(), CullGrainSize, [&](size_t begin, size_t end, size_t)
+		{
+			for (size_t i = begin; i != end; ++i)
+			{
+				if (instanceOffsets.empty())
+				{
+					isVisible[i] = !isOccluded(shapes[i].bbox);
+					continue;
+				}
+				for (auto inst = instanceOffsets[i]; inst != instanceOffsets[i + 1] && !isVisible[i]; ++inst)
+					isVisible[i] = !isOccluded(shapes[i].bbox, m_viewProjection * instances[inst]);
+			}
+		});
+
+		for (size_t i = 0; i < shapes.size(); ++i)
+		{
+			if (isVisible[i]) visible.push_back(uint32_t(i));
+		}
+	}
+
+	template void OcclusionCuller::rasterize<uint16_t>(const float*, size_t, const uint16_t*, size_t, const glm::mat4&);
+	template void OcclusionCuller::rasterize<uint32_t>(const float*, size_t, const uint32_t*, size_t, const glm::mat4&);
+	template void OcclusionCuller::rasterizeShapes<uint16_t>(const ShapeBinaryMesh<uint16_t>&, const std::vector<uint32_t>&, uint32_t);
+	template void OcclusionCuller::rasterizeShapes<uint32_t>(const ShapeBinaryMesh<uint32_t>&, const std::vector<uint32_t>&, uint32_t);
+	template void OcclusionCuller::cullShapes<uint16_t>(const ShapeBinaryMesh<uint16_t>&, std::vector<uint32_t>&) const;
+	template void OcclusionCuller::cullShapes<uint32_t>(const ShapeBinaryMesh<uint32_t>&, std::vector<uint32_t>&) const;
+}
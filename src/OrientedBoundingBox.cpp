@@ -0,0 +1,189 @@
+#include "../include/bmf/OrientedBoundingBox.h"
+#include "../dependencies/eigen/Eigen/Dense"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace bmf
+{
+	namespace
+	{
+		// rotation angles that are tried around each axis during the refinement.
+		// each iteration searches around the best rotation of the previous iteration with a finer step
+		constexpr int NumRefineAngles = 16;
+		constexpr int NumRefineIterations = 4;
+		// dot products above this are considered parallel in the separating axis test
+		constexpr float ParallelEpsilon = 1e-6f;
+
+		// smallest box with the given axes that contains the points
+		OrientedBoundingBox fitBox(const float* positions, size_t count, size_t stride, const glm::vec3* axes)
+		{
+			glm::vec3 minProj(FLT_MAX);
+			glm::vec3 maxProj(-FLT_MAX);
+			for (size_t i = 0; i < count; ++i)
+			{
+				const auto p = toVec3(positions + i * stride);
+				const auto proj = glm::vec3(glm::dot(p, axes[0]), glm::dot(p, axes[1]), glm::dot(p, axes[2]));
+				minProj = glm::min(minProj, proj);
+				maxProj = glm::max(maxProj, proj);
+			}
+
+			OrientedBoundingBox res;
+			const auto mid = (minProj + maxProj) * 0.5f;
+			res.center = axes[0] * mid.x + axes[1] * mid.y + axes[2] * mid.z;
+			std::copy(axes, axes + 3, res.axes);
+			res.halfSize = (maxProj - minProj) * 0.5f;
+			return res;
+		}
+
+		// the surface area decides between flat boxes with zero volume
+		bool isSmaller(const OrientedBoundingBox& a, const OrientedBoundingBox& b)
+		{
+			const auto getArea = [](const glm::vec3& h) { return h.x * h.y + h.y * h.z + h.z * h.x; };
+			if (a.getVolume() != b.getVolume()) return a.getVolume() < b.getVolume();
+			return getArea(a.halfSize) < getArea(b.halfSize);
+		}
+	}
+
+	bool OrientedBoundingBox::overlappingWith(const OrientedBoundingBox& o) const
+	{
+		// rotation from o into this frame
+		float r[3][3];
+		float absR[3][3];
+		for (int i = 0; i < 3; ++i)
+		{
+			for (int j = 0; j < 3; ++j)
+			{
+				r[i][j] = glm::dot(axes[i], o.axes[j]);
+				// the epsilon avoids false separation for (nearly) parallel edges with a zero cross product
+				absR[i][j] = std::abs(r[i][j]) + ParallelEpsilon;
+			}
+		}
+
+		const auto d = o.center - center;
+		const float t[] = { glm::dot(d, axes[0]), glm::dot(d, axes[1]), glm::dot(d, axes[2]) };
+		const auto& a = halfSize;
+		const auto& b = o.halfSize;
+
+		// axes of this box
+		for (int i = 0; i < 3; ++i)
+		{
+			if (std::abs(t[i]) > a[i] + b[0] * absR[i][0] + b[1] * absR[i][1] + b[2] * absR[i][2]) return false;
+		}
+		// axes of the other box
+		for (int j = 0; j < 3; ++j)
+		{
+			const float tj = t[0] * r[0][j] + t[1] * r[1][j] + t[2] * r[2][j];
+			if (std::abs(tj) > b[j] + a[0] * absR[0][j] + a[1] * absR[1][j] + a[2] * absR[2][j]) return false;
+		}
+		// cross products of the axes
+		for (int i = 0; i < 3; ++i)
+		{
+			const int i1 = (i + 1) % 3;
+			const int i2 = (i + 2) % 3;
+			for (int j = 0; j < 3; ++j)
+			{
+				const int j1 = (j + 1) % 3;
+				const int j2 = (j + 2) % 3;
+				const float ra = a[i1] * absR[i2][j] + a[i2] * absR[i1][j];
+				const float rb = b[j1] * absR[i][j2] + b[j2] * absR[i][j1];
+				if (std::abs(t[i2] * r[i1][j] - t[i1] * r[i2][j]) > ra + rb) return false;
+			}
+		}
+		return true;
+	}
+
+	BoundingBox OrientedBoundingBox::getBoundingBox() const
+	{
+		const auto extent = glm::vec3(
+			getProjectedRadius(glm::vec3(1.0f, 0.0f, 0.0f)),
+			getProjectedRadius(glm::vec3(0.0f, 1.0f, 0.0f)),
+			getProjectedRadius(glm::vec3(0.0f, 0.0f, 1.0f)));
+		return BoundingBox{
+			center.x - extent.x, center.y - extent.y, center.z - extent.z,
+			center.x + extent.x, center.y + extent.y, center.z + extent.z
+		};
+	}
+
+	OrientedBoundingBox OrientedBoundingBox::fromBoundingBox(const BoundingBox& box)
+	{
+		OrientedBoundingBox res;
+		res.center = glm::vec3(box.minX + box.maxX, box.minY + box.maxY, box.minZ + box.maxZ) * 0.5f;
+		res.axes[0] = glm::vec3(1.0f, 0.0f, 0.0f);
+		res.axes[1] = glm::vec3(0.0f, 1.0f, 0.0f);
+		res.axes[2] = glm::vec3(0.0f, 0.0f, 1.0f);
+		res.halfSize = glm::vec3(box.maxX - box.minX, box.maxY - box.minY, box.maxZ - box.minZ) * 0.5f;
+		return res;
+	}
+
+	OrientedBoundingBox computeOrientedBoundingBox(const float* positions, size_t count, size_t stride, bool refine)
+	{
+		const glm::vec3 identity[] = { glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f) };
+		if (count == 0)
+		{
+			OrientedBoundingBox res;
+			res.center = glm::vec3(0.0f);
+			std::copy(identity, identity + 3, res.axes);
+			res.halfSize = glm::vec3(0.0f);
+			return res;
+		}
+
+		// covariance of the points (double precision for big coordinates)
+		Eigen::Vector3d mean = Eigen::Vector3d::Zero();
+		for (size_t i = 0; i < count; ++i)
+			mean += Eigen::Map<const Eigen::Vector3f>(positions + i * stride).cast<double>();
+		mean /= double(count);
+
+		Eigen::Matrix3d covariance = Eigen::Matrix3d::Zero();
+		for (size_t i = 0; i < count; ++i)
+		{
+			const Eigen::Vector3d d = Eigen::Map<const Eigen::Vector3f>(positions + i * stride).cast<double>() - mean;
+			covariance += d * d.transpose();
+		}
+
+		// the eigenvectors are the principal axes
+		const Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(covariance);
+		const Eigen::Matrix3d vectors = solver.eigenvectors();
+		glm::vec3 axes[3];
+		for (int i = 0; i < 2; ++i)
+			axes[i] = glm::normalize(glm::vec3(float(vectors(0, 2 - i)), float(vectors(1, 2 - i)), float(vectors(2, 2 - i))));
+		axes[2] = glm::normalize(glm::cross(axes[0], axes[1]));
+		axes[1] = glm::cross(axes[2], axes[0]);
+
+		auto best = fitBox(positions, count, stride, axes);
+		if (!refine) return best;
+
+		// the axis aligned box is better for some symmetric inputs
+		const auto aligned = fitBox(positions, count, stride, identity);
+		if (isSmaller(aligned, best)) best = aligned;
+
+		// a quarter turn maps the box onto itself => the first iteration covers +-45 degrees
+		float range = 0.785398163f;
+		for (int iteration = 0; iteration < NumRefineIterations; ++iteration)
+		{
+			const float angleStep = range / float(NumRefineAngles / 2);
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				const auto start = best;
+				const auto& u = start.axes[(axis + 1) % 3];
+				const auto& v = start.axes[(axis + 2) % 3];
+				for (int step = -NumRefineAngles / 2; step <= NumRefineAngles / 2; ++step)
+				{
+					if (step == 0) continue;
+					const float angle = float(step) * angleStep;
+					const float c = std::cos(angle);
+					const float s = std::sin(angle);
+					glm::vec3 rotated[3];
+					rotated[axis] = start.axes[axis];
+					rotated[(axis + 1) % 3] = u * c + v * s;
+					rotated[(axis + 2) % 3] = v * c - u * s;
+
+					const auto candidate = fitBox(positions, count, stride, rotated);
+					if (isSmaller(candidate, best)) best = candidate;
+				}
+			}
+			range = angleStep;
+		}
+		return best;
+	}
+}
@@ -0,0 +1,296 @@
+#include "../include/bmf/PointCloudHierarchy.h"
+#include "../include/bmf/BinaryMesh.h"
+#include <queue>
+#include <cmath>
+#include <cstring>
+
+namespace bmf
+{
+	namespace
+	{
+		const char* const PointCloudSignature = "BMFPC";
+		constexpr uint32_t PointCloudVersion = 1;
+		// 10 bits per axis in the morton codes
+		constexpr uint32_t MaxPointCloudLevel = 10;
+
+		template<class T>
+		void writeValue(std::ofstream& stream, const T& value)
+		{
+			stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+		}
+
+		template<class T>
+		T readValue(std::ifstream& stream)
+		{
+			T value;
+			stream.read(reinterpret_cast<char*>(&value), sizeof(T));
+			return value;
+		}
+
+		uint64_t alignUp(uint64_t value, uint64_t alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		// size of the signature, version, attributes, page size and node count
+		uint64_t getHeaderSize()
+		{
+			return strlen(PointCloudSignature) + 1 + 4 * sizeof(uint32_t);
+		}
+
+		float getDistance(const BoundingBox& box, const glm::vec3& p)
+		{
+			const auto d = glm::max(glm::max(glm::vec3(box.minX, box.minY, box.minZ) - p, p - glm::vec3(box.maxX, box.maxY, box.maxZ)), glm::vec3(0.0f));
+			return glm::length(d);
+		}
+
+		float getDiagonal(const BoundingBox& box)
+		{
+			return glm::length(glm::vec3(box.maxX - box.minX, box.maxY - box.minY, box.maxZ - box.minZ));
+		}
+	}
+
+	void writePointCloudHierarchy(const BinaryMesh& mesh, const std::string& filename, uint32_t maxNodePoints, uint32_t pageSize)
+	{
+		const auto attributes = mesh.getAttributes();
+		if (!(attributes & Position))
+			throw std::runtime_error("writePointCloudHierarchy positions are required");
+		if (maxNodePoints == 0 || pageSize == 0)
+			throw std::runtime_error("writePointCloudHierarchy node size and page size must not be 0");
+
+		const auto stride = getAttributeElementStride(attributes);
+		const auto& vertices = mesh.getVertices();
+		const auto numVertices = vertices.size() / stride;
+		const int extentOffsets[] = {
+			(attributes & Width) ? int(getAttributeElementOffset(attributes, Width)) : -1,
+			(attributes & Height) ? int(getAttributeElementOffset(attributes, Height)) : -1,
+			(attributes & Depth) ? int(getAttributeElementOffset(attributes, Depth)) : -1,
+		};
+
+		// morton codes in a cube => the octants of each level are contiguous ranges of the sorted codes
+		auto cube = -BoundingBox::max();
+		for (size_t i = 0; i < numVertices; ++i)
+		{
+			const auto p = toVec3(vertices.data() + i * stride);
+			cube = cube.unionWith(BoundingBox{ p.x, p.y, p.z, p.x, p.y, p.z });
+		}
+		if (numVertices)
+		{
+			const float size = std::max({ cube.maxX - cube.minX, cube.maxY - cube.minY, cube.maxZ - cube.minZ });
+			cube.maxX = cube.minX + size;
+			cube.maxY = cube.minY + size;
+			cube.maxZ = cube.minZ + size;
+		}
+		const auto codes = computeMortonCodes(vertices.data(), numVertices, stride, cube);
+
+		// breadth first construction. pending are the points of the node octant that are not stored by ancestors
+		std::vector<PointCloudNode> nodes;
+		std::vector<std::vector<uint32_t>> nodePoints;
+		std::vector<std::vector<uint32_t>> pending;
+		nodes.push_back(PointCloudNode{ -BoundingBox::max(), 0, 0, 0, 0, 0 });
+		nodePoints.emplace_back();
+		pending.push_back(radixSortIndices(codes));
+		for (size_t n = 0; n < nodes.size(); ++n)
+		{
+			auto points = std::move(pending[n]);
+			pending[n] = std::vector<uint32_t>();
+			const auto level = nodes[n].level;
+			if (points.size() <= maxNodePoints || level == MaxPointCloudLevel)
+			{
+				nodePoints[n] = std::move(points);
+				continue;
+			}
+
+			// every step-th point in morton order is a uniform subsample
+			const size_t step = (points.size() + maxNodePoints - 1) / maxNodePoints;
+			std::vector<uint32_t> children[8];
+			const auto shift = 3 * (MaxPointCloudLevel - 1 - level);
+			for (size_t i = 0; i < points.size(); ++i)
+			{
+				if (i % step == 0) nodePoints[n].push_back(points[i]);
+				else children[(codes[points[i]] >> shift) & 7].push_back(points[i]);
+			}
+
+			nodes[n].firstChild = uint32_t(nodes.size());
+			for (auto& c : children)
+			{
+				if (c.empty()) continue;
+				nodes.push_back(PointCloudNode{ -BoundingBox::max(), 0, 0, level + 1, 0, 0 });
+				nodePoints.emplace_back();
+				pending.push_back(std::move(c));
+				++nodes[n].childCount;
+			}
+		}
+
+		// bounds from the children to the root
+		for (size_t n = nodes.size(); n-- > 0;)
+		{
+			auto& node = nodes[n];
+			node.pointCount = uint32_t(nodePoints[n].size());
+			for (auto i : nodePoints[n])
+			{
+				const float* v = vertices.data() + size_t(i) * stride;
+				float extent = 0.0f;
+				for (auto offset : extentOffsets)
+				{
+					if (offset >= 0) extent = std::max(extent, v[offset]);
+				}
+				node.bbox = node.bbox.unionWith(BoundingBox{ v[0] - extent, v[1] - extent, v[2] - extent, v[0] + extent, v[1] + extent, v[2] + extent });
+			}
+			for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; ++c)
+				node.bbox = node.bbox.unionWith(nodes[c].bbox);
+		}
+
+		// page aligned node data after the node table
+		const size_t vertexSize = stride * sizeof(float);
+		uint64_t offset = alignUp(getHeaderSize() + nodes.size() * sizeof(PointCloudNode), pageSize);
+		for (auto& node : nodes)
+		{
+			node.fileOffset = offset;
+			offset = alignUp(offset + node.pointCount * vertexSize, pageSize);
+		}
+
+		std::ofstream f(filename, std::ios::out | std::ios::binary);
+		if (!f)
+			throw std::runtime_error("writePointCloudHierarchy could not open " + filename);
+		f.write(PointCloudSignature, strlen(PointCloudSignature) + 1);
+		writeValue(f, PointCloudVersion);
+		writeValue(f, attributes);
+		writeValue(f, pageSize);
+		writeValue(f, uint32_t(nodes.size()));
+		f.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(PointCloudNode));
+
+		std::vector<float> nodeVertices;
+		const std::vector<char> padding(pageSize, 0);
+		uint64_t position = getHeaderSize() + nodes.size() * sizeof(PointCloudNode);
+		for (size_t n = 0; n < nodes.size(); ++n)
+		{
+			f.write(padding.data(), nodes[n].fileOffset - position);
+			nodeVertices.resize(nodePoints[n].size() * stride);
+			for (size_t i = 0; i < nodePoints[n].size(); ++i)
+			{
+				const auto src = vertices.begin() + size_t(nodePoints[n][i]) * stride;
+				std::copy(src, src + stride, nodeVertices.begin() + i * stride);
+			}
+			f.write(reinterpret_cast<const char*>(nodeVertices.data()), nodeVertices.size() * sizeof(float));
+			position = nodes[n].fileOffset + nodeVertices.size() * sizeof(float);
+		}
+		f.write("EOF", 3);
+		if (!f)
+			throw std::runtime_error("writePointCloudHierarchy could not write " + filename);
+	}
+
+	PointCloudReader::PointCloudReader(const std::string& filename, size_t memoryBudget)
+		:
+	m_file(filename, std::ios::in | std::ios::binary),
+	m_memoryBudget(memoryBudget)
+	{
+		if (!m_file)
+			throw std::runtime_error("PointCloudReader could not open " + filename);
+
+		std::string sig;
+		std::getline(m_file, sig, '\0');
+		if (sig != PointCloudSignature)
+			throw std::runtime_error("invalid file signature");
+		if (readValue<uint32_t>(m_file) != PointCloudVersion)
+			throw std::runtime_error("invalid file version");
+		m_attributes = readValue<uint32_t>(m_file);
+		readValue<uint32_t>(m_file); // page size
+		const auto numNodes = readValue<uint32_t>(m_file);
+		m_nodes.resize(numNodes);
+		m_file.read(reinterpret_cast<char*>(m_nodes.data()), numNodes * sizeof(PointCloudNode));
+		if (!m_file || numNodes == 0)
+			throw std::runtime_error("PointCloudReader invalid node table");
+
+		for (size_t i = 0; i < m_nodes.size(); ++i)
+		{
+			const auto& n = m_nodes[i];
+			if (n.childCount && (n.firstChild <= i || uint64_t(n.firstChild) + n.childCount > m_nodes.size()))
+				throw std::runtime_error("PointCloudReader node " + std::to_string(i) + " has invalid children");
+		}
+
+		m_nodeVertices.resize(numNodes);
+		m_loaded.resize(numNodes, 0);
+	}
+
+	void PointCloudReader::update(const glm::vec3& viewPosition, float minDetail)
+	{
+		const size_t vertexSize = getAttributeElementStride(m_attributes) * sizeof(float);
+		const auto getDetail = [&](uint32_t node)
+		{
+			const auto& box = m_nodes[node].bbox;
+			return getDiagonal(box) / std::max(getDistance(box, viewPosition), 1e-6f);
+		};
+
+		// most detailed nodes first. ties are resolved by the node index => deterministic
+		using Candidate = std::pair<float, uint32_t>;
+		const auto compare = [](const Candidate& a, const Candidate& b)
+		{
+			return a.first < b.first || (a.first == b.first && a.second > b.second);
+		};
+		std::priority_queue<Candidate, std::vector<Candidate>, decltype(compare)> candidates(compare);
+		candidates.push(Candidate(getDetail(0), 0));
+
+		m_selected.clear();
+		size_t remaining = m_memoryBudget;
+		while (!candidates.empty())
+		{
+			const auto c = candidates.top();
+			candidates.pop();
+			const auto& node = m_nodes[c.second];
+			const size_t size = node.pointCount * vertexSize;
+			if (size > remaining) continue;
+			if (c.second != 0 && c.first < minDetail) continue;
+
+			m_selected.push_back(c.second);
+			remaining -= size;
+			for (uint32_t i = node.firstChild; i < node.firstChild + node.childCount; ++i)
+				candidates.push(Candidate(getDetail(i), i));
+		}
+		std::sort(m_selected.begin(), m_selected.end());
+
+		// unload before loading => the memory usage stays below the budget
+		std::vector<uint8_t> isSelected(m_nodes.size(), 0);
+		for (auto n : m_selected) isSelected[n] = 1;
+		for (size_t n = 0; n < m_nodes.size(); ++n)
+		{
+			if (!m_loaded[n] || isSelected[n]) continue;
+			m_memoryUsage -= m_nodeVertices[n].size() * sizeof(float);
+			m_nodeVertices[n] = std::vector<float>();
+			m_loaded[n] = 0;
+		}
+
+		// the node data is ordered by node index => sequential reads
+		for (auto n : m_selected)
+		{
+			if (m_loaded[n]) continue;
+			auto& vertices = m_nodeVertices[n];
+			vertices.resize(m_nodes[n].pointCount * (vertexSize / sizeof(float)));
+			m_file.seekg(std::streamoff(m_nodes[n].fileOffset));
+			m_file.read(reinterpret_cast<char*>(vertices.data()), vertices.size() * sizeof(float));
+			if (!m_file)
+				throw std::runtime_error("PointCloudReader could not read node " + std::to_string(n));
+			m_memoryUsage += vertices.size() * sizeof(float);
+			m_loaded[n] = 1;
+		}
+	}
+
+	const std::vector<float>& PointCloudReader::getNodeVertices(uint32_t node) const
+	{
+		if (node >= m_nodes.size() || !m_loaded[node])
+			throw std::runtime_error("PointCloudReader node " + std::to_string(node) + " is not loaded");
+		return m_nodeVertices[node];
+	}
+
+	BinaryMesh PointCloudReader::toBinaryMesh() const
+	{
+		std::vector<float> vertices;
+		vertices.reserve(m_memoryUsage / sizeof(float));
+		for (auto n : m_selected)
+			vertices.insert(vertices.end(), m_nodeVertices[n].begin(), m_nodeVertices[n].end());
+
+		BinaryMesh res(m_attributes, std::move(vertices));
+		if (!res.getVertices().empty()) res.generateBoundingVolumes();
+		return res;
+	}
+}
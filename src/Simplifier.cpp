@@ -0,0 +1,538 @@
+#include "../include/bmf/Simplifier.h"
+#include "../include/bmf/VertexRemap.h"
+#include "../include/bmf/generators/glm.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// edge collapse simplification with quadric error metrics (Garland and Heckbert).
+// The vertex classification and collapse rules follow meshoptimizer's simplifier (Arseny Kapoulkine).
+namespace bmf
+{
+	namespace
+	{
+		constexpr uint32_t NoVertex = ~uint32_t(0);
+
+		enum VertexKind
+		{
+			// all edges have an opposite edge and the vertex has a single wedge
+			Manifold,
+			// the vertex has exactly one open incoming and outgoing edge and a single wedge
+			Border,
+			// two wedges with the same position and matching open edges (attribute seam)
+			Seam,
+			// all other cases (multiple borders, more than two wedges, ...)
+			Locked,
+			KindCount
+		};
+
+		// CanCollapse[k0][k1]: a vertex of kind k0 can be moved onto a vertex of kind k1
+		const bool CanCollapse[KindCount][KindCount] = {
+			{ true, true, true, true },
+			{ false, true, false, true },
+			{ false, false, true, true },
+			{ false, false, false, false },
+		};
+
+		// HasOpposite[k0][k1]: an edge between the kinds exists in both directions
+		const bool HasOpposite[KindCount][KindCount] = {
+			{ true, true, true, true },
+			{ true, false, true, false },
+			{ true, true, true, true },
+			{ true, false, true, false },
+		};
+
+		// the geometry of borders should be preserved more than the geometry of seams
+		constexpr float BorderEdgeWeight = 10.0f;
+		constexpr float SeamEdgeWeight = 1.0f;
+
+		/// \brief half edges of each vertex: the next and previous vertex in the triangle
+		struct EdgeAdjacency
+		{
+			struct Edge
+			{
+				uint32_t next;
+				uint32_t prev;
+			};
+
+			std::vector<uint32_t> offsets;
+			std::vector<uint32_t> counts;
+			std::vector<Edge> edges;
+
+			/// \param remap vertex ids are replaced by remap[id] (nullptr => no replacement)
+			void build(const uint32_t* indices, size_t numIndices, size_t numVertices, const uint32_t* remap)
+			{
+				const auto getVertex = [remap](uint32_t v) { return remap ? remap[v] : v; };
+
+				counts.assign(numVertices, 0);
+				for (size_t i = 0; i < numIndices; ++i)
+					++counts[getVertex(indices[i])];
+
+				offsets.resize(numVertices);
+				uint32_t offset = 0;
+				for (size_t v = 0; v < numVertices; ++v)
+				{
+					offsets[v] = offset;
+					offset += counts[v];
+				}
+
+				edges.resize(numIndices);
+				std::fill(counts.begin(), counts.end(), 0);
+				for (size_t i = 0; i < numIndices; i += 3)
+				{
+					const uint32_t tri[] = { getVertex(indices[i]), getVertex(indices[i + 1]), getVertex(indices[i + 2]) };
+					for (uint32_t e = 0; e < 3; ++e)
+					{
+						const auto v = tri[e];
+						edges[offsets[v] + counts[v]++] = Edge{ tri[(e + 1) % 3], tri[(e + 2) % 3] };
+					}
+				}
+			}
+
+			bool hasEdge(uint32_t from, uint32_t to) const
+			{
+				for (auto i = offsets[from], end = offsets[from] + counts[from]; i != end; ++i)
+				{
+					if (edges[i].next == to) return true;
+				}
+				return false;
+			}
+		};
+
+		/// \brief symmetric 4x4 matrix that sums the squared distances to weighted planes
+		struct Quadric
+		{
+			float a00 = 0.0f, a11 = 0.0f, a22 = 0.0f;
+			float a10 = 0.0f, a20 = 0.0f, a21 = 0.0f;
+			float b0 = 0.0f, b1 = 0.0f, b2 = 0.0f;
+			float c = 0.0f;
+			float w = 0.0f;
+
+			static Quadric fromPlane(const glm::vec3& n, float d, float weight)
+			{
+				Quadric q;
+				q.a00 = weight * n.x * n.x;
+				q.a11 = weight * n.y * n.y;
+				q.a22 = weight * n.z * n.z;
+				q.a10 = weight * n.y * n.x;
+				q.a20 = weight * n.z * n.x;
+				q.a21 = weight * n.z * n.y;
+				q.b0 = weight * n.x * d;
+				q.b1 = weight * n.y * d;
+				q.b2 = weight * n.z * d;
+				q.c = weight * d * d;
+				q.w = weight;
+				return q;
+			}
+
+			Quadric& operator+=(const Quadric& o)
+			{
+				a00 += o.a00; a11 += o.a11; a22 += o.a22;
+				a10 += o.a10; a20 += o.a20; a21 += o.a21;
+				b0 += o.b0; b1 += o.b1; b2 += o.b2;
+				c += o.c;
+				w += o.w;
+				return *this;
+			}
+
+			/// \brief weighted average of the squared distances of v to the planes
+			float getError(const glm::vec3& v) const
+			{
+				const float r =
+					a00 * v.x * v.x + a11 * v.y * v.y + a22 * v.z * v.z +
+					2.0f * (a10 * v.x * v.y + a20 * v.x * v.z + a21 * v.y * v.z) +
+					2.0f * (b0 * v.x + b1 * v.y + b2 * v.z) + c;
+				return w > 0.0f ? std::abs(r) / w : 0.0f;
+			}
+		};
+
+		struct Collapse
+		{
+			uint32_t v0;
+			uint32_t v1;
+			// the edge may be collapsed in both directions
+			bool bidirectional;
+			float error;
+		};
+
+		/// \brief determines the kind of each vertex and the open edge loops of borders and seams
+		/// \param loop next vertex of the open edge that starts at the vertex
+		/// \param loopback previous vertex of the open edge that ends at the vertex
+		void classifyVertices(std::vector<VertexKind>& kind, std::vector<uint32_t>& loop, std::vector<uint32_t>& loopback,
+			const EdgeAdjacency& adjacency, const std::vector<uint32_t>& remap, const std::vector<uint32_t>& wedge)
+		{
+			const auto numVertices = remap.size();
+			loop.assign(numVertices, NoVertex);
+			loopback.assign(numVertices, NoVertex);
+
+			// open edges (no opposite edge with the same vertices). the vertex itself marks multiple open edges
+			for (uint32_t v = 0; v < uint32_t(numVertices); ++v)
+			{
+				for (auto i = adjacency.offsets[v], end = adjacency.offsets[v] + adjacency.counts[v]; i != end; ++i)
+				{
+					const auto target = adjacency.edges[i].next;
+					if (adjacency.hasEdge(target, v)) continue;
+
+					loopback[target] = loopback[target] == NoVertex ? v : target;
+					loop[v] = loop[v] == NoVertex ? target : v;
+				}
+			}
+
+			kind.resize(numVertices);
+			for (uint32_t v = 0; v < uint32_t(numVertices); ++v)
+			{
+				if (remap[v] != v)
+				{
+					// the representative was classified before
+					kind[v] = kind[remap[v]];
+					continue;
+				}
+
+				if (wedge[v] == v)
+				{
+					const auto in = loopback[v];
+					const auto out = loop[v];
+					if (in == NoVertex && out == NoVertex) kind[v] = Manifold;
+					else if (in != NoVertex && in != v && out != NoVertex && out != v) kind[v] = Border;
+					else kind[v] = Locked;
+				}
+				else if (wedge[wedge[v]] == v)
+				{
+					// seams need one open edge in each direction for both wedges and the edges must connect
+					const auto w = wedge[v];
+					const auto inV = loopback[v], outV = loop[v], inW = loopback[w], outW = loop[w];
+					if (inV != NoVertex && inV != v && outV != NoVertex && outV != v &&
+						inW != NoVertex && inW != w && outW != NoVertex && outW != w &&
+						remap[inV] == remap[outW] && remap[outV] == remap[inW])
+						kind[v] = Seam;
+					else kind[v] = Locked;
+				}
+				else kind[v] = Locked;
+			}
+		}
+
+		void fillQuadrics(std::vector<Quadric>& quadrics, const std::vector<uint32_t>& indices,
+			const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& remap,
+			const std::vector<VertexKind>& kind, const std::vector<uint32_t>& loop, const std::vector<uint32_t>& loopback)
+		{
+			quadrics.assign(positions.size(), Quadric());
+
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				const uint32_t tri[] = { indices[i], indices[i + 1], indices[i + 2] };
+
+				// plane of the triangle weighted by its area
+				const auto& p0 = positions[tri[0]];
+				auto n = glm::cross(positions[tri[1]] - p0, positions[tri[2]] - p0);
+				const auto area = glm::length(n);
+				if (area > 0.0f)
+				{
+					n /= area;
+					const auto q = Quadric::fromPlane(n, -glm::dot(n, p0), area);
+					for (auto v : tri)
+						quadrics[remap[v]] += q;
+				}
+
+				// planes perpendicular to the triangle through border and seam edges
+				for (uint32_t e = 0; e < 3; ++e)
+				{
+					const auto i0 = tri[e];
+					const auto i1 = tri[(e + 1) % 3];
+					const auto i2 = tri[(e + 2) % 3];
+					const auto k0 = kind[i0];
+					const auto k1 = kind[i1];
+					const bool open0 = k0 == Border || k0 == Seam;
+					const bool open1 = k1 == Border || k1 == Seam;
+					if (!open0 && !open1) continue;
+					if (open0 && loop[i0] != i1) continue;
+					if (open1 && loopback[i1] != i0) continue;
+					// seam edges exist in both directions
+					if (HasOpposite[k0][k1] && remap[i1] > remap[i0]) continue;
+
+					const auto& e0 = positions[i0];
+					auto edge = positions[i1] - e0;
+					const auto length = glm::length(edge);
+					if (length == 0.0f) continue;
+					edge /= length;
+					// altitude of the triangle from i2 onto the edge
+					const auto toThird = positions[i2] - e0;
+					auto normal = toThird - edge * glm::dot(toThird, edge);
+					const auto normalLength = glm::length(normal);
+					if (normalLength == 0.0f) continue;
+					normal /= normalLength;
+
+					const auto weight = (k0 == Border || k1 == Border) ? BorderEdgeWeight : SeamEdgeWeight;
+					const auto q = Quadric::fromPlane(normal, -glm::dot(normal, e0), length * length * weight);
+					quadrics[remap[i0]] += q;
+					quadrics[remap[i1]] += q;
+				}
+			}
+		}
+
+		void pickEdgeCollapses(std::vector<Collapse>& collapses, const std::vector<uint32_t>& indices, size_t numIndices,
+			const std::vector<uint32_t>& remap, const std::vector<VertexKind>& kind, const std::vector<uint32_t>& loop)
+		{
+			collapses.clear();
+			for (size_t i = 0; i < numIndices; i += 3)
+			{
+				for (uint32_t e = 0; e < 3; ++e)
+				{
+					const auto i0 = indices[i + e];
+					const auto i1 = indices[i + (e + 1) % 3];
+
+					// zero length edges are kept to preserve the mesh integrity
+					if (remap[i0] == remap[i1]) continue;
+
+					const auto k0 = kind[i0];
+					const auto k1 = kind[i1];
+					if (!CanCollapse[k0][k1] && !CanCollapse[k1][k0]) continue;
+					// skip the second occurence of edges that exist in both directions
+					if (HasOpposite[k0][k1] && remap[i1] > remap[i0]) continue;
+					// border and seam vertices that are not directly connected belong to different edge loops
+					if (k0 == k1 && (k0 == Border || k0 == Seam) && loop[i0] != i1) continue;
+
+					if (CanCollapse[k0][k1] && CanCollapse[k1][k0])
+						collapses.push_back(Collapse{ i0, i1, true, 0.0f });
+					else if (CanCollapse[k0][k1])
+						collapses.push_back(Collapse{ i0, i1, false, 0.0f });
+					else
+						collapses.push_back(Collapse{ i1, i0, false, 0.0f });
+				}
+			}
+		}
+
+		void rankEdgeCollapses(std::vector<Collapse>& collapses, const std::vector<glm::vec3>& positions,
+			const std::vector<Quadric>& quadrics, const std::vector<uint32_t>& remap)
+		{
+			for (auto& c : collapses)
+			{
+				// pick the direction with the smaller error
+				const auto e0 = quadrics[remap[c.v0]].getError(positions[c.v1]);
+				const auto e1 = c.bidirectional ? quadrics[remap[c.v1]].getError(positions[c.v0]) : FLT_MAX;
+				if (e1 < e0) std::swap(c.v0, c.v1);
+				c.error = std::min(e0, e1);
+			}
+		}
+
+		bool hasTriangleFlip(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d)
+		{
+			// triangle a b c becomes triangle a b d
+			const auto eb = b - a;
+			return glm::dot(glm::cross(eb, c - a), glm::cross(eb, d - a)) <= 0.0f;
+		}
+
+		bool hasTriangleFlips(const EdgeAdjacency& adjacency, const std::vector<glm::vec3>& positions,
+			const std::vector<uint32_t>& collapseRemap, uint32_t r0, uint32_t r1)
+		{
+			for (auto i = adjacency.offsets[r0], end = adjacency.offsets[r0] + adjacency.counts[r0]; i != end; ++i)
+			{
+				const auto a = collapseRemap[adjacency.edges[i].next];
+				const auto b = collapseRemap[adjacency.edges[i].prev];
+				// this triangle will be collapsed
+				if (a == r1 || b == r1) continue;
+
+				if (hasTriangleFlip(positions[a], positions[b], positions[r0], positions[r1]))
+					return true;
+			}
+			return false;
+		}
+
+		/// \return number of performed collapses
+		size_t performEdgeCollapses(std::vector<uint32_t>& collapseRemap, std::vector<bool>& collapseLocked,
+			std::vector<Quadric>& quadrics, const std::vector<Collapse>& collapses, const std::vector<uint32_t>& order,
+			const std::vector<uint32_t>& remap, const std::vector<uint32_t>& wedge, const std::vector<VertexKind>& kind,
+			const std::vector<uint32_t>& loop, const std::vector<uint32_t>& loopback,
+			const std::vector<glm::vec3>& positions, const EdgeAdjacency& adjacency,
+			size_t triangleCollapseGoal, float errorLimit, float& resultError)
+		{
+			size_t edgeCollapses = 0;
+			size_t triangleCollapses = 0;
+
+			// collapses share vertices => many collapses are locked in this pass. the error is limited relative to the
+			// error of the last collapse that would be required to reach the goal if no collapse was locked
+			const auto edgeCollapseGoal = triangleCollapseGoal / 2;
+			const auto errorGoal = edgeCollapseGoal < collapses.size() ? 1.5f * collapses[order[edgeCollapseGoal]].error : FLT_MAX;
+
+			for (auto ci : order)
+			{
+				const auto& c = collapses[ci];
+				if (c.error > errorLimit) break;
+				if (triangleCollapses >= triangleCollapseGoal) break;
+				// each collapse locks about 6 other collapses => only stop if enough progress was made
+				if (c.error > errorGoal && triangleCollapses > triangleCollapseGoal / 6) break;
+
+				const auto i0 = c.v0;
+				const auto i1 = c.v1;
+				const auto r0 = remap[i0];
+				const auto r1 = remap[i1];
+
+				// vertices are moved at most once per pass and nothing is moved onto a moved vertex
+				if (collapseLocked[r0] || collapseLocked[r1]) continue;
+				if (hasTriangleFlips(adjacency, positions, collapseRemap, r0, r1)) continue;
+
+				if (kind[i0] == Seam)
+				{
+					// the other wedge moves along the other side of the seam
+					const auto s0 = wedge[i0];
+					const auto s1 = loop[i0] == i1 ? loopback[s0] : loop[s0];
+					if (s1 == NoVertex || remap[s1] != r1) continue;
+
+					collapseRemap[i0] = i1;
+					collapseRemap[s0] = s1;
+				}
+				else
+				{
+					collapseRemap[i0] = i1;
+				}
+
+				quadrics[r1] += quadrics[r0];
+				collapseLocked[r0] = true;
+				collapseLocked[r1] = true;
+
+				// border edges have one triangle, other edges two
+				triangleCollapses += kind[i0] == Border ? 1 : 2;
+				++edgeCollapses;
+				resultError = std::max(resultError, c.error);
+			}
+
+			return edgeCollapses;
+		}
+
+		void remapEdgeLoops(std::vector<uint32_t>& loop, const std::vector<uint32_t>& collapseRemap)
+		{
+			for (uint32_t v = 0; v < uint32_t(loop.size()); ++v)
+			{
+				if (loop[v] == NoVertex) continue;
+				const auto l = loop[v];
+				const auto r = collapseRemap[l];
+				// the seam edge was collapsed in the opposite direction of the loop
+				loop[v] = v == r ? loop[l] : r;
+			}
+		}
+
+		/// \return new number of indices
+		size_t remapIndexBuffer(std::vector<uint32_t>& indices, size_t numIndices, const std::vector<uint32_t>& collapseRemap)
+		{
+			size_t write = 0;
+			for (size_t i = 0; i < numIndices; i += 3)
+			{
+				const auto v0 = collapseRemap[indices[i]];
+				const auto v1 = collapseRemap[indices[i + 1]];
+				const auto v2 = collapseRemap[indices[i + 2]];
+
+				// skip collapsed triangles
+				if (v0 == v1 || v0 == v2 || v1 == v2) continue;
+
+				indices[write++] = v0;
+				indices[write++] = v1;
+				indices[write++] = v2;
+			}
+			return write;
+		}
+	}
+
+	template<class IndexT>
+	float simplify(std::vector<IndexT>& destination, const IndexT* indices, size_t numIndices,
+		const float* positions, size_t numVertices, size_t stride, size_t targetIndexCount, float maxError)
+	{
+		std::vector<uint32_t> result(indices, indices + numIndices - numIndices % 3);
+		auto numResult = result.size();
+
+		// positions normalized to the unit cube => the error is relative to the mesh extent
+		std::vector<glm::vec3> vertexPositions(numVertices);
+		glm::vec3 minPos(FLT_MAX);
+		glm::vec3 maxPos(-FLT_MAX);
+		for (size_t v = 0; v < numVertices; ++v)
+		{
+			vertexPositions[v] = toVec3(positions + v * stride);
+			minPos = glm::min(minPos, vertexPositions[v]);
+			maxPos = glm::max(maxPos, vertexPositions[v]);
+		}
+		const auto extent = std::max(maxPos.x - minPos.x, std::max(maxPos.y - minPos.y, maxPos.z - minPos.z));
+		const auto scale = extent > 0.0f ? 1.0f / extent : 0.0f;
+		for (auto& p : vertexPositions)
+			p = (p - minPos) * scale;
+
+		// remap[v] = first vertex with the same position, wedge[v] = next vertex with the same position (cyclic)
+		std::vector<uint32_t> remap;
+		const auto numUnique = generateVertexRemap(positions, numVertices, stride, 0, 3, remap);
+		{
+			std::vector<uint32_t> firstVertex(numUnique);
+			uint32_t curUnique = 0;
+			for (uint32_t v = 0; v < uint32_t(numVertices); ++v)
+			{
+				if (remap[v] == curUnique) firstVertex[curUnique++] = v;
+				remap[v] = firstVertex[remap[v]];
+			}
+		}
+		std::vector<uint32_t> wedge(numVertices);
+		for (uint32_t v = 0; v < uint32_t(numVertices); ++v)
+		{
+			wedge[v] = v;
+			if (remap[v] == v) continue;
+			wedge[v] = wedge[remap[v]];
+			wedge[remap[v]] = v;
+		}
+
+		EdgeAdjacency adjacency;
+		adjacency.build(result.data(), numResult, numVertices, nullptr);
+
+		std::vector<VertexKind> kind;
+		std::vector<uint32_t> loop;
+		std::vector<uint32_t> loopback;
+		classifyVertices(kind, loop, loopback, adjacency, remap, wedge);
+
+		std::vector<Quadric> quadrics;
+		fillQuadrics(quadrics, result, vertexPositions, remap, kind, loop, loopback);
+
+		std::vector<Collapse> collapses;
+		std::vector<uint32_t> order;
+		std::vector<uint32_t> collapseRemap(numVertices);
+		std::vector<bool> collapseLocked(numVertices);
+		const auto errorLimit = maxError * maxError;
+		float resultError = 0.0f;
+
+		while (numResult > targetIndexCount)
+		{
+			// adjacency of the current triangles on position level
+			adjacency.build(result.data(), numResult, numVertices, remap.data());
+
+			pickEdgeCollapses(collapses, result, numResult, remap, kind, loop);
+			if (collapses.empty()) break;
+			rankEdgeCollapses(collapses, vertexPositions, quadrics, remap);
+
+			order.resize(collapses.size());
+			for (uint32_t i = 0; i < uint32_t(order.size()); ++i)
+				order[i] = i;
+			std::stable_sort(order.begin(), order.end(), [&collapses](uint32_t a, uint32_t b)
+			{
+				return collapses[a].error < collapses[b].error;
+			});
+
+			for (uint32_t v = 0; v < uint32_t(numVertices); ++v)
+				collapseRemap[v] = v;
+			std::fill(collapseLocked.begin(), collapseLocked.end(), false);
+
+			const auto triangleCollapseGoal = (numResult - targetIndexCount) / 3;
+			const auto numCollapses = performEdgeCollapses(collapseRemap, collapseLocked, quadrics, collapses, order,
+				remap, wedge, kind, loop, loopback, vertexPositions, adjacency, triangleCollapseGoal, errorLimit, resultError);
+			// no edge can be collapsed anymore
+			if (numCollapses == 0) break;
+
+			remapEdgeLoops(loop, collapseRemap);
+			remapEdgeLoops(loopback, collapseRemap);
+			numResult = remapIndexBuffer(result, numResult, collapseRemap);
+		}
+
+		destination.resize(numResult);
+		std::transform(result.begin(), result.begin() + numResult, destination.begin(), [](uint32_t i)
+		{
+			return IndexT(i);
+		});
+
+		return std::sqrt(resultError);
+	}
+
+	template float simplify<uint16_t>(std::vector<uint16_t>&, const uint16_t*, size_t, const float*, size_t, size_t, size_t, float);
+	template float simplify<uint32_t>(std::vector<uint32_t>&, const uint32_t*, size_t, const float*, size_t, size_t, size_t, float);
+}
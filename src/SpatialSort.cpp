@@ -0,0 +1,112 @@
+#include "../include/bmf/SpatialSort.h"
+#include "../include/bmf/Parallel.h"
+#include <algorithm>
+#include <array>
+
+namespace bmf
+{
+	namespace
+	{
+		// minimum number of keys per thread
+		constexpr size_t RadixGrainSize = 65536;
+		constexpr uint32_t RadixBits = 8;
+		constexpr uint32_t RadixBuckets = 1u << RadixBits;
+
+		// inserts two zero bits between each of the lower 10 bits
+		uint32_t expandBits(uint32_t v)
+		{
+			v = (v * 0x00010001u) & 0xFF0000FFu;
+			v = (v * 0x00000101u) & 0x0F00F00Fu;
+			v = (v * 0x00000011u) & 0xC30C30C3u;
+			v = (v * 0x00000005u) & 0x49249249u;
+			return v;
+		}
+
+		uint32_t quantize(float v, float min, float max)
+		{
+			const float extent = max - min;
+			const float t = extent > 0.0f ? (v - min) / extent : 0.0f;
+			return uint32_t(std::min(std::max(t * 1024.0f, 0.0f), 1023.0f));
+		}
+	}
+
+	uint32_t getMortonCode(const glm::vec3& point, const BoundingBox& bounds)
+	{
+		return (expandBits(quantize(point.x, bounds.minX, bounds.maxX)) << 2) |
+			(expandBits(quantize(point.y, bounds.minY, bounds.maxY)) << 1) |
+			expandBits(quantize(point.z, bounds.minZ, bounds.maxZ));
+	}
+
+	std::vector<uint32_t> computeMortonCodes(const float* positions, size_t count, size_t stride, const BoundingBox& bounds)
+	{
+		std::vector<uint32_t> codes(count);
+		parallelFor(count, RadixGrainSize, [&](size_t begin, size_t end, size_t)
+		{
+			for (size_t i = begin; i != end; ++i)
+				codes[i] = getMortonCode(toVec3(positions + i * stride), bounds);
+		});
+		return codes;
+	}
+
+	std::vector<uint32_t> radixSortIndices(const std::vector<uint32_t>& keys)
+	{
+		const size_t count = keys.size();
+		std::vector<uint32_t> srcKeys = keys;
+		std::vector<uint32_t> srcIndices(count);
+		for (size_t i = 0; i < count; ++i)
+			srcIndices[i] = uint32_t(i);
+		std::vector<uint32_t> dstKeys(count);
+		std::vector<uint32_t> dstIndices(count);
+
+		// parallelFor assigns the same ranges to the same threads => the histograms match the scatter ranges
+		const auto numThreads = getNumThreads(count, RadixGrainSize);
+		std::vector<std::array<size_t, RadixBuckets>> offsets(numThreads);
+		for (uint32_t shift = 0; shift < 32; shift += RadixBits)
+		{
+			for (auto& o : offsets) o.fill(0);
+			parallelFor(count, RadixGrainSize, [&](size_t begin, size_t end, size_t thread)
+			{
+				auto& histogram = offsets[thread];
+				for (size_t i = begin; i != end; ++i)
+					++histogram[(srcKeys[i] >> shift) & (RadixBuckets - 1)];
+			});
+
+			// all keys have the same digit => nothing to do
+			bool skip = false;
+			for (uint32_t b = 0; b < RadixBuckets && !skip; ++b)
+			{
+				size_t sum = 0;
+				for (const auto& o : offsets) sum += o[b];
+				skip = sum == count;
+			}
+			if (skip) continue;
+
+			// exclusive prefix sum ordered by bucket and then by thread => stable
+			size_t sum = 0;
+			for (uint32_t b = 0; b < RadixBuckets; ++b)
+			{
+				for (auto& o : offsets)
+				{
+					const auto n = o[b];
+					o[b] = sum;
+					sum += n;
+				}
+			}
+
+			parallelFor(count, RadixGrainSize, [&](size_t begin, size_t end, size_t thread)
+			{
+				auto& offset = offsets[thread];
+				for (size_t i = begin; i != end; ++i)
+				{
+					const auto dst = offset[(srcKeys[i] >> shift) & (RadixBuckets - 1)]++;
+					dstKeys[dst] = srcKeys[i];
+					dstIndices[dst] = srcIndices[i];
+				}
+			});
+			std::swap(srcKeys, dstKeys);
+			std::swap(srcIndices, dstIndices);
+		}
+
+		return srcIndices;
+	}
+}
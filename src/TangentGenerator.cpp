@@ -0,0 +1,177 @@
+#include "../include/bmf/generators/TangentGenerator.h"
+#include "../include/bmf/generators/glm.h"
+#include "../include/bmf/Parallel.h"
+#include <cmath>
+
+namespace
+{
+	// projects v into the plane with the normal n and normalizes the result (zero if not possible)
+	glm::vec3 projectNormalized(const glm::vec3& v, const glm::vec3& n)
+	{
+		const auto p = v - n * glm::dot(n, v);
+		const auto len = glm::length(p);
+		return len > 0.0f ? p / len : glm::vec3(0.0f);
+	}
+
+	// texture space orientation of a triangle corner
+	enum Orientation : uint8_t
+	{
+		PositiveArea = 0,
+		NegativeArea = 1,
+		// zero area in texture space => no orientation vote
+		ZeroArea = 2
+	};
+}
+
+uint32_t bmf::TangentGenerator::getRequiredAttributes() const
+{
+	return Position | Normal | Texcoord0;
+}
+
+uint32_t bmf::TangentGenerator::getOutputAttribute(uint32_t inAttr) const
+{
+	return inAttr | Tangent | BiTangent;
+}
+
+void bmf::TangentGenerator::generate(uint32_t attributes, const std::vector<float>& vertices,
+	std::vector<uint32_t>& indices, std::vector<float>& outVertices) const
+{
+	const auto outAttributes = getOutputAttribute(attributes);
+	const auto stride = getAttributeElementStride(attributes);
+	const auto outStride = getAttributeElementStride(outAttributes);
+	const auto normalOffset = getAttributeElementOffset(attributes, Normal);
+	const auto texcoordOffset = getAttributeElementOffset(attributes, Texcoord0);
+	const auto tangentOffset = getAttributeElementOffset(outAttributes, Tangent);
+	const auto bitangentOffset = getAttributeElementOffset(outAttributes, BiTangent);
+	const auto numVertices = vertices.size() / stride;
+	const auto numIndices = indices.size();
+
+	// weighted tangent and orientation of each triangle corner
+	std::vector<glm::vec3> cornerTangents(numIndices);
+	std::vector<uint8_t> cornerOrientation(numIndices);
+
+	parallelFor(numIndices / 3, GrainSize, [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t t = begin * 3; t < end * 3; t += 3)
+		{
+			const float* v[] = {
+				&vertices[indices[t] * stride],
+				&vertices[indices[t + 1] * stride],
+				&vertices[indices[t + 2] * stride]
+			};
+			const auto e1 = toVec3(v[1]) - toVec3(v[0]);
+			const auto e2 = toVec3(v[2]) - toVec3(v[0]);
+			const auto du1 = v[1][texcoordOffset] - v[0][texcoordOffset];
+			const auto dv1 = v[1][texcoordOffset + 1] - v[0][texcoordOffset + 1];
+			const auto du2 = v[2][texcoordOffset] - v[0][texcoordOffset];
+			const auto dv2 = v[2][texcoordOffset + 1] - v[0][texcoordOffset + 1];
+
+			// signed area in texture space determines the orientation
+			const auto signedArea = du1 * dv2 - du2 * dv1;
+			const auto orientation = signedArea > 0.0f ? PositiveArea : (signedArea < 0.0f ? NegativeArea : ZeroArea);
+			// direction of increasing u
+			auto faceTangent = e1 * dv2 - e2 * dv1;
+			if (orientation == ZeroArea) faceTangent = glm::vec3(0.0f);
+			else if (orientation == NegativeArea) faceTangent = -faceTangent;
+
+			for (size_t i = 0; i < 3; ++i)
+			{
+				const auto n = toVec3(v[i] + normalOffset);
+				const auto p = toVec3(v[i]);
+
+				// corner angle in the tangent plane
+				const auto edge1 = projectNormalized(toVec3(v[(i + 1) % 3]) - p, n);
+				const auto edge2 = projectNormalized(toVec3(v[(i + 2) % 3]) - p, n);
+				const auto angle = std::acos(std::max(-1.0f, std::min(1.0f, glm::dot(edge1, edge2))));
+
+				cornerTangents[t + i] = projectNormalized(faceTangent, n) * angle;
+				cornerOrientation[t + i] = orientation;
+			}
+		}
+	});
+
+	std::vector<uint32_t> cornerStart;
+	std::vector<uint32_t> corners;
+	getVertexCorners(numVertices, indices, cornerStart, corners);
+
+	// output orientations of a vertex: the vertex is only split if positive and negative corners meet.
+	// zero area corners use the positive output if present (and the negative one otherwise)
+	const auto getOutputs = [&](size_t v, bool outputs[2])
+	{
+		bool used[3] = { false, false, false };
+		for (auto k = cornerStart[v], kEnd = cornerStart[v + 1]; k != kEnd; ++k)
+			used[cornerOrientation[corners[k]]] = true;
+		outputs[PositiveArea] = used[PositiveArea] || (used[ZeroArea] && !used[NegativeArea]);
+		outputs[NegativeArea] = used[NegativeArea];
+	};
+
+	// number of output vertices for each input vertex (one per orientation, zero if unused)
+	std::vector<uint32_t> outStart(numVertices + 1, 0);
+	parallelFor(numVertices, GrainSize, [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t v = begin; v < end; ++v)
+		{
+			bool outputs[2];
+			getOutputs(v, outputs);
+			outStart[v + 1] = uint32_t(outputs[0]) + uint32_t(outputs[1]);
+		}
+	});
+	for (size_t v = 0; v < numVertices; ++v)
+		outStart[v + 1] += outStart[v];
+
+	outVertices.resize(size_t(outStart[numVertices]) * outStride);
+
+	parallelFor(numVertices, GrainSize, [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t v = begin; v < end; ++v)
+		{
+			if (outStart[v] == outStart[v + 1]) continue; // unused vertex
+
+			bool used[2];
+			getOutputs(v, used);
+			// zero area corners have no tangent
+			glm::vec3 sum[2] = { glm::vec3(0.0f), glm::vec3(0.0f) };
+			for (auto k = cornerStart[v], kEnd = cornerStart[v + 1]; k != kEnd; ++k)
+			{
+				const auto c = corners[k];
+				if (cornerOrientation[c] != ZeroArea)
+					sum[cornerOrientation[c]] += cornerTangents[c];
+			}
+
+			const RefVertex src(attributes, const_cast<float*>(&vertices[v * stride]));
+			const auto n = toVec3(src.get(Normal));
+			uint32_t outIndex[2] = { 0, 0 };
+			auto curIndex = outStart[v];
+
+			for (size_t o = 0; o < 2; ++o)
+			{
+				if (!used[o]) continue;
+				outIndex[o] = curIndex;
+
+				float* dstData = &outVertices[size_t(curIndex) * outStride];
+				RefVertex dst(outAttributes, dstData);
+				src.copyAttributesTo(dst);
+
+				auto tangent = projectNormalized(sum[o], n);
+				if (tangent == glm::vec3(0.0f))
+				{
+					// no texture information => use any vector in the tangent plane
+					tangent = projectNormalized(std::abs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f), n);
+				}
+				const auto bitangent = glm::cross(n, tangent) * (o == 0 ? 1.0f : -1.0f);
+
+				toFloat3(tangent, dstData + tangentOffset);
+				toFloat3(bitangent, dstData + bitangentOffset);
+				++curIndex;
+			}
+
+			// each corner belongs to exactly one vertex => no synchronization needed
+			for (auto k = cornerStart[v], kEnd = cornerStart[v + 1]; k != kEnd; ++k)
+			{
+				const auto c = corners[k];
+				const uint8_t o = cornerOrientation[c] == ZeroArea ? uint8_t(used[PositiveArea] ? PositiveArea : NegativeArea) : cornerOrientation[c];
+				indices[c] = outIndex[o];
+			}
+		}
+	});
+}
@@ -0,0 +1,246 @@
+#include "../include/bmf/VertexRemap.h"
+#include "../include/bmf/Hash.h"
+#include "../include/bmf/Parallel.h"
+#include <cstring>
+#include <cmath>
+
+namespace bmf
+{
+	namespace
+	{
+		constexpr uint32_t EmptySlot = ~uint32_t(0);
+		// number of hash partitions for the parallel mode (uses the upper bits of the hash)
+		constexpr uint32_t PartitionBits = 8;
+		// minimum number of vertices per thread when hashing
+		constexpr size_t HashGrainSize = 65536;
+
+		struct Slot
+		{
+			uint64_t hash;
+			uint32_t index;
+		};
+
+		struct GridCell
+		{
+			int64_t coord[3];
+			// first vertex in this cell (linked list)
+			uint32_t head;
+		};
+
+		/// \brief open addressing hash table of grid cells
+		class HashGrid
+		{
+		public:
+			HashGrid(size_t maxCells)
+			{
+				size_t tableSize = 16;
+				while (tableSize < maxCells * 2) tableSize <<= 1;
+				m_mask = tableSize - 1;
+				m_cells.assign(tableSize, GridCell{ {0, 0, 0}, EmptySlot });
+			}
+
+			/// \brief returns the cell or nullptr if it does not exist and insert is false
+			GridCell* find(const int64_t* coord, bool insert)
+			{
+				uint64_t h = uint64_t(coord[0]) * 0x9e3779b97f4a7c15ull ^ uint64_t(coord[1]) * 0xc2b2ae3d27d4eb4full ^ uint64_t(coord[2]) * 0x165667b19e3779f9ull;
+				h ^= h >> 29;
+				for (auto slot = size_t(h) & m_mask; ; slot = (slot + 1) & m_mask)
+				{
+					auto& c = m_cells[slot];
+					if (c.head == EmptySlot)
+					{
+						if (!insert) return nullptr;
+						memcpy(c.coord, coord, sizeof(c.coord));
+						return &c;
+					}
+					if (memcmp(c.coord, coord, sizeof(c.coord)) == 0)
+						return &c;
+				}
+			}
+		private:
+			std::vector<GridCell> m_cells;
+			size_t m_mask;
+		};
+
+		/// \brief inserts vertices into an open addressing hash table (linear probing, load factor <= 0.5)
+		/// and calls onVertex(i, j) for each vertex i. j is the first vertex with the same key (j == i for new keys)
+		/// \param order vertex indices in ascending order (nullptr => 0 ... count - 1)
+		/// \param hashes precomputed hashes for all vertices (nullptr => calculate)
+		template<class OnVertex>
+		void insertVertices(const float* vertices, size_t stride, size_t keyOffset, size_t keyCount,
+			const uint32_t* order, const uint64_t* hashes, size_t count, std::vector<Slot>& table, OnVertex onVertex)
+		{
+			size_t tableSize = 16;
+			while (tableSize < count * 2) tableSize <<= 1;
+			const auto mask = tableSize - 1;
+			table.assign(tableSize, Slot{ 0, EmptySlot });
+			const auto keyBytes = keyCount * sizeof(float);
+
+			for (size_t n = 0; n < count; ++n)
+			{
+				const auto i = order ? order[n] : uint32_t(n);
+				const float* key = vertices + size_t(i) * stride + keyOffset;
+				const auto h = hashes ? hashes[i] : hashFloats(key, keyCount);
+
+				for (auto slot = size_t(h) & mask; ; slot = (slot + 1) & mask)
+				{
+					auto& s = table[slot];
+					if (s.index == EmptySlot)
+					{
+						s = Slot{ h, i };
+						onVertex(i, i);
+						break;
+					}
+					if (s.hash == h && memcmp(vertices + size_t(s.index) * stride + keyOffset, key, keyBytes) == 0)
+					{
+						onVertex(i, s.index);
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	uint32_t generateVertexRemap(const float* vertices, size_t numVertices, size_t stride,
+		size_t keyOffset, size_t keyCount, std::vector<uint32_t>& remap, bool parallel)
+	{
+		remap.resize(numVertices);
+		uint32_t numUnique = 0;
+
+		if (!parallel)
+		{
+			std::vector<Slot> table;
+			// single pass: the first occurrence of a key always gets the next free index
+			insertVertices(vertices, stride, keyOffset, keyCount, nullptr, nullptr, numVertices, table,
+				[&](uint32_t i, uint32_t first)
+			{
+				remap[i] = i == first ? numUnique++ : remap[first];
+			});
+			return numUnique;
+		}
+
+		// hash all vertices
+		std::vector<uint64_t> hashes(numVertices);
+		parallelFor(numVertices, HashGrainSize, [&](size_t begin, size_t end, size_t)
+		{
+			for (size_t i = begin; i < end; ++i)
+				hashes[i] = hashFloats(vertices + i * stride + keyOffset, keyCount);
+		});
+
+		// partition vertices by the upper hash bits (counting sort keeps the ascending vertex order)
+		constexpr uint32_t numPartitions = 1u << PartitionBits;
+		std::vector<uint32_t> partitionStart(numPartitions + 1, 0);
+		for (const auto h : hashes)
+			++partitionStart[(h >> (64 - PartitionBits)) + 1];
+		for (uint32_t p = 0; p < numPartitions; ++p)
+			partitionStart[p + 1] += partitionStart[p];
+
+		std::vector<uint32_t> order(numVertices);
+		{
+			auto curPartition = partitionStart;
+			for (size_t i = 0; i < numVertices; ++i)
+				order[curPartition[hashes[i] >> (64 - PartitionBits)]++] = uint32_t(i);
+		}
+
+		// equal keys are always in the same partition => partitions are independent.
+		// remap temporarily stores the first occurrence of each vertex
+		const auto numThreads = getNumThreads(numVertices, HashGrainSize);
+		parallelFor(numPartitions, (numPartitions + numThreads - 1) / numThreads, [&](size_t begin, size_t end, size_t)
+		{
+			std::vector<Slot> partitionTable;
+			for (size_t p = begin; p < end; ++p)
+			{
+				insertVertices(vertices, stride, keyOffset, keyCount, order.data() + partitionStart[p], hashes.data(),
+					partitionStart[p + 1] - partitionStart[p], partitionTable,
+					[&](uint32_t i, uint32_t first)
+				{
+					remap[i] = first;
+				});
+			}
+		});
+
+		// number unique vertices in the order of their first occurrence
+		for (size_t i = 0; i < numVertices; ++i)
+		{
+			remap[i] = remap[i] == i ? numUnique++ : remap[remap[i]];
+		}
+
+		return numUnique;
+	}
+
+	uint32_t generateWeldRemap(const float* vertices, size_t numVertices, size_t stride,
+		float positionEpsilon, const float* elementEpsilons, std::vector<uint32_t>& remap)
+	{
+		remap.resize(numVertices);
+		uint32_t numUnique = 0;
+
+		// cell size is twice the epsilon => the search box [p - epsilon, p + epsilon] touches at most 2 cells per axis
+		const float invCellSize = positionEpsilon > 0.0f ? 0.5f / positionEpsilon : 1.0f;
+		const float maxDistSq = positionEpsilon * positionEpsilon;
+		const auto toCell = [invCellSize](float v)
+		{
+			// clamp to avoid overflow for tiny epsilons
+			return int64_t(std::max(-1e18f, std::min(1e18f, std::floor(v * invCellSize))));
+		};
+
+		const auto matches = [&](const float* a, const float* b)
+		{
+			const float dx = a[0] - b[0];
+			const float dy = a[1] - b[1];
+			const float dz = a[2] - b[2];
+			if (dx * dx + dy * dy + dz * dz > maxDistSq) return false;
+
+			for (size_t e = 3; e < stride; ++e)
+			{
+				if (elementEpsilons[e] < 0.0f)
+				{
+					if (memcmp(a + e, b + e, sizeof(float)) != 0) return false;
+				}
+				else if (!(std::abs(a[e] - b[e]) <= elementEpsilons[e])) return false;
+			}
+			return true;
+		};
+
+		// only unique vertices are inserted into the grid
+		HashGrid grid(numVertices);
+		std::vector<uint32_t> next(numVertices, EmptySlot);
+
+		for (size_t i = 0; i < numVertices; ++i)
+		{
+			const float* v = vertices + i * stride;
+			const int64_t cell[] = { toCell(v[0]), toCell(v[1]), toCell(v[2]) };
+			const int64_t minCell[] = { toCell(v[0] - positionEpsilon), toCell(v[1] - positionEpsilon), toCell(v[2] - positionEpsilon) };
+			const int64_t maxCell[] = { toCell(v[0] + positionEpsilon), toCell(v[1] + positionEpsilon), toCell(v[2] + positionEpsilon) };
+
+			// search all cells that overlap the epsilon box for the first matching vertex
+			auto best = EmptySlot;
+			for (int64_t z = minCell[2]; z <= maxCell[2]; ++z)
+			for (int64_t y = minCell[1]; y <= maxCell[1]; ++y)
+			for (int64_t x = minCell[0]; x <= maxCell[0]; ++x)
+			{
+				const int64_t neighbor[] = { x, y, z };
+				const auto c = grid.find(neighbor, false);
+				if (!c) continue;
+
+				for (auto j = c->head; j != EmptySlot; j = next[j])
+				{
+					if (j < best && matches(vertices + size_t(j) * stride, v))
+						best = j;
+				}
+			}
+
+			if (best != EmptySlot)
+			{
+				remap[i] = remap[best];
+				continue;
+			}
+
+			remap[i] = numUnique++;
+			auto c = grid.find(cell, true);
+			next[i] = c->head;
+			c->head = uint32_t(i);
+		}
+
+		return numUnique;
+	}
+}